@@ -235,15 +235,24 @@ static int testLastDirectorySectorWithWeakBits(
     unsigned char track, unsigned char se)
 {
     unsigned char gcr[GCRBUFSIZE];
+    unsigned char gcrtrack[GCRTRACKSIZE];
     char trackmap[21+1];
+    void *state;
     int st, i;
 
+    state = calloc(1, target->state_size);
+    if(state == NULL)
+    {
+        my_message_cb(0, "no memory for transfer state");
+        return -1;
+    }
+
     SETSTATEDEBUG((void)0);
     // warp write
     send_turbo(fd_cbm, cbm_drive, 1, 1, setup.drive_type == cbm_dt_cbm1541 ? 0 : 1);
 
     SETSTATEDEBUG((void)0);
-    if(target->open_disk(fd_cbm, &setup, (void*)(ULONG_PTR)cbm_drive, 1,
+    if(target->open_disk(state, fd_cbm, &setup, (void*)(ULONG_PTR)cbm_drive, 1,
                       turbo_routine_starter, my_message_cb) == 0)
     {
         for(i=0; i<GCRBUFSIZE; i++)
@@ -257,8 +266,8 @@ static int testLastDirectorySectorWithWeakBits(
         printGcrBuffer(gcr, 0);
 
         SETSTATEDEBUG((void)0);
-        st = target->write_block(track, se, gcr, GCRBUFSIZE-1, 0);
-        target->close_disk();
+        st = target->write_block(state, track, se, gcr, GCRBUFSIZE-1, 0);
+        target->close_disk(state);
 
         if(st)
         {
@@ -272,22 +281,26 @@ static int testLastDirectorySectorWithWeakBits(
         send_turbo(fd_cbm, cbm_drive, 0, 1, setup.drive_type == cbm_dt_cbm1541 ? 0 : 1);
 
         SETSTATEDEBUG((void)0);
-        if(target->open_disk(fd_cbm, &setup, (void*)(ULONG_PTR)cbm_drive, 0,
+        if(target->open_disk(state, fd_cbm, &setup, (void*)(ULONG_PTR)cbm_drive, 0,
                           turbo_routine_starter, my_message_cb) == 0)
         {
             // set up the map with sectors to copy
             memset(trackmap, bs_dont_copy, sizeof(trackmap));
             trackmap[se] = bs_must_copy;
             SETSTATEDEBUG((void)0);
-            target->send_track_map(track, trackmap, 1);
+            target->send_track_map(state, track, trackmap, 1);
 
             SETSTATEDEBUG((void)0);
-            st = target->read_gcr_block(&se, gcr);
-            target->close_disk();
+            target->read_gcr_track(state, 1, gcrtrack);
+            target->close_disk(state);
+
+            st = gcrtrack[1];
+            memcpy(gcr, gcrtrack + 2, GCRBUFSIZE);
 
             if(st)
             {
                 my_message_cb(1, "failed to read back block (%d)", st);
+                free(state);
                 return -1;
             }
 
@@ -299,10 +312,12 @@ static int testLastDirectorySectorWithWeakBits(
             printf("\nRead back weak bit area XOR'ed with input vector");
             printGcrBuffer(gcr, 1);
 
+            free(state);
             return 0;
         }
     }
     my_message_cb(0, "can't open target");
+    free(state);
     return -1;
 }
 
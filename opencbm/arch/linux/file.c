@@ -9,6 +9,7 @@
 
 #include "arch.h"
 
+#include <stdio.h>
 #include <sys/stat.h>
 
 
@@ -44,3 +45,34 @@ int arch_filesize(const char *Filename, off_t *Filesize)
 
     return ret;
 }
+
+/*! \brief Rename a file, replacing an existing one
+
+ This function renames a file. If a file with the new name
+ already exists, it is replaced atomically; the renamed file
+ gets the permissions of the replaced one.
+
+ \param OldName
+   Name of the file to be renamed.
+
+ \param NewName
+   The new name of the file.
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+
+int arch_rename_replace(const char *OldName, const char *NewName)
+{
+    struct stat statrec;
+
+    if (stat(NewName, &statrec) == 0)
+    {
+        if (chmod(OldName, statrec.st_mode & 07777) != 0)
+        {
+            /* ignore it */
+        }
+    }
+
+    return rename(OldName, NewName);
+}
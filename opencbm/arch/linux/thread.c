@@ -0,0 +1,233 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file arch/linux/thread.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Threads, mutexes and condition variables
+**
+****************************************************************/
+
+#include "arch.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+
+/*! \brief a thread */
+struct arch_thread_s
+{
+    pthread_t Thread;              /*!< the POSIX thread */
+    ARCH_THREAD_FUNCTION Function; /*!< the function to execute */
+    void *Context;                 /*!< the parameter for Function */
+};
+
+/*! \brief a mutex */
+struct arch_mutex_s
+{
+    pthread_mutex_t Mutex;         /*!< the POSIX mutex */
+};
+
+/*! \brief a condition variable */
+struct arch_cond_s
+{
+    pthread_cond_t Cond;           /*!< the POSIX condition variable */
+};
+
+/*! \internal \brief start routine of all threads
+
+ The Ctrl+C handler is left to the main thread, as it might
+ wait for the other threads to terminate.
+*/
+static void *
+thread_start(void *Arg)
+{
+    arch_thread_t thread = Arg;
+    sigset_t set;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    thread->Function(thread->Context);
+    return NULL;
+}
+
+/*! \brief Create and start a thread
+
+ \param Thread
+   Pointer to a location which gets the thread.
+
+ \param Function
+   The function which is executed by the thread.
+
+ \param Context
+   The parameter which is given to Function.
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+int
+arch_thread_create(arch_thread_t *Thread, ARCH_THREAD_FUNCTION Function, void *Context)
+{
+    arch_thread_t thread = malloc(sizeof(*thread));
+
+    if (thread == NULL)
+        return 1;
+
+    thread->Function = Function;
+    thread->Context = Context;
+
+    if (pthread_create(&thread->Thread, NULL, thread_start, thread) != 0)
+    {
+        free(thread);
+        return 1;
+    }
+
+    *Thread = thread;
+    return 0;
+}
+
+/*! \brief Wait for a thread to terminate, and free it
+
+ \param Thread
+   The thread, as returned by arch_thread_create().
+*/
+void
+arch_thread_join(arch_thread_t Thread)
+{
+    pthread_join(Thread->Thread, NULL);
+    free(Thread);
+}
+
+/*! \brief Create a mutex
+
+ \param Mutex
+   Pointer to a location which gets the mutex.
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+int
+arch_mutex_create(arch_mutex_t *Mutex)
+{
+    arch_mutex_t mutex = malloc(sizeof(*mutex));
+
+    if (mutex == NULL)
+        return 1;
+
+    if (pthread_mutex_init(&mutex->Mutex, NULL) != 0)
+    {
+        free(mutex);
+        return 1;
+    }
+
+    *Mutex = mutex;
+    return 0;
+}
+
+/*! \brief Free a mutex
+
+ \param Mutex
+   The mutex, as returned by arch_mutex_create().
+*/
+void
+arch_mutex_destroy(arch_mutex_t Mutex)
+{
+    pthread_mutex_destroy(&Mutex->Mutex);
+    free(Mutex);
+}
+
+/*! \brief Lock a mutex
+
+ \param Mutex
+   The mutex, as returned by arch_mutex_create().
+*/
+void
+arch_mutex_lock(arch_mutex_t Mutex)
+{
+    pthread_mutex_lock(&Mutex->Mutex);
+}
+
+/*! \brief Unlock a mutex
+
+ \param Mutex
+   The mutex, as returned by arch_mutex_create().
+*/
+void
+arch_mutex_unlock(arch_mutex_t Mutex)
+{
+    pthread_mutex_unlock(&Mutex->Mutex);
+}
+
+/*! \brief Create a condition variable
+
+ \param Cond
+   Pointer to a location which gets the condition variable.
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+int
+arch_cond_create(arch_cond_t *Cond)
+{
+    arch_cond_t cond = malloc(sizeof(*cond));
+
+    if (cond == NULL)
+        return 1;
+
+    if (pthread_cond_init(&cond->Cond, NULL) != 0)
+    {
+        free(cond);
+        return 1;
+    }
+
+    *Cond = cond;
+    return 0;
+}
+
+/*! \brief Free a condition variable
+
+ \param Cond
+   The condition variable, as returned by arch_cond_create().
+*/
+void
+arch_cond_destroy(arch_cond_t Cond)
+{
+    pthread_cond_destroy(&Cond->Cond);
+    free(Cond);
+}
+
+/*! \brief Wait on a condition variable
+
+ \param Cond
+   The condition variable, as returned by arch_cond_create().
+
+ \param Mutex
+   The mutex which protects the condition. It must be locked
+   by the caller; it is unlocked while waiting.
+*/
+void
+arch_cond_wait(arch_cond_t Cond, arch_mutex_t Mutex)
+{
+    pthread_cond_wait(&Cond->Cond, &Mutex->Mutex);
+}
+
+/*! \brief Wake up the threads waiting on a condition variable
+
+ \param Cond
+   The condition variable, as returned by arch_cond_create().
+*/
+void
+arch_cond_signal(arch_cond_t Cond)
+{
+    pthread_cond_broadcast(&Cond->Cond);
+}
@@ -50,3 +50,23 @@ int arch_filesize(const char *Filename, off_t *Filesize)
 
     return ret;
 }
+
+/*! \brief Rename a file, replacing an existing one
+
+ This function renames a file. If a file with the new name
+ already exists, it is replaced.
+
+ \param OldName
+   Name of the file to be renamed.
+
+ \param NewName
+   The new name of the file.
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+
+int arch_rename_replace(const char *OldName, const char *NewName)
+{
+    return MoveFileEx(OldName, NewName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file arch/windows/thread.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Threads, mutexes and condition variables
+**
+** Condition variables need Windows Vista or newer.
+**
+****************************************************************/
+
+#include <windows.h>
+
+#include "arch.h"
+
+#include <stdlib.h>
+
+/*! \brief a thread */
+struct arch_thread_s
+{
+    HANDLE Thread;                 /*!< the Windows thread */
+    ARCH_THREAD_FUNCTION Function; /*!< the function to execute */
+    void *Context;                 /*!< the parameter for Function */
+};
+
+/*! \brief a mutex */
+struct arch_mutex_s
+{
+    CRITICAL_SECTION Mutex;        /*!< the critical section */
+};
+
+/*! \brief a condition variable */
+struct arch_cond_s
+{
+    CONDITION_VARIABLE Cond;       /*!< the Windows condition variable */
+};
+
+/*! \internal \brief start routine of all threads */
+static DWORD WINAPI
+thread_start(LPVOID Arg)
+{
+    arch_thread_t thread = Arg;
+
+    thread->Function(thread->Context);
+    return 0;
+}
+
+/*! \brief Create and start a thread
+
+ \param Thread
+   Pointer to a location which gets the thread.
+
+ \param Function
+   The function which is executed by the thread.
+
+ \param Context
+   The parameter which is given to Function.
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+int
+arch_thread_create(arch_thread_t *Thread, ARCH_THREAD_FUNCTION Function, void *Context)
+{
+    arch_thread_t thread = malloc(sizeof(*thread));
+
+    if (thread == NULL)
+        return 1;
+
+    thread->Function = Function;
+    thread->Context = Context;
+
+    thread->Thread = CreateThread(NULL, 0, thread_start, thread, 0, NULL);
+    if (thread->Thread == NULL)
+    {
+        free(thread);
+        return 1;
+    }
+
+    *Thread = thread;
+    return 0;
+}
+
+/*! \brief Wait for a thread to terminate, and free it
+
+ \param Thread
+   The thread, as returned by arch_thread_create().
+*/
+void
+arch_thread_join(arch_thread_t Thread)
+{
+    WaitForSingleObject(Thread->Thread, INFINITE);
+    CloseHandle(Thread->Thread);
+    free(Thread);
+}
+
+/*! \brief Create a mutex
+
+ \param Mutex
+   Pointer to a location which gets the mutex.
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+int
+arch_mutex_create(arch_mutex_t *Mutex)
+{
+    arch_mutex_t mutex = malloc(sizeof(*mutex));
+
+    if (mutex == NULL)
+        return 1;
+
+    InitializeCriticalSection(&mutex->Mutex);
+
+    *Mutex = mutex;
+    return 0;
+}
+
+/*! \brief Free a mutex
+
+ \param Mutex
+   The mutex, as returned by arch_mutex_create().
+*/
+void
+arch_mutex_destroy(arch_mutex_t Mutex)
+{
+    DeleteCriticalSection(&Mutex->Mutex);
+    free(Mutex);
+}
+
+/*! \brief Lock a mutex
+
+ \param Mutex
+   The mutex, as returned by arch_mutex_create().
+*/
+void
+arch_mutex_lock(arch_mutex_t Mutex)
+{
+    EnterCriticalSection(&Mutex->Mutex);
+}
+
+/*! \brief Unlock a mutex
+
+ \param Mutex
+   The mutex, as returned by arch_mutex_create().
+*/
+void
+arch_mutex_unlock(arch_mutex_t Mutex)
+{
+    LeaveCriticalSection(&Mutex->Mutex);
+}
+
+/*! \brief Create a condition variable
+
+ \param Cond
+   Pointer to a location which gets the condition variable.
+
+ \return
+   0 on success, everything else denotes an error.
+*/
+int
+arch_cond_create(arch_cond_t *Cond)
+{
+    arch_cond_t cond = malloc(sizeof(*cond));
+
+    if (cond == NULL)
+        return 1;
+
+    InitializeConditionVariable(&cond->Cond);
+
+    *Cond = cond;
+    return 0;
+}
+
+/*! \brief Free a condition variable
+
+ \param Cond
+   The condition variable, as returned by arch_cond_create().
+*/
+void
+arch_cond_destroy(arch_cond_t Cond)
+{
+    free(Cond);
+}
+
+/*! \brief Wait on a condition variable
+
+ \param Cond
+   The condition variable, as returned by arch_cond_create().
+
+ \param Mutex
+   The mutex which protects the condition. It must be locked
+   by the caller; it is unlocked while waiting.
+*/
+void
+arch_cond_wait(arch_cond_t Cond, arch_mutex_t Mutex)
+{
+    SleepConditionVariableCS(&Cond->Cond, &Mutex->Mutex, INFINITE);
+}
+
+/*! \brief Wake up the threads waiting on a condition variable
+
+ \param Cond
+   The condition variable, as returned by arch_cond_create().
+*/
+void
+arch_cond_signal(arch_cond_t Cond)
+{
+    WakeAllConditionVariable(&Cond->Cond);
+}
@@ -0,0 +1,45 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file arch/windows/timer.c \n
+** \author OpenCBM team \n
+** \n
+** \brief A clock for measuring time intervals
+**
+****************************************************************/
+
+#include <windows.h>
+
+#include "arch.h"
+
+/*! \brief Get the current time of a monotonic clock
+
+ \return
+   The time in microseconds, from an arbitrary starting point.
+   The value wraps around; the difference of two values is
+   valid, though, as long as it fits into an unsigned long.
+*/
+unsigned long
+arch_time_usec(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&counter);
+
+    return (unsigned long) (counter.QuadPart / frequency.QuadPart * 1000000
+        + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
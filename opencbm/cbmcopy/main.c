@@ -49,13 +49,16 @@ static void my_message_cb(cbmcopy_severity_e severity,
         "Debug"
     };
 
+    char message[200];
+
     if(verbosity >= severity)
     {
-        fprintf(stderr, "[%s] ", severities[severity]);
+        /* in one go, as the files are stored by a thread of their own */
         va_start(args, format);
-        vfprintf(stderr, format, args);
+        arch_vsnprintf(message, sizeof(message), format, args);
         va_end(args);
-        fprintf(stderr, "\n");
+        message[sizeof(message) - 1] = '\0';
+        fprintf(stderr, "[%s] %s\n", severities[severity], message);
     }
 }
 
@@ -121,6 +124,10 @@ static void help(const char *prog)
 "Options for writing:\n"
 "  -f, --file-type            specify CBM file type (D,P,S,U)\n"
 "  -R, --raw                  skip test for PC64 (.p00) and T64 input file\n"
+"\n"
+"When reading, FILE may contain the wildcards `*' and `?', and may end with\n"
+"`,T' to select a file type. Then, the directory is read once, and all files\n"
+"which match are copied in one go, e.g. `cbmcopy -r 8 \"*\"'.\n"
 "\n", prog);
 }
 
@@ -151,6 +158,99 @@ static void ARCH_SIGNALDECL reset(int dummy)
 }
 
 
+/* the name of the file which gets a CBM file, malloc()'d */
+static char *make_fs_name(const char *name, char type)
+{
+    const char *ext;
+    char *fs_name;
+    char *tail;
+
+    switch(tolower(type))
+    {
+        case 'd': ext = "del"; break;
+        case 's': ext = "seq"; break;
+        case 'u': ext = "usr"; break;
+        default : ext = "prg"; break;
+    }
+
+    fs_name = malloc(strlen(name) + strlen(ext) + 2);
+    if(fs_name)
+    {
+        sprintf(fs_name, "%s.%s", name, ext);
+        for(tail = fs_name; *tail; tail++)
+        {
+            if(*tail == '/') *tail = '_';
+        }
+    }
+    return fs_name;
+}
+
+static int save_file(const char *fs_name, unsigned char *filedata,
+                     size_t filesize, int address)
+{
+    FILE *file;
+    int rv = 0;
+
+    file = fopen(fs_name, "wb");
+    if(file)
+    {
+        if(filedata)
+        {
+            if(address >= 0 && filesize > 1)
+            {
+                filedata[0] = address % 0x100;
+                filedata[1] = address / 0x100;
+
+                my_message_cb( sev_debug,
+                               "override address: $%02x%02x",
+                               filedata[1], filedata[0] );
+            }
+            if(fwrite(filedata, filesize, 1, file) != 1)
+            {
+                my_message_cb(sev_warning,
+                              "could not write %s: %s",
+                              fs_name, arch_strerror(arch_get_errno()));
+                rv = -1;
+            }
+        }
+        fclose(file);
+    }
+    else
+    {
+        my_message_cb(sev_warning,
+                      "could not open %s: %s",
+                      fs_name, arch_strerror(arch_get_errno()));
+        rv = -1;
+    }
+    return rv;
+}
+
+/* called by cbmcopy_read_files() for every file, see there */
+static int store_file(void *context, const char *cbmname, char type,
+                      unsigned char *filedata, size_t filedata_size)
+{
+    char name[17];
+    char *fs_name;
+    int rv = -1;
+
+    strncpy(name, cbmname, 16);
+    name[16] = '\0';
+    cbm_petscii2ascii(name);
+
+    fs_name = make_fs_name(name, type);
+    if(fs_name)
+    {
+        my_message_cb( sev_info, "read %s -> %s", name, fs_name );
+        rv = save_file(fs_name, filedata, filedata_size, *(int *)context);
+        free(fs_name);
+    }
+    if(filedata)
+    {
+        free(filedata);
+    }
+    return rv;
+}
+
 extern input_reader cbmwrite_raw;
 extern input_reader cbmwrite_pc64;
 extern input_reader cbmwrite_t64;
@@ -186,12 +286,13 @@ int ARCH_MAINDECL main(int argc, char **argv)
     int rv;
     int i;
     int write;
+    int batch = 0;
+    char **patterns;
     cbmcopy_settings *settings;
     char auto_name[17];
     char auto_type = '\0';
     char output_type = '\0';
     char *tail;
-    char *ext;
     char *adapter = NULL;
 
     unsigned char drive;
@@ -435,6 +536,23 @@ int ARCH_MAINDECL main(int argc, char **argv)
         return 1;
     }
 
+    /* with wildcards, all files are read in one go */
+    if(!write)
+    {
+        for(i = optind + 1; i < argc; i++)
+        {
+            if(strpbrk(argv[i], "*?"))
+            {
+                batch = 1;
+            }
+        }
+        if(batch && output_name)
+        {
+            my_message_cb(sev_fatal, "--output cannot be used with wildcards");
+            return 1;
+        }
+    }
+
     rv = cbm_driver_open_ex( &fd, adapter );
     cbmlibmisc_strfree(adapter);
 
@@ -453,6 +571,41 @@ int ARCH_MAINDECL main(int argc, char **argv)
 
         arch_set_ctrlbreak_handler(reset);
 
+        if(batch)
+        {
+            patterns = calloc(num_files, sizeof(*patterns));
+            for(i = 0; patterns && i < num_files; i++)
+            {
+                patterns[i] = arch_strdup(argv[optind + 1 + i]);
+                if(patterns[i] == NULL)
+                {
+                    break;
+                }
+                cbm_ascii2petscii(patterns[i]);
+            }
+            if(patterns == NULL || i < num_files)
+            {
+                cbm_driver_close( fd );
+                my_message_cb(sev_fatal, "Out of memory");
+                exit(1);
+            }
+
+            rv = cbmcopy_read_files(fd, settings, drive,
+                                    (const char * const *) patterns, num_files,
+                                    my_message_cb, my_status_cb,
+                                    store_file, &address);
+            printf("\n");
+
+            for(i = 0; i < num_files; i++)
+            {
+                free(patterns[i]);
+            }
+            free(patterns);
+
+            /* nothing left for the loop below */
+            optind = argc;
+        }
+
         while(++optind < argc)
         {
             fname = argv[optind];
@@ -559,35 +712,25 @@ int ARCH_MAINDECL main(int argc, char **argv)
                 if(output_name)
                 {
                     fs_name = arch_strdup(output_name);
+                    if(fs_name)
+                    {
+                        for(tail = fs_name; *tail; tail++)
+                        {
+                            if(*tail == '/') *tail = '_';
+                        }
+                    }
                 }
                 else
                 {
                     tail = strrchr(fname, ',');
-
-                    ext = "prg"; /* default */
-
                     if(tail)
                     {
                         *tail++ = '\0';
-                        switch(*tail)
-                        {
-                            case 'd': ext = "del"; break;
-                            case 's': ext = "seq"; break;
-                            case 'u': ext = "usr"; break;
-                        }
                     }
-                    fs_name = malloc(strlen(fname) + strlen(ext) + 2);
-                    if(fs_name) sprintf(fs_name, "%s.%s", fname, ext);
+                    fs_name = make_fs_name(fname, tail ? *tail : 'p');
                 }
 
-                if(fs_name)
-                {
-                    for(tail = fs_name; *tail; tail++)
-                    {
-                        if(*tail == '/') *tail = '_';
-                    }
-                }
-                else
+                if(fs_name == NULL)
                 {
                     /* should not happen... */
                     cbm_driver_close( fd );
@@ -604,35 +747,7 @@ int ARCH_MAINDECL main(int argc, char **argv)
                     rv = cbm_device_status( fd, drive, buf, sizeof(buf) );
                     my_message_cb( rv ? sev_warning : sev_info, "%s", buf );
 
-                    file = fopen(fs_name, "wb");
-                    if(file)
-                    {
-                        if(filedata)
-                        {
-                            if(address >= 0 && filesize > 1)
-                            {
-                                filedata[0] = address % 0x100;
-                                filedata[1] = address / 0x100;
-
-                                my_message_cb( sev_debug,
-                                               "override address: $%02x%02x",
-                                               filedata[1], filedata[0] );
-                            }
-                            if(fwrite(filedata, filesize, 1, file) != 1)
-                            {
-                                my_message_cb(sev_warning,
-                                              "could not write %s: %s",
-                                              fs_name, arch_strerror(arch_get_errno()));
-                            }
-                        }
-                        fclose(file);
-                    }
-                    else
-                    {
-                        my_message_cb(sev_warning,
-                                      "could not open %s: %s",
-                                      fs_name, arch_strerror(arch_get_errno()));
-                    }
+                    save_file(fs_name, filedata, filesize, address);
 
                     if(filedata)
                     {
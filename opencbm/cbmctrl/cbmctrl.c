@@ -1036,7 +1036,9 @@ static int do_command(CBM_FILE fd, OPTIONS * const options)
  */
 static int do_dir(CBM_FILE fd, OPTIONS * const options)
 {
-    char c, buf[40];
+    char buf[40];
+    int c;
+    cbm_stream_t *stream;
     struct command_spec {
         char * str;
         char * filename;
@@ -1075,31 +1077,31 @@ static int do_dir(CBM_FILE fd, OPTIONS * const options)
     {
         if(cbm_device_status(fd, command.device, buf, sizeof(buf)) == 0)
         {
-            cbm_talk(fd, command.device, 0);
-            if(cbm_raw_read(fd, buf, 2) == 2)
+            stream = cbm_stream_open_talk(fd, command.device, 0);
+            if(stream && cbm_stream_read(stream, buf, 2) == 2)
             {
-                while(cbm_raw_read(fd, buf, 2) == 2)
+                while(cbm_stream_read(stream, buf, 2) == 2)
                 {
-                    if(cbm_raw_read(fd, buf, 2) == 2)
+                    if(cbm_stream_read(stream, buf, 2) == 2)
                     {
                         printf("%u ", (unsigned char)buf[0] | (unsigned char)buf[1] << 8 );
-                        while((cbm_raw_read(fd, &c, 1) == 1) && c)
+                        while((c = cbm_stream_getc(stream)) > 0)
                         {
                             if (options->petsciiraw == PA_PETSCII)
-                                putchar(cbm_petscii2ascii_c(c));
+                                putchar(cbm_petscii2ascii_c((char) c));
                             else
                                 putchar(c);
                         }
                         putchar('\n');
                     }
                 }
-                cbm_untalk(fd);
+                cbm_stream_close(stream);
                 cbm_device_status(fd, command.device, buf, sizeof(buf));
                 printf("%s", cbm_petscii2ascii(buf));
             }
             else
             {
-                cbm_untalk(fd);
+                cbm_stream_close(stream);
             }
 
         }
@@ -1182,15 +1184,37 @@ static int do_test_updown(CBM_FILE fd, OPTIONS * const options)
 static int do_download(CBM_FILE fd, OPTIONS * const options)
 {
     unsigned char unit;
-    unsigned short c;
+    unsigned int c;
     int addr, count, rv = 0;
     char *tail, buf[256];
+    char *fastbuf = NULL;
     FILE *f;
 
     char *tmpstring;
 
-    if (skip_options(options))
-        return 1;
+    int fast = 0;
+    int ch;
+    static const char short_options[] = "+f";
+    static struct option long_options[] =
+    {
+        {"fast", no_argument, NULL, 'f'},
+        {NULL,   no_argument, NULL, 0  }
+    };
+
+    // first of all, process the options given
+
+    while ((ch = process_individual_option(options, short_options, long_options)) != EOF)
+    {
+        switch (ch)
+        {
+        case 'f':
+            fast = 1;
+            break;
+
+        default:
+            return 1;
+        }
+    }
 
     // process the drive number (unit)
 
@@ -1230,22 +1254,49 @@ static int do_download(CBM_FILE fd, OPTIONS * const options)
         return 1;
 
 
-    // download in chunks of sizeof(buf) (currently: 256) bytes
-    while(count > 0)
+    // with --fast, download everything at once
+
+    if (fast && count > 0)
     {
-        show_monkey(count / sizeof(buf));
+        fastbuf = malloc(count);
+        if (fastbuf == NULL)
+        {
+            arch_error(0, arch_get_errno(), "could not allocate %d bytes", count);
+            fclose(f);
+            return 1;
+        }
+    }
 
-        c = (count > sizeof(buf)) ? sizeof(buf) : count;
+    // else, download in chunks of sizeof(buf) (currently: 256) bytes
+    while(count > 0)
+    {
+        if (fastbuf)
+        {
+            c = count;
 
-        if (c + (addr & 0xFF) > 0x100) {
-            c = 0x100 - (addr & 0xFF);
+            if ((int) c != cbm_download_fast(fd, unit, addr, fastbuf, c))
+            {
+                rv = 1;
+                fprintf(stderr, "A transfer error occurred!\n");
+                break;
+            }
         }
-
-        if(c != cbm_download(fd, unit, addr, buf, c))
+        else
         {
-            rv = 1;
-            fprintf(stderr, "A transfer error occurred!\n");
-            break;
+            show_monkey(count / sizeof(buf));
+
+            c = (count > sizeof(buf)) ? sizeof(buf) : count;
+
+            if (c + (addr & 0xFF) > 0x100) {
+                c = 0x100 - (addr & 0xFF);
+            }
+
+            if ((int) c != cbm_download(fd, unit, addr, buf, c))
+            {
+                rv = 1;
+                fprintf(stderr, "A transfer error occurred!\n");
+                break;
+            }
         }
 
         // If the user wants to convert them from PETSCII, do this
@@ -1254,17 +1305,19 @@ static int do_download(CBM_FILE fd, OPTIONS * const options)
 
         if (options->petsciiraw == PA_PETSCII)
         {
-            int i;
+            unsigned int i;
+            char *p = fastbuf ? fastbuf : buf;
             for (i = 0; i < c; i++)
-                buf[i] = cbm_petscii2ascii_c(buf[i]);
+                p[i] = cbm_petscii2ascii_c(p[i]);
         }
 
-        fwrite(buf, 1, c, f);
+        fwrite(fastbuf ? fastbuf : buf, 1, c, f);
 
         addr  += c;
         count -= c;
     }
 
+    free(fastbuf);
     fclose(f);
     return rv;
 }
@@ -1749,9 +1802,13 @@ static struct prog prog_table[] =
         "<filespec> can be used to restrict the number of files. wildcards\n"
         "           are allowed, but drive limitations apply." },
 
-    {1, "download", PA_RAW,     do_download, "<device> <adr> <count> [<file>]",
+    {1, "download", PA_RAW,     do_download, "[-f|--fast] <device> <adr> <count> [<file>]",
         "download memory contents from the floppy drive",
         "With this command, you can get data from the floppy drive memory.\n"
+        "-f, --fast: upload a dump routine and read with the s1 protocol,\n"
+        "         instead of one M-R command per 256 bytes. This works\n"
+        "         with 1541, 1570 and 1571 drives. It changes the drive\n"
+        "         memory from $0500 on.\n"
         "<device> is the device number of the drive.\n"
         "<adr>    is the starting address of the memory region to get.\n"
         "         it can be given in decimal or in hex (with a 0x prefix).\n"
@@ -1762,7 +1819,9 @@ static struct prog prog_table[] =
         "         contents will be written to stdout, normally the console.\n\n"
         "Example:\n"
         " cbmctrl download 8 0xc000 0x4000 1541ROM.BIN\n"
-        " * reads the 1541 ROM (from $C000 to $FFFF) from drive 8 into 1541ROM.BIN" },
+        " * reads the 1541 ROM (from $C000 to $FFFF) from drive 8 into 1541ROM.BIN\n"
+        " cbmctrl download --fast 8 0 0x800 1541RAM.BIN\n"
+        " * reads the 2 KB RAM of drive 8 into 1541RAM.BIN" },
 
     {1, "upload"  , PA_RAW,     do_upload  , "<device> <adr> [<file>]",
         "upload memory contents to the floppy drive",
@@ -0,0 +1,276 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+*/
+
+/*
+ * Convert a trace file, as written by the OpenCBM tools if the environment
+ * variable OPENCBM_TRACE is set, into a timeline. The events of all
+ * threads are merged in the order of their time stamps.
+ */
+
+#include "opencbm.h"
+#include "statedebug.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "libmisc.h"
+
+/* one event of the trace */
+typedef struct trace_event_s
+{
+    long Time;          /* relative to the first event of the file */
+    unsigned Thread;
+    unsigned Line;
+    int BlockCount;
+    int ByteCount;
+    int BitCount;
+    char *File;
+} trace_event_t;
+
+static void help()
+{
+    printf(
+        "Usage: cbmtrace [OPTION]... FILE\n"
+        "Show the trace written by the OpenCBM tools as a timeline\n"
+        "\n"
+        "  -h, --help                 display this help and exit\n"
+        "  -V, --version              display version information and exit\n"
+        "\n"
+        "  -l, --last=N               show only the last N events\n"
+        "\n"
+        "To record a trace, set the environment variable " STATEDEBUG_ENVIRONMENT "\n"
+        "to the name of the file before starting the tool, e.g.:\n"
+        "\n"
+        "  " STATEDEBUG_ENVIRONMENT "=d64copy.trc d64copy 8 image.d64\n"
+        "\n"
+        );
+}
+
+static void hint(char *s)
+{
+    fprintf(stderr, "Try `%s' -h for more information.\n", s);
+}
+
+static int get32(FILE *f, unsigned long *value)
+{
+    unsigned char b[4];
+
+    if (fread(b, 1, sizeof(b), f) != sizeof(b))
+        return 1;
+
+    *value = b[0] | ((unsigned long) b[1] << 8) | ((unsigned long) b[2] << 16) | ((unsigned long) b[3] << 24);
+    return 0;
+}
+
+static int get16(FILE *f, unsigned *value)
+{
+    unsigned char b[2];
+
+    if (fread(b, 1, sizeof(b), f) != sizeof(b))
+        return 1;
+
+    *value = b[0] | (b[1] << 8);
+    return 0;
+}
+
+/* the counters are stored as 32 bit two's complement */
+static int to_signed(unsigned long value)
+{
+    value &= 0xfffffffful;
+    return value & 0x80000000ul ? -(int) (0xfffffffful - value) - 1 : (int) value;
+}
+
+static int compare_events(const void *a, const void *b)
+{
+    const trace_event_t *ea = a;
+    const trace_event_t *eb = b;
+
+    if (ea->Time != eb->Time)
+        return ea->Time < eb->Time ? -1 : 1;
+
+    if (ea->Thread != eb->Thread)
+        return ea->Thread < eb->Thread ? -1 : 1;
+
+    /* keep the order within a thread */
+    return ea < eb ? -1 : ea > eb;
+}
+
+/*
+ * Read all events of the file; returns the number of events or -1 on error.
+ * Lost is set to the number of events the rings did not hold anymore.
+ */
+static long read_trace(FILE *f, const char *name, trace_event_t **Events, unsigned long *Lost)
+{
+    char magic[sizeof(STATEDEBUG_FILE_MAGIC) - 1];
+    unsigned long rings;
+    unsigned long ring;
+    unsigned long first_time = 0;
+    int have_first = 0;
+    trace_event_t *events = NULL;
+    long count = 0;
+
+    *Lost = 0;
+
+    if (fread(magic, 1, sizeof(magic), f) != sizeof(magic)
+        || memcmp(magic, STATEDEBUG_FILE_MAGIC, sizeof(magic)) != 0
+        || get32(f, &rings))
+    {
+        fprintf(stderr, "%s: not a trace file\n", name);
+        return -1;
+    }
+
+    for (ring = 0; ring < rings; ring++)
+    {
+        unsigned long thread, total, stored, n;
+        trace_event_t *more;
+
+        if (get32(f, &thread) || get32(f, &total) || get32(f, &stored) || stored > total)
+            break;
+
+        *Lost += total - stored;
+
+        more = realloc(events, (count + stored) * sizeof(*events));
+        if (more == NULL && stored > 0)
+        {
+            fprintf(stderr, "out of memory\n");
+            break;
+        }
+        events = more;
+
+        for (n = 0; n < stored; n++)
+        {
+            trace_event_t *event = &events[count];
+            unsigned long time, line, block, byte, bit;
+            unsigned length;
+
+            if (get32(f, &time) || get32(f, &line) || get32(f, &block)
+                || get32(f, &byte) || get32(f, &bit) || get16(f, &length))
+                break;
+
+            event->File = malloc(length + 1);
+            if (event->File == NULL || fread(event->File, 1, length, f) != length)
+            {
+                free(event->File);
+                break;
+            }
+            event->File[length] = '\0';
+
+            /* the time stamps wrap around after 2^32 us; count relative to the first one */
+            if (!have_first)
+            {
+                first_time = time;
+                have_first = 1;
+            }
+
+            event->Time = to_signed(time - first_time);
+            event->Thread = (unsigned) thread;
+            event->Line = (unsigned) line;
+            event->BlockCount = to_signed(block);
+            event->ByteCount = to_signed(byte);
+            event->BitCount = to_signed(bit);
+            count++;
+        }
+
+        if (n < stored)
+            break;
+    }
+
+    if (ring < rings)
+        fprintf(stderr, "%s: the file is truncated\n", name);
+
+    *Events = events;
+    return count;
+}
+
+int ARCH_MAINDECL main(int argc, char *argv[])
+{
+    trace_event_t *events = NULL;
+    unsigned long lost;
+    long count;
+    long last = -1;
+    long start;
+    long i;
+    FILE *f;
+    int option;
+
+    static const struct option longopts[] =
+    {
+        { "help"       , no_argument      , NULL, 'h' },
+        { "version"    , no_argument      , NULL, 'V' },
+        { "last"       , required_argument, NULL, 'l' },
+        { NULL         , 0                , NULL, 0   }
+    };
+
+    static const char shortopts[] ="hVl:";
+
+    while ((option = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1)
+    {
+        switch(option)
+        {
+            case 'h': help();
+                      return 0;
+            case 'V': printf("cbmtrace %s\n", OPENCBM_VERSION);
+                      return 0;
+            case 'l': last = atol(optarg);
+                      break;
+            default : hint(argv[0]);
+                      return 1;
+        }
+    }
+
+    if (optind + 1 != argc)
+    {
+        fprintf(stderr, "Usage: %s [OPTION]... FILE\n", argv[0]);
+        hint(argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[optind], "rb");
+    if (f == NULL)
+    {
+        arch_error(0, arch_get_errno(), "%s", argv[optind]);
+        return 1;
+    }
+
+    count = read_trace(f, argv[optind], &events, &lost);
+    fclose(f);
+
+    if (count < 0)
+        return 1;
+
+    qsort(events, count, sizeof(*events), compare_events);
+
+    start = (last >= 0 && last < count) ? count - last : 0;
+
+    if (lost > 0)
+        printf("%lu older events have been overwritten.\n", lost);
+
+    printf("%10s %10s %3s %6s %6s %4s  %s\n",
+           "time/us", "delta/us", "thr", "block", "byte", "bit", "site");
+
+    for (i = start; i < count; i++)
+    {
+        const trace_event_t *event = &events[i];
+        long delta = i > start ? event->Time - events[i - 1].Time : 0;
+
+        printf("%10ld %10ld %3u %6d %6d %4d  %s:%u\n",
+               event->Time - events[0].Time, delta, event->Thread,
+               event->BlockCount, event->ByteCount, event->BitCount,
+               event->File, event->Line);
+    }
+
+    for (i = 0; i < count; i++)
+        free(events[i].File);
+    free(events);
+
+    return 0;
+}
@@ -40,6 +40,7 @@ static void help()
 {
     printf(
 "Usage: d64copy [OPTION]... [SOURCE] [TARGET]\n"
+"       d64copy [OPTION]... --tune DRIVE\n"
 "Copy .d64 disk images to a CBM-1541 or compatible drive and vice versa\n"
 "\n"
 "Options:\n"
@@ -65,7 +66,8 @@ static void help()
 "                            connected to the IEC bus;\n"
 "                            `parallel' needs a XP1541/XP1571 cable in addition\n"
 "                            to the serial one.\n"
-"                            `auto' tries to determine the best option.\n"
+"                            `auto' tries to determine the best option, or\n"
+"                            uses the result of `--tune', if available.\n"
 "\n"
 "  -i, --interleave=VALUE    set interleave value; ignored when reading with\n"
 "                            warp mode; default values are:\n"
@@ -111,6 +113,20 @@ static void help()
 "  -2, --two-sided           two-sided disk transfer (.d71): Requires 1571.\n"
 "                            Warp mode is not available for .d71 images.\n"
 "\n"
+"      --atomic              write the image into a temporary file first, and\n"
+"                            rename it when the transfer is done; this way,\n"
+"                            there is never a half-written image file.\n"
+"\n"
+"      --turbo-loader        send the turbo to the drive over the transfer\n"
+"                            protocol instead of with M-W; experimental.\n"
+"\n"
+"      --tune                read track 18 of the disk in DRIVE with all\n"
+"                            transfer modes which are possible, with and\n"
+"                            without warp, and with several interleaves, and\n"
+"                            remember the fastest combination for the adapter\n"
+"                            and the drive in the configuration file. `auto'\n"
+"                            uses it for later transfers. The disk is only read.\n"
+"\n"
 );
 }
 
@@ -192,6 +208,133 @@ static int my_status_cb(d64copy_status status)
 }
 
 
+/*
+ * The result of --tune is stored in the configuration file as a setting
+ * of the adapter, named "d64copy-<drive>", with the value
+ * "<transfer mode>,<warp>,<interleave>", e.g. "serial2,1,9".
+ */
+static char *tune_entry_name(int drive)
+{
+    return cbmlibmisc_sprintf("d64copy-%d", drive);
+}
+
+static char *tune_entry_value(const d64copy_settings *settings)
+{
+    char *modes = d64copy_get_transfer_modes();
+    char *value = NULL;
+    char *m;
+    int i;
+
+    for(i = 0, m = modes; modes && *m; i++, m += strlen(m) + 1)
+    {
+        if(i == settings->transfer_mode)
+        {
+            value = cbmlibmisc_sprintf("%s,%d,%d", m, settings->warp,
+                                       settings->interleave);
+            break;
+        }
+    }
+
+    free(modes);
+    return value;
+}
+
+/*
+ * use the result of --tune for an `auto' transfer; the user's choices
+ * of warp and interleave are kept. The interleave has been measured for
+ * reading only.
+ */
+static int tune_load(const char *adapter, int drive, int reading, d64copy_settings *settings)
+{
+    char *entry = tune_entry_name(drive);
+    char value[40];
+    char *warp;
+    char *interleave;
+    int mode;
+    int error = 1;
+
+    do
+    {
+        if(entry == NULL || cbm_adapter_configuration_get(adapter, entry, value, sizeof(value)))
+        {
+            break;
+        }
+
+        warp = strchr(value, ',');
+        if(warp == NULL)
+        {
+            break;
+        }
+        *warp++ = '\0';
+
+        interleave = strchr(warp, ',');
+        if(interleave == NULL)
+        {
+            break;
+        }
+        *interleave++ = '\0';
+
+        mode = d64copy_get_transfer_mode_index(value);
+        if(mode <= 0)
+        {
+            break;
+        }
+
+        settings->transfer_mode = mode;
+
+        if(reading)
+        {
+            if(settings->warp == -1)
+            {
+                settings->warp = atoi(warp);
+            }
+            if(settings->interleave == -1)
+            {
+                settings->interleave = atoi(interleave);
+            }
+        }
+
+        my_message_cb(sev_info, "using the tuned transfer mode %s", value);
+        error = 0;
+
+    } while(0);
+
+    cbmlibmisc_strfree(entry);
+
+    return error;
+}
+
+static int tune(const char *adapter, d64copy_settings *settings, int drive)
+{
+    char *entry;
+    char *value;
+    int error;
+
+    if(d64copy_tune(fd_cbm, settings, drive, my_message_cb))
+    {
+        my_message_cb(sev_fatal, "no turbo transfer mode works, is there a disk in the drive?");
+        return 1;
+    }
+
+    entry = tune_entry_name(drive);
+    value = tune_entry_value(settings);
+
+    printf("%s=%s\n", entry ? entry : "", value ? value : "");
+
+    error = entry == NULL || value == NULL
+        || cbm_adapter_configuration_set(adapter, entry, value);
+
+    if(error)
+    {
+        my_message_cb(sev_fatal, "could not store the result in the configuration file");
+    }
+
+    cbmlibmisc_strfree(value);
+    cbmlibmisc_strfree(entry);
+
+    return error;
+}
+
 static void ARCH_SIGNALDECL reset(int dummy)
 {
     CBM_FILE fd_cbm_local;
@@ -229,6 +372,7 @@ int ARCH_MAINDECL main(int argc, char *argv[])
 
     int src_is_cbm;
     int dst_is_cbm;
+    int do_tune = 0;
 
     struct option longopts[] =
     {
@@ -250,6 +394,9 @@ int ARCH_MAINDECL main(int argc, char *argv[])
         { "retry-count", required_argument, NULL, 'r' },
         { "two-sided"  , no_argument      , NULL, '2' },
         { "error-map"  , required_argument, NULL, 'E' },
+        { "atomic"     , no_argument      , &settings->atomic_write, 1 },
+        { "turbo-loader", no_argument     , &settings->turbo_loader, 1 },
+        { "tune"       , no_argument      , &do_tune, 1 },
         { NULL         , 0                , NULL, 0   }
     };
 
@@ -333,7 +480,7 @@ int ARCH_MAINDECL main(int argc, char *argv[])
                           exit(1);
                       }
                       break;
-            case 0:   break; // needed for --no-warp
+            case 0:   break; // needed for --no-warp, --atomic, --turbo-loader and --tune
             default : hint(argv[0]);
                       return 1;
         }
@@ -358,6 +505,34 @@ int ARCH_MAINDECL main(int argc, char *argv[])
 
     my_message_cb(3, "transfer mode is %d", settings->transfer_mode );
 
+    if(do_tune)
+    {
+        if(optind + 1 != argc || !is_cbm(argv[optind]))
+        {
+            fprintf(stderr, "Usage: %s [OPTION]... --tune DRIVE\n", argv[0]);
+            hint(argv[0]);
+            return 1;
+        }
+
+        if(cbm_driver_open_ex(&fd_cbm, adapter) == 0)
+        {
+            arch_set_ctrlbreak_handler(reset);
+
+            rv = tune(adapter, settings, atoi(argv[optind]));
+
+            cbm_driver_close(fd_cbm);
+        }
+        else
+        {
+            arch_error(0, arch_get_errno(), "%s", cbm_get_driver_name_ex(adapter));
+        }
+
+        cbmlibmisc_strfree(adapter);
+        free(settings);
+
+        return rv;
+    }
+
     if(optind + 2 != argc)
     {
         fprintf(stderr, "Usage: %s [OPTION]... [SOURCE] [TARGET]\n", argv[0]);
@@ -383,10 +558,15 @@ int ARCH_MAINDECL main(int argc, char *argv[])
          * If the user specified auto transfer mode, find out
          * which transfer mode to use.
          */
-        settings->transfer_mode =
-            d64copy_check_auto_transfer_mode(fd_cbm,
-                settings->transfer_mode,
-                atoi(src_is_cbm ? src_arg : dst_arg));
+        if(settings->transfer_mode != 0 ||
+           tune_load(adapter, atoi(src_is_cbm ? src_arg : dst_arg),
+                     src_is_cbm, settings))
+        {
+            settings->transfer_mode =
+                d64copy_check_auto_transfer_mode(fd_cbm,
+                    settings->transfer_mode,
+                    atoi(src_is_cbm ? src_arg : dst_arg));
+        }
 
         my_message_cb(3, "decided to use transfer mode %d", settings->transfer_mode );
 
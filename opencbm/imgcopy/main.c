@@ -106,6 +106,10 @@ static void help(void)
 "\n"
 "  -2, --two-sided          two-sided disk transfer (.d82): Requires CBM-8250 or SFD-1001.\n"
 "\n"
+"      --atomic             write the image into a temporary file first, and\n"
+"                           rename it when the transfer is done; this way,\n"
+"                           there is never a half-written image file.\n"
+"\n"
 );
 }
 
@@ -262,6 +266,7 @@ int ARCH_MAINDECL main(int argc, char *argv[])
         { "one-sided"  , no_argument      , NULL, '1' },
         { "two-sided"  , no_argument      , NULL, '2' },
         { "error-map"  , required_argument, NULL, 'E' },
+        { "atomic"     , no_argument      , &settings->atomic_write, 1 },
         { NULL         , 0                , NULL, 0   }
     };
 
@@ -384,7 +389,7 @@ int ARCH_MAINDECL main(int argc, char *argv[])
                           exit(1);
                       }
                       break;
-            case 0:   break; // needed for --no-warp
+            case 0:   break; // needed for --no-warp and --atomic
             default : hint(argv[0]);
                       return 1;
         }
@@ -28,6 +28,49 @@ typedef struct PARBURST_RW_VALUE {
     int length;
 } PARBURST_RW_VALUE;
 
+/* all values needed by BLOCK_READ and BLOCK_WRITE */
+typedef struct BLOCK_RW_VALUE {
+    unsigned char *buffer;
+    int length;
+    int protocol;   /* one of CBM_BLOCK_PROTOCOL_* */
+} BLOCK_RW_VALUE;
+
+/* the protocols of the drive programs; the same as OPENCBM_PROTOCOL_* */
+#define CBM_BLOCK_PROTOCOL_S1     1 /* serial-1 */
+#define CBM_BLOCK_PROTOCOL_S2     2 /* serial-2 */
+#define CBM_BLOCK_PROTOCOL_PP_DC  3 /* parallel, d64copy variant */
+#define CBM_BLOCK_PROTOCOL_PP_CC  4 /* parallel, cbmcopy variant */
+
+/* the ring of tracks read with parallel burst, which user space gets
+ * with mmap() of the device: the header is at offset 0, the tail at
+ * CBM_TRACK_RING_TAIL_OFFSET, slot i at CBM_TRACK_RING_SLOT_OFFSET(i).
+ * The driver fills slot (head % SLOTS) and increments head; user space
+ * takes slot (tail % SLOTS) and increments tail when it is done with it.
+ * The header belongs to the driver and can only be mapped read-only;
+ * the tail has a page of its own, so that it can be mapped writable.
+ * Both are 64 KiB apart, so that they are on different pages even with
+ * the largest page size. */
+#define CBM_TRACK_RING_SLOTS      8
+#define CBM_TRACK_RING_SLOT_SIZE  0x2000
+#define CBM_TRACK_RING_PAGE_SIZE  0x10000
+#define CBM_TRACK_RING_TAIL_OFFSET CBM_TRACK_RING_PAGE_SIZE
+#define CBM_TRACK_RING_SLOT_OFFSET(_i) \
+    (2 * CBM_TRACK_RING_PAGE_SIZE + (_i) * CBM_TRACK_RING_SLOT_SIZE)
+#define CBM_TRACK_RING_SIZE       CBM_TRACK_RING_SLOT_OFFSET(CBM_TRACK_RING_SLOTS)
+
+typedef struct CBM_TRACK_RING_HEADER {
+    unsigned int head;  /* tracks put into the ring by the driver */
+    int result[CBM_TRACK_RING_SLOTS]; /* as returned by PARBURST_READ_TRACK */
+} CBM_TRACK_RING_HEADER;
+
+typedef struct CBM_TRACK_RING_TAIL {
+    unsigned int tail;  /* tracks taken out of the ring by user space */
+} CBM_TRACK_RING_TAIL;
+
+/* the argument of PARBURST_READ_TRACK_RING */
+#define CBM_TRACK_RING_FIXED      0 /* like PARBURST_READ_TRACK */
+#define CBM_TRACK_RING_VAR        1 /* like PARBURST_READ_TRACK_VAR */
+
 #define CBMCTRL_BASE        0xcb
 
 #define CBMCTRL_TALK        _IOW(CBMCTRL_BASE, 0, int)
@@ -55,4 +98,15 @@ typedef struct PARBURST_RW_VALUE {
 #define CBMCTRL_PARBURST_WRITE_TRACK _IOW(CBMCTRL_BASE, 20, PARBURST_RW_VALUE)
 #define CBMCTRL_PARBURST_READ_TRACK_VAR    _IOW(CBMCTRL_BASE, 21, PARBURST_RW_VALUE)
 
+/* block transfers with the protocols of the drive programs;
+ * BLOCK_CAPS returns a bit mask with (1 << CBM_BLOCK_PROTOCOL_*) set
+ * for every protocol the driver supports */
+#define CBMCTRL_BLOCK_CAPS       _IOR(CBMCTRL_BASE, 22, int)
+#define CBMCTRL_BLOCK_READ       _IOW(CBMCTRL_BASE, 23, BLOCK_RW_VALUE)
+#define CBMCTRL_BLOCK_WRITE      _IOW(CBMCTRL_BASE, 24, BLOCK_RW_VALUE)
+
+/* read a track into the next slot of the ring; with O_NONBLOCK, this
+ * returns at once, and poll() reports POLLIN when the track is there */
+#define CBMCTRL_PARBURST_READ_TRACK_RING _IOW(CBMCTRL_BASE, 25, int)
+
 #endif
@@ -121,6 +121,10 @@ int arch_filesize(const char *Filename, off_t *Filesize);
 
 #define arch_fdopen(_x, _y) ARCH_CBM_LINUX_WIN(fdopen(_x, _y), _fdopen(_x, _y))
 
+#define arch_fsync(_x) ARCH_CBM_LINUX_WIN(fsync(_x), _commit(_x))
+
+int arch_rename_replace(const char *OldName, const char *NewName);
+
 #define arch_snprintf ARCH_CBM_LINUX_WIN(snprintf, _snprintf)
 #define arch_vsnprintf ARCH_CBM_LINUX_WIN(vsnprintf, _vsnprintf)
 
@@ -130,4 +134,30 @@ int arch_filesize(const char *Filename, off_t *Filesize);
 typedef void (ARCH_SIGNALDECL *ARCH_CTRLBREAK_HANDLER)(int dummy);
 extern void arch_set_ctrlbreak_handler(ARCH_CTRLBREAK_HANDLER Handler);
 
+/* threads, mutexes and condition variables */
+
+typedef struct arch_thread_s *arch_thread_t; /*!< a thread, opaque */
+typedef struct arch_mutex_s  *arch_mutex_t;  /*!< a mutex, opaque */
+typedef struct arch_cond_s   *arch_cond_t;   /*!< a condition variable, opaque */
+
+/*! the function which is executed by a thread */
+typedef void (*ARCH_THREAD_FUNCTION)(void *Context);
+
+extern int  arch_thread_create(arch_thread_t *Thread, ARCH_THREAD_FUNCTION Function, void *Context);
+extern void arch_thread_join(arch_thread_t Thread);
+
+extern int  arch_mutex_create(arch_mutex_t *Mutex);
+extern void arch_mutex_destroy(arch_mutex_t Mutex);
+extern void arch_mutex_lock(arch_mutex_t Mutex);
+extern void arch_mutex_unlock(arch_mutex_t Mutex);
+
+extern int  arch_cond_create(arch_cond_t *Cond);
+extern void arch_cond_destroy(arch_cond_t Cond);
+extern void arch_cond_wait(arch_cond_t Cond, arch_mutex_t Mutex);
+extern void arch_cond_signal(arch_cond_t Cond);
+
+/* a clock for measuring time intervals */
+
+extern unsigned long arch_time_usec(void);
+
 #endif /* #ifndef CBM_ARCH_H */
@@ -34,6 +34,15 @@ typedef void (*cbmcopy_message_cb)(cbmcopy_severity_e sev, const char *format, .
 
 typedef int (*cbmcopy_status_cb)(int blocks_processed);
 
+/*
+ * gets the files read by cbmcopy_read_files(): the PETSCII name, the type
+ * ('D', 'S', 'P' or 'U') and the data, which must be free()'d. It is called
+ * from a thread of its own, while the next file is read.
+ * Returns 0 if the file could be stored.
+ */
+typedef int (*cbmcopy_file_cb)(void *context, const char *cbmname, char type,
+                               unsigned char *filedata, size_t filedata_size);
+
 #ifdef LIBCBMCOPY_DEBUG
 /*
  * print out the state of internal counters that are used on read
@@ -97,6 +106,23 @@ extern int cbmcopy_read_file_ts(CBM_FILE cbm_fd,
                                 cbmcopy_message_cb msg_cb,
                                 cbmcopy_status_cb status_cb);
 
+/*
+ * read all files which match one of the patterns (PETSCII, with the
+ * wildcards of the DOS, optionally followed by ",T" for the file type).
+ * The directory is read only once, and the turbo stays in the drive.
+ * Returns the number of files which could not be copied, or -1 if the
+ * directory could not be read.
+ */
+extern int cbmcopy_read_files(CBM_FILE cbm_fd,
+                              cbmcopy_settings *settings,
+                              int drive,
+                              const char * const *patterns,
+                              int pattern_count,
+                              cbmcopy_message_cb msg_cb,
+                              cbmcopy_status_cb status_cb,
+                              cbmcopy_file_cb file_cb,
+                              void *context);
+
 #ifdef __cplusplus
 }
 #endif
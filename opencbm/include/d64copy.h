@@ -57,6 +57,8 @@ typedef struct
     enum cbm_device_type_e drive_type;
     d64copy_bam_mode bam_mode;
     d64copy_error_mode error_mode;
+    int atomic_write;   /* write image files via a temporary file */
+    int turbo_loader;   /* send the turbo over the transfer protocol */
 } d64copy_settings;
 
 typedef struct
@@ -82,6 +84,11 @@ typedef enum
 typedef void (*d64copy_message_cb)(int d64copy_severity_e, const char *format, ...);
 typedef int (*d64copy_status_cb)(d64copy_status status);
 
+/*
+ * opaque state of one copy operation
+ */
+typedef struct d64copy_context_s d64copy_context;
+
 #ifdef LIBD64COPY_DEBUG
 /*
  * print out the state of internal counters that are used on read
@@ -110,6 +117,20 @@ extern int d64copy_check_auto_transfer_mode(CBM_FILE cbm_fd,
                                             int auto_transfermode,
                                             int drive);
 
+/*
+ * read a track under all transfer modes which are possible with the
+ * cable and the drives on the bus, with and without warp, and with
+ * several interleaves, and store the fastest combination which works
+ * into settings (transfer_mode, warp, interleave). The interleave is
+ * the best one for reading without warp.
+ * Returns 0 on success, or -1 if no turbo mode works; then, `original'
+ * is stored.
+ */
+extern int d64copy_tune(CBM_FILE cbm_fd,
+                        d64copy_settings *settings,
+                        int drive,
+                        d64copy_message_cb msg_cb);
+
 /*
  * returns malloc()'d pointer to default settings.
  * must be free()'d after use.
@@ -137,6 +158,43 @@ extern int d64copy_write_image(CBM_FILE cbm_fd,
 
 extern void d64copy_cleanup(void);
 
+/*
+ * returns malloc()'d context for the *_ex() functions below.
+ * must be freed with d64copy_destroy_context() after use.
+ */
+extern d64copy_context *d64copy_create_context(void);
+
+extern void d64copy_destroy_context(d64copy_context *ctx);
+
+/*
+ * Reentrant variants of the functions above. Each one works on its own
+ * context only, so several drives (on several adapters) can be copied
+ * from separate threads at the same time.
+ */
+extern int d64copy_read_image_ex(d64copy_context *ctx,
+                                 CBM_FILE cbm_fd,
+                                 d64copy_settings *settings,
+                                 int src_drive,
+                                 const char *dst_image,
+                                 d64copy_message_cb msg_cb,
+                                 d64copy_status_cb status_cb);
+
+extern int d64copy_write_image_ex(d64copy_context *ctx,
+                                  CBM_FILE cbm_fd,
+                                  d64copy_settings *settings,
+                                  const char *src_image,
+                                  int dst_drive,
+                                  d64copy_message_cb msg_cb,
+                                  d64copy_status_cb status_cb);
+
+extern void d64copy_cleanup_ex(d64copy_context *ctx);
+
+extern int d64copy_tune_ex(d64copy_context *ctx,
+                           CBM_FILE cbm_fd,
+                           d64copy_settings *settings,
+                           int drive,
+                           d64copy_message_cb msg_cb);
+
 #ifdef __cplusplus
 }
 #endif
@@ -75,6 +75,7 @@ typedef struct
     enum cbm_device_type_e drive_type;
     d82copy_bam_mode bam_mode;
     d82copy_error_mode error_mode;
+    int atomic_write;   /* write image files via a temporary file */
 } d82copy_settings;
 
 typedef struct
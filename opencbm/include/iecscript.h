@@ -0,0 +1,37 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file include/iecscript.h \n
+** \author OpenCBM team \n
+** \n
+** \brief The IEC line scripts of the serial-1 and serial-2 protocols
+**
+****************************************************************/
+
+#ifndef CBM_IECSCRIPT_H
+#define CBM_IECSCRIPT_H
+
+/*! the script length of one serial-1 byte */
+#define CBMLIBMISC_IEC_SCRIPT_S1_LEN        (8 * 8)
+
+/*! the script length of one serial-2 byte, when reading */
+#define CBMLIBMISC_IEC_SCRIPT_S2_READ_LEN   (4 * 6)
+
+/*! the script length of one serial-2 byte, when writing */
+#define CBMLIBMISC_IEC_SCRIPT_S2_WRITE_LEN  (4 * 6 + 1)
+
+extern unsigned int cbmlibmisc_iec_script_s1_read(unsigned char *Script);
+extern unsigned int cbmlibmisc_iec_script_s1_write(unsigned char *Script, unsigned char Byte, int Handshake);
+
+extern unsigned int cbmlibmisc_iec_script_s2_read(unsigned char *Script);
+extern unsigned int cbmlibmisc_iec_script_s2_write(unsigned char *Script, unsigned char Byte, int Handshake);
+
+#endif /* #ifndef CBM_IECSCRIPT_H */
@@ -0,0 +1,75 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file include/imagefile.h \n
+** \author OpenCBM team \n
+** \n
+** \brief Disk image files (.d64, .d71, .d80, .d81, .d82) held in memory
+**
+****************************************************************/
+
+#ifndef CBM_IMAGEFILE_H
+#define CBM_IMAGEFILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*! the number of bytes of one block of an image */
+#define CBMLIBMISC_IMAGE_BLOCKSIZE  256
+
+/*! the maximum number of tracks of an image (.d82) */
+#define CBMLIBMISC_IMAGE_MAX_TRACKS 154
+
+/*! \brief A disk image file
+
+ The complete image is read into memory when it is opened,
+ and it is written back in one go when it is closed. In
+ between, blocks are accessed through a table which holds
+ the block number of sector 0 of every track. Without
+ Atomic, cbmlibmisc_image_track_written() writes the tracks
+ into the image file as they are completed.
+
+ The caller may access Data[0] to Data[Length - 1] directly, e.g.
+ for the error info. All other members are private to
+ libmisc/imagefile.c.
+*/
+typedef struct cbmlibmisc_image_s
+{
+    char *Name;              /*!< the name of the image file */
+    char *TempName;          /*!< atomic mode: the file which is renamed to Name on close */
+    FILE *File;              /*!< for writing: the file which gets the data on close */
+    int   Existed;           /*!< the image file existed before it was opened */
+
+    unsigned char *Data;     /*!< the image contents: the blocks, then the error info */
+    size_t Length;           /*!< the number of valid bytes in Data */
+    size_t Allocated;        /*!< the number of bytes allocated for Data */
+
+    unsigned int Tracks;     /*!< the number of tracks, as given to cbmlibmisc_image_set_tracks() */
+    unsigned int BlockCount; /*!< the number of blocks of all tracks */
+    unsigned int WriteTrack; /*!< the track of the last cbmlibmisc_image_track_written() */
+
+    /*! the block number of sector 0 of every track; track 1 is at index 1,
+     * index Tracks + 1 is the number of blocks of the image */
+    unsigned int TrackOffset[CBMLIBMISC_IMAGE_MAX_TRACKS + 2];
+} cbmlibmisc_image;
+
+extern int  cbmlibmisc_image_open(cbmlibmisc_image *Image, const char *Name, int ForWriting, int Atomic);
+extern int  cbmlibmisc_image_close(cbmlibmisc_image *Image, int Commit);
+
+extern int  cbmlibmisc_image_track_written(cbmlibmisc_image *Image, unsigned int Track);
+
+extern int  cbmlibmisc_image_set_tracks(cbmlibmisc_image *Image, unsigned int Tracks, const unsigned char *Sectors);
+extern int  cbmlibmisc_image_resize(cbmlibmisc_image *Image, size_t Length);
+
+extern int  cbmlibmisc_image_block_number(cbmlibmisc_image *Image, unsigned int Track, unsigned int Sector);
+extern unsigned char *cbmlibmisc_image_block(cbmlibmisc_image *Image, unsigned int Track, unsigned int Sector);
+
+#endif /* #ifndef CBM_IMAGEFILE_H */
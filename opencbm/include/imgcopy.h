@@ -107,6 +107,7 @@ typedef struct
     enum cbm_device_type_e drive_type;
     imgcopy_bam_mode bam_mode;
     imgcopy_error_mode error_mode;
+    int atomic_write;   /* write image files via a temporary file */
 } imgcopy_settings;
 
 typedef struct
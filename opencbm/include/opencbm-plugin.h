@@ -14,6 +14,12 @@
 ** \n
 ** \brief Plugin DLL interface
 **
+** A plugin can have several handles open at the same time, which are
+** used by different threads. opencbm_plugin_init(), _uninit(),
+** _driver_open() and _driver_close() are never called in parallel;
+** all other functions must only use the state of the handle they are
+** called for. See lib/cbm.c for the details.
+**
 ****************************************************************/
 
 #ifndef OPENCBM_PLUGIN_H
@@ -242,6 +248,30 @@ typedef void CBMAPIDECL opencbm_plugin_iec_setrelease_t(CBM_FILE HandleDevice, i
 */
 typedef int CBMAPIDECL opencbm_plugin_iec_wait_t(CBM_FILE HandleDevice, int Line, int State);
 
+/*! \brief Execute a script of IEC line operations in the adapter
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Script
+   The IEC_SCRIPT_... operations to execute.
+
+ \param Length
+   The number of bytes in Script, at most IEC_SCRIPT_MAXLEN.
+
+ \param Result
+   Receives the sampled bits, LSB first.
+
+ \param ResultLength
+   The size of Result, in bytes.
+
+ \return
+   The number of sampled bits, -1 on error or timeout, or -2 if the
+   adapter cannot execute scripts. In the latter case, cbm_iec_script()
+   executes the script itself.
+*/
+typedef int CBMAPIDECL opencbm_plugin_iec_script_t(CBM_FILE HandleDevice, const unsigned char *Script, unsigned int Length, unsigned char *Result, unsigned int ResultLength);
+
 /*! \brief @@@@@ \todo document
 
  \param HandleDevice
@@ -336,6 +366,7 @@ typedef int CBMAPIDECL opencbm_plugin_tap_wait_for_play_sense_t(CBM_FILE HandleD
 typedef int CBMAPIDECL opencbm_plugin_tap_motor_on_t(CBM_FILE HandleDevice, int *Status);
 typedef int CBMAPIDECL opencbm_plugin_tap_motor_off_t(CBM_FILE HandleDevice, int *Status);
 typedef int CBMAPIDECL opencbm_plugin_tap_start_capture_t(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Buffer_Length, int *Status, int *BytesRead);
+typedef int CBMAPIDECL opencbm_plugin_tap_capture_stream_t(CBM_FILE HandleDevice, cbm_tap_capture_cb_t *Callback, void *Context, int *Status, int *BytesRead);
 typedef int CBMAPIDECL opencbm_plugin_tap_start_write_t(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Length, int *Status, int *BytesWritten);
 typedef int CBMAPIDECL opencbm_plugin_tap_get_ver_t(CBM_FILE HandleDevice, int *Status);
 typedef int CBMAPIDECL opencbm_plugin_tap_download_config_t(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Buffer_Length, int *Status, int *BytesRead);
@@ -512,6 +543,112 @@ typedef int CBMAPIDECL opencbm_plugin_pp_cc_read_n_t (CBM_FILE HandleDevice,
 */
 typedef int CBMAPIDECL opencbm_plugin_pp_cc_write_n_t(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size);
 
+/*
+ * protocols for the asynchronous transfer functions
+ */
+#define OPENCBM_PROTOCOL_CBM    0 /*!< standard CBM protocol (raw read/write) */
+#define OPENCBM_PROTOCOL_S1     1 /*!< serial-1 */
+#define OPENCBM_PROTOCOL_S2     2 /*!< serial-2 */
+#define OPENCBM_PROTOCOL_PP_DC  3 /*!< parallel, d64copy variant */
+#define OPENCBM_PROTOCOL_PP_CC  4 /*!< parallel, cbmcopy variant */
+
+/*! \brief query the protocols an adapter transfers blocks with itself
+
+ \param HandleDevice
+   Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \return
+    A bit mask with the bit (1 << OPENCBM_PROTOCOL_*) set for every protocol
+    whose read_n and write_n functions move a complete block with one request
+    to the adapter.
+
+ \remark
+    Without this function, the library assumes that every protocol whose
+    read_n and write_n functions are exported by the plugin is supported.
+    A plugin needs it if that depends on the adapter or its driver.
+*/
+typedef int CBMAPIDECL opencbm_plugin_block_caps_t(CBM_FILE HandleDevice);
+
+/*! \brief completion callback of an asynchronous transfer
+
+ \param Context
+    The context pointer given when the transfer was queued
+
+ \param Result
+    The number of bytes actually transferred, or -1 if the transfer failed.
+*/
+typedef void CBMAPIDECL opencbm_plugin_async_cb_t(void *Context, int Result);
+
+/*! \brief queue an asynchronous read from the OpenCBM backend
+
+ \param HandleDevice
+   Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \param Protocol
+    The protocol to use (OPENCBM_PROTOCOL_*)
+
+ \param data
+    Pointer to a buffer which will contain the data read from the OpenCBM backend.
+    It must stay valid until the transfer has completed.
+
+ \param size
+    The number of bytes to read from the OpenCBM backend
+
+ \param Callback
+    Function to call on completion, or NULL if not needed
+
+ \param Context
+    Context pointer that is given to the Callback
+
+ \return
+    0 if the transfer has been queued, -1 on error.
+
+ \remark
+    The transfers are executed in the order they have been queued,
+    and their callbacks are called in that order, too.
+*/
+typedef int CBMAPIDECL opencbm_plugin_async_read_n_t(CBM_FILE HandleDevice, unsigned int Protocol, unsigned char *data, unsigned int size, opencbm_plugin_async_cb_t *Callback, void *Context);
+
+/*! \brief queue an asynchronous write to the OpenCBM backend
+
+ \param HandleDevice
+   Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \param Protocol
+    The protocol to use (OPENCBM_PROTOCOL_*)
+
+ \param data
+    Pointer to buffer which contains the data to be written to the OpenCBM backend.
+    It must stay valid until the transfer has completed.
+
+ \param size
+    The length of the data buffer to be written to the OpenCBM backend
+
+ \param Callback
+    Function to call on completion, or NULL if not needed
+
+ \param Context
+    Context pointer that is given to the Callback
+
+ \return
+    0 if the transfer has been queued, -1 on error.
+*/
+typedef int CBMAPIDECL opencbm_plugin_async_write_n_t(CBM_FILE HandleDevice, unsigned int Protocol, const unsigned char *data, unsigned int size, opencbm_plugin_async_cb_t *Callback, void *Context);
+
+/*! \brief wait for queued asynchronous transfers to complete
+
+ \param HandleDevice
+   Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
+
+ \param Pending
+    Return as soon as no more than this number of transfers is still
+    outstanding. Use 0 to wait for all transfers.
+
+ \return
+    0 if all completed transfers succeeded, -1 if at least one of them failed.
+*/
+typedef int CBMAPIDECL opencbm_plugin_async_wait_t(CBM_FILE HandleDevice, unsigned int Pending);
+
 
 /*! \brief @@@@@ \todo document
 
@@ -567,6 +704,17 @@ struct opencbm_plugin_s {
     opencbm_plugin_iec_release_t                * opencbm_plugin_iec_release;                /*!< pointer to a opencbm_plugin_iec_release_t() function */
     opencbm_plugin_iec_setrelease_t             * opencbm_plugin_iec_setrelease;             /*!< pointer to a opencbm_plugin_iec_setrelease_t() function */
     opencbm_plugin_iec_wait_t                   * opencbm_plugin_iec_wait;                   /*!< pointer to a opencbm_plugin_iec_wait_t() function */
+    opencbm_plugin_iec_script_t                 * opencbm_plugin_iec_script;                 /*!< pointer to a opencbm_plugin_iec_script_t() function */
+
+    opencbm_plugin_block_caps_t                 * opencbm_plugin_block_caps;                 /*!< pointer to a opencbm_plugin_block_caps_t() function */
+    opencbm_plugin_s1_read_n_t                  * opencbm_plugin_s1_read_n;                  /*!< pointer to a opencbm_plugin_s1_read_n_t() function */
+    opencbm_plugin_s1_write_n_t                 * opencbm_plugin_s1_write_n;                 /*!< pointer to a opencbm_plugin_s1_write_n_t() function */
+    opencbm_plugin_s2_read_n_t                  * opencbm_plugin_s2_read_n;                  /*!< pointer to a opencbm_plugin_s2_read_n_t() function */
+    opencbm_plugin_s2_write_n_t                 * opencbm_plugin_s2_write_n;                 /*!< pointer to a opencbm_plugin_s2_write_n_t() function */
+    opencbm_plugin_pp_dc_read_n_t               * opencbm_plugin_pp_dc_read_n;               /*!< pointer to a opencbm_plugin_pp_dc_read_n_t() function */
+    opencbm_plugin_pp_dc_write_n_t              * opencbm_plugin_pp_dc_write_n;              /*!< pointer to a opencbm_plugin_pp_dc_write_n_t() function */
+    opencbm_plugin_pp_cc_read_n_t               * opencbm_plugin_pp_cc_read_n;               /*!< pointer to a opencbm_plugin_pp_cc_read_n_t() function */
+    opencbm_plugin_pp_cc_write_n_t              * opencbm_plugin_pp_cc_write_n;              /*!< pointer to a opencbm_plugin_pp_cc_write_n_t() function */
 
     opencbm_plugin_parallel_burst_read_t        * opencbm_plugin_parallel_burst_read;        /*!< pointer to a opencbm_plugin_parallel_burst_read_t() function */
     opencbm_plugin_parallel_burst_write_t       * opencbm_plugin_parallel_burst_write;       /*!< pointer to a opencbm_plugin_parallel_burst_write_t() function */
@@ -598,6 +746,7 @@ struct opencbm_plugin_s {
     opencbm_plugin_tap_download_config_t        * opencbm_plugin_tap_download_config;     /*!< pointer to a opencbm_plugin_tap_download_config_t() function */
     opencbm_plugin_tap_upload_config_t          * opencbm_plugin_tap_upload_config;       /*!< pointer to a opencbm_plugin_tap_upload_config_t() function */
     opencbm_plugin_tap_break_t                  * opencbm_plugin_tap_break;               /*!< pointer to a opencbm_plugin_tap_break_t() function */
+    opencbm_plugin_tap_capture_stream_t         * opencbm_plugin_tap_capture_stream;      /*!< pointer to a opencbm_plugin_tap_capture_stream_t() function */
 
 } opencbm_plugin_t;
 
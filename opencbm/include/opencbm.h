@@ -136,6 +136,13 @@ enum cbm_cable_type_e
     cbm_ct_xp1541        /*!< The device does have a parallel cable */
 };
 
+/* Several driver handles can be open at the same time, on different
+ * adapters and even through different plugins. Different handles can
+ * be used from different threads at the same time; one handle must
+ * only be used by one thread at a time. cbm_get_driver_name() and
+ * cbm_get_driver_name_ex() return a static buffer, thus, they are not
+ * thread-safe. See lib/cbm.c for the details. */
+
 /*! \todo FIXME: port isn't used yet */
 EXTERN int CBMAPIDECL cbm_driver_open(CBM_FILE *f, int port);
 EXTERN int CBMAPIDECL cbm_driver_open_ex(CBM_FILE *f, char * adapter);
@@ -174,10 +181,57 @@ EXTERN void CBMAPIDECL cbm_iec_release(CBM_FILE f, int line);
 EXTERN void CBMAPIDECL cbm_iec_setrelease(CBM_FILE f, int set, int release);
 EXTERN int CBMAPIDECL cbm_iec_wait(CBM_FILE f, int line, int state);
 
+/* micro-operations for cbm_iec_script(); each takes one byte,
+ * the lower 5 bits are the IEC line(s) (IEC_DATA, ...) resp. the argument */
+#define IEC_SCRIPT_OP(_x)           ((_x) & 0xE0) /*!< the operation of a script byte */
+#define IEC_SCRIPT_ARG(_x)          ((_x) & 0x1F) /*!< the lines or argument of a script byte */
+#define IEC_SCRIPT_NOP              0x00          /*!< do nothing */
+#define IEC_SCRIPT_SET(_l)          (0x20 | (_l)) /*!< set (pull down) the given lines */
+#define IEC_SCRIPT_RELEASE(_l)      (0x40 | (_l)) /*!< release the given lines */
+#define IEC_SCRIPT_WAIT_SET(_l)     (0x60 | (_l)) /*!< wait until the given line is set */
+#define IEC_SCRIPT_WAIT_RELEASE(_l) (0x80 | (_l)) /*!< wait until the given line is released */
+#define IEC_SCRIPT_SAMPLE(_l)       (0xA0 | (_l)) /*!< store the state of the given line as the next result bit */
+#define IEC_SCRIPT_WAIT_CHANGE(_l)  (0xC0 | (_l)) /*!< wait until the given line differs from the last sample */
+#define IEC_SCRIPT_TIMEOUT(_n)      (0xE0 | (_n)) /*!< following waits time out after _n * 10 ms; 0 = wait forever (default) */
+
+#define IEC_SCRIPT_MAXLEN           128           /*!< the maximum length of a script */
+
+EXTERN int CBMAPIDECL cbm_iec_script(CBM_FILE f, const unsigned char *script, unsigned int length,
+                                     unsigned char *result, unsigned int result_length);
+
+/*! the protocols of the drive programs for cbm_block_read() and cbm_block_write();
+ *  the values are the same as the ones of OPENCBM_PROTOCOL_* in opencbm-plugin.h */
+enum cbm_block_protocol_e
+{
+    cbm_bp_s1 = 1,                      /*!< serial-1 */
+    cbm_bp_s2 = 2,                      /*!< serial-2 */
+    cbm_bp_pp_dc = 3,                   /*!< parallel, d64copy variant */
+    cbm_bp_pp_cc = 4                    /*!< parallel, cbmcopy variant */
+};
+
+/*! the bit of a protocol in the result of cbm_block_caps() */
+#define CBM_BLOCK_CAP(_p) (1 << (_p))
+
+EXTERN int CBMAPIDECL cbm_block_caps(CBM_FILE f);
+EXTERN int CBMAPIDECL cbm_block_read(CBM_FILE f, enum cbm_block_protocol_e protocol, unsigned char *data, unsigned int size);
+EXTERN int CBMAPIDECL cbm_block_write(CBM_FILE f, enum cbm_block_protocol_e protocol, const unsigned char *data, unsigned int size);
+
 EXTERN int CBMAPIDECL cbm_upload(CBM_FILE f, unsigned char dev, int adr, const void *prog, size_t size);
 EXTERN int CBMAPIDECL cbm_download(CBM_FILE f, unsigned char dev, int adr, void *dbuf, size_t size);
+EXTERN int CBMAPIDECL cbm_download_fast(CBM_FILE f, unsigned char dev, int adr, void *dbuf, size_t size);
+EXTERN int CBMAPIDECL cbm_upload_cached(CBM_FILE f, unsigned char dev, int adr, const void *prog, size_t size);
+EXTERN int CBMAPIDECL cbm_upload_is_resident(CBM_FILE f, unsigned char dev, int adr, const void *prog, size_t size);
 
 EXTERN int CBMAPIDECL cbm_device_status(CBM_FILE f, unsigned char dev, void *buf, size_t bufsize);
+
+/*! a buffered talk channel, see cbm_stream_open_talk() */
+typedef struct cbm_stream_s cbm_stream_t;
+
+EXTERN cbm_stream_t * CBMAPIDECL cbm_stream_open_talk(CBM_FILE f, unsigned char dev, unsigned char secadr);
+EXTERN int CBMAPIDECL cbm_stream_read(cbm_stream_t *stream, void *buf, size_t size);
+EXTERN int CBMAPIDECL cbm_stream_getc(cbm_stream_t *stream);
+EXTERN int CBMAPIDECL cbm_stream_close(cbm_stream_t *stream);
+
 EXTERN int CBMAPIDECL cbm_exec_command(CBM_FILE f, unsigned char dev, const void *cmd, size_t len);
 
 EXTERN int CBMAPIDECL cbm_identify(CBM_FILE f, unsigned char drv,
@@ -202,6 +256,88 @@ EXTERN int CBMAPIDECL gcr_5_to_4_decode(const unsigned char *source, unsigned ch
 EXTERN int CBMAPIDECL gcr_4_to_5_encode(const unsigned char *source, unsigned char *dest,
                                         size_t sourceLength,         size_t destLength);
 
+/*! the number of data bytes of a block, as handled by gcr_decode_block_n() and gcr_encode_block_n() */
+#define GCR_BLOCK_DATASIZE 256
+
+/*! the number of GCR bytes of an encoded data block: data block
+ *  marker 0x07, 256 data bytes, checksum and two fill bytes */
+#define GCR_BLOCK_GCRSIZE  325
+
+EXTERN int CBMAPIDECL gcr_decode_block_n(const unsigned char *source, unsigned char *dest,
+                                         unsigned int count, int *status);
+EXTERN int CBMAPIDECL gcr_encode_block_n(const unsigned char *source, unsigned char *dest,
+                                         unsigned int count);
+
+
+/* per-call statistics */
+
+#if defined WIN32
+typedef unsigned __int64 cbm_counter_t; /*!< a counter for cbm_get_statistics() */
+#elif defined(__MSDOS__)
+typedef unsigned long cbm_counter_t;    /*!< a counter for cbm_get_statistics() */
+#else
+typedef uint64_t cbm_counter_t;         /*!< a counter for cbm_get_statistics() */
+#endif
+
+/*! Specifies the entry points which are measured by cbm_get_statistics() */
+enum cbm_statistics_entry_e
+{
+    cbm_se_raw_write,                   /*!< cbm_raw_write() */
+    cbm_se_raw_read,                    /*!< cbm_raw_read() */
+    cbm_se_listen,                      /*!< cbm_listen() */
+    cbm_se_talk,                        /*!< cbm_talk() */
+    cbm_se_open,                        /*!< cbm_open() */
+    cbm_se_close,                       /*!< cbm_close() */
+    cbm_se_unlisten,                    /*!< cbm_unlisten() */
+    cbm_se_untalk,                      /*!< cbm_untalk() */
+    cbm_se_get_eoi,                     /*!< cbm_get_eoi() */
+    cbm_se_clear_eoi,                   /*!< cbm_clear_eoi() */
+    cbm_se_reset,                       /*!< cbm_reset() */
+    cbm_se_pp_read,                     /*!< cbm_pp_read() */
+    cbm_se_pp_write,                    /*!< cbm_pp_write() */
+    cbm_se_iec_poll,                    /*!< cbm_iec_poll() and cbm_iec_get() */
+    cbm_se_iec_setrelease,              /*!< cbm_iec_set(), cbm_iec_release() and cbm_iec_setrelease() */
+    cbm_se_iec_wait,                    /*!< cbm_iec_wait() */
+    cbm_se_iec_script,                  /*!< cbm_iec_script() */
+    cbm_se_block,                       /*!< cbm_block_read() and cbm_block_write() */
+    cbm_se_parallel_burst,              /*!< cbm_parallel_burst_read(), cbm_parallel_burst_write() and their _n variants */
+    cbm_se_parallel_burst_track,        /*!< cbm_parallel_burst_read_track(), cbm_parallel_burst_read_track_var() and cbm_parallel_burst_write_track() */
+    cbm_se_srq_burst,                   /*!< cbm_srq_burst_read(), cbm_srq_burst_write() and their _n variants */
+    cbm_se_srq_burst_track,             /*!< cbm_srq_burst_read_track() and cbm_srq_burst_write_track() */
+    cbm_se_count                        /*!< the number of entries, not an entry itself */
+};
+
+/*! the number of latency buckets of a cbm_statistics_entry_t */
+#define CBM_STATISTICS_BUCKETS 24
+
+/*! the statistics of one entry point, see cbm_get_statistics() */
+typedef struct cbm_statistics_entry_s
+{
+    cbm_counter_t Calls;                /*!< the number of calls */
+    cbm_counter_t Bytes;                /*!< the number of bytes transferred by the calls */
+    cbm_counter_t Microseconds;         /*!< the time spent in the calls */
+    unsigned long MaxMicroseconds;      /*!< the time spent in the slowest call */
+
+    /*! the number of calls by their duration: bucket 0 counts the calls
+     *  shorter than 1 us, bucket n the ones from 2^(n-1) us to 2^n - 1 us.
+     *  The last bucket counts all calls which take longer. */
+    cbm_counter_t Latency[CBM_STATISTICS_BUCKETS];
+} cbm_statistics_entry_t;
+
+/*! the statistics of a driver handle, see cbm_get_statistics() */
+typedef struct cbm_statistics_s
+{
+    cbm_statistics_entry_t Entry[cbm_se_count]; /*!< indexed by enum cbm_statistics_entry_e */
+} cbm_statistics_t;
+
+EXTERN int CBMAPIDECL cbm_statistics_enable(CBM_FILE f, int enable);
+EXTERN int CBMAPIDECL cbm_get_statistics(CBM_FILE f, cbm_statistics_t *statistics);
+EXTERN const char * CBMAPIDECL cbm_statistics_entry_name(enum cbm_statistics_entry_e entry);
+
+/* settings of the tools per adapter, in the configuration file */
+
+EXTERN int CBMAPIDECL cbm_adapter_configuration_get(const char *adapter, const char entry[], char buffer[], size_t length);
+EXTERN int CBMAPIDECL cbm_adapter_configuration_set(const char *adapter, const char entry[], const char value[]);
 
 #if DBG
 EXTERN int CBMAPIDECL cbm_get_debugging_buffer(CBM_FILE HandleDevice, char *buffer, size_t len);
@@ -235,12 +371,29 @@ EXTERN int CBMAPIDECL cbm_srq_burst_write_track(CBM_FILE f, unsigned char *buffe
 
 /* functions specifically for CBM 153x tape drive */
 
+/*! \brief receives the data of a streaming tape capture
+
+ \param Context
+    The context pointer given to cbm_tap_capture_stream()
+
+ \param Data
+    The captured timestamps; a timestamp can be split between two calls
+
+ \param Length
+    The number of bytes in Data
+
+ \return
+    0 to continue, != 0 to stop the capture
+*/
+typedef int CBMAPIDECL cbm_tap_capture_cb_t(void *Context, const unsigned char *Data, unsigned int Length);
+
 EXTERN int CBMAPIDECL cbm_tap_prepare_capture(CBM_FILE f, int *Status);
 EXTERN int CBMAPIDECL cbm_tap_prepare_write(CBM_FILE f, int *Status);
 EXTERN int CBMAPIDECL cbm_tap_get_sense(CBM_FILE f, int *Status);
 EXTERN int CBMAPIDECL cbm_tap_wait_for_stop_sense(CBM_FILE f, int *Status);
 EXTERN int CBMAPIDECL cbm_tap_wait_for_play_sense(CBM_FILE f, int *Status);
 EXTERN int CBMAPIDECL cbm_tap_start_capture(CBM_FILE f, unsigned char *Buffer, unsigned int Buffer_Length, int *Status, int *BytesRead);
+EXTERN int CBMAPIDECL cbm_tap_capture_stream(CBM_FILE f, cbm_tap_capture_cb_t *Callback, void *Context, int *Status, int *BytesRead);
 EXTERN int CBMAPIDECL cbm_tap_start_write(CBM_FILE f, unsigned char *Buffer, unsigned int Length, int *Status, int *BytesWritten);
 EXTERN int CBMAPIDECL cbm_tap_motor_on(CBM_FILE f, int *Status);
 EXTERN int CBMAPIDECL cbm_tap_motor_off(CBM_FILE f, int *Status);
@@ -253,6 +406,7 @@ EXTERN int CBMAPIDECL cbm_tap_break(CBM_FILE f);
 
 /* get function address of the plugin */
 EXTERN void * CBMAPIDECL cbm_get_plugin_function_address(const char * Functionname);
+EXTERN void * CBMAPIDECL cbm_get_plugin_function_address_ex(CBM_FILE f, const char * Functionname);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,129 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+*/
+
+/*
+ * The protocol between opencbmd, which owns the adapter, and the opencbmd
+ * plugin of its clients. They talk over a local (Unix domain) stream socket.
+ *
+ * The client sends requests, the daemon answers each of them with a reply,
+ * in order. A client may send further requests before it has received the
+ * replies to the previous ones (this is used for the asynchronous transfer
+ * functions).
+ *
+ * A request is an opencbmd_request_t, followed by Length bytes of data.
+ * A reply is an opencbmd_reply_t, followed by Length bytes of data. As the
+ * socket is local, all numbers are stored in the byte order of the host.
+ *
+ * The requests and their arguments; if not mentioned, a request has no
+ * arguments and no data, and Result is the return value of the function:
+ *
+ *  OPENCBMD_HELLO          Arg1: OPENCBMD_VERSION; Result: OPENCBMD_VERSION
+ *                          of the daemon. Does not need the bus.
+ *  OPENCBMD_LOCK           cbm_lock()
+ *  OPENCBMD_UNLOCK         cbm_unlock(); does not need the bus.
+ *  OPENCBMD_RAW_WRITE      data: the bytes to write
+ *  OPENCBMD_RAW_READ       Arg1: the number of bytes; reply data: the bytes read
+ *  OPENCBMD_OPEN           Arg1: device, Arg2: secondary address
+ *  OPENCBMD_CLOSE          Arg1: device, Arg2: secondary address
+ *  OPENCBMD_LISTEN         Arg1: device, Arg2: secondary address
+ *  OPENCBMD_TALK           Arg1: device, Arg2: secondary address
+ *  OPENCBMD_UNLISTEN
+ *  OPENCBMD_UNTALK
+ *  OPENCBMD_GET_EOI
+ *  OPENCBMD_CLEAR_EOI
+ *  OPENCBMD_RESET
+ *  OPENCBMD_PP_READ
+ *  OPENCBMD_PP_WRITE       Arg1: the byte
+ *  OPENCBMD_IEC_POLL
+ *  OPENCBMD_IEC_SET        Arg1: the line
+ *  OPENCBMD_IEC_RELEASE    Arg1: the line
+ *  OPENCBMD_IEC_SETRELEASE Arg1: the lines to set, Arg2: the lines to release
+ *  OPENCBMD_IEC_WAIT       Arg1: the line, Arg2: the state
+ *  OPENCBMD_IEC_SCRIPT     Arg1: the length of the result; data: the script;
+ *                          reply data: the result
+ *  OPENCBMD_READ_N         Arg1: the protocol, Arg2: the number of bytes;
+ *                          reply data: the bytes read
+ *  OPENCBMD_WRITE_N        Arg1: the protocol; data: the bytes to write
+ *  OPENCBMD_BLOCK_CAPS     Result: the protocols which are moved with one
+ *                          request, see cbm_block_caps(). Does not need the bus.
+ *
+ * The protocol of OPENCBMD_READ_N and OPENCBMD_WRITE_N is one of the
+ * OPENCBM_PROTOCOL_* values of opencbm-plugin.h, except OPENCBM_PROTOCOL_CBM.
+ * The daemon transfers it with cbm_block_read() and cbm_block_write(); the
+ * result is -1 if neither the adapter nor the library can do so.
+ *
+ * The bus belongs to one client at a time. A client gets it with its first
+ * request which needs the bus, and keeps it until it calls cbm_unlock() as
+ * often as it has called cbm_lock() (once, if it never did), or until it
+ * disconnects. The requests of the other clients are queued meanwhile.
+ */
+
+#ifndef OPENCBMD_H
+#define OPENCBMD_H
+
+/*! the version of the protocol */
+#define OPENCBMD_VERSION 1
+
+/*! the socket which is used if no other one is given: this file in
+ * $XDG_RUNTIME_DIR, which only belongs to the user */
+#define OPENCBMD_DEFAULT_SOCKET_NAME "opencbmd.socket"
+
+/*! the environment variable which names the socket */
+#define OPENCBMD_SOCKET_ENVIRONMENT "OPENCBMD_SOCKET"
+
+/*! the maximum length of the data of a request or reply */
+#define OPENCBMD_MAX_DATA (16ul * 1024 * 1024)
+
+/*! the requests */
+enum opencbmd_command_e
+{
+    OPENCBMD_HELLO = 1,
+    OPENCBMD_LOCK,
+    OPENCBMD_UNLOCK,
+    OPENCBMD_RAW_WRITE,
+    OPENCBMD_RAW_READ,
+    OPENCBMD_OPEN,
+    OPENCBMD_CLOSE,
+    OPENCBMD_LISTEN,
+    OPENCBMD_TALK,
+    OPENCBMD_UNLISTEN,
+    OPENCBMD_UNTALK,
+    OPENCBMD_GET_EOI,
+    OPENCBMD_CLEAR_EOI,
+    OPENCBMD_RESET,
+    OPENCBMD_PP_READ,
+    OPENCBMD_PP_WRITE,
+    OPENCBMD_IEC_POLL,
+    OPENCBMD_IEC_SET,
+    OPENCBMD_IEC_RELEASE,
+    OPENCBMD_IEC_SETRELEASE,
+    OPENCBMD_IEC_WAIT,
+    OPENCBMD_IEC_SCRIPT,
+    OPENCBMD_READ_N,
+    OPENCBMD_WRITE_N,
+    OPENCBMD_BLOCK_CAPS
+};
+
+/*! a request, followed by Length bytes of data */
+typedef struct opencbmd_request_s
+{
+    unsigned int Command;   /*!< one of enum opencbmd_command_e */
+    int Arg1;               /*!< the first argument */
+    int Arg2;               /*!< the second argument */
+    unsigned int Length;    /*!< the number of bytes which follow */
+} opencbmd_request_t;
+
+/*! a reply, followed by Length bytes of data */
+typedef struct opencbmd_reply_s
+{
+    int Result;             /*!< the return value */
+    unsigned int Length;    /*!< the number of bytes which follow */
+} opencbmd_reply_t;
+
+#endif /* #ifndef OPENCBMD_H */
@@ -6,17 +6,83 @@
  *
  *  Copyright 2011 Wolfgang Moser
  *  Copyright 2011 Spiro Trikaliotis
+ *  Copyright 2026 OpenCBM team
 */
 
+/*
+ * Every SETSTATEDEBUG() is a trace point. If the environment variable
+ * OPENCBM_TRACE names a file, each thread records the trace points it
+ * passes into its own ring of the last STATEDEBUG_RING_SIZE events
+ * (time stamp, source position and the counters below). The rings are
+ * written into that file when the program exits, also on Ctrl+C, and
+ * can be converted into a timeline with cbmtrace.
+ *
+ * Without OPENCBM_TRACE, a trace point costs one test of a global.
+ *
+ * With DEBUG_STATEDEBUG defined, the argument of SETSTATEDEBUG() is
+ * evaluated, too; it is used to maintain the counters.
+ */
+
+#ifndef STATEDEBUG_H
+#define STATEDEBUG_H
+
+#ifdef WIN32
+#   define STATEDEBUG_THREAD __declspec(thread) /*!< a variable with one instance per thread */
+#else
+#   define STATEDEBUG_THREAD __thread           /*!< a variable with one instance per thread */
+#endif
+
+/*! the environment variable which names the file the trace is written to */
+#define STATEDEBUG_ENVIRONMENT "OPENCBM_TRACE"
+
+/*! the number of events kept per thread */
+#define STATEDEBUG_RING_SIZE 4096
+
+/*! the first bytes of a trace file; the number is the version of the format */
+#define STATEDEBUG_FILE_MAGIC "OCBMTRC1"
+
+/*
+ * A trace file consists of the magic, followed by the number of rings
+ * (4 byte), followed by the rings. A ring is the number of the thread,
+ * the number of events the thread has recorded in total and the number
+ * of events in the file (4 byte each), followed by the events, oldest
+ * first. An event is the time stamp in microseconds, the line, the
+ * block, byte and bit counters (4 byte each), followed by the length
+ * of the file name (2 byte) and the file name itself.
+ *
+ * All numbers are stored little endian.
+ */
+
+/*! the state of the trace, see DebugTraceState */
+enum statedebug_state_e
+{
+    statedebug_unknown = 0,  /*!< OPENCBM_TRACE has not been checked yet */
+    statedebug_off,          /*!< the trace is off */
+    statedebug_on            /*!< the trace is on */
+};
+
+extern enum statedebug_state_e DebugTraceState;
+
+extern STATEDEBUG_THREAD int DebugBlockCount, DebugByteCount, DebugBitCount;
+
+extern void DebugTrace(const char *File, int Line);
+extern int DebugTraceSave(const char *Filename);
+extern int DebugTraceLast(const char **File, int *Line);
+
+/*! record a trace point, if the trace is on */
+#define STATEDEBUG_TRACE() \
+    do { \
+        if (DebugTraceState != statedebug_off) \
+            DebugTrace(__FILE__, __LINE__); \
+    } while (0)
+
 #ifdef DEBUG_STATEDEBUG
-    extern volatile int DebugLineNumber, DebugBlockCount,
-                        DebugByteCount, DebugBitCount;
-    extern volatile char *     DebugFileName;
 
 #   define SETSTATEDEBUG(_x)  \
-        DebugLineNumber=__LINE__; \
-        DebugFileName  =__FILE__; \
-        (_x)
+        do { \
+            (_x); \
+            STATEDEBUG_TRACE(); \
+        } while (0)
 
     extern void DebugPrintDebugCounters(void);
 
@@ -24,6 +90,8 @@
         DebugPrintDebugCounters()
 
 #else
-#   define SETSTATEDEBUG(_x) do { } while (0)
+#   define SETSTATEDEBUG(_x) STATEDEBUG_TRACE()
 #   define DEBUG_PRINTDEBUGCOUNTERS()
 #endif
+
+#endif /* #ifndef STATEDEBUG_H */
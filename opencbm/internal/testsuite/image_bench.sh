@@ -0,0 +1,79 @@
+#!/bin/bash
+#
+# Regression test and benchmark of cbmctrl, d64copy and cbmcopy
+# without any hardware, using the "image" plugin.
+#
+# set -x
+
+function error_info {
+	echo "image_bench.sh [<latency>]" 1>&2
+	echo  1>&2
+	echo "latency: value for OPENCBM_IMAGE_LATENCY, e.g. none, 1541, 1541,virtual" 1>&2
+	echo "         or byte=400,command=1500,block=20000 (default: none)" 1>&2
+	exit 1
+	}
+
+if [ $# -gt 1 ]
+then
+	error_info
+fi
+
+export OPENCBM_IMAGE_LATENCY="${1:-none}"
+export OPENCBM_IMAGE_STATS=1
+
+WORK=`mktemp -d`
+trap 'rm -rf "$WORK"' EXIT
+
+FAILED=0
+
+TIMEFORMAT="  %R s wall, %U s user, %S s system"
+
+function run {
+	echo executing: "$@"
+	time "$@" > "$WORK/out.txt" 2>&1 || FAILED=1
+	grep "^image:" "$WORK/out.txt"
+	}
+
+function compare {
+	if cmp "$1" "$2"
+	then
+		echo "  $1 and $2 are identical"
+	else
+		FAILED=1
+	fi
+	}
+
+cp filleddk.d64 "$WORK/drive.d64"
+ADAPTER="image:$WORK/drive.d64"
+
+run cbmctrl -@"$ADAPTER" detect
+run cbmctrl -@"$ADAPTER" dir 8
+run cbmctrl -@"$ADAPTER" status 8
+
+run d64copy -@"$ADAPTER" -n -t original 8 "$WORK/read.d64"
+compare filleddk.d64 "$WORK/read.d64"
+
+run d64copy -@"$ADAPTER" -n -t original "$WORK/read.d64" 8
+compare filleddk.d64 "$WORK/drive.d64"
+
+# filleddk.d64 has 34 blocks free; cbmcopy only writes into the current directory
+cd "$WORK"
+head -c 8000 /dev/urandom > random.prg
+run cbmcopy -@"$ADAPTER" -t original -w 8 random.prg -o random
+run cbmcopy -@"$ADAPTER" -t original -r 8 random -o random.back
+compare random.prg random.back
+
+# wildcards: the directory is read once, all matching files are copied
+mkdir batch
+cd batch
+run cbmcopy -@"$ADAPTER" -t original -r 8 "r?nd*,p" "nomatch"
+compare ../random.prg random.prg
+cd ..
+
+if [ $FAILED != 0 ]
+then
+	echo "*** image_bench.sh: FAILED" 1>&2
+	exit 1
+fi
+
+echo image_bench.sh: all tests passed
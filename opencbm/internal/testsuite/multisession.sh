@@ -0,0 +1,43 @@
+#!/bin/bash
+#
+# Test of concurrent sessions on several simulated adapters,
+# using the "image" plugin.
+#
+# set -x
+
+function error_info {
+	echo "multisession.sh [<sessions> [<rounds>]]" 1>&2
+	echo  1>&2
+	echo "sessions: the number of adapters used at the same time (default: 4)" 1>&2
+	echo "rounds:   the number of rounds of every session (default: 50)" 1>&2
+	exit 1
+	}
+
+if [ $# -gt 2 ]
+then
+	error_info
+fi
+
+SESSIONS="${1:-4}"
+ROUNDS="${2:-50}"
+
+export OPENCBM_IMAGE_LATENCY=none
+
+WORK=`mktemp -d`
+trap 'rm -rf "$WORK"' EXIT
+
+ADAPTERS=
+for i in `seq 1 $SESSIONS`
+do
+	cp filleddk.d64 "$WORK/drive$i.d64"
+	ADAPTERS="$ADAPTERS image:$WORK/drive$i.d64"
+done
+
+echo executing: multisession -r $ROUNDS $ADAPTERS
+if ! multisession -r $ROUNDS $ADAPTERS
+then
+	echo "*** multisession.sh: FAILED" 1>&2
+	exit 1
+fi
+
+echo multisession.sh: all tests passed
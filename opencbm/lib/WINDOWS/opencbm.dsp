@@ -124,6 +124,14 @@ SOURCE=..\petscii.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\stream.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\statistics.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\upload.c
 # End Source File
 # End Group
@@ -157,6 +165,41 @@ SOURCE="..\..\include\opencbm-plugin.h"
 # Begin Source File
 
 SOURCE=..\..\include\opencbm.h
+# End Source File
+# End Group
+# Begin Group "CA65"
+
+# PROP Default_Filter "a65"
+# Begin Source File
+
+SOURCE=..\download.a65
+
+!IF  "$(CFG)" == "opencbm - Win32 Release"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\lib
+InputPath=..\download.a65
+InputName=download
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ELSEIF  "$(CFG)" == "opencbm - Win32 Debug"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\lib
+InputPath=..\download.a65
+InputName=download
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ENDIF 
+
 # End Source File
 # End Group
 # Begin Group "Resource Files"
@@ -53,6 +53,7 @@ EXTERN opencbm_plugin_iec_set_t                    opencbm_plugin_iec_set;
 EXTERN opencbm_plugin_iec_release_t                opencbm_plugin_iec_release;
 EXTERN opencbm_plugin_iec_setrelease_t             opencbm_plugin_iec_setrelease;
 EXTERN opencbm_plugin_iec_wait_t                   opencbm_plugin_iec_wait;
+EXTERN opencbm_plugin_iec_script_t                 opencbm_plugin_iec_script;
 
 EXTERN opencbm_plugin_parallel_burst_read_t        opencbm_plugin_parallel_burst_read;
 EXTERN opencbm_plugin_parallel_burst_write_t       opencbm_plugin_parallel_burst_write;
@@ -76,12 +77,14 @@ EXTERN opencbm_plugin_tap_wait_for_play_sense_t    opencbm_plugin_tap_wait_for_p
 EXTERN opencbm_plugin_tap_motor_on_t               opencbm_plugin_tap_motor_on;
 EXTERN opencbm_plugin_tap_motor_off_t              opencbm_plugin_tap_motor_off;
 EXTERN opencbm_plugin_tap_start_capture_t          opencbm_plugin_tap_start_capture;
+EXTERN opencbm_plugin_tap_capture_stream_t         opencbm_plugin_tap_capture_stream;
 EXTERN opencbm_plugin_tap_start_write_t            opencbm_plugin_tap_start_write;
 EXTERN opencbm_plugin_tap_get_ver_t                opencbm_plugin_tap_get_ver;
 EXTERN opencbm_plugin_tap_download_config_t        opencbm_plugin_tap_download_config;
 EXTERN opencbm_plugin_tap_upload_config_t          opencbm_plugin_tap_upload_config;
 EXTERN opencbm_plugin_tap_break_t                  opencbm_plugin_tap_break;
 
+EXTERN opencbm_plugin_block_caps_t                 opencbm_plugin_block_caps;
 EXTERN opencbm_plugin_s1_read_n_t                  opencbm_plugin_s1_read_n;
 EXTERN opencbm_plugin_s1_write_n_t                 opencbm_plugin_s1_write_n;
 EXTERN opencbm_plugin_s2_read_n_t                  opencbm_plugin_s2_read_n;
@@ -91,6 +94,10 @@ EXTERN opencbm_plugin_pp_dc_write_n_t              opencbm_plugin_pp_dc_write_n;
 EXTERN opencbm_plugin_pp_cc_read_n_t               opencbm_plugin_pp_cc_read_n;
 EXTERN opencbm_plugin_pp_cc_write_n_t              opencbm_plugin_pp_cc_write_n;
 
+EXTERN opencbm_plugin_async_read_n_t               opencbm_plugin_async_read_n;
+EXTERN opencbm_plugin_async_write_n_t              opencbm_plugin_async_write_n;
+EXTERN opencbm_plugin_async_wait_t                 opencbm_plugin_async_wait;
+
 EXTERN opencbm_plugin_iec_dbg_read_t               opencbm_plugin_iec_dbg_read;
 EXTERN opencbm_plugin_iec_dbg_write_t              opencbm_plugin_iec_dbg_write;
 
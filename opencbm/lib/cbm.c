@@ -16,6 +16,28 @@
 ** \n
 ** \brief Shared library / DLL for accessing the driver
 **
+** Several driver handles can be open at the same time, on different
+** adapters and through different plugins. Every plugin is loaded once,
+** with its first handle, and unloaded with its last one. The library
+** remembers the plugin of every handle and calls that plugin for it.
+**
+** The rules for threads:
+**
+** - Different handles can be used from different threads at the same
+**   time. One handle must only be used by one thread at a time; this
+**   includes the functions of its plugin which are called directly,
+**   see cbm_get_plugin_function_address_ex().
+** - cbm_driver_open_ex() and cbm_driver_close() can be called at any
+**   time. They are serialised, thus, the plugins do not need to
+**   protect their global state in their opencbm_plugin_init(),
+**   opencbm_plugin_driver_open() and opencbm_plugin_driver_close().
+**   All other functions of a plugin must only use the state of the
+**   handle they are called for.
+** - The handles returned by the plugins must be unique in the process,
+**   as the pointers or file descriptors they are.
+** - cbm_get_driver_name() and cbm_get_driver_name_ex() return a static
+**   buffer and are not thread-safe.
+**
 ****************************************************************/
 
 /*! Mark: We are in user-space (for debug.h) */
@@ -42,8 +64,14 @@
 
 #include "configuration.h"
 
+#include "iecscript.h"
+
 #include "arch.h"
 
+#include "statistics.h"
+
+#include "library.h"
+
 /*! \brief @@@@@ \todo document
 
  \param Handle
@@ -112,17 +140,362 @@ int plugin_set_inactive(const char PluginName[])
 }
 
 
-/*! \brief @@@@@ \todo document */
+/*! \brief a loaded plugin */
 struct plugin_information_s {
-    SHARED_OBJECT_HANDLE Library; /*!< \brief @@@@@ \todo document */
-    opencbm_plugin_t     Plugin;  /*!< \brief @@@@@ \todo document */
+    SHARED_OBJECT_HANDLE Library; /*!< \brief the handle of the shared object */
+    opencbm_plugin_t     Plugin;  /*!< \brief the entry points of the plugin */
+    char *               Name;    /*!< \brief the name of the plugin, that is, its section in the configuration file */
+    unsigned int         Handles; /*!< \brief the number of driver handles which have been opened with this plugin */
+    struct plugin_information_s * Next; /*!< \brief the plugin which has been loaded before this one */
 };
 
-/*! \brief @@@@@ \todo document */
+/*! \brief a loaded plugin */
 typedef struct plugin_information_s plugin_information_t;
 
-static
-struct plugin_information_s Plugin_information = { 0 };
+/*! \brief the loaded plugins, the one loaded last first
+
+ Only changed with Plugin_mutex and the library lock held.
+*/
+static plugin_information_t * Plugin_list = NULL;
+
+/*! \brief the maximum number of driver handles which can be open at the same time */
+enum { CBM_MAX_HANDLES = 32 };
+
+/*! \brief an open driver handle */
+typedef struct cbm_handle_s {
+    CBM_FILE               HandleDevice; /*!< \brief the handle, as returned by the plugin */
+    plugin_information_t * Plugin;       /*!< \brief the plugin of the handle, NULL if this entry is unused */
+    int                    BlockCaps;    /*!< \brief the protocols the adapter moves blocks with itself, see cbm_block_caps() */
+    struct statistics_handle_s * volatile Statistics; /*!< \brief the statistics, see handle_statistics(); NULL if they have never been enabled */
+} cbm_handle_t;
+
+/*! \brief the open driver handles; protected by the library lock */
+static cbm_handle_t Handle_table[CBM_MAX_HANDLES];
+
+/*! \brief the number of entries of Handle_table which have ever been used */
+static unsigned int Handle_table_used = 0;
+
+/*! \brief incremented whenever a handle is unregistered, which invalidates the Handle_cache of all threads */
+static unsigned int volatile Handle_generation = 0;
+
+/*! \brief the handle this thread has looked up last; the bus functions
+    are called for the same handle again and again, and finding it in
+    Handle_table would cost the library lock every time */
+static CBM_THREAD_LOCAL CBM_FILE Handle_cache_device;
+
+/*! \brief the entry of Handle_table of Handle_cache_device, NULL if there is none */
+static CBM_THREAD_LOCAL cbm_handle_t * Handle_cache = NULL;
+
+/*! \brief the value of Handle_generation when Handle_cache was set */
+static CBM_THREAD_LOCAL unsigned int Handle_cache_generation;
+
+/*! \brief the library lock, see library_lock() */
+static arch_mutex_t volatile Library_mutex = NULL;
+
+/*! \brief serialises the loading and unloading of the plugins, and the
+    opening and closing of the driver handles */
+static arch_mutex_t volatile Plugin_mutex = NULL;
+
+/*! \internal \brief Get a mutex, create it on first use
+
+ \param Mutex
+   The location of the mutex.
+
+ \return
+   The mutex; NULL if it could not be created.
+*/
+static arch_mutex_t
+library_get_mutex(arch_mutex_t volatile * Mutex)
+{
+    arch_mutex_t mutex = CBM_ATOMIC_GET(Mutex);
+
+    if (mutex == NULL && arch_mutex_create(&mutex) == 0)
+    {
+        if (!CBM_ATOMIC_SET_IF_NULL(Mutex, mutex))
+        {
+            /* another thread has been faster */
+            arch_mutex_destroy(mutex);
+            mutex = CBM_ATOMIC_GET(Mutex);
+        }
+    }
+
+    return mutex;
+}
+
+/*! \brief Take the library lock
+
+ The library lock protects the tables of the library which are
+ shared by all driver handles. It is only held for short times;
+ never call a plugin while holding it.
+*/
+void
+library_lock(void)
+{
+    arch_mutex_t mutex = library_get_mutex(&Library_mutex);
+
+    if (mutex)
+        arch_mutex_lock(mutex);
+}
+
+/*! \brief Release the library lock */
+void
+library_unlock(void)
+{
+    arch_mutex_t mutex = CBM_ATOMIC_GET(&Library_mutex);
+
+    if (mutex)
+        arch_mutex_unlock(mutex);
+}
+
+/*! \internal \brief Take the plugin lock, see Plugin_mutex */
+static void
+plugin_lock(void)
+{
+    arch_mutex_t mutex = library_get_mutex(&Plugin_mutex);
+
+    if (mutex)
+        arch_mutex_lock(mutex);
+}
+
+/*! \internal \brief Release the plugin lock */
+static void
+plugin_unlock(void)
+{
+    arch_mutex_t mutex = CBM_ATOMIC_GET(&Plugin_mutex);
+
+    if (mutex)
+        arch_mutex_unlock(mutex);
+}
+
+/*! \internal \brief Register an open driver handle
+
+ \param HandleDevice
+   The handle, as returned by the plugin.
+
+ \param Plugin
+   The plugin which has opened the handle.
+
+ \param BlockCaps
+   The protocols the adapter moves blocks with itself, see cbm_block_caps().
+
+ \return
+   0 on success, 1 if there are too many open handles.
+*/
+static int
+handle_register(CBM_FILE HandleDevice, plugin_information_t * Plugin, int BlockCaps)
+{
+    unsigned int i;
+    int error = 1;
+
+    library_lock();
+
+    for (i = 0; i < CBM_MAX_HANDLES; i++)
+    {
+        if (Handle_table[i].Plugin == NULL)
+        {
+            Handle_table[i].HandleDevice = HandleDevice;
+            Handle_table[i].Plugin = Plugin;
+            Handle_table[i].BlockCaps = BlockCaps;
+            Handle_table[i].Statistics = NULL;
+
+            if (i >= Handle_table_used)
+                Handle_table_used = i + 1;
+
+            error = 0;
+            break;
+        }
+    }
+
+    library_unlock();
+
+    return error;
+}
+
+/*! \internal \brief Unregister a driver handle which is about to be closed
+
+ \param HandleDevice
+   The handle.
+
+ \return
+   The plugin of the handle; NULL if the handle is unknown.
+*/
+static plugin_information_t *
+handle_unregister(CBM_FILE HandleDevice)
+{
+    plugin_information_t * plugin = NULL;
+    struct statistics_handle_s * statistics = NULL;
+    unsigned int i;
+
+    library_lock();
+
+    for (i = 0; i < Handle_table_used; i++)
+    {
+        if (Handle_table[i].Plugin != NULL && Handle_table[i].HandleDevice == HandleDevice)
+        {
+            plugin = Handle_table[i].Plugin;
+            statistics = Handle_table[i].Statistics;
+            Handle_table[i].Plugin = NULL;
+            Handle_table[i].Statistics = NULL;
+            CBM_ATOMIC_INC_UINT(&Handle_generation);
+            break;
+        }
+    }
+
+    library_unlock();
+
+    /* allocated by cbm_statistics_enable() */
+    free(statistics);
+
+    return plugin;
+}
+
+/*! \internal \brief Find the entry of a driver handle
+
+ \param HandleDevice
+   The handle.
+
+ \return
+   The entry in Handle_table; NULL if the handle is unknown.
+*/
+static cbm_handle_t *
+handle_entry(CBM_FILE HandleDevice)
+{
+    cbm_handle_t * entry = NULL;
+    unsigned int i;
+
+    /*
+     * The entry of a handle does not change while it is open, and a
+     * handle is not closed while it is used. Thus, unless a handle
+     * has been closed since, the entry found last can be used as is.
+     */
+    if (Handle_cache != NULL && Handle_cache_device == HandleDevice
+        && Handle_cache_generation == CBM_ATOMIC_GET_UINT(&Handle_generation))
+    {
+        return Handle_cache;
+    }
+
+    library_lock();
+
+    for (i = 0; i < Handle_table_used; i++)
+    {
+        if (Handle_table[i].Plugin != NULL && Handle_table[i].HandleDevice == HandleDevice)
+        {
+            entry = &Handle_table[i];
+
+            Handle_cache = entry;
+            Handle_cache_device = HandleDevice;
+            Handle_cache_generation = CBM_ATOMIC_GET_UINT(&Handle_generation);
+            break;
+        }
+    }
+
+    library_unlock();
+
+    return entry;
+}
+
+/*! \internal \brief Get the plugin a driver handle has been opened with
+
+ \param HandleDevice
+   The handle.
+
+ \param BlockCaps
+   If not NULL, receives the protocols the adapter moves blocks with
+   itself, see cbm_block_caps(); 0 if the handle is unknown.
+
+ \return
+   The plugin. If the handle is unknown, this is the plugin which has
+   been loaded last, as the library did before it supported more than
+   one plugin at a time.
+*/
+static plugin_information_t *
+handle_lookup(CBM_FILE HandleDevice, int *BlockCaps)
+{
+    cbm_handle_t * entry = handle_entry(HandleDevice);
+    plugin_information_t * plugin;
+
+    if (entry != NULL)
+    {
+        plugin = entry->Plugin;
+    }
+    else
+    {
+        library_lock();
+        plugin = Plugin_list;
+        library_unlock();
+    }
+
+    DBG_ASSERT(plugin != NULL);
+
+    if (BlockCaps)
+        *BlockCaps = entry != NULL ? entry->BlockCaps : 0;
+
+    return plugin;
+}
+
+/*! \internal \brief Get the location of the statistics of a driver handle
+
+ \param HandleDevice
+   The handle.
+
+ \return
+   The location of the pointer to the statistics. It stays valid
+   until the handle is closed. NULL if the handle is unknown.
+*/
+struct statistics_handle_s * volatile *
+handle_statistics(CBM_FILE HandleDevice)
+{
+    cbm_handle_t * entry = handle_entry(HandleDevice);
+
+    return entry != NULL ? &entry->Statistics : NULL;
+}
+
+/*! \internal \brief Get the plugin a driver handle has been opened with
+
+ \param HandleDevice
+   The handle.
+
+ \return
+   The plugin, see handle_lookup().
+*/
+static plugin_information_t *
+plugin_of(CBM_FILE HandleDevice)
+{
+    return handle_lookup(HandleDevice, NULL);
+}
+
+/*! \internal \brief Query the protocols an adapter moves blocks with itself
+
+ \param Plugin
+   The plugin the handle has been opened with.
+
+ \param HandleDevice
+   The handle.
+
+ \return
+   The protocols, see cbm_block_caps().
+*/
+static int
+block_caps_query(plugin_information_t * Plugin, CBM_FILE HandleDevice)
+{
+    opencbm_plugin_t * p = &Plugin->Plugin;
+    int caps = 0;
+
+    if (p->opencbm_plugin_s1_read_n && p->opencbm_plugin_s1_write_n)
+        caps |= CBM_BLOCK_CAP(cbm_bp_s1);
+    if (p->opencbm_plugin_s2_read_n && p->opencbm_plugin_s2_write_n)
+        caps |= CBM_BLOCK_CAP(cbm_bp_s2);
+    if (p->opencbm_plugin_pp_dc_read_n && p->opencbm_plugin_pp_dc_write_n)
+        caps |= CBM_BLOCK_CAP(cbm_bp_pp_dc);
+    if (p->opencbm_plugin_pp_cc_read_n && p->opencbm_plugin_pp_cc_write_n)
+        caps |= CBM_BLOCK_CAP(cbm_bp_pp_cc);
+
+    /* the plugin can only restrict the protocols it has the functions for */
+    if (p->opencbm_plugin_block_caps)
+        caps &= p->opencbm_plugin_block_caps(HandleDevice);
+
+    return caps;
+}
 
 struct plugin_read_pointer
 {
@@ -181,6 +554,17 @@ static struct plugin_read_pointer plugin_pointer_to_read_optional[] =
     PLUGIN_POINTER_DEF(opencbm_plugin_parallel_burst_write_track),
     PLUGIN_POINTER_DEF(opencbm_plugin_pp_read),
     PLUGIN_POINTER_DEF(opencbm_plugin_pp_write),
+    PLUGIN_POINTER_DEF(opencbm_plugin_tap_capture_stream),
+    PLUGIN_POINTER_DEF(opencbm_plugin_iec_script),
+    PLUGIN_POINTER_DEF(opencbm_plugin_block_caps),
+    PLUGIN_POINTER_DEF(opencbm_plugin_s1_read_n),
+    PLUGIN_POINTER_DEF(opencbm_plugin_s1_write_n),
+    PLUGIN_POINTER_DEF(opencbm_plugin_s2_read_n),
+    PLUGIN_POINTER_DEF(opencbm_plugin_s2_write_n),
+    PLUGIN_POINTER_DEF(opencbm_plugin_pp_dc_read_n),
+    PLUGIN_POINTER_DEF(opencbm_plugin_pp_dc_write_n),
+    PLUGIN_POINTER_DEF(opencbm_plugin_pp_cc_read_n),
+    PLUGIN_POINTER_DEF(opencbm_plugin_pp_cc_write_n),
     PLUGIN_POINTER_END()
 };
 
@@ -340,14 +724,66 @@ read_plugin_pointer_groups(
     return error;
 }
 
+/*! \internal \brief Get the name of the plugin to use
+
+ \param Adapter
+   The name of the plugin, or NULL for the default plugin.
+
+ \return
+   The name of the plugin; it has to be freed with cbmlibmisc_strfree().
+   NULL if there is no default plugin.
+*/
+static char *
+plugin_get_name(const char * const Adapter)
+{
+    char * plugin_name = NULL;
+    const char * configurationFilename;
+    opencbm_configuration_handle handle_configuration;
+
+    if (Adapter != NULL)
+        return cbmlibmisc_strdup(Adapter);
+
+    configurationFilename = configuration_get_default_filename();
+
+    if (configurationFilename == NULL) {
+        DBG_ERROR((DBG_PREFIX "Do not know where the plugin information is stored!\n"));
+        return NULL;
+    }
+
+    handle_configuration = opencbm_configuration_open(configurationFilename);
+
+    if (handle_configuration)
+    {
+        //
+        // get the name of the default plugin
+        //
+
+        if (opencbm_configuration_get_data(handle_configuration,
+                   "plugins", "default", &plugin_name))
+        {
+            cbmlibmisc_strfree(plugin_name);
+            plugin_name = NULL;
+        }
+
+        opencbm_configuration_close(handle_configuration);
+    }
+    else
+    {
+        DBG_ERROR((DBG_PREFIX "Cannot open config file '%s'.\n", configurationFilename));
+    }
+
+    cbmlibmisc_strfree(configurationFilename);
+
+    return plugin_name;
+}
+
 static int
-initialize_plugin_pointer(plugin_information_t *Plugin_information, const char * const Adapter)
+initialize_plugin_pointer(plugin_information_t *Plugin_information, const char * const plugin_name)
 {
     int error = 1;
 
     const char * configurationFilename = configuration_get_default_filename();
 
-    char * plugin_name = NULL;
     char * plugin_location = NULL;
 
     do {
@@ -365,40 +801,20 @@ initialize_plugin_pointer(plugin_information_t *Plugin_information, const char *
         {
             int error = 0;
 
-            if (Adapter == NULL)
-            {
-                //
-                // get the name of the default plugin
-                //
-
-                error = opencbm_configuration_get_data(handle_configuration,
-                           "plugins", "default", &plugin_name);
-            }
-            else
-            {
-                //
-                // Use the given plugin name
-                //
-                plugin_name = cbmlibmisc_strdup(Adapter);
-            }
-
             //
             // check if the plugin has been disabled
             //
 
             if ( ! plugin_is_active(handle_configuration, plugin_name) ) {
-                error = 1;
+                opencbm_configuration_close(handle_configuration);
                 break;
             }
 
             //
             // get the location of the plugin
             //
-            if (!error)
-            {
-                error = opencbm_configuration_get_data(handle_configuration,
-                           plugin_name, "location", &plugin_location);
-            }
+            error = opencbm_configuration_get_data(handle_configuration,
+                       plugin_name, "location", &plugin_location);
 
             //
             // if an error occurred, make sure that no plugin will be loaded!
@@ -450,47 +866,103 @@ initialize_plugin_pointer(plugin_information_t *Plugin_information, const char *
 
     } while (0);
 
-    cbmlibmisc_strfree(plugin_name);
     cbmlibmisc_strfree(plugin_location);
     cbmlibmisc_strfree(configurationFilename);
 
     return error;
 }
 
+/*! \internal \brief Unload a plugin
+
+ The caller holds the plugin lock.
+
+ \param Plugin
+   The plugin; it must not have any open driver handles anymore.
+*/
 static void
-uninitialize_plugin(void)
+uninitialize_plugin(plugin_information_t * Plugin)
 {
-    if (Plugin_information.Library != NULL)
+    plugin_information_t ** p;
+
+    library_lock();
+
+    for (p = &Plugin_list; *p != NULL; p = &(*p)->Next)
     {
-        if (Plugin_information.Plugin.opencbm_plugin_uninit) {
-            Plugin_information.Plugin.opencbm_plugin_uninit();
+        if (*p == Plugin)
+        {
+            *p = Plugin->Next;
+            break;
         }
+    }
 
-        plugin_unload(Plugin_information.Library);
+    library_unlock();
 
-        Plugin_information.Library = NULL;
+    if (Plugin->Plugin.opencbm_plugin_uninit) {
+        Plugin->Plugin.opencbm_plugin_uninit();
     }
+
+    plugin_unload(Plugin->Library);
+
+    cbmlibmisc_strfree(Plugin->Name);
+    free(Plugin);
 }
 
-static int
+/*! \internal \brief Get a plugin, load it if it is not loaded yet
+
+ The caller holds the plugin lock.
+
+ \param Adapter
+   The name of the plugin, or NULL for the default plugin.
+
+ \return
+   The plugin; NULL if it could not be loaded.
+*/
+static plugin_information_t *
 initialize_plugin(const char * const Adapter)
 {
-    /* if library is already opened and initialized correctly then
-       this function returns OK */
-    int error = 0;
+    plugin_information_t * plugin;
+    char * plugin_name = plugin_get_name(Adapter);
+
+    if (plugin_name == NULL)
+        return NULL;
 
-    /* init pointers if library was not yet opened */
-    if (Plugin_information.Library == NULL)
+    /* if the plugin is already loaded, use it */
+    for (plugin = Plugin_list; plugin != NULL; plugin = plugin->Next)
     {
-        /* if pointer init failed then close library and make Library NULL */
-        error = initialize_plugin_pointer(&Plugin_information, Adapter);
-        if(error != 0)
+        if (strcmp(plugin->Name, plugin_name) == 0)
+            break;
+    }
+
+    if (plugin == NULL)
+    {
+        plugin = calloc(1, sizeof(*plugin));
+
+        if (plugin != NULL)
         {
-            uninitialize_plugin();
+            if (initialize_plugin_pointer(plugin, plugin_name) == 0)
+            {
+                plugin->Name = plugin_name;
+                plugin_name = NULL;
+
+                library_lock();
+                plugin->Next = Plugin_list;
+                Plugin_list = plugin;
+                library_unlock();
+            }
+            else
+            {
+                if (plugin->Library != NULL)
+                    plugin_unload(plugin->Library);
+
+                free(plugin);
+                plugin = NULL;
+            }
         }
     }
 
-    return error;
+    cbmlibmisc_strfree(plugin_name);
+
+    return plugin;
 }
 
 // #define DBG_DUMP_RAW_READ
@@ -588,7 +1060,7 @@ cbm_get_driver_name_ex(char * Adapter)
     char *adapter_stripped = NULL;
     char *port = NULL;
 
-    int error;
+    plugin_information_t * plugin;
 
     FUNC_ENTER();
 
@@ -608,10 +1080,12 @@ cbm_get_driver_name_ex(char * Adapter)
             Adapter, adapter_stripped, port));
     }
 
-    error = initialize_plugin(adapter_stripped);
+    plugin_lock();
 
-    if (error == 0) {
-        ret = Plugin_information.Plugin.opencbm_plugin_get_driver_name(port);
+    plugin = initialize_plugin(adapter_stripped);
+
+    if (plugin != NULL) {
+        ret = plugin->Plugin.opencbm_plugin_get_driver_name(port);
     }
     else {
         ret = "NO PLUGIN DRIVER!";
@@ -619,6 +1093,8 @@ cbm_get_driver_name_ex(char * Adapter)
 
     buffer = cbmlibmisc_strdup(ret);
 
+    plugin_unlock();
+
     cbmlibmisc_strfree(adapter_stripped);
     cbmlibmisc_strfree(port);
 
@@ -682,7 +1158,8 @@ cbm_get_driver_name(int PortNumber)
 int CBMAPIDECL
 cbm_driver_open_ex(CBM_FILE *HandleDevice, char * Adapter)
 {
-    int error;
+    int error = 1;
+    plugin_information_t * plugin;
     char * port = NULL;
     char * adapter_stripped = NULL;
 
@@ -698,12 +1175,33 @@ cbm_driver_open_ex(CBM_FILE *HandleDevice, char * Adapter)
             Adapter, adapter_stripped, port));
     }
 
-    error = initialize_plugin(adapter_stripped);
+    plugin_lock();
+
+    plugin = initialize_plugin(adapter_stripped);
 
     cbmlibmisc_strfree(adapter_stripped);
 
+    if (plugin != NULL) {
+        error = plugin->Plugin.opencbm_plugin_driver_open(HandleDevice, port);
+
+        if (error == 0) {
+            error = handle_register(*HandleDevice, plugin,
+                                    block_caps_query(plugin, *HandleDevice));
+
+            if (error == 0) {
+                ++plugin->Handles;
+            }
+            else {
+                DBG_ERROR((DBG_PREFIX "Too many open driver handles.\n"));
+                plugin->Plugin.opencbm_plugin_driver_close(*HandleDevice);
+            }
+        }
+    }
+
+    plugin_unlock();
+
     if (error == 0) {
-        error = Plugin_information.Plugin.opencbm_plugin_driver_open(HandleDevice, port);
+        statistics_open(*HandleDevice);
     }
 
     cbmlibmisc_strfree(port);
@@ -767,11 +1265,31 @@ cbm_driver_open(CBM_FILE *HandleDevice, int PortNumber)
 void CBMAPIDECL
 cbm_driver_close(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin;
+
     FUNC_ENTER();
 
-    Plugin_information.Plugin.opencbm_plugin_driver_close(HandleDevice);
+    statistics_close(HandleDevice);
 
-    uninitialize_plugin();
+    upload_close(HandleDevice);
+
+    plugin_lock();
+
+    plugin = handle_unregister(HandleDevice);
+
+    if (plugin != NULL) {
+        plugin->Plugin.opencbm_plugin_driver_close(HandleDevice);
+
+        if (--plugin->Handles == 0) {
+            uninitialize_plugin(plugin);
+        }
+    }
+    else if (Plugin_list != NULL) {
+        DBG_WARN((DBG_PREFIX "cbm_driver_close() for an unknown handle"));
+        Plugin_list->Plugin.opencbm_plugin_driver_close(HandleDevice);
+    }
+
+    plugin_unlock();
 
     FUNC_LEAVE();
 }
@@ -803,10 +1321,11 @@ cbm_driver_close(CBM_FILE HandleDevice)
 void CBMAPIDECL
 cbm_lock(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_lock)
-        Plugin_information.Plugin.opencbm_plugin_lock(HandleDevice);
+    if (plugin->Plugin.opencbm_plugin_lock)
+        plugin->Plugin.opencbm_plugin_lock(HandleDevice);
 
     FUNC_LEAVE();
 }
@@ -831,10 +1350,11 @@ cbm_lock(CBM_FILE HandleDevice)
 void CBMAPIDECL
 cbm_unlock(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_unlock)
-        Plugin_information.Plugin.opencbm_plugin_unlock(HandleDevice);
+    if (plugin->Plugin.opencbm_plugin_unlock)
+        plugin->Plugin.opencbm_plugin_unlock(HandleDevice);
 
     FUNC_LEAVE();
 }
@@ -869,13 +1389,21 @@ cbm_unlock(CBM_FILE HandleDevice)
 int CBMAPIDECL
 cbm_raw_write(CBM_FILE HandleDevice, const void *Buffer, size_t Count)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
 #ifdef DBG_DUMP_RAW_WRITE
     DBG_MEMDUMP("cbm_raw_write", Buffer, Count);
 #endif
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_raw_write(HandleDevice,Buffer, Count));
+    ret = plugin->Plugin.opencbm_plugin_raw_write(HandleDevice,Buffer, Count);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_raw_write, start, ret > 0 ? ret : 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 
@@ -905,11 +1433,15 @@ cbm_raw_write(CBM_FILE HandleDevice, const void *Buffer, size_t Count)
 int CBMAPIDECL
 cbm_raw_read(CBM_FILE HandleDevice, void *Buffer, size_t Count)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     int bytesRead = 0;
 
     FUNC_ENTER();
 
-    bytesRead = Plugin_information.Plugin.opencbm_plugin_raw_read(HandleDevice, Buffer, Count);
+    bytesRead = plugin->Plugin.opencbm_plugin_raw_read(HandleDevice, Buffer, Count);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_raw_read, start, bytesRead > 0 ? bytesRead : 0);
 
 #ifdef DBG_DUMP_RAW_READ
     DBG_MEMDUMP("cbm_raw_read", Buffer, bytesRead);
@@ -944,9 +1476,17 @@ cbm_raw_read(CBM_FILE HandleDevice, void *Buffer, size_t Count)
 int CBMAPIDECL
 cbm_listen(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_listen(HandleDevice, DeviceAddress, SecondaryAddress));
+    ret = plugin->Plugin.opencbm_plugin_listen(HandleDevice, DeviceAddress, SecondaryAddress);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_listen, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 /*! \brief Send a TALK on the IEC serial bus
@@ -975,9 +1515,17 @@ cbm_listen(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char Sec
 int CBMAPIDECL
 cbm_talk(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_talk(HandleDevice, DeviceAddress, SecondaryAddress));
+    ret = plugin->Plugin.opencbm_plugin_talk(HandleDevice, DeviceAddress, SecondaryAddress);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_talk, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 /*! \brief Open a file on the IEC serial bus
@@ -1012,11 +1560,15 @@ int CBMAPIDECL
 cbm_open(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress,
          const void *Filename, size_t FilenameLength)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     int returnValue;
 
     FUNC_ENTER();
 
-    returnValue = Plugin_information.Plugin.opencbm_plugin_open(HandleDevice, DeviceAddress, SecondaryAddress);
+    returnValue = plugin->Plugin.opencbm_plugin_open(HandleDevice, DeviceAddress, SecondaryAddress);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_open, start, 0);
 
     if (returnValue == 0)
     {
@@ -1071,9 +1623,17 @@ cbm_open(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char Secon
 int CBMAPIDECL
 cbm_close(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_close(HandleDevice, DeviceAddress, SecondaryAddress));
+    ret = plugin->Plugin.opencbm_plugin_close(HandleDevice, DeviceAddress, SecondaryAddress);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_close, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 /*! \brief Send an UNLISTEN on the IEC serial bus
@@ -1099,9 +1659,17 @@ cbm_close(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char Seco
 int CBMAPIDECL
 cbm_unlisten(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_unlisten(HandleDevice));
+    ret = plugin->Plugin.opencbm_plugin_unlisten(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_unlisten, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 /*! \brief Send an UNTALK on the IEC serial bus
@@ -1127,9 +1695,17 @@ cbm_unlisten(CBM_FILE HandleDevice)
 int CBMAPIDECL
 cbm_untalk(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_untalk(HandleDevice));
+    ret = plugin->Plugin.opencbm_plugin_untalk(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_untalk, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 
@@ -1156,9 +1732,17 @@ cbm_untalk(CBM_FILE HandleDevice)
 int CBMAPIDECL
 cbm_get_eoi(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_get_eoi(HandleDevice));
+    ret = plugin->Plugin.opencbm_plugin_get_eoi(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_get_eoi, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 /*! \brief Reset the EOI flag
@@ -1179,9 +1763,17 @@ cbm_get_eoi(CBM_FILE HandleDevice)
 int CBMAPIDECL
 cbm_clear_eoi(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_clear_eoi(HandleDevice));
+    ret = plugin->Plugin.opencbm_plugin_clear_eoi(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_clear_eoi, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 /*! \brief RESET all devices
@@ -1208,9 +1800,17 @@ cbm_clear_eoi(CBM_FILE HandleDevice)
 int CBMAPIDECL
 cbm_reset(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_reset(HandleDevice));
+    ret = plugin->Plugin.opencbm_plugin_reset(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_reset, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 
@@ -1243,12 +1843,16 @@ cbm_reset(CBM_FILE HandleDevice)
 unsigned char CBMAPIDECL
 cbm_pp_read(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     unsigned char ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_pp_read)
-        ret = Plugin_information.Plugin.opencbm_plugin_pp_read(HandleDevice);
+    if (plugin->Plugin.opencbm_plugin_pp_read)
+        ret = plugin->Plugin.opencbm_plugin_pp_read(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_pp_read, start, 1);
 
     FUNC_LEAVE_UCHAR(ret);
 }
@@ -1281,10 +1885,15 @@ cbm_pp_read(CBM_FILE HandleDevice)
 void CBMAPIDECL
 cbm_pp_write(CBM_FILE HandleDevice, unsigned char Byte)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_pp_write)
-        Plugin_information.Plugin.opencbm_plugin_pp_write(HandleDevice, Byte);
+    if (plugin->Plugin.opencbm_plugin_pp_write)
+        plugin->Plugin.opencbm_plugin_pp_write(HandleDevice, Byte);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_pp_write, start, 1);
 
     FUNC_LEAVE();
 }
@@ -1313,9 +1922,17 @@ cbm_pp_write(CBM_FILE HandleDevice, unsigned char Byte)
 int CBMAPIDECL
 cbm_iec_poll(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_iec_poll(HandleDevice));
+    ret = plugin->Plugin.opencbm_plugin_iec_poll(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_iec_poll, start, 0);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 
@@ -1340,12 +1957,17 @@ cbm_iec_poll(CBM_FILE HandleDevice)
 void CBMAPIDECL
 cbm_iec_set(CBM_FILE HandleDevice, int Line)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_iec_set)
-        Plugin_information.Plugin.opencbm_plugin_iec_set(HandleDevice, Line);
+    if (plugin->Plugin.opencbm_plugin_iec_set)
+        plugin->Plugin.opencbm_plugin_iec_set(HandleDevice, Line);
     else
-        Plugin_information.Plugin.opencbm_plugin_iec_setrelease(HandleDevice, Line, 0);
+        plugin->Plugin.opencbm_plugin_iec_setrelease(HandleDevice, Line, 0);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_iec_setrelease, start, 0);
 
     FUNC_LEAVE();
 }
@@ -1354,131 +1976,660 @@ cbm_iec_set(CBM_FILE HandleDevice, int Line)
 
  This function deactivates (sets to 5V) a line on the IEC serial bus.
 
- \param HandleDevice
-   A CBM_FILE which contains the file handle of the driver.
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be deactivated. This must be exactly one of
+   IEC_DATA, IEC_CLOCK, IEC_ATN, or IEC_RESET.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+
+ \bug
+   This function can't signal an error, thus, be careful!
+*/
+
+void CBMAPIDECL
+cbm_iec_release(CBM_FILE HandleDevice, int Line)
+{
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+
+    FUNC_ENTER();
+
+    if (plugin->Plugin.opencbm_plugin_iec_release)
+        plugin->Plugin.opencbm_plugin_iec_release(HandleDevice, Line);
+    else
+        plugin->Plugin.opencbm_plugin_iec_setrelease(HandleDevice, 0, Line);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_iec_setrelease, start, 0);
+
+    FUNC_LEAVE();
+}
+
+/*! \brief Activate and deactive a line on the IEC serial bus
+
+ This function activates (sets to 0V, L) and deactivates
+ (set to 5V, H) lines on the IEC serial bus.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Set
+   The mask of which lines should be set. This has to be a bitwise OR
+   between the constants IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET
+
+ \param Release
+   The mask of which lines should be released. This has to be a bitwise
+   OR between the constants IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+
+ \bug
+   This function can't signal an error, thus, be careful!
+
+ \remark
+   If a bit is specified in the Set as well as in the Release mask, the
+   effect is undefined.
+*/
+
+void CBMAPIDECL
+cbm_iec_setrelease(CBM_FILE HandleDevice, int Set, int Release)
+{
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+
+    FUNC_ENTER();
+
+    plugin->Plugin.opencbm_plugin_iec_setrelease(HandleDevice, Set, Release);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_iec_setrelease, start, 0);
+
+    FUNC_LEAVE();
+}
+
+/*! \brief Wait for a line to have a specific state
+
+ This function waits for a line to enter a specific state
+ on the IEC serial bus.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be deactivated. This must be exactly one of
+   IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET.
+
+ \param State
+   If zero, then wait for this line to be deactivated. \n
+   If not zero, then wait for this line to be activated.
+
+ \return
+   The state of the IEC bus on return (like cbm_iec_poll).
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+
+ \bug
+   This function can't signal an error, thus, be careful!
+*/
+
+int CBMAPIDECL
+cbm_iec_wait(CBM_FILE HandleDevice, int Line, int State)
+{
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
+    FUNC_ENTER();
+
+    ret = plugin->Plugin.opencbm_plugin_iec_wait(HandleDevice, Line, State);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_iec_wait, start, 0);
+
+    FUNC_LEAVE_INT(ret);
+}
+
+/*! \brief Get the (logical) state of a line on the IEC serial bus
+
+ This function gets the (logical) state of a line on the IEC serial bus.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be tested. This must be exactly one of
+   IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET.
+
+ \return
+   1 if the line is set, 0 if it is not
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+
+ \bug
+   This function can't signal an error, thus, be careful!
+*/
+
+int CBMAPIDECL
+cbm_iec_get(CBM_FILE HandleDevice, int Line)
+{
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret;
+
+    FUNC_ENTER();
+
+    ret = (plugin->Plugin.opencbm_plugin_iec_poll(HandleDevice)&Line) != 0 ? 1 : 0;
+
+    STATISTICS_STOP(HandleDevice, cbm_se_iec_poll, start, 0);
+
+    FUNC_LEAVE_INT(ret);
+}
+
+/*! \internal \brief Wait for a line, with an optional timeout
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to wait for.
+
+ \param State
+   If zero, wait for the line to be released; else, wait for it to be set.
+
+ \param Timeout
+   The timeout in units of 10 ms; 0 means no timeout.
+
+ \return
+   0 on success, -1 on timeout.
+*/
+static int
+iec_script_wait(plugin_information_t * Plugin, CBM_FILE HandleDevice, int Line, int State, unsigned int Timeout)
+{
+    unsigned int polls;
+
+    if (Timeout == 0)
+    {
+        Plugin->Plugin.opencbm_plugin_iec_wait(HandleDevice, Line, State);
+        return 0;
+    }
+
+    /* poll about once per ms; this is a lower bound, as usleep() can take longer */
+    for (polls = Timeout * 10; polls > 0; polls--)
+    {
+        int set = (Plugin->Plugin.opencbm_plugin_iec_poll(HandleDevice) & Line) != 0;
+
+        if (set == (State != 0))
+            return 0;
+
+        arch_usleep(1000);
+    }
+
+    return -1;
+}
+
+/*! \internal \brief Execute an IEC line script on the host
+
+ This is used if the plugin cannot execute scripts itself.
+ The parameters are the same as for cbm_iec_script().
+*/
+static int
+iec_script_execute(plugin_information_t * Plugin, CBM_FILE HandleDevice, const unsigned char *Script, unsigned int Length,
+                   unsigned char *Result, unsigned int ResultLength)
+{
+    unsigned int timeout = 0;
+    unsigned int samples = 0;
+    int last_sample = 0;
+    unsigned int i;
+
+    for (i = 0; i < Length; i++)
+    {
+        int line = IEC_SCRIPT_ARG(Script[i]);
+        int ret = 0;
+
+        switch (IEC_SCRIPT_OP(Script[i]))
+        {
+        case IEC_SCRIPT_NOP:
+            break;
+
+        case IEC_SCRIPT_SET(0):
+            Plugin->Plugin.opencbm_plugin_iec_setrelease(HandleDevice, line, 0);
+            break;
+
+        case IEC_SCRIPT_RELEASE(0):
+            Plugin->Plugin.opencbm_plugin_iec_setrelease(HandleDevice, 0, line);
+            break;
+
+        case IEC_SCRIPT_WAIT_SET(0):
+            ret = iec_script_wait(Plugin, HandleDevice, line, 1, timeout);
+            break;
+
+        case IEC_SCRIPT_WAIT_RELEASE(0):
+            ret = iec_script_wait(Plugin, HandleDevice, line, 0, timeout);
+            break;
+
+        case IEC_SCRIPT_WAIT_CHANGE(0):
+            ret = iec_script_wait(Plugin, HandleDevice, line, !last_sample, timeout);
+            break;
+
+        case IEC_SCRIPT_SAMPLE(0):
+            if (samples >= ResultLength * 8)
+                return -1;
+
+            last_sample = (Plugin->Plugin.opencbm_plugin_iec_poll(HandleDevice) & line) != 0;
+
+            if (last_sample)
+                Result[samples / 8] |= 1 << (samples % 8);
+            else
+                Result[samples / 8] &= ~(1 << (samples % 8));
+            samples++;
+            break;
+
+        case IEC_SCRIPT_TIMEOUT(0):
+            timeout = line;
+            break;
+        }
+
+        if (ret)
+            return -1;
+    }
+
+    return samples;
+}
+
+/*! \brief Execute a script of IEC line operations
+
+ This function executes a sequence of set, release, wait and
+ sample operations on the IEC serial bus. If the adapter supports
+ it, the complete script is executed by the adapter itself, which
+ saves a round trip to the adapter for every single operation.
+ Otherwise, the script is executed by the library.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Script
+   The operations to execute, built with the IEC_SCRIPT_... macros.
+
+ \param Length
+   The number of bytes in Script, at most IEC_SCRIPT_MAXLEN.
+
+ \param Result
+   Receives the sampled bits. The first sample is stored in bit 0
+   of Result[0], the 9th one in bit 0 of Result[1], and so on.
+
+ \param ResultLength
+   The size of Result, in bytes.
+
+ \return
+   The number of sampled bits on success, -1 on error or if a
+   wait timed out.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+*/
+
+int CBMAPIDECL
+cbm_iec_script(CBM_FILE HandleDevice, const unsigned char *Script, unsigned int Length,
+               unsigned char *Result, unsigned int ResultLength)
+{
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+    int ret = -2;
+
+    FUNC_ENTER();
+
+    if (Length > IEC_SCRIPT_MAXLEN)
+    {
+        FUNC_LEAVE_INT(-1);
+    }
+
+    if (plugin->Plugin.opencbm_plugin_iec_script)
+    {
+        ret = plugin->Plugin.opencbm_plugin_iec_script(HandleDevice, Script, Length, Result, ResultLength);
+    }
+
+    if (ret == -2)
+    {
+        ret = iec_script_execute(plugin, HandleDevice, Script, Length, Result, ResultLength);
+    }
+
+    STATISTICS_STOP(HandleDevice, cbm_se_iec_script, start, 0);
+
+    FUNC_LEAVE_INT(ret);
+}
+
+
+/*-------------------------------------------------------------------*/
+/*--------- BLOCK TRANSFERS -----------------------------------------*/
+
+/*! \internal \brief Transfer a block with serial-1 or serial-2, by IEC line scripts
+
+ As many bytes as fit into IEC_SCRIPT_MAXLEN are moved with one script.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Protocol
+   cbm_bp_s1 or cbm_bp_s2.
+
+ \param Write
+   0 to read the block, 1 to write it.
+
+ \param Data
+   The bytes to write, or the buffer for the bytes read.
+
+ \param Size
+   The number of bytes to transfer.
+
+ \return
+   The number of bytes transferred.
+*/
+static int
+block_transfer_script(CBM_FILE HandleDevice, enum cbm_block_protocol_e Protocol, int Write,
+                      unsigned char *Data, unsigned int Size)
+{
+    unsigned char script[IEC_SCRIPT_MAXLEN];
+    unsigned int scriptLength;
+    unsigned int done = 0;
+    unsigned int count;
+
+    while (done < Size)
+    {
+        scriptLength = 0;
+
+        if (Write)
+        {
+            for (count = 0; done + count < Size; count++)
+            {
+                if (Protocol == cbm_bp_s1)
+                {
+                    if (scriptLength + CBMLIBMISC_IEC_SCRIPT_S1_LEN > sizeof(script))
+                        break;
+                    scriptLength += cbmlibmisc_iec_script_s1_write(script + scriptLength, Data[done + count], 1);
+                }
+                else
+                {
+                    if (scriptLength + CBMLIBMISC_IEC_SCRIPT_S2_WRITE_LEN > sizeof(script))
+                        break;
+                    scriptLength += cbmlibmisc_iec_script_s2_write(script + scriptLength, Data[done + count], 1);
+                }
+            }
+
+            if (cbm_iec_script(HandleDevice, script, scriptLength, NULL, 0) < 0)
+                break;
+        }
+        else
+        {
+            for (count = 0; done + count < Size; count++)
+            {
+                if (Protocol == cbm_bp_s1)
+                {
+                    if (scriptLength + CBMLIBMISC_IEC_SCRIPT_S1_LEN > sizeof(script))
+                        break;
+                    scriptLength += cbmlibmisc_iec_script_s1_read(script + scriptLength);
+                }
+                else
+                {
+                    if (scriptLength + CBMLIBMISC_IEC_SCRIPT_S2_READ_LEN > sizeof(script))
+                        break;
+                    scriptLength += cbmlibmisc_iec_script_s2_read(script + scriptLength);
+                }
+            }
+
+            if (cbm_iec_script(HandleDevice, script, scriptLength, Data + done, count) < 0)
+                break;
+        }
+
+        done += count;
+    }
+
+    return done;
+}
+
+/*! \internal \brief Transfer a block with the parallel protocol of cbmcopy, byte by byte
+
+ \param Plugin
+   The plugin the handle has been opened with.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Write
+   0 to read the block, 1 to write it.
+
+ \param Data
+   The bytes to write, or the buffer for the bytes read.
+
+ \param Size
+   The number of bytes to transfer.
+
+ \return
+   The number of bytes transferred, -1 if the adapter has no
+   parallel port.
+*/
+static int
+block_transfer_pp_cc(plugin_information_t * Plugin, CBM_FILE HandleDevice, int Write,
+                     unsigned char *Data, unsigned int Size)
+{
+    opencbm_plugin_t * p = &Plugin->Plugin;
+    unsigned int i;
+
+    if (p->opencbm_plugin_pp_read == NULL || p->opencbm_plugin_pp_write == NULL)
+        return -1;
+
+    for (i = 0; i < Size; i++)
+    {
+        if (Write)
+            p->opencbm_plugin_pp_write(HandleDevice, Data[i]);
+
+        p->opencbm_plugin_iec_setrelease(HandleDevice, 0, IEC_CLOCK);
+        p->opencbm_plugin_iec_wait(HandleDevice, IEC_DATA, 0);
+
+        if (!Write)
+            Data[i] = p->opencbm_plugin_pp_read(HandleDevice);
+
+        p->opencbm_plugin_iec_setrelease(HandleDevice, IEC_CLOCK, 0);
+        p->opencbm_plugin_iec_wait(HandleDevice, IEC_DATA, 1);
+    }
+
+    return i;
+}
+
+/*! \internal \brief Transfer a block with one of the protocols of the drive programs
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Protocol
+   The protocol to use.
+
+ \param Write
+   0 to read the block, 1 to write it.
+
+ \param Data
+   The bytes to write, or the buffer for the bytes read.
+
+ \param Size
+   The number of bytes to transfer.
+
+ \return
+   The number of bytes transferred, -1 on error.
+*/
+static int
+block_transfer(CBM_FILE HandleDevice, enum cbm_block_protocol_e Protocol, int Write,
+               unsigned char *Data, unsigned int Size)
+{
+    int blockCaps;
+    plugin_information_t * plugin = handle_lookup(HandleDevice, &blockCaps);
+    opencbm_plugin_t * p = &plugin->Plugin;
+    unsigned long start = STATISTICS_START();
+    int ret = -1;
+
+    if (blockCaps & CBM_BLOCK_CAP(Protocol))
+    {
+        switch (Protocol)
+        {
+        case cbm_bp_s1:
+            ret = Write ? p->opencbm_plugin_s1_write_n(HandleDevice, Data, Size)
+                        : p->opencbm_plugin_s1_read_n(HandleDevice, Data, Size);
+            break;
+
+        case cbm_bp_s2:
+            ret = Write ? p->opencbm_plugin_s2_write_n(HandleDevice, Data, Size)
+                        : p->opencbm_plugin_s2_read_n(HandleDevice, Data, Size);
+            break;
 
- \param Line
-   The line to be deactivated. This must be exactly one of
-   IEC_DATA, IEC_CLOCK, IEC_ATN, or IEC_RESET.
+        case cbm_bp_pp_dc:
+            ret = Write ? p->opencbm_plugin_pp_dc_write_n(HandleDevice, Data, Size)
+                        : p->opencbm_plugin_pp_dc_read_n(HandleDevice, Data, Size);
+            break;
 
- If cbm_driver_open() did not succeed, it is illegal to
- call this function.
+        case cbm_bp_pp_cc:
+            ret = Write ? p->opencbm_plugin_pp_cc_write_n(HandleDevice, Data, Size)
+                        : p->opencbm_plugin_pp_cc_read_n(HandleDevice, Data, Size);
+            break;
+        }
+    }
+    else
+    {
+        /*
+         * The parallel protocol of d64copy needs a delay whenever the
+         * direction changes, which only d64copy itself knows about.
+         */
+        switch (Protocol)
+        {
+        case cbm_bp_s1:
+        case cbm_bp_s2:
+            ret = block_transfer_script(HandleDevice, Protocol, Write, Data, Size);
+            break;
 
- \bug
-   This function can't signal an error, thus, be careful!
-*/
+        case cbm_bp_pp_cc:
+            ret = block_transfer_pp_cc(plugin, HandleDevice, Write, Data, Size);
+            break;
 
-void CBMAPIDECL
-cbm_iec_release(CBM_FILE HandleDevice, int Line)
-{
-    FUNC_ENTER();
+        default:
+            break;
+        }
+    }
 
-    if (Plugin_information.Plugin.opencbm_plugin_iec_release)
-        Plugin_information.Plugin.opencbm_plugin_iec_release(HandleDevice, Line);
-    else
-        Plugin_information.Plugin.opencbm_plugin_iec_setrelease(HandleDevice, 0, Line);
+    STATISTICS_STOP(HandleDevice, cbm_se_block, start, ret > 0 ? ret : 0);
 
-    FUNC_LEAVE();
+    return ret;
 }
 
-/*! \brief Activate and deactive a line on the IEC serial bus
+/*! \brief Query the protocols an adapter moves complete blocks with
 
- This function activates (sets to 0V, L) and deactivates
- (set to 5V, H) lines on the IEC serial bus.
+ The drive programs of cbmcopy, d64copy and the other tools transfer
+ their data with the protocols of enum cbm_block_protocol_e.
+ cbm_block_read() and cbm_block_write() can use all of them with
+ every adapter, but only the ones returned here are executed by
+ the adapter (or its driver) itself, with one request per block.
+ The others are emulated by the library, which needs at least one
+ request per byte.
 
  \param HandleDevice
    A CBM_FILE which contains the file handle of the driver.
 
- \param Set
-   The mask of which lines should be set. This has to be a bitwise OR
-   between the constants IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET
-
- \param Release
-   The mask of which lines should be released. This has to be a bitwise
-   OR between the constants IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET
+ \return
+   A bit mask with CBM_BLOCK_CAP(protocol) set for every protocol
+   the adapter moves blocks with.
 
  If cbm_driver_open() did not succeed, it is illegal to
  call this function.
-
- \bug
-   This function can't signal an error, thus, be careful!
-
- \remark
-   If a bit is specified in the Set as well as in the Release mask, the
-   effect is undefined.
 */
 
-void CBMAPIDECL
-cbm_iec_setrelease(CBM_FILE HandleDevice, int Set, int Release)
+int CBMAPIDECL
+cbm_block_caps(CBM_FILE HandleDevice)
 {
+    int blockCaps;
+
     FUNC_ENTER();
 
-    Plugin_information.Plugin.opencbm_plugin_iec_setrelease(HandleDevice, Set, Release);
+    handle_lookup(HandleDevice, &blockCaps);
 
-    FUNC_LEAVE();
+    FUNC_LEAVE_INT(blockCaps);
 }
 
-/*! \brief Wait for a line to have a specific state
+/*! \brief Read a block with one of the protocols of the drive programs
 
- This function waits for a line to enter a specific state
- on the IEC serial bus.
+ If the adapter supports the protocol (see cbm_block_caps()), the
+ complete block is read with one request. Otherwise, the library
+ emulates it; this is not available for cbm_bp_pp_dc, which is left
+ to d64copy.
 
  \param HandleDevice
    A CBM_FILE which contains the file handle of the driver.
 
- \param Line
-   The line to be deactivated. This must be exactly one of
-   IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET.
+ \param Protocol
+   The protocol of the drive program.
 
- \param State
-   If zero, then wait for this line to be deactivated. \n
-   If not zero, then wait for this line to be activated.
+ \param Buffer
+   Receives the bytes read.
+
+ \param Size
+   The number of bytes to read.
 
  \return
-   The state of the IEC bus on return (like cbm_iec_poll).
+   The number of bytes actually read, -1 on error.
 
  If cbm_driver_open() did not succeed, it is illegal to
  call this function.
-
- \bug
-   This function can't signal an error, thus, be careful!
 */
 
 int CBMAPIDECL
-cbm_iec_wait(CBM_FILE HandleDevice, int Line, int State)
+cbm_block_read(CBM_FILE HandleDevice, enum cbm_block_protocol_e Protocol,
+               unsigned char *Buffer, unsigned int Size)
 {
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT(Plugin_information.Plugin.opencbm_plugin_iec_wait(HandleDevice, Line, State));
+    ret = block_transfer(HandleDevice, Protocol, 0, Buffer, Size);
+
+    FUNC_LEAVE_INT(ret);
 }
 
-/*! \brief Get the (logical) state of a line on the IEC serial bus
+/*! \brief Write a block with one of the protocols of the drive programs
 
- This function gets the (logical) state of a line on the IEC serial bus.
+ If the adapter supports the protocol (see cbm_block_caps()), the
+ complete block is written with one request. Otherwise, the library
+ emulates it; this is not available for cbm_bp_pp_dc, which is left
+ to d64copy.
 
  \param HandleDevice
    A CBM_FILE which contains the file handle of the driver.
 
- \param Line
-   The line to be tested. This must be exactly one of
-   IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET.
+ \param Protocol
+   The protocol of the drive program.
+
+ \param Buffer
+   The bytes to write.
+
+ \param Size
+   The number of bytes to write.
 
  \return
-   1 if the line is set, 0 if it is not
+   The number of bytes actually written, -1 on error.
 
  If cbm_driver_open() did not succeed, it is illegal to
  call this function.
-
- \bug
-   This function can't signal an error, thus, be careful!
 */
 
 int CBMAPIDECL
-cbm_iec_get(CBM_FILE HandleDevice, int Line)
+cbm_block_write(CBM_FILE HandleDevice, enum cbm_block_protocol_e Protocol,
+                const unsigned char *Buffer, unsigned int Size)
 {
+    int ret;
+
     FUNC_ENTER();
 
-    FUNC_LEAVE_INT((Plugin_information.Plugin.opencbm_plugin_iec_poll(HandleDevice)&Line) != 0 ? 1 : 0);
+    ret = block_transfer(HandleDevice, Protocol, 1, (unsigned char *) Buffer, Size);
+
+    FUNC_LEAVE_INT(ret);
 }
 
 
@@ -1641,12 +2792,16 @@ cbm_exec_command(CBM_FILE HandleDevice, unsigned char DeviceAddress,
 unsigned char CBMAPIDECL
 cbm_parallel_burst_read(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     unsigned char ret = 0;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_read)
-        ret = Plugin_information.Plugin.opencbm_plugin_parallel_burst_read(HandleDevice);
+    if (plugin->Plugin.opencbm_plugin_parallel_burst_read)
+        ret = plugin->Plugin.opencbm_plugin_parallel_burst_read(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_parallel_burst, start, 1);
 
     FUNC_LEAVE_UCHAR(ret);
 }
@@ -1671,10 +2826,15 @@ cbm_parallel_burst_read(CBM_FILE HandleDevice)
 void CBMAPIDECL
 cbm_parallel_burst_write(CBM_FILE HandleDevice, unsigned char Value)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_write)
-        Plugin_information.Plugin.opencbm_plugin_parallel_burst_write(HandleDevice, Value);
+    if (plugin->Plugin.opencbm_plugin_parallel_burst_write)
+        plugin->Plugin.opencbm_plugin_parallel_burst_write(HandleDevice, Value);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_parallel_burst, start, 1);
 
     FUNC_LEAVE();
 }
@@ -1683,22 +2843,26 @@ int CBMAPIDECL
 cbm_parallel_burst_read_n(CBM_FILE HandleDevice, unsigned char *Buffer,
     unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     unsigned int i;
     int rv;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_n) {
-        rv = Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_n(
+    if (plugin->Plugin.opencbm_plugin_parallel_burst_read_n) {
+        rv = plugin->Plugin.opencbm_plugin_parallel_burst_read_n(
             HandleDevice, Buffer, Length);
     } else {
         for (i = 0; i < Length; i++) {
-            Buffer[i] = Plugin_information.Plugin
+            Buffer[i] = plugin->Plugin
                 .opencbm_plugin_parallel_burst_read(HandleDevice);
         }
         rv = Length;
     }
 
+    STATISTICS_STOP(HandleDevice, cbm_se_parallel_burst, start, rv > 0 ? rv : 0);
+
     FUNC_LEAVE_INT(rv);
 }
 
@@ -1706,22 +2870,26 @@ int CBMAPIDECL
 cbm_parallel_burst_write_n(CBM_FILE HandleDevice, unsigned char *Buffer,
     unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     unsigned int i;
     int rv;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_write_n) {
-        rv = Plugin_information.Plugin.opencbm_plugin_parallel_burst_write_n(
+    if (plugin->Plugin.opencbm_plugin_parallel_burst_write_n) {
+        rv = plugin->Plugin.opencbm_plugin_parallel_burst_write_n(
             HandleDevice, Buffer, Length);
     } else {
         for (i = 0; i < Length; i++) {
-            Plugin_information.Plugin.opencbm_plugin_parallel_burst_write(
+            plugin->Plugin.opencbm_plugin_parallel_burst_write(
                 HandleDevice, Buffer[i]);
         }
         rv = Length;
     }
 
+    STATISTICS_STOP(HandleDevice, cbm_se_parallel_burst, start, rv > 0 ? rv : 0);
+
     FUNC_LEAVE_INT(rv);
 }
 
@@ -1752,12 +2920,16 @@ cbm_parallel_burst_write_n(CBM_FILE HandleDevice, unsigned char *Buffer,
 int CBMAPIDECL
 cbm_parallel_burst_read_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_track(HandleDevice, Buffer, Length);
+    if (plugin->Plugin.opencbm_plugin_parallel_burst_read_track)
+        ret = plugin->Plugin.opencbm_plugin_parallel_burst_read_track(HandleDevice, Buffer, Length);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_parallel_burst_track, start, ret > 0 ? Length : 0);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -1786,12 +2958,16 @@ cbm_parallel_burst_read_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsi
 int CBMAPIDECL
 cbm_parallel_burst_read_track_var(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_parallel_burst_read_track_var(HandleDevice, Buffer, Length);
+    if (plugin->Plugin.opencbm_plugin_parallel_burst_read_track)
+        ret = plugin->Plugin.opencbm_plugin_parallel_burst_read_track_var(HandleDevice, Buffer, Length);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_parallel_burst_track, start, ret > 0 ? Length : 0);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -1823,12 +2999,16 @@ cbm_parallel_burst_read_track_var(CBM_FILE HandleDevice, unsigned char *Buffer,
 int CBMAPIDECL
 cbm_parallel_burst_write_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_parallel_burst_write_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_parallel_burst_write_track(HandleDevice, Buffer, Length);
+    if (plugin->Plugin.opencbm_plugin_parallel_burst_write_track)
+        ret = plugin->Plugin.opencbm_plugin_parallel_burst_write_track(HandleDevice, Buffer, Length);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_parallel_burst_track, start, ret > 0 ? Length : 0);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -1853,12 +3033,16 @@ cbm_parallel_burst_write_track(CBM_FILE HandleDevice, unsigned char *Buffer, uns
 unsigned char CBMAPIDECL
 cbm_srq_burst_read(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     unsigned char ret = 0;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_read)
-        ret = Plugin_information.Plugin.opencbm_plugin_srq_burst_read(HandleDevice);
+    if (plugin->Plugin.opencbm_plugin_srq_burst_read)
+        ret = plugin->Plugin.opencbm_plugin_srq_burst_read(HandleDevice);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_srq_burst, start, 1);
 
     FUNC_LEAVE_UCHAR(ret);
 }
@@ -1883,10 +3067,15 @@ cbm_srq_burst_read(CBM_FILE HandleDevice)
 void CBMAPIDECL
 cbm_srq_burst_write(CBM_FILE HandleDevice, unsigned char Value)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
+
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_write)
-        Plugin_information.Plugin.opencbm_plugin_srq_burst_write(HandleDevice, Value);
+    if (plugin->Plugin.opencbm_plugin_srq_burst_write)
+        plugin->Plugin.opencbm_plugin_srq_burst_write(HandleDevice, Value);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_srq_burst, start, 1);
 
     FUNC_LEAVE();
 }
@@ -1895,22 +3084,26 @@ int CBMAPIDECL
 cbm_srq_burst_read_n(CBM_FILE HandleDevice, unsigned char *Buffer,
     unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     unsigned int i;
     int rv;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_read_n) {
-        rv = Plugin_information.Plugin.opencbm_plugin_srq_burst_read_n(
+    if (plugin->Plugin.opencbm_plugin_srq_burst_read_n) {
+        rv = plugin->Plugin.opencbm_plugin_srq_burst_read_n(
             HandleDevice, Buffer, Length);
     } else {
         for (i = 0; i < Length; i++) {
-            Buffer[i] = Plugin_information.Plugin
+            Buffer[i] = plugin->Plugin
                 .opencbm_plugin_srq_burst_read(HandleDevice);
         }
         rv = Length;
     }
 
+    STATISTICS_STOP(HandleDevice, cbm_se_srq_burst, start, rv > 0 ? rv : 0);
+
     FUNC_LEAVE_INT(rv);
 }
 
@@ -1918,22 +3111,26 @@ int CBMAPIDECL
 cbm_srq_burst_write_n(CBM_FILE HandleDevice, unsigned char *Buffer,
     unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     unsigned int i;
     int rv;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_write_n) {
-        rv = Plugin_information.Plugin.opencbm_plugin_srq_burst_write_n(
+    if (plugin->Plugin.opencbm_plugin_srq_burst_write_n) {
+        rv = plugin->Plugin.opencbm_plugin_srq_burst_write_n(
             HandleDevice, Buffer, Length);
     } else {
         for (i = 0; i < Length; i++) {
-            Plugin_information.Plugin.opencbm_plugin_srq_burst_write(
+            plugin->Plugin.opencbm_plugin_srq_burst_write(
                 HandleDevice, Buffer[i]);
         }
         rv = Length;
     }
 
+    STATISTICS_STOP(HandleDevice, cbm_se_srq_burst, start, rv > 0 ? rv : 0);
+
     FUNC_LEAVE_INT(rv);
 }
 
@@ -1964,12 +3161,16 @@ cbm_srq_burst_write_n(CBM_FILE HandleDevice, unsigned char *Buffer,
 int CBMAPIDECL
 cbm_srq_burst_read_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_read_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_srq_burst_read_track(HandleDevice, Buffer, Length);
+    if (plugin->Plugin.opencbm_plugin_srq_burst_read_track)
+        ret = plugin->Plugin.opencbm_plugin_srq_burst_read_track(HandleDevice, Buffer, Length);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_srq_burst_track, start, ret > 0 ? Length : 0);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2001,12 +3202,16 @@ cbm_srq_burst_read_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned
 int CBMAPIDECL
 cbm_srq_burst_write_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Length)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    unsigned long start = STATISTICS_START();
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_srq_burst_write_track)
-        ret = Plugin_information.Plugin.opencbm_plugin_srq_burst_write_track(HandleDevice, Buffer, Length);
+    if (plugin->Plugin.opencbm_plugin_srq_burst_write_track)
+        ret = plugin->Plugin.opencbm_plugin_srq_burst_write_track(HandleDevice, Buffer, Length);
+
+    STATISTICS_STOP(HandleDevice, cbm_se_srq_burst_track, start, ret > 0 ? Length : 0);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2031,12 +3236,13 @@ cbm_srq_burst_write_track(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned
 int CBMAPIDECL
 cbm_tap_prepare_capture(CBM_FILE HandleDevice, int *Status)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_prepare_capture)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_prepare_capture(HandleDevice, Status);
+    if (plugin->Plugin.opencbm_plugin_tap_prepare_capture)
+        ret = plugin->Plugin.opencbm_plugin_tap_prepare_capture(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2061,12 +3267,13 @@ cbm_tap_prepare_capture(CBM_FILE HandleDevice, int *Status)
 int CBMAPIDECL
 cbm_tap_prepare_write(CBM_FILE HandleDevice, int *Status)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_prepare_write)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_prepare_write(HandleDevice, Status);
+    if (plugin->Plugin.opencbm_plugin_tap_prepare_write)
+        ret = plugin->Plugin.opencbm_plugin_tap_prepare_write(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2091,12 +3298,13 @@ cbm_tap_prepare_write(CBM_FILE HandleDevice, int *Status)
 int CBMAPIDECL
 cbm_tap_get_sense(CBM_FILE HandleDevice, int *Status)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_get_sense)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_get_sense(HandleDevice, Status);
+    if (plugin->Plugin.opencbm_plugin_tap_get_sense)
+        ret = plugin->Plugin.opencbm_plugin_tap_get_sense(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2121,12 +3329,13 @@ cbm_tap_get_sense(CBM_FILE HandleDevice, int *Status)
 int CBMAPIDECL
 cbm_tap_wait_for_stop_sense(CBM_FILE HandleDevice, int *Status)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_wait_for_stop_sense)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_wait_for_stop_sense(HandleDevice, Status);
+    if (plugin->Plugin.opencbm_plugin_tap_wait_for_stop_sense)
+        ret = plugin->Plugin.opencbm_plugin_tap_wait_for_stop_sense(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2151,12 +3360,13 @@ cbm_tap_wait_for_stop_sense(CBM_FILE HandleDevice, int *Status)
 int CBMAPIDECL
 cbm_tap_wait_for_play_sense(CBM_FILE HandleDevice, int *Status)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_wait_for_play_sense)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_wait_for_play_sense(HandleDevice, Status);
+    if (plugin->Plugin.opencbm_plugin_tap_wait_for_play_sense)
+        ret = plugin->Plugin.opencbm_plugin_tap_wait_for_play_sense(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2181,12 +3391,13 @@ cbm_tap_wait_for_play_sense(CBM_FILE HandleDevice, int *Status)
 int CBMAPIDECL
 cbm_tap_motor_on(CBM_FILE HandleDevice, int *Status)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_motor_on)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_motor_on(HandleDevice, Status);
+    if (plugin->Plugin.opencbm_plugin_tap_motor_on)
+        ret = plugin->Plugin.opencbm_plugin_tap_motor_on(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2211,12 +3422,13 @@ cbm_tap_motor_on(CBM_FILE HandleDevice, int *Status)
 int CBMAPIDECL
 cbm_tap_motor_off(CBM_FILE HandleDevice, int *Status)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_motor_off)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_motor_off(HandleDevice, Status);
+    if (plugin->Plugin.opencbm_plugin_tap_motor_off)
+        ret = plugin->Plugin.opencbm_plugin_tap_motor_off(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2253,12 +3465,60 @@ cbm_tap_motor_off(CBM_FILE HandleDevice, int *Status)
 int CBMAPIDECL
 cbm_tap_start_capture(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Buffer_Length, int *Status, int *BytesRead)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    int ret = -1;
+
+    FUNC_ENTER();
+
+    if (plugin->Plugin.opencbm_plugin_tap_start_capture)
+        ret = plugin->Plugin.opencbm_plugin_tap_start_capture(HandleDevice, Buffer, Buffer_Length, Status, BytesRead);
+
+    FUNC_LEAVE_INT(ret);
+}
+
+/*! \brief TAPE: Start streaming capture
+
+ This function is a helper function for tape:
+ It starts the actual tape capture, like cbm_tap_start_capture().
+ Instead of filling one buffer which must be big enough for the
+ whole tape, the captured data is given to a callback function
+ as soon as it arrives.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Callback
+   The function which gets the captured data. If it returns != 0,
+   the capture is stopped as if cbm_tap_break() had been called.
+
+ \param Context
+   Context pointer that is given to the Callback.
+
+ \param Status
+   The return status.
+
+ \param BytesRead
+   The number of bytes read.
+
+ \return
+   != 0 on success, -1 if the plugin does not support streaming.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+
+ Note that a plugin is not required to implement this function.
+*/
+
+int CBMAPIDECL
+cbm_tap_capture_stream(CBM_FILE HandleDevice, cbm_tap_capture_cb_t *Callback, void *Context, int *Status, int *BytesRead)
+{
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_start_capture)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_start_capture(HandleDevice, Buffer, Buffer_Length, Status, BytesRead);
+    if (plugin->Plugin.opencbm_plugin_tap_capture_stream)
+        ret = plugin->Plugin.opencbm_plugin_tap_capture_stream(HandleDevice, Callback, Context, Status, BytesRead);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2295,12 +3555,13 @@ cbm_tap_start_capture(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int
 int CBMAPIDECL
 cbm_tap_start_write(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Length, int *Status, int *BytesWritten)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_start_write)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_start_write(HandleDevice, Buffer, Length, Status, BytesWritten);
+    if (plugin->Plugin.opencbm_plugin_tap_start_write)
+        ret = plugin->Plugin.opencbm_plugin_tap_start_write(HandleDevice, Buffer, Length, Status, BytesWritten);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2326,12 +3587,13 @@ cbm_tap_start_write(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int L
 int CBMAPIDECL
 cbm_tap_get_ver(CBM_FILE HandleDevice, int *Status)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_get_ver)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_get_ver(HandleDevice, Status);
+    if (plugin->Plugin.opencbm_plugin_tap_get_ver)
+        ret = plugin->Plugin.opencbm_plugin_tap_get_ver(HandleDevice, Status);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2340,12 +3602,13 @@ cbm_tap_get_ver(CBM_FILE HandleDevice, int *Status)
 int CBMAPIDECL
 cbm_tap_break(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_break)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_break(HandleDevice);
+    if (plugin->Plugin.opencbm_plugin_tap_break)
+        ret = plugin->Plugin.opencbm_plugin_tap_break(HandleDevice);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2383,12 +3646,13 @@ cbm_tap_break(CBM_FILE HandleDevice)
 int CBMAPIDECL
 cbm_tap_download_config(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Buffer_Length, int *Status, int *BytesRead)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_download_config)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_download_config(HandleDevice, Buffer, Buffer_Length, Status, BytesRead);
+    if (plugin->Plugin.opencbm_plugin_tap_download_config)
+        ret = plugin->Plugin.opencbm_plugin_tap_download_config(HandleDevice, Buffer, Buffer_Length, Status, BytesRead);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2425,12 +3689,13 @@ cbm_tap_download_config(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned i
 int CBMAPIDECL
 cbm_tap_upload_config(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int Length, int *Status, int *BytesWritten)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int ret = -1;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Plugin.opencbm_plugin_tap_upload_config)
-        ret = Plugin_information.Plugin.opencbm_plugin_tap_upload_config(HandleDevice, Buffer, Length, Status, BytesWritten);
+    if (plugin->Plugin.opencbm_plugin_tap_upload_config)
+        ret = plugin->Plugin.opencbm_plugin_tap_upload_config(HandleDevice, Buffer, Length, Status, BytesWritten);
 
     FUNC_LEAVE_INT(ret);
 }
@@ -2449,6 +3714,11 @@ cbm_tap_upload_config(CBM_FILE HandleDevice, unsigned char *Buffer, unsigned int
 
  If cbm_driver_open() did not succeed, it is illegal to
  call this function.
+
+ \remark
+   If more than one plugin is in use, this uses the plugin
+   which has been loaded last. Use
+   cbm_get_plugin_function_address_ex() instead.
 */
 
 
@@ -2456,11 +3726,51 @@ void * CBMAPIDECL
 cbm_get_plugin_function_address(const char * Functionname)
 {
     void * pointer = NULL;
+    SHARED_OBJECT_HANDLE library = NULL;
+
+    FUNC_ENTER();
+
+    library_lock();
+
+    if (Plugin_list)
+        library = Plugin_list->Library;
+
+    library_unlock();
+
+    if (library)
+        pointer = plugin_get_address(library, Functionname);
+
+    FUNC_LEAVE_PTR(pointer, void*);
+}
+
+/*! \brief Get the function pointer for a function in the plugin of a driver handle
+
+ This function gets the function pointer for a function which
+ resides in the plugin HandleDevice has been opened with.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Functionname
+   The name of the function of which to get the address
+
+ \return
+   Pointer to the function if successfull; 0 if not.
+
+ The function has to be called with HandleDevice, or with
+ another handle of the same plugin.
+*/
+
+void * CBMAPIDECL
+cbm_get_plugin_function_address_ex(CBM_FILE HandleDevice, const char * Functionname)
+{
+    plugin_information_t * plugin = plugin_of(HandleDevice);
+    void * pointer = NULL;
 
     FUNC_ENTER();
 
-    if (Plugin_information.Library)
-        pointer = plugin_get_address(Plugin_information.Library, Functionname);
+    if (plugin)
+        pointer = plugin_get_address(plugin->Library, Functionname);
 
     FUNC_LEAVE_PTR(pointer, void*);
 }
@@ -2491,12 +3801,13 @@ cbm_get_plugin_function_address(const char * Functionname)
 int CBMAPIDECL
 cbm_iec_dbg_read(CBM_FILE HandleDevice)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int returnValue = -1;
 
     FUNC_ENTER();
 
-    if ( Plugin_information.Plugin.opencbm_plugin_iec_dbg_read ) {
-        returnValue = Plugin_information.Plugin.opencbm_plugin_iec_dbg_read(HandleDevice);
+    if ( plugin->Plugin.opencbm_plugin_iec_dbg_read ) {
+        returnValue = plugin->Plugin.opencbm_plugin_iec_dbg_read(HandleDevice);
     }
 
     FUNC_LEAVE_INT(returnValue);
@@ -2534,13 +3845,189 @@ cbm_iec_dbg_read(CBM_FILE HandleDevice)
 int CBMAPIDECL
 cbm_iec_dbg_write(CBM_FILE HandleDevice, unsigned char Value)
 {
+    plugin_information_t * plugin = plugin_of(HandleDevice);
     int returnValue = -1;
 
     FUNC_ENTER();
 
-    if ( Plugin_information.Plugin.opencbm_plugin_iec_dbg_write ) {
-        returnValue = Plugin_information.Plugin.opencbm_plugin_iec_dbg_write(HandleDevice, Value);
+    if ( plugin->Plugin.opencbm_plugin_iec_dbg_write ) {
+        returnValue = plugin->Plugin.opencbm_plugin_iec_dbg_write(HandleDevice, Value);
     }
 
     FUNC_LEAVE_INT(returnValue);
 }
+
+/*! \internal \brief Open the configuration file and find the place of an adapter setting
+
+ The settings of an adapter are stored in the section of its plugin.
+ If the adapter specification contains a port, the name of the entry
+ is prefixed with it, e.g. "1:Entry", so each bus has its own settings.
+
+ \param Adapter
+   The adapter specification, as for cbm_driver_open_ex().
+   NULL means the default adapter.
+
+ \param Entry
+   The name of the setting.
+
+ \param Section
+   Pointer to a pointer to char which will get the name of the section.
+   This data has to be freed with cbmlibmisc_strfree() afterwards!
+
+ \param EntryName
+   Pointer to a pointer to char which will get the name of the entry.
+   This data has to be freed with cbmlibmisc_strfree() afterwards!
+
+ \return
+   The handle of the configuration file, or NULL on error. It has to be
+   closed with opencbm_configuration_close() afterwards.
+*/
+static opencbm_configuration_handle
+adapter_configuration_open(const char * Adapter, const char Entry[], char ** Section, char ** EntryName)
+{
+    const char * configurationFilename = configuration_get_default_filename();
+    opencbm_configuration_handle handle = NULL;
+    char * adapter = cbmlibmisc_strdup(Adapter);
+    char * port = NULL;
+
+    *Section = NULL;
+    *EntryName = NULL;
+
+    do {
+        if (configurationFilename == NULL)
+            break;
+
+        handle = opencbm_configuration_open(configurationFilename);
+        if (handle == NULL)
+            break;
+
+        *Section = cbm_split_adapter_in_name_and_port(adapter, &port);
+
+        if (*Section == NULL
+            && opencbm_configuration_get_data(handle, "plugins", "default", Section) != 0)
+        {
+            break;
+        }
+
+        *EntryName = port ? cbmlibmisc_sprintf("%s:%s", port, Entry) : cbmlibmisc_strdup(Entry);
+
+    } while (0);
+
+    if (handle && (*Section == NULL || *EntryName == NULL))
+    {
+        opencbm_configuration_close(handle);
+        handle = NULL;
+
+        cbmlibmisc_strfree(*Section);
+        cbmlibmisc_strfree(*EntryName);
+        *Section = NULL;
+        *EntryName = NULL;
+    }
+
+    cbmlibmisc_strfree(port);
+    cbmlibmisc_strfree(adapter);
+    cbmlibmisc_strfree(configurationFilename);
+
+    return handle;
+}
+
+/*! \brief Read a setting of an adapter from the configuration file
+
+ Tools can use this to remember settings which depend on the adapter,
+ e.g. the results of measurements. They should prefix the name of the
+ setting with their own name, so there are no clashes with the
+ settings of the plugin itself.
+
+ \param Adapter
+   The adapter specification, as for cbm_driver_open_ex().
+   NULL means the default adapter.
+
+ \param Entry
+   The name of the setting.
+
+ \param Buffer
+   Pointer to a buffer which will hold the value of the setting.
+
+ \param BufferLength
+   The length of the buffer pointed to by Buffer.
+
+ \return
+   0 on success, 1 if the configuration file cannot be read, the
+   setting does not exist, or its value does not fit into Buffer.
+*/
+int CBMAPIDECL
+cbm_adapter_configuration_get(const char * Adapter, const char Entry[], char Buffer[], size_t BufferLength)
+{
+    opencbm_configuration_handle handle;
+    char * section;
+    char * entryName;
+    char * value = NULL;
+    int error = 1;
+
+    FUNC_ENTER();
+
+    handle = adapter_configuration_open(Adapter, Entry, &section, &entryName);
+
+    if (handle)
+    {
+        if (opencbm_configuration_get_data(handle, section, entryName, &value) == 0
+            && strlen(value) < BufferLength)
+        {
+            strcpy(Buffer, value);
+            error = 0;
+        }
+
+        cbmlibmisc_strfree(value);
+        cbmlibmisc_strfree(section);
+        cbmlibmisc_strfree(entryName);
+        opencbm_configuration_close(handle);
+    }
+
+    FUNC_LEAVE_INT(error);
+}
+
+/*! \brief Write a setting of an adapter into the configuration file
+
+ See cbm_adapter_configuration_get().
+
+ \param Adapter
+   The adapter specification, as for cbm_driver_open_ex().
+   NULL means the default adapter.
+
+ \param Entry
+   The name of the setting. If it does not exist yet, it is created.
+
+ \param Value
+   The new value of the setting.
+
+ \return
+   0 on success, 1 if the configuration file cannot be read
+   or written.
+
+ \remark
+   Depending on the installation, the configuration file might
+   not be writable for every user.
+*/
+int CBMAPIDECL
+cbm_adapter_configuration_set(const char * Adapter, const char Entry[], const char Value[])
+{
+    opencbm_configuration_handle handle;
+    char * section;
+    char * entryName;
+    int error = 1;
+
+    FUNC_ENTER();
+
+    handle = adapter_configuration_open(Adapter, Entry, &section, &entryName);
+
+    if (handle)
+    {
+        error = opencbm_configuration_set_data(handle, section, entryName, Value);
+        error = opencbm_configuration_close(handle) || error;
+
+        cbmlibmisc_strfree(section);
+        cbmlibmisc_strfree(entryName);
+    }
+
+    FUNC_LEAVE_INT(error);
+}
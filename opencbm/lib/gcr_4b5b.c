@@ -265,3 +265,338 @@ gcr_4_to_5_encode(const unsigned char *source, unsigned char *dest,
     FUNC_LEAVE_INT(rv);
     return rv;
 }
+
+/*
+ * Whole block conversion
+ *
+ * The functions above are general purpose: They cope with partial
+ * buffers and overlapping pointers, and they shift nybble by nybble.
+ * For converting complete data blocks (or complete tracks of them),
+ * this is far too slow. Thus, the following functions use tables
+ * which map 10 GCR bits to one plain byte and vice versa, and
+ * assemble each 5 byte GCR group in one 64 bit word.
+ */
+
+#ifdef _MSC_VER
+typedef unsigned __int64 gcr_word_t;     /*!< a type with at least 40 bits */
+#else
+typedef unsigned long long gcr_word_t;   /*!< a type with at least 40 bits */
+#endif
+
+/*! \brief decoding table: 10 GCR bits to one plain byte
+
+ This is the decodeGCR[] table of gcr_5_to_4_decode(), applied to
+ the upper and lower 5 bits of the index. An illegal GCR code gives
+ the same result as with gcr_5_to_4_decode(), that is, the
+ corresponding nybble is 0xf.
+*/
+static const unsigned char gcr_decode_10[1024] =
+    {
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0x8f,0x8f,0x8f,0x8f,0x8f,0x8f,0x8f,0x8f,0x8f,0x88,0x80,0x81,0x8f,0x8c,0x84,0x85,
+        0x8f,0x8f,0x82,0x83,0x8f,0x8f,0x86,0x87,0x8f,0x89,0x8a,0x8b,0x8f,0x8d,0x8e,0x8f,
+        0x0f,0x0f,0x0f,0x0f,0x0f,0x0f,0x0f,0x0f,0x0f,0x08,0x00,0x01,0x0f,0x0c,0x04,0x05,
+        0x0f,0x0f,0x02,0x03,0x0f,0x0f,0x06,0x07,0x0f,0x09,0x0a,0x0b,0x0f,0x0d,0x0e,0x0f,
+        0x1f,0x1f,0x1f,0x1f,0x1f,0x1f,0x1f,0x1f,0x1f,0x18,0x10,0x11,0x1f,0x1c,0x14,0x15,
+        0x1f,0x1f,0x12,0x13,0x1f,0x1f,0x16,0x17,0x1f,0x19,0x1a,0x1b,0x1f,0x1d,0x1e,0x1f,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xcf,0xcf,0xcf,0xcf,0xcf,0xcf,0xcf,0xcf,0xcf,0xc8,0xc0,0xc1,0xcf,0xcc,0xc4,0xc5,
+        0xcf,0xcf,0xc2,0xc3,0xcf,0xcf,0xc6,0xc7,0xcf,0xc9,0xca,0xcb,0xcf,0xcd,0xce,0xcf,
+        0x4f,0x4f,0x4f,0x4f,0x4f,0x4f,0x4f,0x4f,0x4f,0x48,0x40,0x41,0x4f,0x4c,0x44,0x45,
+        0x4f,0x4f,0x42,0x43,0x4f,0x4f,0x46,0x47,0x4f,0x49,0x4a,0x4b,0x4f,0x4d,0x4e,0x4f,
+        0x5f,0x5f,0x5f,0x5f,0x5f,0x5f,0x5f,0x5f,0x5f,0x58,0x50,0x51,0x5f,0x5c,0x54,0x55,
+        0x5f,0x5f,0x52,0x53,0x5f,0x5f,0x56,0x57,0x5f,0x59,0x5a,0x5b,0x5f,0x5d,0x5e,0x5f,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0x2f,0x2f,0x2f,0x2f,0x2f,0x2f,0x2f,0x2f,0x2f,0x28,0x20,0x21,0x2f,0x2c,0x24,0x25,
+        0x2f,0x2f,0x22,0x23,0x2f,0x2f,0x26,0x27,0x2f,0x29,0x2a,0x2b,0x2f,0x2d,0x2e,0x2f,
+        0x3f,0x3f,0x3f,0x3f,0x3f,0x3f,0x3f,0x3f,0x3f,0x38,0x30,0x31,0x3f,0x3c,0x34,0x35,
+        0x3f,0x3f,0x32,0x33,0x3f,0x3f,0x36,0x37,0x3f,0x39,0x3a,0x3b,0x3f,0x3d,0x3e,0x3f,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0x6f,0x6f,0x6f,0x6f,0x6f,0x6f,0x6f,0x6f,0x6f,0x68,0x60,0x61,0x6f,0x6c,0x64,0x65,
+        0x6f,0x6f,0x62,0x63,0x6f,0x6f,0x66,0x67,0x6f,0x69,0x6a,0x6b,0x6f,0x6d,0x6e,0x6f,
+        0x7f,0x7f,0x7f,0x7f,0x7f,0x7f,0x7f,0x7f,0x7f,0x78,0x70,0x71,0x7f,0x7c,0x74,0x75,
+        0x7f,0x7f,0x72,0x73,0x7f,0x7f,0x76,0x77,0x7f,0x79,0x7a,0x7b,0x7f,0x7d,0x7e,0x7f,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0x9f,0x9f,0x9f,0x9f,0x9f,0x9f,0x9f,0x9f,0x9f,0x98,0x90,0x91,0x9f,0x9c,0x94,0x95,
+        0x9f,0x9f,0x92,0x93,0x9f,0x9f,0x96,0x97,0x9f,0x99,0x9a,0x9b,0x9f,0x9d,0x9e,0x9f,
+        0xaf,0xaf,0xaf,0xaf,0xaf,0xaf,0xaf,0xaf,0xaf,0xa8,0xa0,0xa1,0xaf,0xac,0xa4,0xa5,
+        0xaf,0xaf,0xa2,0xa3,0xaf,0xaf,0xa6,0xa7,0xaf,0xa9,0xaa,0xab,0xaf,0xad,0xae,0xaf,
+        0xbf,0xbf,0xbf,0xbf,0xbf,0xbf,0xbf,0xbf,0xbf,0xb8,0xb0,0xb1,0xbf,0xbc,0xb4,0xb5,
+        0xbf,0xbf,0xb2,0xb3,0xbf,0xbf,0xb6,0xb7,0xbf,0xb9,0xba,0xbb,0xbf,0xbd,0xbe,0xbf,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff,
+        0xdf,0xdf,0xdf,0xdf,0xdf,0xdf,0xdf,0xdf,0xdf,0xd8,0xd0,0xd1,0xdf,0xdc,0xd4,0xd5,
+        0xdf,0xdf,0xd2,0xd3,0xdf,0xdf,0xd6,0xd7,0xdf,0xd9,0xda,0xdb,0xdf,0xdd,0xde,0xdf,
+        0xef,0xef,0xef,0xef,0xef,0xef,0xef,0xef,0xef,0xe8,0xe0,0xe1,0xef,0xec,0xe4,0xe5,
+        0xef,0xef,0xe2,0xe3,0xef,0xef,0xe6,0xe7,0xef,0xe9,0xea,0xeb,0xef,0xed,0xee,0xef,
+        0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xf8,0xf0,0xf1,0xff,0xfc,0xf4,0xf5,
+        0xff,0xff,0xf2,0xf3,0xff,0xff,0xf6,0xf7,0xff,0xf9,0xfa,0xfb,0xff,0xfd,0xfe,0xff
+    };
+
+/*! \brief encoding table: one plain byte to 10 GCR bits */
+static const unsigned short gcr_encode_10[256] =
+    {
+        0x14a, 0x14b, 0x152, 0x153, 0x14e, 0x14f, 0x156, 0x157,
+        0x149, 0x159, 0x15a, 0x15b, 0x14d, 0x15d, 0x15e, 0x155,
+        0x16a, 0x16b, 0x172, 0x173, 0x16e, 0x16f, 0x176, 0x177,
+        0x169, 0x179, 0x17a, 0x17b, 0x16d, 0x17d, 0x17e, 0x175,
+        0x24a, 0x24b, 0x252, 0x253, 0x24e, 0x24f, 0x256, 0x257,
+        0x249, 0x259, 0x25a, 0x25b, 0x24d, 0x25d, 0x25e, 0x255,
+        0x26a, 0x26b, 0x272, 0x273, 0x26e, 0x26f, 0x276, 0x277,
+        0x269, 0x279, 0x27a, 0x27b, 0x26d, 0x27d, 0x27e, 0x275,
+        0x1ca, 0x1cb, 0x1d2, 0x1d3, 0x1ce, 0x1cf, 0x1d6, 0x1d7,
+        0x1c9, 0x1d9, 0x1da, 0x1db, 0x1cd, 0x1dd, 0x1de, 0x1d5,
+        0x1ea, 0x1eb, 0x1f2, 0x1f3, 0x1ee, 0x1ef, 0x1f6, 0x1f7,
+        0x1e9, 0x1f9, 0x1fa, 0x1fb, 0x1ed, 0x1fd, 0x1fe, 0x1f5,
+        0x2ca, 0x2cb, 0x2d2, 0x2d3, 0x2ce, 0x2cf, 0x2d6, 0x2d7,
+        0x2c9, 0x2d9, 0x2da, 0x2db, 0x2cd, 0x2dd, 0x2de, 0x2d5,
+        0x2ea, 0x2eb, 0x2f2, 0x2f3, 0x2ee, 0x2ef, 0x2f6, 0x2f7,
+        0x2e9, 0x2f9, 0x2fa, 0x2fb, 0x2ed, 0x2fd, 0x2fe, 0x2f5,
+        0x12a, 0x12b, 0x132, 0x133, 0x12e, 0x12f, 0x136, 0x137,
+        0x129, 0x139, 0x13a, 0x13b, 0x12d, 0x13d, 0x13e, 0x135,
+        0x32a, 0x32b, 0x332, 0x333, 0x32e, 0x32f, 0x336, 0x337,
+        0x329, 0x339, 0x33a, 0x33b, 0x32d, 0x33d, 0x33e, 0x335,
+        0x34a, 0x34b, 0x352, 0x353, 0x34e, 0x34f, 0x356, 0x357,
+        0x349, 0x359, 0x35a, 0x35b, 0x34d, 0x35d, 0x35e, 0x355,
+        0x36a, 0x36b, 0x372, 0x373, 0x36e, 0x36f, 0x376, 0x377,
+        0x369, 0x379, 0x37a, 0x37b, 0x36d, 0x37d, 0x37e, 0x375,
+        0x1aa, 0x1ab, 0x1b2, 0x1b3, 0x1ae, 0x1af, 0x1b6, 0x1b7,
+        0x1a9, 0x1b9, 0x1ba, 0x1bb, 0x1ad, 0x1bd, 0x1be, 0x1b5,
+        0x3aa, 0x3ab, 0x3b2, 0x3b3, 0x3ae, 0x3af, 0x3b6, 0x3b7,
+        0x3a9, 0x3b9, 0x3ba, 0x3bb, 0x3ad, 0x3bd, 0x3be, 0x3b5,
+        0x3ca, 0x3cb, 0x3d2, 0x3d3, 0x3ce, 0x3cf, 0x3d6, 0x3d7,
+        0x3c9, 0x3d9, 0x3da, 0x3db, 0x3cd, 0x3dd, 0x3de, 0x3d5,
+        0x2aa, 0x2ab, 0x2b2, 0x2b3, 0x2ae, 0x2af, 0x2b6, 0x2b7,
+        0x2a9, 0x2b9, 0x2ba, 0x2bb, 0x2ad, 0x2bd, 0x2be, 0x2b5
+    };
+
+/*! \brief Decode one group of 5 GCR bytes into 4 plain bytes */
+#define GCR_DECODE_GROUP(_source, _dest) \
+    do { \
+        gcr_word_t w = ((gcr_word_t) (_source)[0] << 32) \
+                     | ((gcr_word_t) (_source)[1] << 24) \
+                     | ((gcr_word_t) (_source)[2] << 16) \
+                     | ((gcr_word_t) (_source)[3] <<  8) \
+                     |  (gcr_word_t) (_source)[4]; \
+        (_dest)[0] = gcr_decode_10[(unsigned int)(w >> 30) & 0x3ff]; \
+        (_dest)[1] = gcr_decode_10[(unsigned int)(w >> 20) & 0x3ff]; \
+        (_dest)[2] = gcr_decode_10[(unsigned int)(w >> 10) & 0x3ff]; \
+        (_dest)[3] = gcr_decode_10[(unsigned int) w        & 0x3ff]; \
+    } while (0)
+
+/*! \brief Encode 4 plain bytes into one group of 5 GCR bytes */
+#define GCR_ENCODE_GROUP(_b0, _b1, _b2, _b3, _dest) \
+    do { \
+        gcr_word_t w = ((gcr_word_t) gcr_encode_10[_b0] << 30) \
+                     | ((gcr_word_t) gcr_encode_10[_b1] << 20) \
+                     | ((gcr_word_t) gcr_encode_10[_b2] << 10) \
+                     |  (gcr_word_t) gcr_encode_10[_b3]; \
+        (_dest)[0] = (unsigned char) (w >> 32); \
+        (_dest)[1] = (unsigned char) (w >> 24); \
+        (_dest)[2] = (unsigned char) (w >> 16); \
+        (_dest)[3] = (unsigned char) (w >>  8); \
+        (_dest)[4] = (unsigned char)  w; \
+    } while (0)
+
+/*! \brief Decode GCR data blocks
+
+ This function decodes a number of GCR encoded data blocks, as they
+ are read from the disk, into plain blocks of 256 bytes each. This
+ can be a single block as well as all blocks of a complete track.
+
+ \param source
+   The pointer to the source buffer. It contains count encoded
+   blocks of GCR_BLOCK_GCRSIZE (325) bytes each, that is, the data
+   block marker, the data, the checksum and the two fill bytes.
+
+ \param dest
+   The pointer to the destination buffer. It gets count blocks of
+   GCR_BLOCK_DATASIZE (256) bytes each.
+
+ \param count
+   The number of blocks to decode.
+
+ \param status
+   Pointer to an array of count ints which gets the result of
+   each block, or NULL if the caller is not interested in it.
+   0 means success, 4 means that the data block marker was not
+   found (the block is not decoded, then), and 5 means a checksum
+   error.
+
+ \return
+   The number of blocks which could not be decoded without an
+   error, or -1 on invalid buffer pointers.
+
+ Remarks:
+
+ The source and the destination buffer must not overlap.
+*/
+
+int CBMAPIDECL
+gcr_decode_block_n(const unsigned char *source, unsigned char *dest,
+                   unsigned int count, int *status)
+{
+    int rv;
+
+    FUNC_ENTER();
+
+    DBG_ASSERT(source != NULL);
+    DBG_ASSERT(dest   != NULL);
+
+    if ((source == NULL) || (dest == NULL))
+    {
+        rv = -1;
+    }
+    else
+    {
+        rv = 0;
+
+        for (; count > 0; count--, source += GCR_BLOCK_GCRSIZE, dest += GCR_BLOCK_DATASIZE)
+        {
+            const unsigned char *gcr = source;
+            unsigned char *decoded = dest;
+            unsigned char head[4], tail[4];
+            unsigned char chksum;
+            int i, result;
+
+            GCR_DECODE_GROUP(gcr, head);
+            gcr += 5;
+
+            if (head[0] != 0x07)
+            {
+                result = 4;
+            }
+            else
+            {
+                decoded[0] = head[1];
+                decoded[1] = head[2];
+                decoded[2] = head[3];
+                chksum = head[1] ^ head[2] ^ head[3];
+                decoded += 3;
+
+                for (i = 1; i < GCR_BLOCK_DATASIZE / 4; i++, gcr += 5, decoded += 4)
+                {
+                    GCR_DECODE_GROUP(gcr, decoded);
+                    chksum ^= decoded[0] ^ decoded[1] ^ decoded[2] ^ decoded[3];
+                }
+
+                GCR_DECODE_GROUP(gcr, tail);
+                decoded[0] = tail[0];
+                chksum ^= tail[0];
+
+                result = (tail[1] != chksum) ? 5 : 0;
+            }
+
+            if (result != 0)
+            {
+                rv++;
+            }
+
+            if (status)
+            {
+                *status++ = result;
+            }
+        }
+    }
+
+    FUNC_LEAVE_INT(rv);
+    return rv;
+}
+
+/*! \brief Encode data blocks into GCR
+
+ This function encodes a number of plain blocks of 256 bytes each
+ into GCR encoded data blocks, as they are written to the disk.
+ This can be a single block as well as all blocks of a complete
+ track.
+
+ \param source
+   The pointer to the source buffer. It contains count blocks of
+   GCR_BLOCK_DATASIZE (256) bytes each.
+
+ \param dest
+   The pointer to the destination buffer. It gets count encoded
+   blocks of GCR_BLOCK_GCRSIZE (325) bytes each, that is, the data
+   block marker, the data, the checksum and the two fill bytes.
+
+ \param count
+   The number of blocks to encode.
+
+ \return
+   0 means success, -1 means failure due to invalid buffer pointers.
+
+ Remarks:
+
+ The source and the destination buffer must not overlap.
+*/
+
+int CBMAPIDECL
+gcr_encode_block_n(const unsigned char *source, unsigned char *dest,
+                   unsigned int count)
+{
+    int rv;
+
+    FUNC_ENTER();
+
+    DBG_ASSERT(source != NULL);
+    DBG_ASSERT(dest   != NULL);
+
+    if ((source == NULL) || (dest == NULL))
+    {
+        rv = -1;
+    }
+    else
+    {
+        rv = 0;
+
+        for (; count > 0; count--, source += GCR_BLOCK_DATASIZE, dest += GCR_BLOCK_GCRSIZE)
+        {
+            const unsigned char *block = source;
+            unsigned char *gcr = dest;
+            unsigned char chksum;
+            int i;
+
+            GCR_ENCODE_GROUP(0x07, block[0], block[1], block[2], gcr);
+            chksum = block[0] ^ block[1] ^ block[2];
+            block += 3;
+            gcr += 5;
+
+            for (i = 1; i < GCR_BLOCK_DATASIZE / 4; i++, block += 4, gcr += 5)
+            {
+                GCR_ENCODE_GROUP(block[0], block[1], block[2], block[3], gcr);
+                chksum ^= block[0] ^ block[1] ^ block[2] ^ block[3];
+            }
+
+            chksum ^= block[0];
+            GCR_ENCODE_GROUP(block[0], chksum, 0, 0, gcr);
+        }
+    }
+
+    FUNC_LEAVE_INT(rv);
+    return rv;
+}
@@ -0,0 +1,114 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ */
+
+/*! **************************************************************
+** \file lib/library.h \n
+** \author OpenCBM team \n
+** \n
+** \brief Shared library / DLL: internal interface between its modules
+**
+****************************************************************/
+
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include "opencbm.h"
+
+/*
+ * atomic operations on variables which are used by more than one thread
+ * without a lock. The LOAD variants only guarantee that the value is read
+ * as a whole, they do not order other memory accesses.
+ */
+#ifdef WIN32
+# define CBM_ATOMIC_GET(_p) \
+    InterlockedCompareExchangePointer((PVOID volatile *) (_p), NULL, NULL) /*!< read the pointer *_p */
+# define CBM_ATOMIC_SET_IF_NULL(_p, _new) \
+    (InterlockedCompareExchangePointer((PVOID volatile *) (_p), (_new), NULL) == NULL) /*!< set *_p to _new if it is NULL */
+# define CBM_ATOMIC_GET_UINT(_p) \
+    ((unsigned int) InterlockedCompareExchange((LONG volatile *) (_p), 0, 0)) /*!< read the unsigned int *_p */
+# define CBM_ATOMIC_INC_UINT(_p) \
+    InterlockedIncrement((LONG volatile *) (_p)) /*!< increment the unsigned int *_p */
+# define CBM_ATOMIC_LOAD_INT(_p) \
+    (*(int volatile *) (_p)) /*!< read the int *_p */
+# define CBM_ATOMIC_ADD_INT(_p, _v) \
+    InterlockedExchangeAdd((LONG volatile *) (_p), (_v)) /*!< add _v to the int *_p */
+# define CBM_ATOMIC_CHANGE_INT(_p, _old, _new) \
+    (InterlockedCompareExchange((LONG volatile *) (_p), (_new), (_old)) == (_old)) /*!< set the int *_p to _new if it is _old */
+# define CBM_ATOMIC_LOAD_ULONG(_p) \
+    (*(unsigned long volatile *) (_p)) /*!< read the unsigned long *_p */
+# define CBM_ATOMIC_SET_ULONG(_p, _v) \
+    InterlockedExchange((LONG volatile *) (_p), (_v)) /*!< set the unsigned long *_p to _v */
+# define CBM_ATOMIC_CHANGE_ULONG(_p, _old, _new) \
+    ((unsigned long) InterlockedCompareExchange((LONG volatile *) (_p), (_new), (_old)) == (_old)) /*!< set the unsigned long *_p to _new if it is _old */
+# define CBM_ATOMIC_LOAD_COUNTER(_p) \
+    ((cbm_counter_t) InterlockedCompareExchange64((LONGLONG volatile *) (_p), 0, 0)) /*!< read the cbm_counter_t *_p */
+# define CBM_ATOMIC_ADD_COUNTER(_p, _v) \
+    cbm_atomic_change_counter((_p), (_v), 1) /*!< add _v to the cbm_counter_t *_p */
+# define CBM_ATOMIC_SET_COUNTER(_p, _v) \
+    cbm_atomic_change_counter((_p), (_v), 0) /*!< set the cbm_counter_t *_p to _v */
+# define CBM_THREAD_LOCAL __declspec(thread) /*!< a variable with one instance per thread */
+
+/* the headers of older compilers have no InterlockedExchangeAdd64()
+ * and InterlockedExchange64() for x86; thus, both are built from
+ * InterlockedCompareExchange64() */
+static __inline cbm_counter_t
+cbm_atomic_change_counter(cbm_counter_t volatile *Counter, cbm_counter_t Value, int Add)
+{
+    LONGLONG old, value;
+
+    do {
+        old = *(LONGLONG volatile *) Counter;
+        value = (LONGLONG) (Add ? old + Value : Value);
+    } while (InterlockedCompareExchange64((LONGLONG volatile *) Counter, value, old) != old);
+
+    return (cbm_counter_t) value;
+}
+#else
+# define CBM_ATOMIC_GET(_p) \
+    __sync_val_compare_and_swap((_p), NULL, NULL) /*!< read the pointer *_p */
+# define CBM_ATOMIC_SET_IF_NULL(_p, _new) \
+    __sync_bool_compare_and_swap((_p), NULL, (_new)) /*!< set *_p to _new if it is NULL */
+# define CBM_ATOMIC_GET_UINT(_p) \
+    __sync_fetch_and_add((_p), 0) /*!< read the unsigned int *_p */
+# define CBM_ATOMIC_INC_UINT(_p) \
+    __sync_add_and_fetch((_p), 1) /*!< increment the unsigned int *_p */
+# define CBM_ATOMIC_LOAD_INT(_p) \
+    __atomic_load_n((_p), __ATOMIC_RELAXED) /*!< read the int *_p */
+# define CBM_ATOMIC_ADD_INT(_p, _v) \
+    __sync_add_and_fetch((_p), (_v)) /*!< add _v to the int *_p */
+# define CBM_ATOMIC_CHANGE_INT(_p, _old, _new) \
+    __sync_bool_compare_and_swap((_p), (_old), (_new)) /*!< set the int *_p to _new if it is _old */
+# define CBM_ATOMIC_LOAD_ULONG(_p) \
+    __atomic_load_n((_p), __ATOMIC_RELAXED) /*!< read the unsigned long *_p */
+# define CBM_ATOMIC_SET_ULONG(_p, _v) \
+    __atomic_store_n((_p), (_v), __ATOMIC_RELAXED) /*!< set the unsigned long *_p to _v */
+# define CBM_ATOMIC_CHANGE_ULONG(_p, _old, _new) \
+    __sync_bool_compare_and_swap((_p), (_old), (_new)) /*!< set the unsigned long *_p to _new if it is _old */
+# define CBM_ATOMIC_LOAD_COUNTER(_p) \
+    __atomic_load_n((_p), __ATOMIC_RELAXED) /*!< read the cbm_counter_t *_p */
+# define CBM_ATOMIC_ADD_COUNTER(_p, _v) \
+    __sync_add_and_fetch((_p), (_v)) /*!< add _v to the cbm_counter_t *_p */
+# define CBM_ATOMIC_SET_COUNTER(_p, _v) \
+    __atomic_store_n((_p), (_v), __ATOMIC_RELAXED) /*!< set the cbm_counter_t *_p to _v */
+# define CBM_THREAD_LOCAL __thread /*!< a variable with one instance per thread */
+#endif
+
+/* protects the tables which are shared by all driver handles, see cbm.c */
+extern void library_lock(void);
+extern void library_unlock(void);
+
+/* the statistics of a driver handle, see statistics.c; they are kept in
+ * the handle table of cbm.c, and freed when the handle is closed */
+struct statistics_handle_s;
+extern struct statistics_handle_s * volatile * handle_statistics(CBM_FILE HandleDevice);
+
+/* forget the drive programs uploaded with a driver handle, see upload.c */
+extern void upload_close(CBM_FILE HandleDevice);
+
+#endif /* #ifndef LIBRARY_H */
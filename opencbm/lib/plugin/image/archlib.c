@@ -0,0 +1,928 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file lib/plugin/image/archlib.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Virtual IEC drive backed by a disk image: the plugin interface
+**
+** This plugin does not talk to any hardware. Instead, it serves
+** .d64, .d71 and .d81 images as if they were disk drives on the
+** IEC bus. It is meant for testing and benchmarking the tools and
+** the library on machines without any drives attached.
+**
+** The images are given as port of the adapter, or in environment
+** variables:
+**
+**   -@ image:disk.d64                 disk.d64 is drive 8
+**   -@ image:8=disk.d64,9=other.d81   two drives, 8 and 9
+**   OPENCBM_IMAGE=disk.d64            drive 8 if no port is given
+**   OPENCBM_IMAGE_9=other.d81         additional drive 9
+**
+** The time a real drive needs is modelled by OPENCBM_IMAGE_LATENCY,
+** a comma separated list of:
+**
+**   none, 1541, 1571, 1581   presets (default: none)
+**   byte=<us>                time for transferring one byte
+**   command=<us>             time for one bus command (LISTEN, TALK, ...)
+**   block=<us>               time for reading or writing one block
+**   virtual                  only account the time, do not wait
+**
+** If OPENCBM_IMAGE_STATS is set, the number of bus commands, bytes and
+** blocks as well as the modelled bus time are printed to stderr when
+** the driver is closed. Subtracting the latter from the run time of a
+** tool gives the overhead of the library and the tool.
+**
+****************************************************************/
+
+#ifdef WIN32
+#include <windows.h>
+#include <windowsx.h>
+
+/*! Mark: We are in user-space (for debug.h) */
+#define DBG_USERMODE
+
+/*! The name of the executable */
+#define DBG_PROGNAME "OPENCBM-IMAGE.DLL"
+
+#include "debug.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! mark: We are building the DLL */
+#define OPENCBM_PLUGIN
+#include "archlib.h"
+
+#include "arch.h"
+
+#include "image.h"
+
+/*! \brief the state of the virtual IEC bus */
+typedef enum image_bus_state_e
+{
+    BUS_IDLE,    /*!< no device is addressed */
+    BUS_LISTEN,  /*!< a device was told to LISTEN */
+    BUS_TALK,    /*!< a device was told to TALK */
+    BUS_OPEN     /*!< a device was told to OPEN, the file name follows */
+} image_bus_state_t;
+
+/*! \brief the virtual IEC bus; this is what the CBM_FILE points to */
+typedef struct image_bus_s
+{
+    image_drive_t *drive[IMAGE_MAX_UNIT + 1]; /*!< the drives, by device address */
+
+    image_bus_state_t state;  /*!< the state of the bus */
+    image_drive_t *active;    /*!< the drive which is addressed */
+    unsigned channel;         /*!< the secondary address of the active drive */
+
+    unsigned char name[IMAGE_CMDSIZE]; /*!< BUS_OPEN: the file name */
+    size_t name_length;       /*!< BUS_OPEN: the length of the file name */
+
+    int eoi;                  /*!< the last byte read was sent with EOI */
+
+    unsigned long byte_us;    /*!< latency model: time for one byte */
+    unsigned long command_us; /*!< latency model: time for one bus command */
+    unsigned long block_us;   /*!< latency model: time for one block */
+    int wait;                 /*!< !=0: really wait for the modelled time */
+    unsigned long pending_us; /*!< modelled time we did not wait for yet */
+
+    int print_stats;          /*!< print the statistics on close */
+    unsigned long commands;   /*!< statistics: number of bus commands */
+    unsigned long bytes_read; /*!< statistics: number of bytes read */
+    unsigned long bytes_written; /*!< statistics: number of bytes written */
+    unsigned long blocks;     /*!< statistics: number of blocks accessed */
+    double bus_us;            /*!< statistics: modelled bus time */
+} image_bus_t;
+
+/*! \brief the latency presets */
+static const struct
+{
+    const char *name;         /*!< the name of the preset */
+    unsigned long byte_us;    /*!< time for one byte */
+    unsigned long command_us; /*!< time for one bus command */
+    unsigned long block_us;   /*!< time for one block */
+} latency_presets[] =
+{
+    /* rough figures for the standard serial protocol on an xum1541 */
+    { "none",     0,    0,     0 },
+    { "1541",   400, 1500, 20000 },
+    { "1571",   400, 1500, 10000 },
+    { "1581",   400, 1500,  5000 }
+};
+
+/*! \internal \brief Apply the latency model
+
+ \param Bus
+   The bus.
+
+ \param Commands
+   The number of bus commands which were executed.
+
+ \param Bytes
+   The number of bytes which were transferred.
+
+ \param Blocks
+   The number of blocks which were read or written.
+*/
+static void
+bus_delay(image_bus_t *Bus, unsigned Commands, size_t Bytes, unsigned long Blocks)
+{
+    unsigned long us;
+
+    us = Commands * Bus->command_us + (unsigned long) Bytes * Bus->byte_us + Blocks * Bus->block_us;
+
+    Bus->commands += Commands;
+    Bus->blocks += Blocks;
+    Bus->bus_us += us;
+
+    if (!Bus->wait)
+        return;
+
+    /* do not sleep for every single byte; the granularity of the OS is worse anyway */
+    Bus->pending_us += us;
+
+    while (Bus->pending_us >= 1000)
+    {
+        unsigned long chunk = Bus->pending_us > 500000 ? 500000 : Bus->pending_us;
+
+        arch_usleep(chunk);
+        Bus->pending_us -= chunk;
+    }
+}
+
+/*! \internal \brief Get the number of blocks the active drive accessed so far */
+static unsigned long
+bus_blocks(image_bus_t *Bus)
+{
+    return Bus->active ? Bus->active->blocks_accessed : 0;
+}
+
+/*! \internal \brief Address a drive on the bus
+
+ \return
+   The drive, or NULL if there is no drive with this address.
+*/
+static image_drive_t *
+bus_address(image_bus_t *Bus, unsigned char DeviceAddress, unsigned char SecondaryAddress,
+            image_bus_state_t State)
+{
+    image_drive_t *drive = DeviceAddress <= IMAGE_MAX_UNIT ? Bus->drive[DeviceAddress] : NULL;
+
+    bus_delay(Bus, 1, 0, 0);
+
+    if (drive == NULL)
+    {
+        /* device not present */
+        Bus->state = BUS_IDLE;
+        Bus->active = NULL;
+        return NULL;
+    }
+
+    Bus->state = State;
+    Bus->active = drive;
+    Bus->channel = SecondaryAddress & 0x0f;
+
+    return drive;
+}
+
+/*! \internal \brief Insert an image into a drive
+
+ \return
+   0 on success, else an error occurred.
+*/
+static int
+bus_attach(image_bus_t *Bus, unsigned Unit, const char *Path)
+{
+    image_drive_t *drive;
+
+    if (Unit < 4 || Unit > IMAGE_MAX_UNIT || Bus->drive[Unit] != NULL)
+    {
+        fprintf(stderr, "image: invalid or duplicate device address %u for '%s'\n", Unit, Path);
+        return 1;
+    }
+
+    drive = calloc(1, sizeof(*drive));
+    if (drive == NULL)
+        return 1;
+
+    if (image_disk_load(&drive->disk, Path))
+    {
+        free(drive);
+        return 1;
+    }
+
+    drive->unit = (unsigned char) Unit;
+    image_dos_reset(drive);
+
+    Bus->drive[Unit] = drive;
+
+    return 0;
+}
+
+/*! \internal \brief Insert the images given in a list
+
+ \param Bus
+   The bus.
+
+ \param List
+   A comma separated list of image files, optionally
+   preceeded by the device address and "=".
+
+ \return
+   0 on success, else an error occurred.
+*/
+static int
+bus_attach_list(image_bus_t *Bus, const char *List)
+{
+    unsigned unit = 8;
+    int error = 0;
+
+    while (!error && *List)
+    {
+        const char *end = strchr(List, ',');
+        const char *p = List;
+        size_t length;
+        char *path;
+
+        if (end == NULL)
+            end = List + strlen(List);
+
+        while (p < end && *p >= '0' && *p <= '9')
+            ++p;
+
+        if (p > List && p < end && *p == '=')
+        {
+            unit = (unsigned) atoi(List);
+            List = p + 1;
+        }
+
+        length = end - List;
+        path = malloc(length + 1);
+        if (path == NULL)
+            return 1;
+
+        memcpy(path, List, length);
+        path[length] = 0;
+
+        error = bus_attach(Bus, unit++, path);
+
+        free(path);
+
+        List = *end ? end + 1 : end;
+    }
+
+    return error;
+}
+
+/*! \internal \brief Configure the latency model
+
+ \param Bus
+   The bus.
+
+ \param Spec
+   The specification, as described at the top of this file.
+*/
+static void
+bus_configure_latency(image_bus_t *Bus, const char *Spec)
+{
+    while (*Spec)
+    {
+        const char *end = strchr(Spec, ',');
+        size_t length;
+        unsigned i;
+
+        if (end == NULL)
+            end = Spec + strlen(Spec);
+
+        length = end - Spec;
+
+        for (i = 0; i < sizeof(latency_presets) / sizeof(latency_presets[0]); i++)
+        {
+            if (strlen(latency_presets[i].name) == length
+                && strncmp(Spec, latency_presets[i].name, length) == 0)
+            {
+                Bus->byte_us = latency_presets[i].byte_us;
+                Bus->command_us = latency_presets[i].command_us;
+                Bus->block_us = latency_presets[i].block_us;
+                break;
+            }
+        }
+
+        if (i == sizeof(latency_presets) / sizeof(latency_presets[0]))
+        {
+            if (strncmp(Spec, "byte=", 5) == 0)
+                Bus->byte_us = strtoul(Spec + 5, NULL, 10);
+            else if (strncmp(Spec, "command=", 8) == 0)
+                Bus->command_us = strtoul(Spec + 8, NULL, 10);
+            else if (strncmp(Spec, "block=", 6) == 0)
+                Bus->block_us = strtoul(Spec + 6, NULL, 10);
+            else if (length == 7 && strncmp(Spec, "virtual", 7) == 0)
+                Bus->wait = 0;
+            else
+                fprintf(stderr, "image: ignoring unknown latency setting '%.*s'\n", (int) length, Spec);
+        }
+
+        Spec = *end ? end + 1 : end;
+    }
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- OPENCBM ARCH FUNCTIONS ----------------------------------*/
+
+/*! \brief Get the name of the driver for a specific parallel port
+
+ Get the name of the driver for a specific parallel port.
+
+ \param Port
+   The port specification for the driver to open. If not set (== NULL),
+   the "default" driver is used. The exact meaning depends upon the plugin.
+
+ \return
+   Returns a pointer to a null-terminated string containing the
+   driver name, or NULL if an error occurred.
+*/
+
+const char * CBMAPIDECL
+opencbm_plugin_get_driver_name(const char * const Port)
+{
+    UNREFERENCED_PARAMETER(Port);
+
+    return "virtual/image";
+}
+
+/*! \brief Opens the driver
+
+ This function Opens the driver.
+
+ \param HandleDevice
+   Pointer to a CBM_FILE which will contain the file handle of the driver.
+
+ \param Port
+   The image file(s) to serve, see the top of this file.
+   If not set (== NULL), the environment is used.
+
+ \return
+   ==0: This function completed successfully
+   !=0: otherwise
+
+ cbm_driver_open() should be balanced with cbm_driver_close().
+*/
+
+int CBMAPIDECL
+opencbm_plugin_driver_open(CBM_FILE *HandleDevice, const char * const Port)
+{
+    image_bus_t *bus;
+    const char *env;
+    unsigned unit;
+    int error = 0;
+
+    bus = calloc(1, sizeof(*bus));
+    if (bus == NULL)
+        return 1;
+
+    bus->wait = 1;
+
+    env = getenv("OPENCBM_IMAGE_LATENCY");
+    if (env != NULL)
+        bus_configure_latency(bus, env);
+
+    bus->print_stats = getenv("OPENCBM_IMAGE_STATS") != NULL;
+
+    if (Port != NULL && *Port)
+    {
+        error = bus_attach_list(bus, Port);
+    }
+    else if ((env = getenv("OPENCBM_IMAGE")) != NULL)
+    {
+        error = bus_attach_list(bus, env);
+    }
+
+    for (unit = 4; !error && unit <= IMAGE_MAX_UNIT; unit++)
+    {
+        char name[sizeof("OPENCBM_IMAGE_99")];
+
+        sprintf(name, "OPENCBM_IMAGE_%u", unit);
+        env = getenv(name);
+
+        if (env != NULL && bus->drive[unit] == NULL)
+            error = bus_attach(bus, unit, env);
+    }
+
+    for (unit = 0; !error && unit <= IMAGE_MAX_UNIT; unit++)
+        if (bus->drive[unit] != NULL)
+            break;
+
+    if (!error && unit > IMAGE_MAX_UNIT)
+    {
+        fprintf(stderr, "image: no image given; use -@ image:<file> or set OPENCBM_IMAGE\n");
+        error = 1;
+    }
+
+    if (error)
+    {
+        opencbm_plugin_driver_close((CBM_FILE) bus);
+        return 1;
+    }
+
+    *HandleDevice = (CBM_FILE) bus;
+
+    return 0;
+}
+
+/*! \brief Closes the driver
+
+ Closes the driver, which has be opened with cbm_driver_open() before.
+ All images which were changed are written back.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ cbm_driver_close() should be called to balance a previous call to
+ cbm_driver_open().
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call cbm_driver_close().
+*/
+
+void CBMAPIDECL
+opencbm_plugin_driver_close(CBM_FILE HandleDevice)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+    unsigned unit;
+
+    for (unit = 0; unit <= IMAGE_MAX_UNIT; unit++)
+    {
+        image_drive_t *drive = bus->drive[unit];
+
+        if (drive == NULL)
+            continue;
+
+        image_dos_reset(drive);
+        image_disk_save(&drive->disk);
+        image_disk_free(&drive->disk);
+        free(drive);
+    }
+
+    if (bus->print_stats)
+    {
+        fprintf(stderr, "image: %lu bus commands, %lu bytes read, %lu bytes written, "
+            "%lu blocks, modelled bus time %.3f s\n",
+            bus->commands, bus->bytes_read, bus->bytes_written,
+            bus->blocks, bus->bus_us / 1000000.0);
+    }
+
+    free(bus);
+}
+
+/*! \brief Write data to the IEC serial bus
+
+ This function sends data after a cbm_listen().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Buffer
+   Pointer to a buffer which hold the bytes to write to the bus.
+
+ \param Count
+   Number of bytes to be written.
+
+ \return
+   >= 0: The actual number of bytes written.
+   <0  indicates an error.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_raw_write(CBM_FILE HandleDevice, const void *Buffer, size_t Count)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+    unsigned long blocks = bus_blocks(bus);
+    int ret = -1;
+
+    switch (bus->state)
+    {
+    case BUS_OPEN:
+        if (bus->name_length + Count <= sizeof(bus->name))
+        {
+            memcpy(bus->name + bus->name_length, Buffer, Count);
+            bus->name_length += Count;
+            ret = (int) Count;
+        }
+        break;
+
+    case BUS_LISTEN:
+        ret = image_dos_write(bus->active, bus->channel, Buffer, Count);
+        break;
+
+    default:
+        break;
+    }
+
+    if (ret > 0)
+    {
+        bus->bytes_written += ret;
+        bus_delay(bus, 0, ret, bus_blocks(bus) - blocks);
+    }
+
+    return ret;
+}
+
+/*! \brief Read data from the IEC serial bus
+
+ This function retrieves data after a cbm_talk().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Buffer
+   Pointer to a buffer which will hold the bytes read.
+
+ \param Count
+   Number of bytes to be read at most.
+
+ \return
+   >= 0: The actual number of bytes read.
+   <0  indicates an error.
+
+ At most Count bytes are read. If EOI is signalled, the
+ function returns early.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_raw_read(CBM_FILE HandleDevice, void *Buffer, size_t Count)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+    int ret;
+
+    if (bus->state != BUS_TALK)
+        return -1;
+
+    if (bus->eoi)
+        return 0;
+
+    ret = image_dos_read(bus->active, bus->channel, Buffer, Count, &bus->eoi);
+
+    if (ret > 0)
+    {
+        bus->bytes_read += ret;
+        bus_delay(bus, 0, ret, 0);
+    }
+
+    return ret;
+}
+
+/*! \brief Send a LISTEN on the IEC serial bus
+
+ This function sends a LISTEN on the IEC serial bus.
+ This prepares a LISTENer, so that it will wait for our
+ bytes we will write in the future.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as "primary address", too.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_listen(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+
+    return bus_address(bus, DeviceAddress, SecondaryAddress, BUS_LISTEN) ? 0 : -1;
+}
+
+/*! \brief Send a TALK on the IEC serial bus
+
+ This function sends a TALK on the IEC serial bus.
+ This prepares a TALKer, so that it will prepare to send
+ data to us.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as "primary address", too.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_talk(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+
+    bus->eoi = 0;
+
+    return bus_address(bus, DeviceAddress, SecondaryAddress, BUS_TALK) ? 0 : -1;
+}
+
+/*! \brief Open a file on the IEC serial bus
+
+ This function opens a file on the IEC serial bus. The file
+ name is sent with cbm_raw_write() afterwards, and the file
+ is opened with the following cbm_unlisten().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as "primary address", too.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_open(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+
+    bus->name_length = 0;
+
+    return bus_address(bus, DeviceAddress, SecondaryAddress, BUS_OPEN) ? 0 : -1;
+}
+
+/*! \brief Close a file on the IEC serial bus
+
+ This function closes a file on the IEC serial bus.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as "primary address", too.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 on success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_close(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+    image_drive_t *drive;
+    unsigned long blocks;
+
+    drive = bus_address(bus, DeviceAddress, SecondaryAddress, BUS_IDLE);
+    if (drive == NULL)
+        return -1;
+
+    blocks = drive->blocks_accessed;
+    image_dos_close(drive, SecondaryAddress);
+
+    /* this is LISTEN + CLOSE + UNLISTEN on the bus */
+    bus_delay(bus, 1, 0, drive->blocks_accessed - blocks);
+
+    return 0;
+}
+
+/*! \brief Send an UNLISTEN on the IEC serial bus
+
+ This function sends an UNLISTEN on the IEC serial bus.
+ Other than LISTEN and TALK, an UNLISTEN is not directed
+ to just one device, but to all devices on that IEC
+ serial bus.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, else failure
+
+ At least on a 1541 floppy drive, an UNLISTEN also undoes
+ a previous TALK.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_unlisten(CBM_FILE HandleDevice)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+    image_drive_t *drive = bus->active;
+    unsigned long blocks = bus_blocks(bus);
+
+    if (drive != NULL && bus->state == BUS_OPEN)
+    {
+        image_dos_open(drive, bus->channel, bus->name, bus->name_length);
+    }
+    else if (drive != NULL && bus->state == BUS_LISTEN && bus->channel == IMAGE_CMD_CHANNEL)
+    {
+        if (drive->command_overflow)
+            image_dos_set_status(drive, 32, 0, 0);
+        else
+            image_dos_execute(drive, drive->command, drive->command_length);
+
+        drive->command_length = 0;
+        drive->command_overflow = 0;
+    }
+
+    bus_delay(bus, 1, 0, bus_blocks(bus) - blocks);
+
+    bus->state = BUS_IDLE;
+    bus->active = NULL;
+
+    return 0;
+}
+
+/*! \brief Send an UNTALK on the IEC serial bus
+
+ This function sends an UNTALK on the IEC serial bus.
+ Other than LISTEN and TALK, an UNTALK is not directed
+ to just one device, but to all devices on that IEC
+ serial bus.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_untalk(CBM_FILE HandleDevice)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+
+    bus_delay(bus, 1, 0, 0);
+
+    bus->state = BUS_IDLE;
+    bus->active = NULL;
+
+    return 0;
+}
+
+/*! \brief Get EOI flag after bus read
+
+ This function gets the EOI ("End of Information") flag
+ after reading the IEC serial bus.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   != 0 if EOI was signalled, else 0.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_get_eoi(CBM_FILE HandleDevice)
+{
+    return ((image_bus_t *) HandleDevice)->eoi;
+}
+
+/*! \brief Reset the EOI flag
+
+ This function resets the EOI ("End of Information") flag
+ which might be still set after reading the IEC serial bus.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, != 0 means an error has occured.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_clear_eoi(CBM_FILE HandleDevice)
+{
+    ((image_bus_t *) HandleDevice)->eoi = 0;
+
+    return 0;
+}
+
+/*! \brief RESET all devices
+
+ This function performs a hardware RESET of all devices on
+ the IEC serial bus. Files which are open for writing are
+ lost, as on the real drives.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_reset(CBM_FILE HandleDevice)
+{
+    image_bus_t *bus = (image_bus_t *) HandleDevice;
+    unsigned unit;
+
+    for (unit = 0; unit <= IMAGE_MAX_UNIT; unit++)
+        if (bus->drive[unit] != NULL)
+            image_dos_reset(bus->drive[unit]);
+
+    bus->state = BUS_IDLE;
+    bus->active = NULL;
+    bus->eoi = 0;
+
+    bus_delay(bus, 1, 0, 0);
+
+    return 0;
+}
+
+/*! \brief Read status of all bus lines.
+
+ This function reads the state of all lines on the IEC serial bus.
+ There is no real bus, thus, all lines are released.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   The state of the lines. The result is an OR between
+   the bit flags IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_iec_poll(CBM_FILE HandleDevice)
+{
+    UNREFERENCED_PARAMETER(HandleDevice);
+
+    return 0;
+}
+
+/*! \brief Activate and deactive a line on the IEC serial bus
+
+ This function activates (sets to 0V, L) and deactivates
+ (set to 5V, H) lines on the IEC serial bus. There is no
+ real bus, thus, this does nothing.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Set
+   The mask of which lines should be set.
+
+ \param Release
+   The mask of which lines should be released.
+*/
+
+void CBMAPIDECL
+opencbm_plugin_iec_setrelease(CBM_FILE HandleDevice, int Set, int Release)
+{
+    UNREFERENCED_PARAMETER(HandleDevice);
+    UNREFERENCED_PARAMETER(Set);
+    UNREFERENCED_PARAMETER(Release);
+}
+
+/*! \brief Wait for a line to have a specific state
+
+ This function waits for a line to enter a specific state
+ on the IEC serial bus. There is no real bus, thus, this
+ returns immediately.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be deactivated. This must be exactly one of
+   IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET.
+
+ \param State
+   If zero, then wait for this line to be deactivated. \n
+   If not zero, then wait for this line to be activated.
+
+ \return
+   The state of the IEC bus on return (like cbm_iec_poll).
+*/
+
+int CBMAPIDECL
+opencbm_plugin_iec_wait(CBM_FILE HandleDevice, int Line, int State)
+{
+    UNREFERENCED_PARAMETER(Line);
+    UNREFERENCED_PARAMETER(State);
+
+    return opencbm_plugin_iec_poll(HandleDevice);
+}
@@ -0,0 +1,1307 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+*/
+
+/*! **************************************************************
+** \file lib/plugin/image/dos.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Virtual IEC drive backed by a disk image: DOS emulation
+**
+** This file emulates the parts of the CBM DOS which are visible
+** on the IEC bus: opening and closing files, the "$" directory,
+** direct access buffers ("#"), and the command and status channel
+** with the block and memory commands.
+**
+** Drive code cannot be executed; M-E and the U3-U8 commands are
+** accepted, but do nothing.
+**
+****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+
+/*! the file types, as stored in the directory */
+#define TYPE_DEL 0
+#define TYPE_SEQ 1
+#define TYPE_PRG 2
+#define TYPE_USR 3
+#define TYPE_REL 4
+
+/*! mark in the file type: the file was closed correctly */
+#define TYPE_CLOSED 0x80
+
+/*! mark in the file type: the file is locked */
+#define TYPE_LOCKED 0x40
+
+/*! the character which pads file names in the directory */
+#define PAD 0xa0
+
+/*! \internal \brief Get the text of a DOS error code */
+static const char *
+status_text(const image_drive_t *Drive, int Code)
+{
+    switch (Code)
+    {
+    case  0: return " OK";
+    case  1: return " FILES SCRATCHED";
+    case 20: case 21: case 22: case 23: case 24: case 27:
+             return "READ ERROR";
+    case 25: case 28:
+             return "WRITE ERROR";
+    case 26: return "WRITE PROTECT ON";
+    case 29: return "DISK ID MISMATCH";
+    case 30: case 31: case 32: case 33: case 34:
+             return "SYNTAX ERROR";
+    case 60: return "WRITE FILE OPEN";
+    case 61: return "FILE NOT OPEN";
+    case 62: return "FILE NOT FOUND";
+    case 63: return "FILE EXISTS";
+    case 64: return "FILE TYPE MISMATCH";
+    case 65: return "NO BLOCK";
+    case 66: case 67:
+             return "ILLEGAL TRACK OR SECTOR";
+    case 70: return "NO CHANNEL";
+    case 71: return "DIR ERROR";
+    case 72: return "DISK FULL";
+    case 73:
+        switch (Drive->disk.format)
+        {
+        case IMAGE_D71: return "CBM DOS V3.0 1571";
+        case IMAGE_D81: return "COPYRIGHT CBM DOS V10 1581";
+        default:        return "CBM DOS V2.6 1541";
+        }
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+/*! \brief Set the status of the drive
+
+ \param Drive
+   The drive.
+
+ \param Code
+   The DOS error code.
+
+ \param Track
+   The track to report.
+
+ \param Sector
+   The sector to report.
+*/
+void
+image_dos_set_status(image_drive_t *Drive, int Code, unsigned Track, unsigned Sector)
+{
+    Drive->status_length = sprintf((char *) Drive->status, "%02d,%s,%02u,%02u\r",
+        Code, status_text(Drive, Code), Track % 100, Sector % 100);
+    Drive->status_pos = 0;
+}
+
+/*! \internal \brief Append data to the buffer of a channel
+
+ \return
+   0 on success, 1 if there is no memory left.
+*/
+static int
+channel_append(image_channel_t *Channel, const void *Data, size_t Length)
+{
+    if (Channel->length + Length > Channel->allocated)
+    {
+        size_t allocated = Channel->allocated ? Channel->allocated : 4 * IMAGE_BLOCKSIZE;
+        unsigned char *p;
+
+        while (allocated < Channel->length + Length)
+            allocated *= 2;
+
+        p = realloc(Channel->data, allocated);
+        if (p == NULL)
+            return 1;
+
+        Channel->data = p;
+        Channel->allocated = allocated;
+    }
+
+    memcpy(Channel->data + Channel->length, Data, Length);
+    Channel->length += Length;
+
+    return 0;
+}
+
+/*! \internal \brief Release a channel, without committing anything */
+static void
+channel_free(image_channel_t *Channel)
+{
+    free(Channel->data);
+    memset(Channel, 0, sizeof(*Channel));
+}
+
+/*! \internal \brief Check if a file name matches a pattern
+
+ \param Pattern
+   The pattern, as a C string. "*" and "?" are wildcards.
+
+ \param Name
+   The file name, as stored in the directory (padded with $A0).
+
+ \return
+   1 if the name matches the pattern, 0 otherwise.
+*/
+static int
+name_matches(const char *Pattern, const unsigned char *Name)
+{
+    unsigned i;
+
+    for (i = 0; i < IMAGE_NAMESIZE; i++)
+    {
+        unsigned char p = (unsigned char) Pattern[i];
+        unsigned char n = Name[i];
+
+        if (p == '*')
+            return 1;
+
+        if (p == 0)
+            return n == PAD;
+
+        if (n == PAD || (p != '?' && p != n))
+            return 0;
+    }
+
+    return Pattern[i] == 0 || Pattern[i] == '*';
+}
+
+/*! \internal \brief Find a file in the directory
+
+ \param Drive
+   The drive.
+
+ \param Pattern
+   The pattern of the file name.
+
+ \return
+   The directory entry of the first file which matches,
+   or NULL if no file matches.
+*/
+static unsigned char *
+find_file(image_drive_t *Drive, const char *Pattern)
+{
+    unsigned char *entry;
+    unsigned track = 0;
+    unsigned sector = 0;
+    unsigned index = 0;
+
+    while ((entry = image_dir_next(&Drive->disk, &track, &sector, &index)) != NULL)
+    {
+        if ((entry[2] & 7) != TYPE_DEL && name_matches(Pattern, entry + 5))
+            return entry;
+    }
+
+    return NULL;
+}
+
+/*! \internal \brief Split a file name as given to OPEN
+
+ \param Name
+   The file name, as sent on the bus.
+
+ \param Length
+   The length of Name.
+
+ \param Pattern
+   Buffer of IMAGE_NAMESIZE + 1 bytes which gets the
+   file name (or pattern), without the drive number.
+
+ \param Replace
+   Set to 1 if the name starts with "@".
+
+ \param Type
+   Gets the file type given, or -1 if none was given.
+
+ \param Mode
+   Gets the mode ('R', 'W', 'A', 'M') given, or 0.
+*/
+static void
+split_filename(const unsigned char *Name, size_t Length,
+               char *Pattern, int *Replace, int *Type, char *Mode)
+{
+    const unsigned char *end = Name + Length;
+    const unsigned char *colon;
+    unsigned i = 0;
+
+    *Replace = 0;
+    *Type = -1;
+    *Mode = 0;
+
+    if (Name < end && *Name == '@')
+    {
+        *Replace = 1;
+        ++Name;
+    }
+
+    colon = memchr(Name, ':', end - Name);
+    if (colon != NULL)
+        Name = colon + 1;
+
+    while (Name < end && *Name != ',' && *Name != '=')
+    {
+        if (i < IMAGE_NAMESIZE)
+            Pattern[i++] = *Name;
+        ++Name;
+    }
+    Pattern[i] = 0;
+
+    while (Name < end)
+    {
+        /* skip the ',' and get the option character */
+        if (++Name >= end)
+            break;
+
+        switch (*Name)
+        {
+        case 'S': *Type = TYPE_SEQ; break;
+        case 'P': *Type = TYPE_PRG; break;
+        case 'U': *Type = TYPE_USR; break;
+        case 'L': *Type = TYPE_REL; break;
+        case 'R': case 'W': case 'A': case 'M':
+                  *Mode = *Name;
+                  break;
+        }
+
+        while (Name < end && *Name != ',')
+            ++Name;
+    }
+}
+
+/*! \internal \brief Append one line of a BASIC directory listing */
+static int
+dir_line(image_channel_t *Channel, unsigned Number, const char *Text, size_t Length)
+{
+    unsigned char header[4];
+    static const unsigned char nul = 0;
+
+    /* the link is never evaluated, the drive sends a dummy, too */
+    header[0] = 1;
+    header[1] = 1;
+    header[2] = (unsigned char) (Number & 0xff);
+    header[3] = (unsigned char) (Number >> 8);
+
+    return channel_append(Channel, header, sizeof(header))
+        || channel_append(Channel, Text, Length)
+        || channel_append(Channel, &nul, 1);
+}
+
+/*! \internal \brief Create the BASIC directory listing for "$"
+
+ \param Drive
+   The drive.
+
+ \param Channel
+   The channel which gets the listing.
+
+ \param Name
+   The name which was used to open the directory, including the "$".
+
+ \param Length
+   The length of Name.
+
+ \return
+   0 on success, else the DOS error code.
+*/
+static int
+build_directory(image_drive_t *Drive, image_channel_t *Channel,
+                const unsigned char *Name, size_t Length)
+{
+    static const char *types[] = { "DEL", "SEQ", "PRG", "USR", "REL", "CBM", "DIR", "???" };
+    static const unsigned char load_address[] = { 0x01, 0x04 };
+    static const unsigned char end_of_program[] = { 0x00, 0x00 };
+
+    const unsigned char *diskname;
+    const unsigned char *id;
+    unsigned char *entry;
+    char line[40];
+    char pattern[IMAGE_NAMESIZE + 1];
+    const unsigned char *filter;
+    unsigned track = 0;
+    unsigned sector = 0;
+    unsigned index = 0;
+    unsigned i;
+    int n;
+    int error = 0;
+
+    pattern[0] = 0;
+    filter = memchr(Name, ':', Length);
+    if (filter != NULL)
+    {
+        for (i = 0, ++filter; i < IMAGE_NAMESIZE && filter < Name + Length && *filter != '='; i++)
+            pattern[i] = *filter++;
+        pattern[i] = 0;
+    }
+
+    filter = memchr(Name, '=', Length);
+
+    diskname = image_disk_name(&Drive->disk, &id);
+
+    n = 0;
+    line[n++] = 0x12;
+    line[n++] = '"';
+    for (i = 0; i < IMAGE_NAMESIZE; i++)
+        line[n++] = diskname[i] == PAD ? ' ' : diskname[i];
+    line[n++] = '"';
+    line[n++] = ' ';
+    for (i = 0; i < 5; i++)
+        line[n++] = id[i] == PAD ? ' ' : id[i];
+
+    error = channel_append(Channel, load_address, sizeof(load_address))
+        || dir_line(Channel, 0, line, n);
+
+    while (!error && (entry = image_dir_next(&Drive->disk, &track, &sector, &index)) != NULL)
+    {
+        unsigned blocks = entry[30] | (entry[31] << 8);
+        unsigned length;
+
+        if ((entry[2] & 7) == TYPE_DEL && !(entry[2] & TYPE_CLOSED))
+            continue;
+
+        if (pattern[0] && !name_matches(pattern, entry + 5))
+            continue;
+
+        if (filter != NULL && filter + 1 < Name + Length && types[entry[2] & 7][0] != filter[1])
+            continue;
+
+        for (length = 0; length < IMAGE_NAMESIZE && entry[5 + length] != PAD; length++)
+            ;
+
+        n = sprintf(line, "%s\"", blocks < 10 ? "   " : blocks < 100 ? "  " : " ");
+        memcpy(line + n, entry + 5, length);
+        n += length;
+        line[n++] = '"';
+        for (i = length; i < IMAGE_NAMESIZE; i++)
+            line[n++] = ' ';
+        n += sprintf(line + n, "%c%s%c",
+            (entry[2] & TYPE_CLOSED) ? ' ' : '*',
+            types[entry[2] & 7],
+            (entry[2] & TYPE_LOCKED) ? '<' : ' ');
+
+        error = dir_line(Channel, blocks, line, n);
+    }
+
+    if (!error)
+    {
+        n = sprintf(line, "BLOCKS FREE.             ");
+        error = dir_line(Channel, image_blocks_free(&Drive->disk), line, n)
+            || channel_append(Channel, end_of_program, sizeof(end_of_program));
+    }
+
+    return error ? 70 : 0;
+}
+
+/*! \internal \brief Open a file for reading
+
+ \return
+   0 on success, else the DOS error code.
+*/
+static int
+open_read(image_drive_t *Drive, image_channel_t *Channel,
+          const char *Pattern, int Type, unsigned *ErrTrack, unsigned *ErrSector)
+{
+    unsigned char *entry;
+    size_t length;
+    int error;
+
+    entry = find_file(Drive, Pattern);
+    if (entry == NULL || !(entry[2] & TYPE_CLOSED))
+        return 62;
+
+    if (Type >= 0 && (entry[2] & 7) != Type)
+        return 64;
+
+    error = image_read_chain(&Drive->disk, entry[3], entry[4],
+        &Channel->data, &Channel->length, ErrTrack, ErrSector);
+
+    if (error == 0)
+    {
+        length = Channel->length;
+        Drive->blocks_accessed += (unsigned long) ((length + IMAGE_BLOCKSIZE - 3) / (IMAGE_BLOCKSIZE - 2));
+        Channel->allocated = length;
+        Channel->mode = IMAGE_CH_READ;
+    }
+
+    return error;
+}
+
+/*! \brief Open a channel
+
+ This is executed with the UNLISTEN after an OPEN.
+
+ \param Drive
+   The drive.
+
+ \param Channel
+   The channel (secondary address) which is opened.
+
+ \param Name
+   The file name which was sent.
+
+ \param Length
+   The length of the file name.
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+image_dos_open(image_drive_t *Drive, unsigned Channel, const unsigned char *Name, size_t Length)
+{
+    image_channel_t *ch;
+    char pattern[IMAGE_NAMESIZE + 1];
+    char mode;
+    int replace;
+    int type;
+    unsigned err_track = 0;
+    unsigned err_sector = 0;
+    int error = 0;
+
+    Channel &= 0x0f;
+
+    if (Channel == IMAGE_CMD_CHANNEL)
+    {
+        image_dos_execute(Drive, Name, Length);
+        return 0;
+    }
+
+    image_dos_close(Drive, Channel);
+
+    ch = &Drive->channel[Channel];
+
+    if (Length == 0)
+    {
+        error = 34;
+    }
+    else if (Name[0] == '#')
+    {
+        ch->data = calloc(1, IMAGE_BLOCKSIZE);
+        if (ch->data == NULL)
+        {
+            error = 70;
+        }
+        else
+        {
+            ch->mode = IMAGE_CH_DIRECT;
+            ch->length = ch->allocated = IMAGE_BLOCKSIZE;
+            ch->pos = 1;
+            ch->eoi_pos = IMAGE_BLOCKSIZE - 1;
+        }
+    }
+    else if (Name[0] == '$')
+    {
+        error = build_directory(Drive, ch, Name, Length);
+        if (error == 0)
+            ch->mode = IMAGE_CH_READ;
+    }
+    else
+    {
+        split_filename(Name, Length, pattern, &replace, &type, &mode);
+
+        if (mode == 0)
+            mode = Channel == 1 ? 'W' : 'R';
+
+        if (mode == 'R' || mode == 'M')
+        {
+            error = open_read(Drive, ch, pattern, type, &err_track, &err_sector);
+        }
+        else if (Drive->disk.readonly)
+        {
+            error = 26;
+        }
+        else if (pattern[0] == 0)
+        {
+            error = 34;
+        }
+        else if (strpbrk(pattern, "*?") != NULL)
+        {
+            error = 33;
+        }
+        else if (type == TYPE_REL)
+        {
+            /* relative files are not supported */
+            error = 64;
+        }
+        else if (mode == 'A')
+        {
+            error = open_read(Drive, ch, pattern, type, &err_track, &err_sector);
+            replace = 1;
+        }
+        else if (!replace && find_file(Drive, pattern) != NULL)
+        {
+            error = 63;
+        }
+
+        if (error == 0 && mode != 'R' && mode != 'M')
+        {
+            strcpy(ch->name, pattern);
+            ch->filetype = (unsigned char) (type >= 0 ? type : Channel == 1 ? TYPE_PRG : TYPE_SEQ);
+            ch->replace = replace;
+            ch->mode = IMAGE_CH_WRITE;
+        }
+    }
+
+    if (error)
+        channel_free(ch);
+
+    image_dos_set_status(Drive, error, err_track, err_sector);
+
+    return error;
+}
+
+/*! \internal \brief Write a file which was written to a channel to the disk
+
+ \return
+   0 on success, else the DOS error code.
+*/
+static int
+commit_file(image_drive_t *Drive, image_channel_t *Channel)
+{
+    image_disk_t *disk = &Drive->disk;
+    unsigned char *entry = NULL;
+    unsigned track;
+    unsigned sector;
+    unsigned blocks;
+    unsigned i;
+    int error;
+
+    if (Channel->replace)
+    {
+        entry = find_file(Drive, Channel->name);
+        if (entry != NULL && (entry[2] & TYPE_LOCKED))
+            return 26;
+    }
+    else if (find_file(Drive, Channel->name) != NULL)
+    {
+        return 63;
+    }
+
+    if (entry == NULL)
+    {
+        entry = image_dir_new_entry(disk);
+        if (entry == NULL)
+            return 72;
+    }
+    else
+    {
+        image_free_chain(disk, entry[3], entry[4]);
+    }
+
+    error = image_write_chain(disk, Channel->data, Channel->length, &track, &sector, &blocks);
+    if (error)
+    {
+        /* the old file is lost, as on the real drive with "@:" */
+        entry[2] = TYPE_DEL;
+        return error;
+    }
+
+    Drive->blocks_accessed += blocks;
+
+    /* keep the link bytes in entry[0] and entry[1] */
+    memset(entry + 2, 0, 30);
+    entry[2] = (unsigned char) (Channel->filetype | TYPE_CLOSED);
+    entry[3] = (unsigned char) track;
+    entry[4] = (unsigned char) sector;
+    for (i = 0; i < IMAGE_NAMESIZE && Channel->name[i]; i++)
+        entry[5 + i] = (unsigned char) Channel->name[i];
+    for (; i < IMAGE_NAMESIZE; i++)
+        entry[5 + i] = PAD;
+    entry[30] = (unsigned char) (blocks & 0xff);
+    entry[31] = (unsigned char) (blocks >> 8);
+
+    disk->dirty = 1;
+
+    return 0;
+}
+
+/*! \brief Close a channel
+
+ If a file was written on this channel, it is written to the disk.
+ Closing the command channel closes all other channels, too.
+
+ \param Drive
+   The drive.
+
+ \param Channel
+   The channel (secondary address) to close.
+*/
+void
+image_dos_close(image_drive_t *Drive, unsigned Channel)
+{
+    image_channel_t *ch;
+    int error;
+
+    Channel &= 0x0f;
+
+    if (Channel == IMAGE_CMD_CHANNEL)
+    {
+        for (Channel = 0; Channel < IMAGE_CMD_CHANNEL; Channel++)
+            image_dos_close(Drive, Channel);
+        return;
+    }
+
+    ch = &Drive->channel[Channel];
+
+    if (ch->mode == IMAGE_CH_WRITE)
+    {
+        error = commit_file(Drive, ch);
+        if (error)
+            image_dos_set_status(Drive, error, 0, 0);
+    }
+
+    channel_free(ch);
+}
+
+/*! \internal \brief Parse the numeric parameters of a command
+
+ \param Params
+   The parameters, following the command name.
+
+ \param End
+   The end of the command.
+
+ \param Numbers
+   Array which gets the numbers.
+
+ \param Max
+   The number of elements of Numbers.
+
+ \return
+   The number of parameters found.
+*/
+static int
+parse_numbers(const unsigned char *Params, const unsigned char *End, unsigned *Numbers, int Max)
+{
+    int count = 0;
+
+    while (count < Max)
+    {
+        while (Params < End && (*Params == ' ' || *Params == ',' || *Params == ':' || *Params == 0x1d))
+            ++Params;
+
+        if (Params >= End || *Params < '0' || *Params > '9')
+            break;
+
+        Numbers[count] = 0;
+        while (Params < End && *Params >= '0' && *Params <= '9')
+            Numbers[count] = Numbers[count] * 10 + (*Params++ - '0');
+
+        ++count;
+    }
+
+    return count;
+}
+
+/*! \internal \brief Read a byte of the drive memory, for M-R */
+static unsigned char
+memory_read(const image_drive_t *Drive, unsigned Address)
+{
+    if (Address < IMAGE_RAMSIZE)
+        return Drive->ram[Address];
+
+    /* the footprint cbm_identify() looks for */
+    if (Address == 0xff40 || Address == 0xff41)
+    {
+        static const unsigned char footprint[][2] =
+        {
+            { 0x0f, 0xf0 },   /* 1541-II */
+            { 0xac, 0x02 },   /* 1571 */
+            { 0xba, 0x01 }    /* 1581 */
+        };
+
+        return footprint[Drive->disk.format][Address - 0xff40];
+    }
+
+    return 0;
+}
+
+/*! \internal \brief Get the direct access channel a block command refers to
+
+ \return
+   The channel, or NULL if it is not a direct access channel.
+*/
+static image_channel_t *
+direct_channel(image_drive_t *Drive, unsigned Channel)
+{
+    image_channel_t *ch;
+
+    if (Channel >= IMAGE_CMD_CHANNEL)
+        return NULL;
+
+    ch = &Drive->channel[Channel];
+
+    return ch->mode == IMAGE_CH_DIRECT ? ch : NULL;
+}
+
+/*! \internal \brief Execute the block commands U1, U2, B-R, B-W, B-P, B-A, B-F
+
+ \param Drive
+   The drive.
+
+ \param Command
+   The command: 'R' for U1 and B-R, 'W' for U2 and B-W,
+   'P', 'A', and 'F' for B-P, B-A, B-F.
+
+ \param Raw
+   For 'R' and 'W': 1 for U1 and U2, 0 for B-R and B-W.
+
+ \param Params
+   The parameters of the command.
+
+ \param End
+   The end of the command.
+*/
+static void
+block_command(image_drive_t *Drive, char Command, int Raw,
+              const unsigned char *Params, const unsigned char *End)
+{
+    image_disk_t *disk = &Drive->disk;
+    image_channel_t *ch;
+    unsigned char *block;
+    unsigned n[4];
+    unsigned track;
+    unsigned sector;
+    int count;
+    int error;
+
+    count = parse_numbers(Params, End, n, 4);
+
+    switch (Command)
+    {
+    case 'P':
+        if (count < 2)
+        {
+            image_dos_set_status(Drive, 30, 0, 0);
+        }
+        else if ((ch = direct_channel(Drive, n[0])) == NULL)
+        {
+            image_dos_set_status(Drive, 70, 0, 0);
+        }
+        else
+        {
+            ch->pos = n[1] & 0xff;
+            image_dos_set_status(Drive, 0, 0, 0);
+        }
+        return;
+
+    case 'A':
+    case 'F':
+        if (count < 3)
+        {
+            image_dos_set_status(Drive, 30, 0, 0);
+            return;
+        }
+
+        track = n[1];
+        sector = n[2];
+
+        if (image_block(disk, track, sector) == NULL)
+        {
+            image_dos_set_status(Drive, 66, track, sector);
+        }
+        else if (Command == 'F')
+        {
+            image_bam_free(disk, track, sector);
+            image_dos_set_status(Drive, 0, 0, 0);
+        }
+        else if (image_bam_allocate(disk, track, sector) == 0)
+        {
+            image_dos_set_status(Drive, 0, 0, 0);
+        }
+        else if (image_find_free_block(disk, &track, &sector) == 0)
+        {
+            image_dos_set_status(Drive, 65, track, sector);
+        }
+        else
+        {
+            image_dos_set_status(Drive, 65, 0, 0);
+        }
+        return;
+    }
+
+    if (count < 4)
+    {
+        image_dos_set_status(Drive, 30, 0, 0);
+        return;
+    }
+
+    track = n[2];
+    sector = n[3];
+
+    ch = direct_channel(Drive, n[0]);
+    block = image_block(disk, track, sector);
+
+    if (ch == NULL)
+    {
+        image_dos_set_status(Drive, 70, 0, 0);
+        return;
+    }
+
+    if (block == NULL)
+    {
+        image_dos_set_status(Drive, 66, track, sector);
+        return;
+    }
+
+    ++Drive->blocks_accessed;
+
+    if (Command == 'R')
+    {
+        memcpy(ch->data, block, IMAGE_BLOCKSIZE);
+
+        if (Raw)
+        {
+            ch->pos = 0;
+            ch->eoi_pos = IMAGE_BLOCKSIZE - 1;
+        }
+        else
+        {
+            /* B-R: byte 0 tells how many bytes are valid */
+            ch->pos = 1;
+            ch->eoi_pos = block[0] ? block[0] : IMAGE_BLOCKSIZE - 1;
+        }
+
+        error = image_block_error(disk, track, sector);
+        image_dos_set_status(Drive, error, error ? track : 0, error ? sector : 0);
+    }
+    else if (disk->readonly)
+    {
+        image_dos_set_status(Drive, 26, track, sector);
+    }
+    else
+    {
+        if (!Raw)
+            ch->data[0] = (unsigned char) ch->pos;
+
+        memcpy(block, ch->data, IMAGE_BLOCKSIZE);
+        disk->dirty = 1;
+        image_dos_set_status(Drive, 0, 0, 0);
+    }
+}
+
+/*! \internal \brief Execute the memory commands M-R, M-W, M-E */
+static void
+memory_command(image_drive_t *Drive, const unsigned char *Command, size_t Length)
+{
+    unsigned address;
+    unsigned count;
+    unsigned i;
+
+    if (Length < 5)
+    {
+        image_dos_set_status(Drive, 31, 0, 0);
+        return;
+    }
+
+    address = Command[3] | (Command[4] << 8);
+
+    switch (Command[2])
+    {
+    case 'R':
+        /* without a count, one byte is read; a count of 0 means 256, as cbm_download() uses it */
+        count = Length > 5 ? (Command[5] ? Command[5] : 256) : 1;
+
+        /* M-R answers on the status channel, terminated by a CR */
+        for (i = 0; i < count; i++)
+            Drive->status[i] = memory_read(Drive, (address + i) & 0xffff);
+        Drive->status[count] = '\r';
+        Drive->status_length = count + 1;
+        Drive->status_pos = 0;
+        break;
+
+    case 'W':
+        count = Length > 5 ? Command[5] : 0;
+        if (count > Length - 6)
+            count = (unsigned) (Length - 6);
+
+        /* everything outside of the RAM (I/O, ROM) is ignored */
+        for (i = 0; i < count; i++)
+            if (address + i < IMAGE_RAMSIZE)
+                Drive->ram[address + i] = Command[6 + i];
+
+        image_dos_set_status(Drive, 0, 0, 0);
+        break;
+
+    case 'E':
+        /* we cannot execute drive code */
+        image_dos_set_status(Drive, 0, 0, 0);
+        break;
+
+    default:
+        image_dos_set_status(Drive, 31, 0, 0);
+        break;
+    }
+}
+
+/*! \internal \brief Execute the S (scratch) command */
+static void
+scratch_command(image_drive_t *Drive, const unsigned char *Command, size_t Length)
+{
+    const unsigned char *end = Command + Length;
+    const unsigned char *p = memchr(Command, ':', Length);
+    unsigned files = 0;
+
+    if (p == NULL)
+    {
+        image_dos_set_status(Drive, 34, 0, 0);
+        return;
+    }
+
+    if (Drive->disk.readonly)
+    {
+        image_dos_set_status(Drive, 26, 0, 0);
+        return;
+    }
+
+    while (p < end)
+    {
+        char pattern[IMAGE_NAMESIZE + 1];
+        unsigned char *entry;
+        unsigned i = 0;
+
+        for (++p; p < end && *p != ','; p++)
+            if (i < IMAGE_NAMESIZE)
+                pattern[i++] = *p;
+        pattern[i] = 0;
+
+        while (pattern[0] && (entry = find_file(Drive, pattern)) != NULL)
+        {
+            if (entry[2] & TYPE_LOCKED)
+                break;
+
+            if (entry[2] & TYPE_CLOSED)
+                image_free_chain(&Drive->disk, entry[3], entry[4]);
+
+            entry[2] = TYPE_DEL;
+            Drive->disk.dirty = 1;
+            ++files;
+        }
+    }
+
+    image_dos_set_status(Drive, 1, files, 0);
+}
+
+/*! \internal \brief Execute the R (rename) command: "R:new=old" */
+static void
+rename_command(image_drive_t *Drive, const unsigned char *Command, size_t Length)
+{
+    const unsigned char *colon = memchr(Command, ':', Length);
+    const unsigned char *equal = memchr(Command, '=', Length);
+    char newname[IMAGE_NAMESIZE + 1];
+    char oldname[IMAGE_NAMESIZE + 1];
+    unsigned char *entry;
+    int replace;
+    int type;
+    char mode;
+    unsigned i;
+
+    if (colon == NULL || equal == NULL || equal < colon)
+    {
+        image_dos_set_status(Drive, 34, 0, 0);
+        return;
+    }
+
+    split_filename(colon + 1, equal - colon - 1, newname, &replace, &type, &mode);
+    split_filename(equal + 1, Command + Length - equal - 1, oldname, &replace, &type, &mode);
+
+    if (Drive->disk.readonly)
+    {
+        image_dos_set_status(Drive, 26, 0, 0);
+    }
+    else if (newname[0] == 0 || strpbrk(newname, "*?") != NULL)
+    {
+        image_dos_set_status(Drive, 33, 0, 0);
+    }
+    else if (find_file(Drive, newname) != NULL)
+    {
+        image_dos_set_status(Drive, 63, 0, 0);
+    }
+    else if ((entry = find_file(Drive, oldname)) == NULL)
+    {
+        image_dos_set_status(Drive, 62, 0, 0);
+    }
+    else
+    {
+        for (i = 0; i < IMAGE_NAMESIZE && newname[i]; i++)
+            entry[5 + i] = (unsigned char) newname[i];
+        for (; i < IMAGE_NAMESIZE; i++)
+            entry[5 + i] = PAD;
+
+        Drive->disk.dirty = 1;
+        image_dos_set_status(Drive, 0, 0, 0);
+    }
+}
+
+/*! \brief Execute a command sent on the command channel
+
+ \param Drive
+   The drive.
+
+ \param Command
+   The command.
+
+ \param Length
+   The length of the command.
+*/
+void
+image_dos_execute(image_drive_t *Drive, const unsigned char *Command, size_t Length)
+{
+    const unsigned char *end;
+
+    /* the memory commands are binary, thus, only strip a CR from text commands */
+    if (Length > 0 && Command[Length - 1] == '\r' && !(Length > 1 && Command[0] == 'M' && Command[1] == '-'))
+        --Length;
+
+    if (Length == 0)
+        return;
+
+    end = Command + Length;
+
+    if (Length >= 3 && Command[1] == '-' && Command[0] == 'M')
+    {
+        memory_command(Drive, Command, Length);
+        return;
+    }
+
+    if (Length >= 3 && Command[1] == '-' && Command[0] == 'B')
+    {
+        switch (Command[2])
+        {
+        case 'R': case 'W': case 'P': case 'A': case 'F':
+            block_command(Drive, Command[2], 0, Command + 3, end);
+            break;
+
+        case 'E':
+            image_dos_set_status(Drive, 0, 0, 0);
+            break;
+
+        default:
+            image_dos_set_status(Drive, 31, 0, 0);
+            break;
+        }
+        return;
+    }
+
+    switch (Command[0])
+    {
+    case 'U':
+        if (Length < 2)
+        {
+            image_dos_set_status(Drive, 31, 0, 0);
+            break;
+        }
+
+        switch (Command[1])
+        {
+        case '1': case 'A':
+            block_command(Drive, 'R', 1, Command + 2, end);
+            break;
+
+        case '2': case 'B':
+            block_command(Drive, 'W', 1, Command + 2, end);
+            break;
+
+        case ':': case 'J':
+            image_dos_reset(Drive);
+            break;
+
+        default:
+            /* U0 (configuration), U3-U9 (jumps into the buffers, NMI) */
+            image_dos_set_status(Drive, 0, 0, 0);
+            break;
+        }
+        break;
+
+    case 'I':
+    case 'V':
+        image_dos_set_status(Drive, 0, 0, 0);
+        break;
+
+    case 'S':
+        scratch_command(Drive, Command, Length);
+        break;
+
+    case 'R':
+        rename_command(Drive, Command, Length);
+        break;
+
+    default:
+        image_dos_set_status(Drive, 31, 0, 0);
+        break;
+    }
+}
+
+/*! \brief Read data from a channel (TALK)
+
+ \param Drive
+   The drive.
+
+ \param Channel
+   The channel (secondary address) to read from.
+
+ \param Buffer
+   The buffer which gets the data.
+
+ \param Count
+   The maximum number of bytes to read.
+
+ \param Eoi
+   Set to 1 if the last byte was sent with EOI.
+
+ \return
+   The number of bytes read, or -1 if the channel is not open.
+*/
+int
+image_dos_read(image_drive_t *Drive, unsigned Channel, unsigned char *Buffer, size_t Count, int *Eoi)
+{
+    image_channel_t *ch;
+    size_t n = 0;
+
+    *Eoi = 0;
+    Channel &= 0x0f;
+
+    if (Channel == IMAGE_CMD_CHANNEL)
+    {
+        while (n < Count && Drive->status_pos < Drive->status_length)
+            Buffer[n++] = Drive->status[Drive->status_pos++];
+
+        if (Drive->status_pos >= Drive->status_length)
+        {
+            *Eoi = 1;
+            image_dos_set_status(Drive, 0, 0, 0);
+        }
+
+        return (int) n;
+    }
+
+    ch = &Drive->channel[Channel];
+
+    switch (ch->mode)
+    {
+    case IMAGE_CH_READ:
+        n = ch->length - ch->pos;
+        if (n > Count)
+            n = Count;
+
+        memcpy(Buffer, ch->data + ch->pos, n);
+        ch->pos += n;
+
+        if (ch->pos >= ch->length)
+            *Eoi = 1;
+        break;
+
+    case IMAGE_CH_DIRECT:
+        while (n < Count && !*Eoi)
+        {
+            Buffer[n++] = ch->data[ch->pos];
+
+            if (ch->pos == ch->eoi_pos)
+                *Eoi = 1;
+
+            ch->pos = (ch->pos + 1) % IMAGE_BLOCKSIZE;
+        }
+        break;
+
+    default:
+        image_dos_set_status(Drive, 61, 0, 0);
+        return -1;
+    }
+
+    return (int) n;
+}
+
+/*! \brief Write data to a channel (LISTEN)
+
+ \param Drive
+   The drive.
+
+ \param Channel
+   The channel (secondary address) to write to.
+
+ \param Buffer
+   The data to write.
+
+ \param Count
+   The number of bytes to write.
+
+ \return
+   The number of bytes written, or -1 if the channel is not open.
+*/
+int
+image_dos_write(image_drive_t *Drive, unsigned Channel, const unsigned char *Buffer, size_t Count)
+{
+    image_channel_t *ch;
+    size_t i;
+
+    Channel &= 0x0f;
+
+    if (Channel == IMAGE_CMD_CHANNEL)
+    {
+        for (i = 0; i < Count; i++)
+        {
+            if (Drive->command_length < IMAGE_CMDSIZE)
+                Drive->command[Drive->command_length++] = Buffer[i];
+            else
+                Drive->command_overflow = 1;
+        }
+        return (int) Count;
+    }
+
+    ch = &Drive->channel[Channel];
+
+    switch (ch->mode)
+    {
+    case IMAGE_CH_WRITE:
+        if (channel_append(ch, Buffer, Count))
+            return -1;
+        break;
+
+    case IMAGE_CH_DIRECT:
+        for (i = 0; i < Count; i++)
+        {
+            ch->data[ch->pos] = Buffer[i];
+            ch->pos = (ch->pos + 1) % IMAGE_BLOCKSIZE;
+        }
+        break;
+
+    default:
+        image_dos_set_status(Drive, 61, 0, 0);
+        return -1;
+    }
+
+    return (int) Count;
+}
+
+/*! \brief Reset the drive
+
+ All channels are closed without writing anything to
+ the disk, and the status shows the DOS version.
+
+ \param Drive
+   The drive to reset.
+*/
+void
+image_dos_reset(image_drive_t *Drive)
+{
+    unsigned channel;
+
+    for (channel = 0; channel < IMAGE_CHANNELS; channel++)
+        channel_free(&Drive->channel[channel]);
+
+    memset(Drive->ram, 0, sizeof(Drive->ram));
+
+    Drive->command_length = 0;
+    Drive->command_overflow = 0;
+
+    image_dos_set_status(Drive, 73, 0, 0);
+}
@@ -0,0 +1,857 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+*/
+
+/*! **************************************************************
+** \file lib/plugin/image/image.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Virtual IEC drive backed by a disk image: image file handling
+**
+** This file knows about the layout of .d64, .d71 and .d81 images:
+** the geometry, the BAM and the directory. It does not know anything
+** about the IEC bus or the DOS commands; this is in dos.c.
+**
+****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+
+/*! \brief the image sizes we know of */
+static const struct
+{
+    image_format_t format; /*!< the format of the image */
+    unsigned tracks;       /*!< the number of tracks */
+    size_t blocks;         /*!< the number of blocks */
+    int errors;            /*!< !=0: the image contains error info */
+} image_sizes[] =
+{
+    { IMAGE_D64, 35,  683, 0 },
+    { IMAGE_D64, 35,  683, 1 },
+    { IMAGE_D64, 40,  768, 0 },
+    { IMAGE_D64, 40,  768, 1 },
+    { IMAGE_D64, 42,  802, 0 },
+    { IMAGE_D64, 42,  802, 1 },
+    { IMAGE_D71, 70, 1366, 0 },
+    { IMAGE_D71, 70, 1366, 1 },
+    { IMAGE_D81, 80, 3200, 0 },
+    { IMAGE_D81, 80, 3200, 1 }
+};
+
+/*! \brief Get the number of sectors of a track
+
+ \param Disk
+   The disk image.
+
+ \param Track
+   The track number, starting with 1.
+
+ \return
+   The number of sectors on that track, 0 if the track does not exist.
+*/
+unsigned
+image_sectors(const image_disk_t *Disk, unsigned Track)
+{
+    if (Track < 1 || Track > Disk->tracks)
+        return 0;
+
+    if (Disk->format == IMAGE_D81)
+        return 40;
+
+    if (Disk->format == IMAGE_D71 && Track > 35)
+        Track -= 35;
+
+    return Track < 18 ? 21 : Track < 25 ? 19 : Track < 31 ? 18 : 17;
+}
+
+/*! \brief Get a pointer to the contents of a block
+
+ \param Disk
+   The disk image.
+
+ \param Track
+   The track number of the block.
+
+ \param Sector
+   The sector number of the block.
+
+ \return
+   A pointer to the 256 bytes of the block, or NULL if
+   the block does not exist.
+*/
+unsigned char *
+image_block(image_disk_t *Disk, unsigned Track, unsigned Sector)
+{
+    if (Sector >= image_sectors(Disk, Track))
+        return NULL;
+
+    return Disk->data + (size_t) (Disk->block_offset[Track] + Sector) * IMAGE_BLOCKSIZE;
+}
+
+/*! \brief Get the DOS error code which the error info records for a block
+
+ \param Disk
+   The disk image.
+
+ \param Track
+   The track number of the block.
+
+ \param Sector
+   The sector number of the block.
+
+ \return
+   0 if the block can be read without error, else the
+   DOS error code (20-29) which the drive would report.
+*/
+int
+image_block_error(const image_disk_t *Disk, unsigned Track, unsigned Sector)
+{
+    static const unsigned char error_codes[] =
+    {
+        0, 0, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29
+    };
+
+    unsigned char code;
+
+    if (Disk->errors == NULL || Sector >= image_sectors(Disk, Track))
+        return 0;
+
+    code = Disk->errors[Disk->block_offset[Track] + Sector];
+
+    return code < sizeof(error_codes) ? error_codes[code] : 0;
+}
+
+/*! \internal \brief Get the BAM entry of a track
+
+ \param Disk
+   The disk image.
+
+ \param Track
+   The track for which the BAM entry is to be found.
+
+ \param Bitmap
+   Pointer to a variable which will get the address of
+   the allocation bitmap of the track.
+
+ \return
+   The address of the free block counter of the track,
+   or NULL if the track is not recorded in the BAM.
+*/
+static unsigned char *
+bam_entry(image_disk_t *Disk, unsigned Track, unsigned char **Bitmap)
+{
+    unsigned char *bam;
+
+    if (Track < 1 || Track > Disk->tracks)
+        return NULL;
+
+    switch (Disk->format)
+    {
+    case IMAGE_D81:
+        bam = image_block(Disk, 40, Track <= 40 ? 1 : 2) + 0x10 + 6 * ((Track - 1) % 40);
+        *Bitmap = bam + 1;
+        return bam;
+
+    case IMAGE_D71:
+        if (Track > 35)
+        {
+            *Bitmap = image_block(Disk, 53, 0) + 3 * (Track - 36);
+            return image_block(Disk, 18, 0) + 0xdd + (Track - 36);
+        }
+        break;
+
+    default:
+        /* there is no common standard for the BAM of tracks 36-42 */
+        if (Track > 35)
+            return NULL;
+        break;
+    }
+
+    bam = image_block(Disk, 18, 0) + 4 * Track;
+    *Bitmap = bam + 1;
+    return bam;
+}
+
+/*! \brief Check if a block is free in the BAM
+
+ \return
+   1 if the block is free, 0 if it is allocated or not
+   managed by the BAM.
+*/
+int
+image_bam_is_free(image_disk_t *Disk, unsigned Track, unsigned Sector)
+{
+    unsigned char *bitmap;
+
+    if (Sector >= image_sectors(Disk, Track) || bam_entry(Disk, Track, &bitmap) == NULL)
+        return 0;
+
+    return (bitmap[Sector >> 3] >> (Sector & 7)) & 1;
+}
+
+/*! \brief Mark a block as allocated in the BAM
+
+ \return
+   0 on success, 1 if the block was not free.
+*/
+int
+image_bam_allocate(image_disk_t *Disk, unsigned Track, unsigned Sector)
+{
+    unsigned char *bitmap = NULL;
+    unsigned char *count;
+
+    if (!image_bam_is_free(Disk, Track, Sector))
+        return 1;
+
+    count = bam_entry(Disk, Track, &bitmap);
+    if (count == NULL)
+        return 1;
+
+    bitmap[Sector >> 3] &= ~(1 << (Sector & 7));
+    --*count;
+    Disk->dirty = 1;
+
+    return 0;
+}
+
+/*! \brief Mark a block as free in the BAM
+
+ \return
+   0 on success, 1 if the block was already free or
+   does not exist.
+*/
+int
+image_bam_free(image_disk_t *Disk, unsigned Track, unsigned Sector)
+{
+    unsigned char *bitmap;
+    unsigned char *count;
+
+    if (Sector >= image_sectors(Disk, Track) || image_bam_is_free(Disk, Track, Sector))
+        return 1;
+
+    count = bam_entry(Disk, Track, &bitmap);
+    if (count == NULL)
+        return 1;
+
+    bitmap[Sector >> 3] |= 1 << (Sector & 7);
+    ++*count;
+    Disk->dirty = 1;
+
+    return 0;
+}
+
+/*! \internal \brief Check if a track is reserved for the directory */
+static int
+is_system_track(const image_disk_t *Disk, unsigned Track)
+{
+    return Track == Disk->dir_track || (Disk->format == IMAGE_D71 && Track == 53);
+}
+
+/*! \brief Get the number of free blocks, as the DOS reports it
+
+ \return
+   The number of free blocks outside of the directory track.
+*/
+unsigned
+image_blocks_free(image_disk_t *Disk)
+{
+    unsigned char *bitmap;
+    unsigned char *count;
+    unsigned track;
+    unsigned free_blocks = 0;
+
+    for (track = 1; track <= Disk->tracks; track++)
+    {
+        if (is_system_track(Disk, track))
+            continue;
+
+        count = bam_entry(Disk, track, &bitmap);
+        if (count != NULL)
+            free_blocks += *count;
+    }
+
+    return free_blocks;
+}
+
+/*! \brief Find a free block for writing a file
+
+ The search starts on the tracks nearest to the directory
+ track; if Track is not 0 on entry, the track and sector
+ given are the previous block of the file, and the next
+ block is searched with the interleave of the drive.
+
+ \param Disk
+   The disk image.
+
+ \param Track
+   Pointer to the previous track (or 0). Gets the track
+   of the free block.
+
+ \param Sector
+   Pointer to the previous sector. Gets the sector
+   of the free block.
+
+ \return
+   0 if a free block was found, 1 if the disk is full.
+
+ \remark
+   The block is not allocated; use image_bam_allocate()
+   for this.
+*/
+int
+image_find_free_block(image_disk_t *Disk, unsigned *Track, unsigned *Sector)
+{
+    unsigned distance;
+    unsigned n;
+    unsigned i;
+
+    if (*Track != 0 && !is_system_track(Disk, *Track))
+    {
+        n = image_sectors(Disk, *Track);
+
+        for (i = 0; i < n; i++)
+        {
+            unsigned sector = (*Sector + Disk->interleave + i) % n;
+
+            if (image_bam_is_free(Disk, *Track, sector))
+            {
+                *Sector = sector;
+                return 0;
+            }
+        }
+    }
+
+    for (distance = 1; distance <= Disk->tracks; distance++)
+    {
+        unsigned candidate[2];
+        unsigned c;
+
+        candidate[0] = Disk->dir_track > distance ? Disk->dir_track - distance : 0;
+        candidate[1] = Disk->dir_track + distance;
+
+        for (c = 0; c < 2; c++)
+        {
+            unsigned track = candidate[c];
+
+            if (track == 0 || track > Disk->tracks || is_system_track(Disk, track))
+                continue;
+
+            n = image_sectors(Disk, track);
+            for (i = 0; i < n; i++)
+            {
+                if (image_bam_is_free(Disk, track, i))
+                {
+                    *Track = track;
+                    *Sector = i;
+                    return 0;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+/*! \brief Get the disk name and id
+
+ \param Disk
+   The disk image.
+
+ \param Id
+   Pointer to a variable which gets the address of the
+   5 bytes of the disk id (including the DOS type).
+
+ \return
+   The address of the 16 bytes of the disk name.
+*/
+const unsigned char *
+image_disk_name(image_disk_t *Disk, const unsigned char **Id)
+{
+    const unsigned char *header;
+
+    if (Disk->format == IMAGE_D81)
+    {
+        header = image_block(Disk, 40, 0);
+        *Id = header + 0x16;
+        return header + 0x04;
+    }
+
+    header = image_block(Disk, 18, 0);
+    *Id = header + 0xa2;
+    return header + 0x90;
+}
+
+/*! \brief Iterate over the directory entries
+
+ \param Disk
+   The disk image.
+
+ \param Track
+   Pointer to the track of the current directory block.
+   Set *Track to 0 to start with the first entry.
+
+ \param Sector
+   Pointer to the sector of the current directory block.
+
+ \param Index
+   Pointer to the index of the current entry.
+
+ \return
+   The address of the 32 byte directory entry, or NULL
+   if there are no more entries. The file type is at
+   offset 2 of the entry.
+*/
+unsigned char *
+image_dir_next(image_disk_t *Disk, unsigned *Track, unsigned *Sector, unsigned *Index)
+{
+    unsigned char *block;
+
+    if (*Track == 0)
+    {
+        *Track = Disk->dir_track;
+        *Sector = Disk->format == IMAGE_D81 ? 3 : 1;
+        *Index = 0;
+    }
+    else if (++*Index % 8 == 0)
+    {
+        block = image_block(Disk, *Track, *Sector);
+
+        /* stop at the end of the chain, and on circular chains */
+        if (block == NULL || block[0] == 0 || *Index >= 8 * IMAGE_BLOCKSIZE)
+            return NULL;
+
+        *Track = block[0];
+        *Sector = block[1];
+    }
+
+    block = image_block(Disk, *Track, *Sector);
+
+    return block ? block + 32 * (*Index % 8) : NULL;
+}
+
+/*! \brief Get an unused directory entry
+
+ If all directory blocks are full, a new block on the
+ directory track is appended to the directory.
+
+ \return
+   The address of the 32 byte directory entry, or NULL
+   if the directory is full.
+*/
+unsigned char *
+image_dir_new_entry(image_disk_t *Disk)
+{
+    unsigned char *entry;
+    unsigned char *last;
+    unsigned char *block;
+    unsigned track = 0;
+    unsigned sector = 0;
+    unsigned index = 0;
+    unsigned last_track = 0;
+    unsigned last_sector = 0;
+
+    while ((entry = image_dir_next(Disk, &track, &sector, &index)) != NULL)
+    {
+        if (entry[2] == 0)
+            return entry;
+
+        last_track = track;
+        last_sector = sector;
+    }
+
+    last = image_block(Disk, last_track, last_sector);
+    if (last == NULL)
+        return NULL;
+
+    /* the directory must stay on the directory track,
+     * which image_find_free_block() never returns */
+    track = Disk->dir_track;
+
+    for (sector = 0; sector < image_sectors(Disk, track); sector++)
+        if (image_bam_is_free(Disk, track, sector))
+            break;
+
+    if (sector == image_sectors(Disk, track))
+        return NULL;
+
+    image_bam_allocate(Disk, track, sector);
+
+    block = image_block(Disk, track, sector);
+    memset(block, 0, IMAGE_BLOCKSIZE);
+    block[1] = 0xff;
+
+    last[0] = (unsigned char) track;
+    last[1] = (unsigned char) sector;
+
+    Disk->dirty = 1;
+
+    return block;
+}
+
+/*! \brief Read a file which is stored as a chain of blocks
+
+ \param Disk
+   The disk image.
+
+ \param Track
+   The track of the first block of the file.
+
+ \param Sector
+   The sector of the first block of the file.
+
+ \param Data
+   Pointer to a variable which gets the malloc()ed file
+   contents. The caller has to free() it.
+
+ \param Length
+   Pointer to a variable which gets the length of the file.
+
+ \param ErrTrack
+   Pointer to a variable which gets the track where an
+   error occurred.
+
+ \param ErrSector
+   Pointer to a variable which gets the sector where an
+   error occurred.
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+image_read_chain(image_disk_t *Disk, unsigned Track, unsigned Sector,
+                 unsigned char **Data, size_t *Length,
+                 unsigned *ErrTrack, unsigned *ErrSector)
+{
+    unsigned char *block;
+    unsigned char *data = NULL;
+    size_t length = 0;
+    size_t allocated = 0;
+    unsigned count = 0;
+    int error = 0;
+
+    while (Track != 0)
+    {
+        size_t used;
+
+        block = image_block(Disk, Track, Sector);
+
+        if (block == NULL || ++count > Disk->blocks)
+        {
+            error = 66;
+            break;
+        }
+
+        error = image_block_error(Disk, Track, Sector);
+        if (error)
+            break;
+
+        used = block[0] ? IMAGE_BLOCKSIZE - 2 : (block[1] > 1 ? block[1] - 1 : 0);
+
+        if (length + used > allocated)
+        {
+            unsigned char *p;
+
+            allocated = allocated ? 2 * allocated : 16 * (IMAGE_BLOCKSIZE - 2);
+            p = realloc(data, allocated);
+            if (p == NULL)
+            {
+                error = 70;
+                break;
+            }
+            data = p;
+        }
+
+        memcpy(data + length, block + 2, used);
+        length += used;
+
+        Track = block[0];
+        Sector = block[1];
+    }
+
+    if (error)
+    {
+        free(data);
+        data = NULL;
+        length = 0;
+        *ErrTrack = Track;
+        *ErrSector = Sector;
+    }
+
+    *Data = data;
+    *Length = length;
+
+    return error;
+}
+
+/*! \brief Write a file as a chain of blocks
+
+ \param Disk
+   The disk image.
+
+ \param Data
+   The contents of the file.
+
+ \param Length
+   The length of the file.
+
+ \param Track
+   Pointer to a variable which gets the track of the first block.
+
+ \param Sector
+   Pointer to a variable which gets the sector of the first block.
+
+ \param Blocks
+   Pointer to a variable which gets the number of blocks used.
+
+ \return
+   0 on success, else the DOS error code.
+*/
+int
+image_write_chain(image_disk_t *Disk, const unsigned char *Data, size_t Length,
+                  unsigned *Track, unsigned *Sector, unsigned *Blocks)
+{
+    unsigned char (*chain)[2];
+    unsigned blocks;
+    unsigned track = 0;
+    unsigned sector = 0;
+    unsigned i;
+
+    blocks = Length ? (unsigned) ((Length + IMAGE_BLOCKSIZE - 3) / (IMAGE_BLOCKSIZE - 2)) : 1;
+
+    if (blocks > image_blocks_free(Disk))
+        return 72;
+
+    chain = malloc(blocks * sizeof(*chain));
+    if (chain == NULL)
+        return 70;
+
+    for (i = 0; i < blocks; i++)
+    {
+        if (image_find_free_block(Disk, &track, &sector))
+        {
+            while (i-- > 0)
+                image_bam_free(Disk, chain[i][0], chain[i][1]);
+
+            free(chain);
+            return 72;
+        }
+
+        image_bam_allocate(Disk, track, sector);
+        chain[i][0] = (unsigned char) track;
+        chain[i][1] = (unsigned char) sector;
+    }
+
+    for (i = 0; i < blocks; i++)
+    {
+        unsigned char *block = image_block(Disk, chain[i][0], chain[i][1]);
+        size_t used = Length > IMAGE_BLOCKSIZE - 2 ? IMAGE_BLOCKSIZE - 2 : Length;
+
+        memset(block, 0, IMAGE_BLOCKSIZE);
+
+        if (i + 1 < blocks)
+        {
+            block[0] = chain[i + 1][0];
+            block[1] = chain[i + 1][1];
+        }
+        else
+        {
+            block[0] = 0;
+            block[1] = (unsigned char) (used + 1);
+        }
+
+        memcpy(block + 2, Data, used);
+        Data += used;
+        Length -= used;
+    }
+
+    *Track = chain[0][0];
+    *Sector = chain[0][1];
+    *Blocks = blocks;
+
+    free(chain);
+
+    Disk->dirty = 1;
+
+    return 0;
+}
+
+/*! \brief Free all blocks of a file in the BAM
+
+ \param Disk
+   The disk image.
+
+ \param Track
+   The track of the first block of the file.
+
+ \param Sector
+   The sector of the first block of the file.
+*/
+void
+image_free_chain(image_disk_t *Disk, unsigned Track, unsigned Sector)
+{
+    unsigned count = 0;
+
+    while (Track != 0 && ++count <= Disk->blocks)
+    {
+        unsigned char *block = image_block(Disk, Track, Sector);
+
+        if (block == NULL)
+            break;
+
+        image_bam_free(Disk, Track, Sector);
+
+        Track = block[0];
+        Sector = block[1];
+    }
+}
+
+/*! \brief Load a disk image into memory
+
+ \param Disk
+   The disk image structure to fill in.
+
+ \param Path
+   The name of the image file. The format is determined
+   by the size of the file.
+
+ \return
+   0 on success, else an error occurred.
+*/
+int
+image_disk_load(image_disk_t *Disk, const char *Path)
+{
+    FILE *f;
+    long size;
+    unsigned i;
+    unsigned track;
+
+    memset(Disk, 0, sizeof(*Disk));
+
+    f = fopen(Path, "r+b");
+    if (f == NULL)
+    {
+        f = fopen(Path, "rb");
+        Disk->readonly = 1;
+    }
+
+    if (f == NULL)
+    {
+        fprintf(stderr, "image: cannot open '%s'\n", Path);
+        return 1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    for (i = 0; i < sizeof(image_sizes) / sizeof(image_sizes[0]); i++)
+    {
+        size_t expected = image_sizes[i].blocks * (IMAGE_BLOCKSIZE + (image_sizes[i].errors ? 1 : 0));
+
+        if (size >= 0 && (size_t) size == expected)
+            break;
+    }
+
+    if (i == sizeof(image_sizes) / sizeof(image_sizes[0]))
+    {
+        fprintf(stderr, "image: '%s' has an unknown size of %ld bytes\n", Path, size);
+        fclose(f);
+        return 1;
+    }
+
+    Disk->format = image_sizes[i].format;
+    Disk->tracks = image_sizes[i].tracks;
+    Disk->blocks = (unsigned) image_sizes[i].blocks;
+    Disk->size = (size_t) size;
+    Disk->data = malloc(Disk->size);
+    Disk->path = malloc(strlen(Path) + 1);
+
+    if (Disk->data == NULL || Disk->path == NULL
+        || fread(Disk->data, 1, Disk->size, f) != Disk->size)
+    {
+        fprintf(stderr, "image: cannot read '%s'\n", Path);
+        fclose(f);
+        image_disk_free(Disk);
+        return 1;
+    }
+
+    fclose(f);
+
+    strcpy(Disk->path, Path);
+
+    if (image_sizes[i].errors)
+        Disk->errors = Disk->data + (size_t) Disk->blocks * IMAGE_BLOCKSIZE;
+
+    Disk->block_offset[1] = 0;
+    for (track = 1; track <= Disk->tracks; track++)
+        Disk->block_offset[track + 1] = Disk->block_offset[track] + image_sectors(Disk, track);
+
+    if (Disk->format == IMAGE_D81)
+    {
+        Disk->dir_track = 40;
+        Disk->interleave = 1;
+    }
+    else
+    {
+        Disk->dir_track = 18;
+        Disk->interleave = 10;
+    }
+
+    return 0;
+}
+
+/*! \brief Write a disk image back to its file, if it was changed
+
+ \return
+   0 on success, else an error occurred.
+*/
+int
+image_disk_save(image_disk_t *Disk)
+{
+    FILE *f;
+    int error = 0;
+
+    if (!Disk->dirty || Disk->readonly || Disk->data == NULL)
+        return 0;
+
+    f = fopen(Disk->path, "r+b");
+    if (f == NULL)
+        return 1;
+
+    if (fwrite(Disk->data, 1, Disk->size, f) != Disk->size)
+        error = 1;
+
+    if (fclose(f) != 0)
+        error = 1;
+
+    if (error)
+        fprintf(stderr, "image: cannot write back '%s'\n", Disk->path);
+    else
+        Disk->dirty = 0;
+
+    return error;
+}
+
+/*! \brief Free the memory of a disk image
+
+ \remark
+   The image is not written back; use image_disk_save() for this.
+*/
+void
+image_disk_free(image_disk_t *Disk)
+{
+    free(Disk->data);
+    free(Disk->path);
+
+    Disk->data = NULL;
+    Disk->path = NULL;
+    Disk->errors = NULL;
+}
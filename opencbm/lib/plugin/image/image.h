@@ -0,0 +1,162 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+*/
+
+/*! **************************************************************
+** \file lib/plugin/image/image.h \n
+** \author OpenCBM team \n
+** \n
+** \brief Virtual IEC drive backed by a disk image: internal definitions
+**
+****************************************************************/
+
+#ifndef OPENCBM_PLUGIN_IMAGE_H
+#define OPENCBM_PLUGIN_IMAGE_H
+
+#include <stddef.h>
+
+/*! the number of bytes in a block */
+#define IMAGE_BLOCKSIZE     256
+
+/*! the maximum number of tracks any supported image can have */
+#define IMAGE_MAX_TRACKS    80
+
+/*! the number of channels (secondary addresses) of one drive */
+#define IMAGE_CHANNELS      16
+
+/*! the secondary address of the command and status channel */
+#define IMAGE_CMD_CHANNEL   15
+
+/*! the size of the emulated drive RAM ($0000-$07FF) */
+#define IMAGE_RAMSIZE       0x800
+
+/*! the size of the command buffer. The real drives only
+ * have 42 bytes; we are a little bit more generous */
+#define IMAGE_CMDSIZE       128
+
+/*! the maximum length of a CBM file name */
+#define IMAGE_NAMESIZE      16
+
+/*! the highest device address on the IEC bus */
+#define IMAGE_MAX_UNIT      30
+
+/*! \brief the formats of the images we can serve */
+typedef enum image_format_e
+{
+    IMAGE_D64,  /*!< 1541 image, 35, 40 or 42 tracks */
+    IMAGE_D71,  /*!< 1571 image, 70 tracks */
+    IMAGE_D81   /*!< 1581 image, 80 tracks with 40 sectors */
+} image_format_t;
+
+/*! \brief a disk image which is held in memory */
+typedef struct image_disk_s
+{
+    image_format_t format;   /*!< the format of this image */
+    char *path;              /*!< the file the image was loaded from */
+    unsigned char *data;     /*!< the image contents, including error info */
+    size_t size;             /*!< the size of data[], in bytes */
+    unsigned tracks;         /*!< the number of tracks */
+    unsigned blocks;         /*!< the number of blocks */
+    unsigned char *errors;   /*!< the error info bytes, or NULL if there are none */
+
+    /*! the block number of sector 0 of every track, track 1 is index 1 */
+    unsigned block_offset[IMAGE_MAX_TRACKS + 2];
+
+    unsigned char dir_track; /*!< the directory track */
+    unsigned char interleave; /*!< the interleave used when writing files */
+    int readonly;            /*!< the image file could only be opened for reading */
+    int dirty;               /*!< the image was changed and must be written back */
+} image_disk_t;
+
+/*! \brief the usage of one channel of a drive */
+typedef enum image_channel_mode_e
+{
+    IMAGE_CH_FREE,   /*!< the channel is not open */
+    IMAGE_CH_READ,   /*!< a file (or the directory) is read */
+    IMAGE_CH_WRITE,  /*!< a file is written */
+    IMAGE_CH_DIRECT  /*!< a direct access buffer ("#") */
+} image_channel_mode_t;
+
+/*! \brief one channel of a drive */
+typedef struct image_channel_s
+{
+    image_channel_mode_t mode; /*!< the usage of this channel */
+
+    unsigned char *data;     /*!< the file contents, or the direct access buffer */
+    size_t length;           /*!< the number of valid bytes in data[] */
+    size_t allocated;        /*!< the number of bytes allocated for data[] */
+    size_t pos;              /*!< the current read or write position */
+    size_t eoi_pos;          /*!< IMAGE_CH_DIRECT: send EOI with this byte */
+
+    char name[IMAGE_NAMESIZE + 1]; /*!< IMAGE_CH_WRITE: the name of the file */
+    unsigned char filetype;  /*!< IMAGE_CH_WRITE: the CBM file type */
+    int replace;             /*!< IMAGE_CH_WRITE: "@:" was given */
+} image_channel_t;
+
+/*! \brief the state of one virtual drive */
+typedef struct image_drive_s
+{
+    unsigned char unit;      /*!< the device address */
+    image_disk_t disk;       /*!< the disk in the drive */
+
+    image_channel_t channel[IMAGE_CHANNELS]; /*!< the channels */
+
+    /*! the data of the status channel; M-R can return up to 255 bytes */
+    unsigned char status[IMAGE_BLOCKSIZE + 1];
+    size_t status_length;    /*!< the number of valid bytes in status[] */
+    size_t status_pos;       /*!< the read position in status[] */
+
+    unsigned char command[IMAGE_CMDSIZE]; /*!< the command which is sent */
+    size_t command_length;   /*!< the number of valid bytes in command[] */
+    int command_overflow;    /*!< more than IMAGE_CMDSIZE bytes were sent */
+
+    unsigned char ram[IMAGE_RAMSIZE]; /*!< the drive RAM, for M-R and M-W */
+
+    unsigned long blocks_accessed; /*!< the number of blocks read or written */
+} image_drive_t;
+
+/* image.c */
+
+extern int  image_disk_load(image_disk_t *Disk, const char *Path);
+extern int  image_disk_save(image_disk_t *Disk);
+extern void image_disk_free(image_disk_t *Disk);
+
+extern unsigned image_sectors(const image_disk_t *Disk, unsigned Track);
+extern unsigned char *image_block(image_disk_t *Disk, unsigned Track, unsigned Sector);
+extern int  image_block_error(const image_disk_t *Disk, unsigned Track, unsigned Sector);
+
+extern int  image_bam_is_free(image_disk_t *Disk, unsigned Track, unsigned Sector);
+extern int  image_bam_allocate(image_disk_t *Disk, unsigned Track, unsigned Sector);
+extern int  image_bam_free(image_disk_t *Disk, unsigned Track, unsigned Sector);
+extern unsigned image_blocks_free(image_disk_t *Disk);
+extern int  image_find_free_block(image_disk_t *Disk, unsigned *Track, unsigned *Sector);
+
+extern const unsigned char *image_disk_name(image_disk_t *Disk, const unsigned char **Id);
+extern unsigned char *image_dir_next(image_disk_t *Disk, unsigned *Track, unsigned *Sector, unsigned *Index);
+extern unsigned char *image_dir_new_entry(image_disk_t *Disk);
+
+extern int  image_read_chain(image_disk_t *Disk, unsigned Track, unsigned Sector,
+                             unsigned char **Data, size_t *Length,
+                             unsigned *ErrTrack, unsigned *ErrSector);
+extern int  image_write_chain(image_disk_t *Disk, const unsigned char *Data, size_t Length,
+                              unsigned *Track, unsigned *Sector, unsigned *Blocks);
+extern void image_free_chain(image_disk_t *Disk, unsigned Track, unsigned Sector);
+
+/* dos.c */
+
+extern void image_dos_reset(image_drive_t *Drive);
+extern void image_dos_set_status(image_drive_t *Drive, int Code, unsigned Track, unsigned Sector);
+
+extern int  image_dos_open(image_drive_t *Drive, unsigned Channel, const unsigned char *Name, size_t Length);
+extern void image_dos_close(image_drive_t *Drive, unsigned Channel);
+extern void image_dos_execute(image_drive_t *Drive, const unsigned char *Command, size_t Length);
+
+extern int  image_dos_read(image_drive_t *Drive, unsigned Channel, unsigned char *Buffer, size_t Count, int *Eoi);
+extern int  image_dos_write(image_drive_t *Drive, unsigned Channel, const unsigned char *Buffer, size_t Count);
+
+#endif /* #ifndef OPENCBM_PLUGIN_IMAGE_H */
@@ -0,0 +1,989 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file lib/plugin/opencbmd/archlib.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Client of the opencbmd daemon: the plugin interface
+**
+** This plugin does not talk to an adapter itself. Instead, it forwards
+** all calls to opencbmd, which has opened the adapter once and shares
+** it among all of its clients. Thus, the programs do not pay for
+** opening and initialising the adapter, and programs which run at the
+** same time do not collide on the bus.
+**
+** The socket of the daemon is given as port of the adapter, or in an
+** environment variable:
+**
+**   -@ opencbmd                       OPENCBMD_SOCKET, or /tmp/opencbmd.socket
+**   -@ opencbmd:/run/opencbmd.socket  the daemon listening on this socket
+**
+** The asynchronous transfer functions send their requests without
+** waiting for the replies; thus, the daemon always has the next
+** request at hand when the adapter has finished the previous one.
+**
+****************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+//! mark: We are building the DLL */
+#define OPENCBM_PLUGIN
+#include "archlib.h"
+
+#include "arch.h"
+
+#include "opencbmd.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0 /*!< not available; SO_NOSIGPIPE is used instead */
+#endif
+
+/*! \brief the maximum number of asynchronous transfers in flight */
+#define OPENCBMD_MAX_PENDING 16
+
+/*! \brief an asynchronous transfer which has been sent to the daemon */
+typedef struct opencbmd_pending_s
+{
+    unsigned char *Data;                 /*!< reads: the buffer for the data, else NULL */
+    unsigned int Size;                   /*!< reads: the size of Data */
+    opencbm_plugin_async_cb_t *Callback; /*!< called on completion, can be NULL */
+    void *Context;                       /*!< given to Callback */
+} opencbmd_pending_t;
+
+/*! \brief the connection to the daemon; this is what the CBM_FILE points to */
+typedef struct opencbmd_connection_s
+{
+    int Socket;                          /*!< the socket connected to the daemon */
+    int Broken;                          /*!< the connection failed; all further calls fail */
+    unsigned int Pending;                /*!< the number of asynchronous transfers in flight */
+    unsigned int First;                  /*!< the index of the oldest of them in Queue */
+    opencbmd_pending_t Queue[OPENCBMD_MAX_PENDING]; /*!< the asynchronous transfers in flight */
+} opencbmd_connection_t;
+
+/*! \internal \brief Get the name of the socket of the daemon
+
+ \param Port
+   The port of the adapter, can be NULL.
+
+ \return
+   The name, or NULL if there is neither a name nor $XDG_RUNTIME_DIR.
+*/
+static const char *
+connection_path(const char *Port)
+{
+    static char default_path[260];
+    const char *path = Port;
+    const char *dir;
+
+    if (path == NULL || *path == '\0')
+        path = getenv(OPENCBMD_SOCKET_ENVIRONMENT);
+
+    if (path == NULL || *path == '\0')
+    {
+        dir = getenv("XDG_RUNTIME_DIR");
+        if (dir == NULL || *dir == '\0')
+            return NULL;
+
+        arch_snprintf(default_path, sizeof(default_path), "%s/%s", dir, OPENCBMD_DEFAULT_SOCKET_NAME);
+        path = default_path;
+    }
+
+    return path;
+}
+
+/*! \internal \brief Mark the connection as broken
+
+ \return
+   -1, for convenience.
+*/
+static int
+connection_broken(opencbmd_connection_t *Connection)
+{
+    if (!Connection->Broken)
+        fprintf(stderr, "opencbmd: the connection to the daemon is broken\n");
+
+    Connection->Broken = 1;
+    return -1;
+}
+
+/*! \internal \brief Send exactly Length bytes
+
+ \return
+   0 on success, -1 on error.
+*/
+static int
+connection_send(opencbmd_connection_t *Connection, const void *Buffer, size_t Length)
+{
+    const unsigned char *p = Buffer;
+
+    while (Length > 0)
+    {
+        ssize_t n = send(Connection->Socket, p, Length, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return connection_broken(Connection);
+
+        p += n;
+        Length -= n;
+    }
+
+    return 0;
+}
+
+/*! \internal \brief Receive exactly Length bytes
+
+ \param Buffer
+   The buffer; if NULL, the bytes are discarded.
+
+ \return
+   0 on success, -1 on error.
+*/
+static int
+connection_receive(opencbmd_connection_t *Connection, void *Buffer, size_t Length)
+{
+    unsigned char *p = Buffer;
+    unsigned char discard[256];
+
+    while (Length > 0)
+    {
+        size_t chunk = p ? Length : (Length < sizeof(discard) ? Length : sizeof(discard));
+        ssize_t n = recv(Connection->Socket, p ? p : discard, chunk, 0);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return connection_broken(Connection);
+
+        if (p)
+            p += n;
+        Length -= n;
+    }
+
+    return 0;
+}
+
+/*! \internal \brief Send a request, do not wait for the reply
+
+ \return
+   0 on success, -1 on error.
+*/
+static int
+connection_send_request(opencbmd_connection_t *Connection, unsigned int Command,
+    int Arg1, int Arg2, const void *Data, unsigned int Length)
+{
+    opencbmd_request_t request;
+
+    if (Connection->Broken)
+        return -1;
+
+    request.Command = Command;
+    request.Arg1 = Arg1;
+    request.Arg2 = Arg2;
+    request.Length = Length;
+
+    if (connection_send(Connection, &request, sizeof(request)) != 0)
+        return -1;
+
+    return Length > 0 ? connection_send(Connection, Data, Length) : 0;
+}
+
+/*! \internal \brief Receive the reply to the oldest request
+
+ \param Out
+   The buffer for the data of the reply; the data which does not fit
+   into it is discarded.
+
+ \param OutLength
+   The size of Out.
+
+ \return
+   The result of the request; -1 on error.
+*/
+static int
+connection_receive_reply(opencbmd_connection_t *Connection, void *Out, unsigned int OutLength)
+{
+    opencbmd_reply_t reply;
+    unsigned int length;
+
+    if (Connection->Broken || connection_receive(Connection, &reply, sizeof(reply)) != 0)
+        return -1;
+
+    length = reply.Length < OutLength ? reply.Length : OutLength;
+
+    if (connection_receive(Connection, Out, length) != 0
+        || connection_receive(Connection, NULL, reply.Length - length) != 0)
+        return -1;
+
+    return reply.Result;
+}
+
+/*! \internal \brief Wait for the asynchronous transfers
+
+ \param Pending
+   Return as soon as no more than this number of transfers is in flight.
+
+ \return
+   0 if all completed transfers succeeded, -1 if not.
+*/
+static int
+connection_wait(opencbmd_connection_t *Connection, unsigned int Pending)
+{
+    int ret = 0;
+
+    while (Connection->Pending > Pending)
+    {
+        opencbmd_pending_t *pending = &Connection->Queue[Connection->First];
+        int result = connection_receive_reply(Connection, pending->Data, pending->Data ? pending->Size : 0);
+
+        Connection->First = (Connection->First + 1) % OPENCBMD_MAX_PENDING;
+        Connection->Pending--;
+
+        if (result < 0)
+            ret = -1;
+
+        if (pending->Callback)
+            pending->Callback(pending->Context, result);
+    }
+
+    return ret;
+}
+
+/*! \internal \brief Execute a request and wait for its reply
+
+ The asynchronous transfers which are still in flight are completed
+ before, as the replies arrive in order.
+
+ \param Data
+   The data of the request.
+
+ \param Length
+   The length of Data.
+
+ \param Out
+   The buffer for the data of the reply, can be NULL.
+
+ \param OutLength
+   The size of Out.
+
+ \return
+   The result of the request; -1 on error.
+*/
+static int
+connection_call(CBM_FILE HandleDevice, unsigned int Command, int Arg1, int Arg2,
+    const void *Data, unsigned int Length, void *Out, unsigned int OutLength)
+{
+    opencbmd_connection_t *connection = (opencbmd_connection_t *) HandleDevice;
+
+    connection_wait(connection, 0);
+
+    if (connection_send_request(connection, Command, Arg1, Arg2, Data, Length) != 0)
+        return -1;
+
+    return connection_receive_reply(connection, Out, OutLength);
+}
+
+/*! \internal \brief Execute a request without data */
+static int
+connection_simple(CBM_FILE HandleDevice, unsigned int Command, int Arg1, int Arg2)
+{
+    return connection_call(HandleDevice, Command, Arg1, Arg2, NULL, 0, NULL, 0);
+}
+
+/*! \internal \brief Queue an asynchronous transfer
+
+ \return
+   0 if the transfer has been sent, -1 on error.
+*/
+static int
+connection_queue(CBM_FILE HandleDevice, unsigned int Protocol, int Write,
+    const unsigned char *Data, unsigned int Size,
+    opencbm_plugin_async_cb_t *Callback, void *Context)
+{
+    opencbmd_connection_t *connection = (opencbmd_connection_t *) HandleDevice;
+    opencbmd_pending_t *pending;
+    int error;
+
+    if (Protocol > OPENCBM_PROTOCOL_PP_CC)
+        return -1;
+
+    if (connection->Pending == OPENCBMD_MAX_PENDING)
+        connection_wait(connection, OPENCBMD_MAX_PENDING - 1);
+
+    if (Protocol == OPENCBM_PROTOCOL_CBM)
+        error = Write
+            ? connection_send_request(connection, OPENCBMD_RAW_WRITE, 0, 0, Data, Size)
+            : connection_send_request(connection, OPENCBMD_RAW_READ, (int) Size, 0, NULL, 0);
+    else
+        error = Write
+            ? connection_send_request(connection, OPENCBMD_WRITE_N, (int) Protocol, 0, Data, Size)
+            : connection_send_request(connection, OPENCBMD_READ_N, (int) Protocol, (int) Size, NULL, 0);
+
+    if (error)
+        return -1;
+
+    pending = &connection->Queue[(connection->First + connection->Pending) % OPENCBMD_MAX_PENDING];
+    pending->Data = Write ? NULL : (unsigned char *) Data;
+    pending->Size = Size;
+    pending->Callback = Callback;
+    pending->Context = Context;
+    connection->Pending++;
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- OPENCBM ARCH FUNCTIONS ----------------------------------*/
+
+/*! \brief Get the name of the driver for a specific parallel port
+
+ Get the name of the driver for a specific parallel port.
+
+ \param Port
+   The socket of the daemon. If not set (== NULL), the
+   default socket is used.
+
+ \return
+   Returns a pointer to a null-terminated string containing the
+   driver name, or NULL if an error occurred.
+*/
+
+const char * CBMAPIDECL
+opencbm_plugin_get_driver_name(const char * const Port)
+{
+    static char name[128];
+    const char *path = connection_path(Port);
+
+    arch_snprintf(name, sizeof(name), "opencbmd:%s", path ? path : "");
+
+    return name;
+}
+
+/*! \brief Opens the driver
+
+ This function connects to the daemon.
+
+ \param HandleDevice
+   Pointer to a CBM_FILE which will contain the file handle of the driver.
+
+ \param Port
+   The socket of the daemon. If not set (== NULL), the
+   default socket is used.
+
+ \return
+   ==0: This function completed successfully
+   !=0: otherwise
+
+ cbm_driver_open() should be balanced with cbm_driver_close().
+*/
+
+int CBMAPIDECL
+opencbm_plugin_driver_open(CBM_FILE *HandleDevice, const char * const Port)
+{
+    opencbmd_connection_t *connection;
+    struct sockaddr_un address;
+    const char *path = connection_path(Port);
+    int version;
+
+    if (path == NULL)
+    {
+        fprintf(stderr, "opencbmd: no socket is given, and $XDG_RUNTIME_DIR is not set\n");
+        return 1;
+    }
+
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "opencbmd: the name of the socket is too long: %s\n", path);
+        return 1;
+    }
+
+    connection = calloc(1, sizeof(*connection));
+    if (connection == NULL)
+        return 1;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    connection->Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (connection->Socket < 0
+        || connect(connection->Socket, (struct sockaddr *) &address, sizeof(address)) != 0)
+    {
+        fprintf(stderr, "opencbmd: cannot connect to the daemon at %s: %s\n", path, strerror(errno));
+        if (connection->Socket >= 0)
+            close(connection->Socket);
+        free(connection);
+        return 1;
+    }
+
+#ifdef SO_NOSIGPIPE
+    {
+        int on = 1;
+        setsockopt(connection->Socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    }
+#endif
+
+    version = connection_simple((CBM_FILE) connection, OPENCBMD_HELLO, OPENCBMD_VERSION, 0);
+
+    if (version != OPENCBMD_VERSION)
+    {
+        fprintf(stderr, "opencbmd: the daemon at %s speaks version %d of the protocol, not %d\n",
+            path, version, OPENCBMD_VERSION);
+        opencbm_plugin_driver_close((CBM_FILE) connection);
+        return 1;
+    }
+
+    *HandleDevice = (CBM_FILE) connection;
+
+    return 0;
+}
+
+/*! \brief Closes the driver
+
+ Closes the connection to the daemon. If this program still
+ owns the bus, the daemon hands it to the next one.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ cbm_driver_close() should be called to balance a previous call to
+ cbm_driver_open().
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call cbm_driver_close().
+*/
+
+void CBMAPIDECL
+opencbm_plugin_driver_close(CBM_FILE HandleDevice)
+{
+    opencbmd_connection_t *connection = (opencbmd_connection_t *) HandleDevice;
+
+    connection_wait(connection, 0);
+
+    close(connection->Socket);
+    free(connection);
+}
+
+/*! \brief Lock the bus for this program
+
+ The requests of the other programs wait until this program
+ calls cbm_unlock() as often as it has called cbm_lock().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+*/
+
+void CBMAPIDECL
+opencbm_plugin_lock(CBM_FILE HandleDevice)
+{
+    connection_simple(HandleDevice, OPENCBMD_LOCK, 0, 0);
+}
+
+/*! \brief Unlock the bus
+
+ If this was the last cbm_unlock(), or cbm_lock() has not been
+ called at all, the bus is handed to the next program. It is
+ taken back with the next access.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+*/
+
+void CBMAPIDECL
+opencbm_plugin_unlock(CBM_FILE HandleDevice)
+{
+    connection_simple(HandleDevice, OPENCBMD_UNLOCK, 0, 0);
+}
+
+/*! \brief Write data to the IEC serial bus
+
+ This function sends data after a cbm_listen().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Buffer
+   Pointer to a buffer which hold the bytes to write to the bus.
+
+ \param Count
+   Number of bytes to be written.
+
+ \return
+   >= 0: The actual number of bytes written.
+   <0  indicates an error.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_raw_write(CBM_FILE HandleDevice, const void *Buffer, size_t Count)
+{
+    if (Count > OPENCBMD_MAX_DATA)
+        return -1;
+
+    return connection_call(HandleDevice, OPENCBMD_RAW_WRITE, 0, 0, Buffer, (unsigned int) Count, NULL, 0);
+}
+
+/*! \brief Read data from the IEC serial bus
+
+ This function retrieves data after a cbm_talk().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Buffer
+   Pointer to a buffer which will hold the bytes read.
+
+ \param Count
+   Number of bytes to be read at most.
+
+ \return
+   >= 0: The actual number of bytes read.
+   <0  indicates an error.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_raw_read(CBM_FILE HandleDevice, void *Buffer, size_t Count)
+{
+    if (Count > OPENCBMD_MAX_DATA)
+        Count = OPENCBMD_MAX_DATA;
+
+    return connection_call(HandleDevice, OPENCBMD_RAW_READ, (int) Count, 0, NULL, 0, Buffer, (unsigned int) Count);
+}
+
+/*! \brief Send a LISTEN on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_listen(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    return connection_simple(HandleDevice, OPENCBMD_LISTEN, DeviceAddress, SecondaryAddress);
+}
+
+/*! \brief Send a TALK on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_talk(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    return connection_simple(HandleDevice, OPENCBMD_TALK, DeviceAddress, SecondaryAddress);
+}
+
+/*! \brief Open a file on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 means success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_open(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    return connection_simple(HandleDevice, OPENCBMD_OPEN, DeviceAddress, SecondaryAddress);
+}
+
+/*! \brief Close a file on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   0 on success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_close(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    return connection_simple(HandleDevice, OPENCBMD_CLOSE, DeviceAddress, SecondaryAddress);
+}
+
+/*! \brief Send an UNLISTEN on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_unlisten(CBM_FILE HandleDevice)
+{
+    return connection_simple(HandleDevice, OPENCBMD_UNLISTEN, 0, 0);
+}
+
+/*! \brief Send an UNTALK on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_untalk(CBM_FILE HandleDevice)
+{
+    return connection_simple(HandleDevice, OPENCBMD_UNTALK, 0, 0);
+}
+
+/*! \brief Get EOI flag after bus read
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   != 0 if EOI was signalled, else 0.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_get_eoi(CBM_FILE HandleDevice)
+{
+    return connection_simple(HandleDevice, OPENCBMD_GET_EOI, 0, 0);
+}
+
+/*! \brief Reset the EOI flag
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, != 0 means an error has occured.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_clear_eoi(CBM_FILE HandleDevice)
+{
+    return connection_simple(HandleDevice, OPENCBMD_CLEAR_EOI, 0, 0);
+}
+
+/*! \brief RESET all devices
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   0 on success, else failure
+*/
+
+int CBMAPIDECL
+opencbm_plugin_reset(CBM_FILE HandleDevice)
+{
+    return connection_simple(HandleDevice, OPENCBMD_RESET, 0, 0);
+}
+
+/*! \brief Read a byte from a XP1541/XP1571 cable
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   the byte which was received on the parallel port
+*/
+
+unsigned char CBMAPIDECL
+opencbm_plugin_pp_read(CBM_FILE HandleDevice)
+{
+    return (unsigned char) connection_simple(HandleDevice, OPENCBMD_PP_READ, 0, 0);
+}
+
+/*! \brief Write a byte to a XP1541/XP1571 cable
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Byte
+   the byte to be output on the parallel port
+*/
+
+void CBMAPIDECL
+opencbm_plugin_pp_write(CBM_FILE HandleDevice, unsigned char Byte)
+{
+    connection_simple(HandleDevice, OPENCBMD_PP_WRITE, Byte, 0);
+}
+
+/*! \brief Read status of all bus lines.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \return
+   The state of the lines. The result is an OR between
+   the bit flags IEC_DATA, IEC_CLOCK, IEC_ATN, and IEC_RESET.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_iec_poll(CBM_FILE HandleDevice)
+{
+    return connection_simple(HandleDevice, OPENCBMD_IEC_POLL, 0, 0);
+}
+
+/*! \brief Activate a line on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be activated.
+*/
+
+void CBMAPIDECL
+opencbm_plugin_iec_set(CBM_FILE HandleDevice, int Line)
+{
+    connection_simple(HandleDevice, OPENCBMD_IEC_SET, Line, 0);
+}
+
+/*! \brief Deactivate a line on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be deactivated.
+*/
+
+void CBMAPIDECL
+opencbm_plugin_iec_release(CBM_FILE HandleDevice, int Line)
+{
+    connection_simple(HandleDevice, OPENCBMD_IEC_RELEASE, Line, 0);
+}
+
+/*! \brief Activate and deactive a line on the IEC serial bus
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Set
+   The mask of which lines should be set.
+
+ \param Release
+   The mask of which lines should be released.
+*/
+
+void CBMAPIDECL
+opencbm_plugin_iec_setrelease(CBM_FILE HandleDevice, int Set, int Release)
+{
+    connection_simple(HandleDevice, OPENCBMD_IEC_SETRELEASE, Set, Release);
+}
+
+/*! \brief Wait for a line to have a specific state
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Line
+   The line to be deactivated.
+
+ \param State
+   If zero, then wait for this line to be deactivated. \n
+   If not zero, then wait for this line to be activated.
+
+ \return
+   The state of the IEC bus on return (like cbm_iec_poll).
+*/
+
+int CBMAPIDECL
+opencbm_plugin_iec_wait(CBM_FILE HandleDevice, int Line, int State)
+{
+    return connection_simple(HandleDevice, OPENCBMD_IEC_WAIT, Line, State);
+}
+
+/*! \brief Execute a script of IEC line operations
+
+ The whole script is executed by the daemon, thus, it needs
+ one round trip only.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Script
+   The script.
+
+ \param Length
+   The number of bytes in Script.
+
+ \param Result
+   The buffer for the results of the script.
+
+ \param ResultLength
+   The size of Result.
+
+ \return
+   See cbm_iec_script().
+*/
+
+int CBMAPIDECL
+opencbm_plugin_iec_script(CBM_FILE HandleDevice, const unsigned char *Script, unsigned int Length,
+                          unsigned char *Result, unsigned int ResultLength)
+{
+    return connection_call(HandleDevice, OPENCBMD_IEC_SCRIPT, (int) ResultLength, 0,
+        Script, Length, Result, ResultLength);
+}
+
+/*! \brief Query the protocols the daemon moves blocks with, see opencbm_plugin_block_caps_t
+
+ The daemon emulates the protocols its adapter does not have, so
+ every block is one request to it anyway. A daemon which does not
+ know the request forwards the blocks to its adapter as they are.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_block_caps(CBM_FILE HandleDevice)
+{
+    int caps = connection_simple(HandleDevice, OPENCBMD_BLOCK_CAPS, 0, 0);
+
+    if (caps < 0)
+    {
+        caps = (1 << OPENCBM_PROTOCOL_S1) | (1 << OPENCBM_PROTOCOL_S2)
+             | (1 << OPENCBM_PROTOCOL_PP_DC) | (1 << OPENCBM_PROTOCOL_PP_CC);
+    }
+    return caps;
+}
+
+/*! \internal \brief Read with a fast transfer protocol */
+static int
+transfer_read_n(CBM_FILE HandleDevice, unsigned int Protocol, unsigned char *data, unsigned int size)
+{
+    return connection_call(HandleDevice, OPENCBMD_READ_N, (int) Protocol, (int) size, NULL, 0, data, size);
+}
+
+/*! \internal \brief Write with a fast transfer protocol */
+static int
+transfer_write_n(CBM_FILE HandleDevice, unsigned int Protocol, const unsigned char *data, unsigned int size)
+{
+    return connection_call(HandleDevice, OPENCBMD_WRITE_N, (int) Protocol, 0, data, size, NULL, 0);
+}
+
+/*! \brief Read with the serial-1 protocol, see opencbm_plugin_s1_read_n_t */
+int CBMAPIDECL
+opencbm_plugin_s1_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return transfer_read_n(HandleDevice, OPENCBM_PROTOCOL_S1, data, size);
+}
+
+/*! \brief Write with the serial-1 protocol, see opencbm_plugin_s1_write_n_t */
+int CBMAPIDECL
+opencbm_plugin_s1_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return transfer_write_n(HandleDevice, OPENCBM_PROTOCOL_S1, data, size);
+}
+
+/*! \brief Read with the serial-2 protocol, see opencbm_plugin_s2_read_n_t */
+int CBMAPIDECL
+opencbm_plugin_s2_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return transfer_read_n(HandleDevice, OPENCBM_PROTOCOL_S2, data, size);
+}
+
+/*! \brief Write with the serial-2 protocol, see opencbm_plugin_s2_write_n_t */
+int CBMAPIDECL
+opencbm_plugin_s2_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return transfer_write_n(HandleDevice, OPENCBM_PROTOCOL_S2, data, size);
+}
+
+/*! \brief Read with the parallel protocol of d64copy, see opencbm_plugin_pp_dc_read_n_t */
+int CBMAPIDECL
+opencbm_plugin_pp_dc_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return transfer_read_n(HandleDevice, OPENCBM_PROTOCOL_PP_DC, data, size);
+}
+
+/*! \brief Write with the parallel protocol of d64copy, see opencbm_plugin_pp_dc_write_n_t */
+int CBMAPIDECL
+opencbm_plugin_pp_dc_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return transfer_write_n(HandleDevice, OPENCBM_PROTOCOL_PP_DC, data, size);
+}
+
+/*! \brief Read with the parallel protocol of cbmcopy, see opencbm_plugin_pp_cc_read_n_t */
+int CBMAPIDECL
+opencbm_plugin_pp_cc_read_n(CBM_FILE HandleDevice, unsigned char *data, unsigned int size)
+{
+    return transfer_read_n(HandleDevice, OPENCBM_PROTOCOL_PP_CC, data, size);
+}
+
+/*! \brief Write with the parallel protocol of cbmcopy, see opencbm_plugin_pp_cc_write_n_t */
+int CBMAPIDECL
+opencbm_plugin_pp_cc_write_n(CBM_FILE HandleDevice, const unsigned char *data, unsigned int size)
+{
+    return transfer_write_n(HandleDevice, OPENCBM_PROTOCOL_PP_CC, data, size);
+}
+
+/*! \brief Queue an asynchronous read, see opencbm_plugin_async_read_n_t
+
+ The request is sent to the daemon at once; the reply is
+ collected by opencbm_plugin_async_wait(), or by the next
+ synchronous call.
+*/
+int CBMAPIDECL
+opencbm_plugin_async_read_n(CBM_FILE HandleDevice, unsigned int Protocol, unsigned char *data, unsigned int size, opencbm_plugin_async_cb_t *Callback, void *Context)
+{
+    return connection_queue(HandleDevice, Protocol, 0, data, size, Callback, Context);
+}
+
+/*! \brief Queue an asynchronous write, see opencbm_plugin_async_write_n_t */
+int CBMAPIDECL
+opencbm_plugin_async_write_n(CBM_FILE HandleDevice, unsigned int Protocol, const unsigned char *data, unsigned int size, opencbm_plugin_async_cb_t *Callback, void *Context)
+{
+    return connection_queue(HandleDevice, Protocol, 1, data, size, Callback, Context);
+}
+
+/*! \brief Wait for queued asynchronous transfers, see opencbm_plugin_async_wait_t */
+int CBMAPIDECL
+opencbm_plugin_async_wait(CBM_FILE HandleDevice, unsigned int Pending)
+{
+    return connection_wait((opencbmd_connection_t *) HandleDevice, Pending);
+}
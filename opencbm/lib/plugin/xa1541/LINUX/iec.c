@@ -19,6 +19,9 @@
 
 static char *cbm_dev_name = "/dev/cbm";
 
+/* in parburst.c */
+extern void xa1541_track_ring_unmap(void);
+
 const char *opencbm_plugin_get_driver_name(int port)
 {
     return cbm_dev_name;
@@ -33,6 +36,7 @@ int opencbm_plugin_driver_open(CBM_FILE *f, int port)
 void opencbm_plugin_driver_close(CBM_FILE f)
 {
     if(f >= 0) {
+        xa1541_track_ring_unmap();
         close(f);
     }
 }
@@ -197,3 +201,77 @@ void opencbm_plugin_iec_setrelease(CBM_FILE f, int set, int release)
     int arg = (set<<8) | release;
     ioctl(f, CBMCTRL_IEC_SETRELEASE, &arg);
 }
+
+/* block transfers of the drive programs, see cbm_block_read() */
+
+/* the driver moves at most that many bytes with one ioctl */
+#define BLOCK_RW_MAX 0x2000
+
+int opencbm_plugin_block_caps(CBM_FILE f)
+{
+    int caps;
+    /* an older driver does not know the ioctl */
+    if (ioctl(f, CBMCTRL_BLOCK_CAPS, &caps)) return 0;
+    return caps;
+}
+
+static int block_rw(CBM_FILE f, unsigned long cmd, int protocol, unsigned char *data, unsigned int size)
+{
+    BLOCK_RW_VALUE bv;
+    unsigned int done = 0;
+    int rv;
+
+    while (done < size)
+    {
+        bv.buffer = data + done;
+        bv.length = size - done > BLOCK_RW_MAX ? BLOCK_RW_MAX : size - done;
+        bv.protocol = protocol;
+
+        rv = ioctl(f, cmd, &bv);
+        if (rv < 0) return done > 0 ? (int) done : -1;
+
+        done += rv;
+        if (rv < bv.length) break;
+    }
+    return done;
+}
+
+int opencbm_plugin_s1_read_n(CBM_FILE f, unsigned char *data, unsigned int size)
+{
+    return block_rw(f, CBMCTRL_BLOCK_READ, CBM_BLOCK_PROTOCOL_S1, data, size);
+}
+
+int opencbm_plugin_s1_write_n(CBM_FILE f, const unsigned char *data, unsigned int size)
+{
+    return block_rw(f, CBMCTRL_BLOCK_WRITE, CBM_BLOCK_PROTOCOL_S1, (unsigned char *) data, size);
+}
+
+int opencbm_plugin_s2_read_n(CBM_FILE f, unsigned char *data, unsigned int size)
+{
+    return block_rw(f, CBMCTRL_BLOCK_READ, CBM_BLOCK_PROTOCOL_S2, data, size);
+}
+
+int opencbm_plugin_s2_write_n(CBM_FILE f, const unsigned char *data, unsigned int size)
+{
+    return block_rw(f, CBMCTRL_BLOCK_WRITE, CBM_BLOCK_PROTOCOL_S2, (unsigned char *) data, size);
+}
+
+int opencbm_plugin_pp_dc_read_n(CBM_FILE f, unsigned char *data, unsigned int size)
+{
+    return block_rw(f, CBMCTRL_BLOCK_READ, CBM_BLOCK_PROTOCOL_PP_DC, data, size);
+}
+
+int opencbm_plugin_pp_dc_write_n(CBM_FILE f, const unsigned char *data, unsigned int size)
+{
+    return block_rw(f, CBMCTRL_BLOCK_WRITE, CBM_BLOCK_PROTOCOL_PP_DC, (unsigned char *) data, size);
+}
+
+int opencbm_plugin_pp_cc_read_n(CBM_FILE f, unsigned char *data, unsigned int size)
+{
+    return block_rw(f, CBMCTRL_BLOCK_READ, CBM_BLOCK_PROTOCOL_PP_CC, data, size);
+}
+
+int opencbm_plugin_pp_cc_write_n(CBM_FILE f, const unsigned char *data, unsigned int size)
+{
+    return block_rw(f, CBMCTRL_BLOCK_WRITE, CBM_BLOCK_PROTOCOL_PP_CC, (unsigned char *) data, size);
+}
@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "opencbm.h"
@@ -39,9 +40,74 @@ void opencbm_plugin_parallel_burst_write(CBM_FILE f, unsigned char c)
     ioctl(f, CBMCTRL_PARBURST_WRITE, &c);
 }
 
+/*
+ * The tracks are read into the ring of the driver, and copied from there
+ * into the buffer of the caller. A driver without the ring is served with
+ * CBMCTRL_PARBURST_READ_TRACK[_VAR], as before. The driver can only be
+ * opened once, thus, there is only one ring.
+ */
+static const unsigned char *track_ring = MAP_FAILED;
+static CBM_TRACK_RING_TAIL *track_ring_tail = MAP_FAILED;
+static int track_ring_tried;
+
+static int track_ring_map(CBM_FILE f)
+{
+    if (!track_ring_tried) {
+        track_ring_tried = 1;
+        track_ring = mmap(NULL, CBM_TRACK_RING_SIZE, PROT_READ,
+                          MAP_SHARED, f, 0);
+        if (track_ring != MAP_FAILED) {
+            track_ring_tail = mmap(NULL, CBM_TRACK_RING_PAGE_SIZE,
+                                   PROT_READ | PROT_WRITE, MAP_SHARED, f,
+                                   CBM_TRACK_RING_TAIL_OFFSET);
+            if (track_ring_tail == MAP_FAILED) {
+                munmap((void *) track_ring, CBM_TRACK_RING_SIZE);
+                track_ring = MAP_FAILED;
+            }
+        }
+    }
+    return track_ring != MAP_FAILED;
+}
+
+/* called by opencbm_plugin_driver_close(): the driver cannot be opened
+ * again as long as the ring is mapped */
+void xa1541_track_ring_unmap(void)
+{
+    if (track_ring != MAP_FAILED) {
+        munmap(track_ring_tail, CBM_TRACK_RING_PAGE_SIZE);
+        munmap((void *) track_ring, CBM_TRACK_RING_SIZE);
+        track_ring_tail = MAP_FAILED;
+        track_ring = MAP_FAILED;
+    }
+    track_ring_tried = 0;
+}
+
+static int track_ring_read(CBM_FILE f, unsigned char *buffer, unsigned int length, int mode)
+{
+    const CBM_TRACK_RING_HEADER *header = (const void *) track_ring;
+    unsigned int head;
+    int rv;
+
+    if (length < CBM_TRACK_RING_SLOT_SIZE) return -EFAULT;
+
+    rv = ioctl(f, CBMCTRL_PARBURST_READ_TRACK_RING, &mode);
+    if (rv < 0) return -errno;
+
+    /* take the newest track; this also drops a track whose read
+     * was interrupted by a signal */
+    head = header->head;
+    memcpy(buffer, track_ring
+           + CBM_TRACK_RING_SLOT_OFFSET((head - 1) % CBM_TRACK_RING_SLOTS),
+           CBM_TRACK_RING_SLOT_SIZE);
+    track_ring_tail->tail = head;
+    return rv;
+}
+
 int opencbm_plugin_parallel_burst_read_track(CBM_FILE f, unsigned char *buffer, unsigned int length)
 {
     PARBURST_RW_VALUE mv;
+    if (track_ring_map(f))
+        return track_ring_read(f, buffer, length, CBM_TRACK_RING_FIXED);
     mv.buffer=buffer;
     mv.length=length; /* only needed in write_track */
     return ioctl(f, CBMCTRL_PARBURST_READ_TRACK, &mv) ? -errno : 0;
@@ -50,6 +116,8 @@ int opencbm_plugin_parallel_burst_read_track(CBM_FILE f, unsigned char *buffer,
 int opencbm_plugin_parallel_burst_read_track_var(CBM_FILE f, unsigned char *buffer, unsigned int length)
 {
     PARBURST_RW_VALUE mv;
+    if (track_ring_map(f))
+        return track_ring_read(f, buffer, length, CBM_TRACK_RING_VAR);
     mv.buffer=buffer;
     mv.length=length; /* only needed in write_track */
     return ioctl(f, CBMCTRL_PARBURST_READ_TRACK_VAR, &mv) ? -errno : 0;
@@ -712,6 +712,37 @@ opencbm_plugin_iec_wait(CBM_FILE HandleDevice, int Line, int State)
     return xum1541_ioctl((struct opencbm_usb_handle *)HandleDevice, XUM1541_IEC_WAIT, Line, State);
 }
 
+/*! \brief Execute a script of IEC line operations
+
+ The xum1541 executes the complete script itself, so there is only
+ one USB round trip instead of one for every operation.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Script
+   The IEC_SCRIPT_... operations to execute.
+
+ \param Length
+   The number of bytes in Script.
+
+ \param Result
+   Receives the sampled bits, LSB first.
+
+ \param ResultLength
+   The size of Result, in bytes.
+
+ \return
+   The number of sampled bits, -1 on error or timeout, or -2 if
+   the firmware cannot execute scripts.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_iec_script(CBM_FILE HandleDevice, const unsigned char *Script, unsigned int Length, unsigned char *Result, unsigned int ResultLength)
+{
+    return xum1541_iec_script((struct opencbm_usb_handle *)HandleDevice, Script, Length, Result, ResultLength);
+}
+
 /*! \brief Sends a command to the xum1541 device
 
  This function sends a control message respectively a command to the xum1541 device.
@@ -565,6 +565,46 @@ opencbm_plugin_tap_start_capture(CBM_FILE HandleDevice, unsigned char *Buffer, u
     return result;
 }
 
+/*! \brief TAPE: Start streaming capture
+
+ This function is a helper function for tape:
+ It starts the actual tape capture, handing the data to
+ a callback function as it arrives.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Callback
+   The function which gets the captured data.
+
+ \param Context
+   Context pointer that is given to the Callback.
+
+ \param Status
+   The return status.
+
+ \param BytesRead
+   The number of bytes read.
+
+ \return
+   != 0 on success.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+
+ Note that a plugin is not required to implement this function.
+*/
+
+int CBMAPIDECL
+opencbm_plugin_tap_capture_stream(CBM_FILE HandleDevice, cbm_tap_capture_cb_t *Callback, void *Context, int *Status, int *BytesRead)
+{
+    int result = xum1541_read_stream((struct opencbm_usb_handle *)HandleDevice, XUM1541_TAP, Callback, Context, Status, BytesRead);
+    if (result <= 0) {
+        DBG_WARN((DBG_PREFIX "opencbm_plugin_tap_capture_stream: returned with error %d", result));
+    }
+    return result;
+}
+
 /*! \brief TAPE: Start write
 
  This function is a helper function for tape:
@@ -260,3 +260,119 @@ opencbm_plugin_nib_write_n(CBM_FILE HandleDevice, const unsigned char *data, uns
 {
     return xum1541_write((struct opencbm_usb_handle *)HandleDevice, XUM1541_NIB, data, size);
 }
+
+#if HAVE_LIBUSB1
+
+/*! \internal \brief Map an OPENCBM_PROTOCOL_* value to the xum1541 protocol
+
+  \param Protocol
+    The OPENCBM_PROTOCOL_* value.
+
+  \return
+    The XUM1541_* protocol value, -1 if the protocol is not supported.
+*/
+static int
+async_protocol(unsigned int Protocol)
+{
+    switch (Protocol)
+    {
+    case OPENCBM_PROTOCOL_CBM:   return XUM1541_CBM;
+    case OPENCBM_PROTOCOL_S1:    return XUM1541_S1;
+    case OPENCBM_PROTOCOL_S2:    return XUM1541_S2;
+    case OPENCBM_PROTOCOL_PP_DC: return XUM1541_PP;
+    case OPENCBM_PROTOCOL_PP_CC: return XUM1541_P2;
+    default:                     return -1;
+    }
+}
+
+/*! \brief Queue an asynchronous read
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param Protocol
+    The protocol to use, one of the OPENCBM_PROTOCOL_* values.
+
+  \param data
+    Pointer to the data buffer which will hold the read bytes.
+    It must stay valid until the Callback has been called.
+
+  \param size
+    The size of the data buffer the read bytes will be written to.
+
+  \param Callback
+    Function which is called with the number of bytes read
+    (or -1 on error) when the read has completed. Can be NULL.
+
+  \param Context
+    Context which is given to the Callback.
+
+  \return
+    0 if the read has been queued, -1 on error.
+*/
+int CBMAPIDECL
+opencbm_plugin_async_read_n(CBM_FILE HandleDevice, unsigned int Protocol, unsigned char *data, unsigned int size, opencbm_plugin_async_cb_t *Callback, void *Context)
+{
+    int mode = async_protocol(Protocol);
+
+    if (mode < 0)
+        return -1;
+
+    return xum1541_async_read((struct opencbm_usb_handle *)HandleDevice, (unsigned char) mode, data, size, Callback, Context) < 0 ? -1 : 0;
+}
+
+/*! \brief Queue an asynchronous write
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param Protocol
+    The protocol to use, one of the OPENCBM_PROTOCOL_* values.
+
+  \param data
+    Pointer to the data buffer to be written.
+    It must stay valid until the Callback has been called.
+
+  \param size
+    The size of the data buffer to be written
+
+  \param Callback
+    Function which is called with the number of bytes written
+    (or -1 on error) when the write has completed. Can be NULL.
+
+  \param Context
+    Context which is given to the Callback.
+
+  \return
+    0 if the write has been queued, -1 on error.
+*/
+int CBMAPIDECL
+opencbm_plugin_async_write_n(CBM_FILE HandleDevice, unsigned int Protocol, const unsigned char *data, unsigned int size, opencbm_plugin_async_cb_t *Callback, void *Context)
+{
+    int mode = async_protocol(Protocol);
+
+    if (mode < 0)
+        return -1;
+
+    return xum1541_async_write((struct opencbm_usb_handle *)HandleDevice, (unsigned char) mode, data, size, Callback, Context) < 0 ? -1 : 0;
+}
+
+/*! \brief Wait for queued asynchronous operations
+
+  \param HandleDevice
+    A CBM_FILE which contains the file handle of the driver.
+
+  \param Pending
+    Return as soon as no more than this number of operations
+    are still in flight. 0 waits for all of them.
+
+  \return
+    0 on success, -1 if at least one of the operations failed.
+*/
+int CBMAPIDECL
+opencbm_plugin_async_wait(CBM_FILE HandleDevice, unsigned int Pending)
+{
+    return xum1541_async_wait((struct opencbm_usb_handle *)HandleDevice, Pending);
+}
+
+#endif // #if HAVE_LIBUSB1
@@ -38,7 +38,13 @@
 
 static int debug_level = -1; /*!< \internal \brief the debugging level for debugging output */
 
-unsigned char DeviceDriveMode; // Temporary disk/tape mode hack until usb device handle context is there.
+#if HAVE_LIBUSB1
+static void xum1541_async_drain(struct opencbm_usb_handle *HandleXum1541);
+static void xum1541_async_shutdown(struct opencbm_usb_handle *HandleXum1541);
+#else
+#define xum1541_async_drain(_h)    /* no asynchronous operations with libusb-0.1 */
+#define xum1541_async_shutdown(_h) /* no asynchronous operations with libusb-0.1 */
+#endif
 
 /*! \internal \brief Output debugging information for the xum1541
 
@@ -149,6 +155,199 @@ xum1541_cleanup(struct opencbm_usb_handle *HandleXum1541, char *msg, ...)
     }
 }
 
+/*
+ * Resolving a PortNumber means opening every xu/xum1541 on the bus and
+ * reading its product name and serial number. To save this, the location
+ * (bus and device) of the xum1541 which was found for a PortNumber is
+ * remembered in a small cache file. On the next open, the device at this
+ * location is checked first; only its serial number is read. If it does
+ * not match (e.g., the device has been replugged), the whole bus is
+ * scanned as before.
+ *
+ * The cache file is named by the environment variable XUM1541_CACHE; if
+ * it is set, but empty, there is no cache. By default, it is
+ * opencbm-xum1541.cache in $XDG_RUNTIME_DIR (or %TEMP% on Windows).
+ */
+
+/*! \internal \brief the name of the cache file, if it is not given by XUM1541_CACHE */
+#define XUM1541_CACHE_FILENAME "opencbm-xum1541.cache"
+
+/*! \internal \brief the size of a location string, "bus/device" */
+#define XUM1541_LOCATION_SIZE 64
+
+/*! \internal \brief Get the name of the cache file
+
+ \return
+   The name, or NULL if the cache is not used.
+*/
+static const char *
+xum1541_cache_filename(void)
+{
+    static char filename[260];
+    const char *name = getenv("XUM1541_CACHE");
+    const char *dir;
+
+    if (name != NULL)
+        return *name ? name : NULL;
+
+#ifdef WIN32
+    dir = getenv("TEMP");
+#else
+    dir = getenv("XDG_RUNTIME_DIR");
+#endif
+    if (dir == NULL || *dir == '\0')
+        return NULL;
+
+    arch_snprintf(filename, sizeof(filename), "%s/%s", dir, XUM1541_CACHE_FILENAME);
+    return filename;
+}
+
+/*! \internal \brief Look up the location of the xum1541 for a PortNumber
+
+ \param PortNumber
+   The PortNumber.
+
+ \param Location
+   Receives the location, as stored by xum1541_cache_store().
+
+ \return
+   0 if the PortNumber is in the cache, -1 if not.
+*/
+static int
+xum1541_cache_lookup(int PortNumber, char Location[XUM1541_LOCATION_SIZE])
+{
+    const char *filename = xum1541_cache_filename();
+    char line[XUM1541_LOCATION_SIZE + 16];
+    FILE *cache;
+    int ret = -1;
+
+    if (filename == NULL || (cache = fopen(filename, "r")) == NULL)
+        return -1;
+
+    while (ret != 0 && fgets(line, sizeof(line), cache) != NULL) {
+        int port;
+        if (sscanf(line, "%d %63s", &port, Location) == 2 && port == PortNumber)
+            ret = 0;
+    }
+
+    fclose(cache);
+    return ret;
+}
+
+/*! \internal \brief Remember the location of the xum1541 for a PortNumber
+
+ \param PortNumber
+   The PortNumber.
+
+ \param Location
+   The location of the device which has been found for PortNumber.
+   NULL removes the entry.
+*/
+static void
+xum1541_cache_store(int PortNumber, const char *Location)
+{
+    const char *filename = xum1541_cache_filename();
+    char lines[MAX_ALLOWED_XUM1541_SERIALNUM + 1][XUM1541_LOCATION_SIZE];
+    char line[XUM1541_LOCATION_SIZE + 16];
+    char location[XUM1541_LOCATION_SIZE];
+    FILE *cache;
+    int port;
+
+    if (filename == NULL)
+        return;
+
+    memset(lines, 0, sizeof(lines));
+
+    // keep the entries of the other PortNumbers
+    if ((cache = fopen(filename, "r")) != NULL) {
+        while (fgets(line, sizeof(line), cache) != NULL) {
+            if (sscanf(line, "%d %63s", &port, location) == 2
+                && port >= 0 && port <= MAX_ALLOWED_XUM1541_SERIALNUM)
+                strcpy(lines[port], location);
+        }
+        fclose(cache);
+    }
+
+    if (Location == NULL) {
+        if (lines[PortNumber][0] == '\0')
+            return;
+        lines[PortNumber][0] = '\0';
+    } else {
+        if (strcmp(lines[PortNumber], Location) == 0)
+            return;
+        arch_snprintf(lines[PortNumber], sizeof(lines[PortNumber]), "%s", Location);
+    }
+
+    if ((cache = fopen(filename, "w")) == NULL) {
+        xum1541_dbg(1, "cannot write the cache %s", filename);
+        return;
+    }
+
+    for (port = 0; port <= MAX_ALLOWED_XUM1541_SERIALNUM; port++) {
+        if (lines[port][0] != '\0')
+            fprintf(cache, "%d %s\n", port, lines[port]);
+    }
+
+    fclose(cache);
+}
+
+/*! \internal \brief Open the xum1541 at the cached location, if it is still there
+
+ \param HandleXum1541
+   The handle; on success, devh is set.
+
+ \param PortNumber
+   The (normalised) PortNumber to search for.
+
+ \param Location
+   The location from the cache.
+
+ \param Found
+   The location of the device that is checked.
+
+ \param Serial
+   The index of the serial number string of the device.
+
+ \return
+   1 if the device matches; devh is valid then. 0 if not.
+*/
+static int
+xum1541_cache_check(struct opencbm_usb_handle *HandleXum1541, int PortNumber,
+    const char *Location, const char *Found, int Serial)
+{
+    unsigned char string[256];
+    int len, serialnum;
+
+    if (strcmp(Location, Found) != 0)
+        return 0;
+
+    // The product name is known, only the serial number is checked
+#if HAVE_LIBUSB0
+    len = usbGetStringAscii(HandleXum1541, Serial, 0x0409, string, sizeof(string) - 1);
+#elif HAVE_LIBUSB1
+    len = usb.get_string_descriptor_ascii(HandleXum1541->devh, (uint8_t) Serial,
+        string, sizeof(string) - 1);
+#endif
+
+    serialnum = 0;
+    if (len > 0 && len <= 3) {
+        string[len] = '\0';
+        serialnum = atoi((char *)string);
+    }
+    if (len < 0 && PortNumber != 0)
+        serialnum = -1;
+
+    if (serialnum != PortNumber) {
+        xum1541_dbg(0, "cached xum1541 at %s does not match", Location);
+        xum1541_cleanup(HandleXum1541, NULL);
+        return 0;
+    }
+
+    xum1541_dbg(0, "xum1541 serial number %3u found at cached location %s",
+        serialnum, Location);
+    return 1;
+}
+
 // USB bus enumeration
 static int
 xum1541_enumerate(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
@@ -169,12 +368,17 @@ xum1541_enumerate(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
 #endif
     int len, serialnum, leastserial;
     unsigned char string[256];
+    char cached[XUM1541_LOCATION_SIZE];
+    char location[XUM1541_LOCATION_SIZE];
+    int haveCached;
 
     if (PortNumber < 0 || PortNumber > MAX_ALLOWED_XUM1541_SERIALNUM) {
         // Normalise the Portnumber for invalid values
         PortNumber = 0;
     }
 
+    haveCached = xum1541_cache_lookup(PortNumber, cached) == 0;
+
     xum1541_dbg(0, "scanning usb ...");
 
 #if HAVE_LIBUSB0
@@ -186,6 +390,23 @@ xum1541_enumerate(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
     /* make lib ignore this as this has nothing to do with our device */
     errno = 0;
 
+    // try the device which was found the last time first
+    for (bus = usb.get_busses(); haveCached && !HandleXum1541->devh && bus; bus = bus->next) {
+        for (dev = bus->devices; !HandleXum1541->devh && dev; dev = dev->next) {
+            if (dev->descriptor.idVendor != XUM1541_VID ||
+                dev->descriptor.idProduct != XUM1541_PID)
+                continue;
+
+            arch_snprintf(location, sizeof(location), "%s/%s", bus->dirname, dev->filename);
+            if (strcmp(location, cached) != 0 || (HandleXum1541->devh = usb.open(dev)) == NULL)
+                continue;
+
+            if (xum1541_cache_check(HandleXum1541, PortNumber, cached, location,
+                    dev->descriptor.iSerialNumber))
+                return 0;
+        }
+    }
+
     preferredDefaultHandle = NULL;
     leastserial = MAX_ALLOWED_XUM1541_SERIALNUM + 1;
     for (bus = usb.get_busses(); !HandleXum1541->devh && bus; bus = bus->next) {
@@ -251,6 +472,8 @@ xum1541_enumerate(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
             }
 
             xum1541_dbg(0, "xum1541 serial number: %3u", serialnum);
+            arch_snprintf(location, sizeof(location), "%s/%s", bus->dirname, dev->filename);
+            xum1541_cache_store(PortNumber, location);
             return 0;
         }
     }
@@ -262,6 +485,10 @@ xum1541_enumerate(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
                 usb.strerror());
         }
     }
+
+    // The default device depends on all devices on the bus, it is not cached
+    if (haveCached)
+        xum1541_cache_store(PortNumber, NULL);
 #elif HAVE_LIBUSB1
     // discover devices
     HandleXum1541->devh = NULL;
@@ -274,6 +501,30 @@ xum1541_enumerate(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
         return -1;
     }
 
+    // try the device which was found the last time first
+    for (i = 0; haveCached && i < cnt; i++)
+    {
+        libusb_device *device = list[i];
+
+        arch_snprintf(location, sizeof(location), "%d/%d",
+            usb.get_bus_number(device), usb.get_device_address(device));
+        if (strcmp(location, cached) != 0)
+            continue;
+
+        if (LIBUSB_SUCCESS == usb.get_device_descriptor(device, &descriptor)
+            && descriptor.idVendor == XUM1541_VID && descriptor.idProduct == XUM1541_PID
+            && LIBUSB_SUCCESS == usb.open(device, &HandleXum1541->devh)
+            && xum1541_cache_check(HandleXum1541, PortNumber, cached, location,
+                descriptor.iSerialNumber))
+        {
+            usb.free_device_list(list, 1);
+            return 0;
+        }
+
+        HandleXum1541->devh = NULL;
+        break;
+    }
+
     for (i = 0; i < cnt; i++)
     {
         libusb_device *device = list[i];
@@ -332,6 +583,9 @@ xum1541_enumerate(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
         if (PortNumber == serialnum) {
             xum1541_dbg(0, "xum1541 serial number: %3u", serialnum);
             HandleXum1541->devh = found.devh;
+            arch_snprintf(location, sizeof(location), "%d/%d",
+                usb.get_bus_number(device), usb.get_device_address(device));
+            xum1541_cache_store(PortNumber, location);
             break;
         }
 
@@ -344,6 +598,10 @@ xum1541_enumerate(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
         xum1541_cleanup(&found, NULL);
     }
 
+    // The default device depends on all devices on the bus, it is not cached
+    if (HandleXum1541->devh == NULL && haveCached)
+        xum1541_cache_store(PortNumber, NULL);
+
     // if no default device was found because only specific devices were present,
     // determine the default device from the specific ones and open it
     if (HandleXum1541->devh == NULL && preferredDefaultHandle != NULL) {
@@ -407,8 +665,13 @@ xum1541_device_path(int PortNumber)
         return NULL;
     }
     HandleXum1541->devh = NULL;
+    HandleXum1541->DriveMode = DeviceDriveMode_Uninit;
+    HandleXum1541->IecScriptSupport = 0;
+    HandleXum1541->PortNumber = -1;
+    HandleXum1541->NextKept = NULL;
 
 #if HAVE_LIBUSB1
+    HandleXum1541->async = NULL;
     usb.init(&HandleXum1541->ctx);
 #endif
 
@@ -491,68 +754,100 @@ xum1541_clear_halt(struct opencbm_usb_handle *Xum1541Handle)
     return 0;
 }
 
-/*! \brief Initialize the xum1541 device
-  This function tries to find and identify the xum1541 device.
+/*
+ * In keep-alive mode (environment variable XUM1541_KEEPALIVE set to a value
+ * other than 0), xum1541_close() shuts down the session with the firmware,
+ * but keeps the USB device open and the interface claimed. If the same
+ * PortNumber is opened again by this process, the bus is not scanned and
+ * the device not configured again; only XUM1541_INIT is sent. As the last
+ * session has been shut down, the firmware reports a clean state then and
+ * does not reset the bus. If the device is gone, it is opened as usual.
+ *
+ * Every device is kept on its own, so a process can use more than one
+ * xum1541 this way. A handle kept for "any" device (PortNumber 0) might
+ * hold the device another PortNumber asks for, thus it is closed before
+ * opening anything but "any" again.
+ *
+ * This is meant for programs which open and close the driver repeatedly;
+ * the interface stays claimed until the program ends, so other programs
+ * cannot use the xum1541 in the meantime.
+ */
 
-  \param HandleXum1541
-   Pointer to a XUM1541_HANDLE which will contain the file handle of the USB device.
+/*! \internal \brief the handles kept open by xum1541_close() in keep-alive mode, linked by NextKept */
+static struct opencbm_usb_handle *KeptHandles;
 
-  \param PortNumber
-   The device's serial number to search for also. It is not considered, if set to 0.
+/*! \internal \brief Check if the keep-alive mode is requested
 
-  \return
-    0 on success, -1 on error. On error, the handle is cleaned up if it
-    was already active.
+ \return
+   1 if XUM1541_KEEPALIVE is set to a value other than 0, else 0.
+*/
+static int
+xum1541_keepalive(void)
+{
+    const char *val = getenv("XUM1541_KEEPALIVE");
 
-  \remark
-    On success, xum1541_handle contains a valid handle to the xum1541 device.
-    In this case, the device configuration has been set and the interface
-    been claimed. xum1541_close() should be called when the user is done
-    with it.
+    return val != NULL && atoi(val) != 0;
+}
+
+/*! \internal \brief Take the handle kept open for a PortNumber
+
+ If there is none, the kept handles that might hold the device asked
+ for are closed.
+
+ \param PortNumber
+   The device's serial number, or 0 for any device.
+
+ \return
+   The kept handle, removed from the list, or NULL if there is none.
 */
-int
-xum1541_init(struct opencbm_usb_handle **HandleXum1541_p, int PortNumber)
+static struct opencbm_usb_handle *
+xum1541_unkeep(int PortNumber)
 {
-    struct opencbm_usb_handle *HandleXum1541;
-    unsigned char devInfo[XUM_DEVINFO_SIZE], devStatus;
-    int len, ret;
-    int success = 0;
+    struct opencbm_usb_handle **prev;
+    struct opencbm_usb_handle *handle;
 
-    if (HandleXum1541_p == NULL) {
-        perror("xum1541_init: HandleXum1541_p is NULL");
-        return -1;
+    for (prev = &KeptHandles; (handle = *prev) != NULL; prev = &handle->NextKept) {
+        if (handle->PortNumber == PortNumber) {
+            *prev = handle->NextKept;
+            return handle;
+        }
     }
 
-    // Place after "opencbm_usb_handle" allocation:
-    /*uh->*/DeviceDriveMode = DeviceDriveMode_Uninit;
-
-    *HandleXum1541_p = HandleXum1541 = malloc(sizeof(struct opencbm_usb_handle));
-    if (HandleXum1541 == NULL) {
-        perror("xum1541_init: malloc failed");
-        return -1;
+    prev = &KeptHandles;
+    while ((handle = *prev) != NULL) {
+        if (handle->PortNumber == 0 || PortNumber == 0) {
+            *prev = handle->NextKept;
+            handle->PortNumber = -1;
+            xum1541_close(handle);
+        } else {
+            prev = &handle->NextKept;
+        }
     }
-    HandleXum1541->devh = NULL;
+    return NULL;
+}
 
-#if HAVE_LIBUSB1
-    usb.init(&HandleXum1541->ctx);
-#endif
+/*! \internal \brief Find the xum1541, configure it and claim its interface
 
-    if (xum1541_enumerate(HandleXum1541, PortNumber) < 0) {
-        fprintf(stderr, "error: no xum1541 device found\n");
-        return -1;
-    }
+ \param HandleXum1541
+   The (new) handle.
 
-    if (HandleXum1541->devh == NULL) {
+ \param PortNumber
+   The device's serial number to search for also. It is not considered, if set to 0.
+
+ \return
+   0 on success, -1 on error. On error, devh is NULL if no device has been found.
+*/
+static int
+xum1541_open_device(struct opencbm_usb_handle *HandleXum1541, int PortNumber)
+{
+    int ret;
+
+    if (xum1541_enumerate(HandleXum1541, PortNumber) < 0 || HandleXum1541->devh == NULL) {
         fprintf(stderr, "error: no xum1541 device found\n");
-#if HAVE_LIBUSB1
-        usb.exit(HandleXum1541->ctx);
-#endif
-        free(HandleXum1541);
-        *HandleXum1541_p = NULL;
         return -1;
     }
 
-    do {
+    {
         // Check if device is already configured.
 #if HAVE_LIBUSB0
         char config = 0;
@@ -572,103 +867,193 @@ xum1541_init(struct opencbm_usb_handle **HandleXum1541_p, int PortNumber)
             ret = usb.set_configuration(HandleXum1541->devh, 1);
             if (ret != LIBUSB_SUCCESS) {
                 fprintf(stderr, "USB error: %s\n", usb.error_name(ret));
-                break;
+                return -1;
             }
         }
+    }
 
-        /*
-         * Get exclusive access to interface 0.
-         */
-        ret = usb.claim_interface(HandleXum1541->devh, 0);
-        if (ret != LIBUSB_SUCCESS) {
-            fprintf(stderr, "USB error: %s\n", usb.error_name(ret));
-            break;
-        }
+    /*
+     * Get exclusive access to interface 0.
+     */
+    ret = usb.claim_interface(HandleXum1541->devh, 0);
+    if (ret != LIBUSB_SUCCESS) {
+        fprintf(stderr, "USB error: %s\n", usb.error_name(ret));
+        return -1;
+    }
 
-        if (ret != LIBUSB_SUCCESS) {
-            fprintf(stderr, "USB error: %s\n", usb.error_name(ret));
-            break;
-        }
+    return 0;
+}
+
+/*! \internal \brief Start a session with the xum1541 firmware
 
-        // Check the basic device info message for firmware version
-        memset(devInfo, 0, sizeof(devInfo));
+ \param HandleXum1541
+   The handle of the device; its interface has been claimed.
+
+ \param Quiet
+   If not 0, a failing XUM1541_INIT is not reported, as the caller
+   will retry.
+
+ \return
+   0 on success, -1 on error.
+*/
+static int
+xum1541_handshake(struct opencbm_usb_handle *HandleXum1541, int Quiet)
+{
+    unsigned char devInfo[XUM_DEVINFO_SIZE], devStatus;
+    int len;
+
+    // Check the basic device info message for firmware version
+    memset(devInfo, 0, sizeof(devInfo));
 #if HAVE_LIBUSB0
-        len = usb.control_msg(HandleXum1541->devh, USB_TYPE_CLASS | USB_ENDPOINT_IN,
-            XUM1541_INIT, 0, 0, (char*)devInfo, sizeof(devInfo), USB_TIMEOUT);
+    len = usb.control_msg(HandleXum1541->devh, USB_TYPE_CLASS | USB_ENDPOINT_IN,
+        XUM1541_INIT, 0, 0, (char*)devInfo, sizeof(devInfo), USB_TIMEOUT);
 #elif HAVE_LIBUSB1
-        len = usb.control_transfer(HandleXum1541->devh, LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_ENDPOINT_IN,
-            XUM1541_INIT, 0, 0, devInfo, sizeof(devInfo), USB_TIMEOUT);
+    len = usb.control_transfer(HandleXum1541->devh, LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_ENDPOINT_IN,
+        XUM1541_INIT, 0, 0, devInfo, sizeof(devInfo), USB_TIMEOUT);
 #endif
-        if (len < 2) {
+    if (len < 2) {
+        if (!Quiet) {
             fprintf(stderr, "USB request for XUM1541 info failed: %s\n",
                 usb.error_name(len));
-            break;
-        }
-        if (xum1541_check_version(devInfo[0]) != 0) {
-            break;
-        }
-        if (len >= 4) {
-            xum1541_dbg(0, "device capabilities %02x status %02x",
-                devInfo[1], devInfo[2]);
         }
+        return -1;
+    }
+    if (xum1541_check_version(devInfo[0]) != 0) {
+        return -1;
+    }
+    HandleXum1541->IecScriptSupport = devInfo[0] >= XUM1541_IEC_SCRIPT_VERSION
+        && len >= 4 && (devInfo[2] & XUM1541_IEEE488_PRESENT) == 0;
+    if (len >= 4) {
+        xum1541_dbg(0, "device capabilities %02x status %02x",
+            devInfo[1], devInfo[2]);
+    }
 
-        // Check for the xum1541's current status. (Not the drive.)
-        devStatus = devInfo[2];
-        if ((devStatus & XUM1541_DOING_RESET) != 0) {
-            fprintf(stderr, "previous command was interrupted, resetting\n");
-            // Clear the stalls on both endpoints
-            if (xum1541_clear_halt(HandleXum1541) < 0) {
-                break;
-            }
+    // Check for the xum1541's current status. (Not the drive.)
+    devStatus = devInfo[2];
+    if ((devStatus & XUM1541_DOING_RESET) != 0) {
+        fprintf(stderr, "previous command was interrupted, resetting\n");
+        // Clear the stalls on both endpoints
+        if (xum1541_clear_halt(HandleXum1541) < 0) {
+            return -1;
         }
+    }
 
-        //  Enable disk or tape mode.
-        if (devInfo[1] & XUM1541_CAP_TAP) {
-            if (devInfo[2] & XUM1541_TAPE_PRESENT) {
-                /*uh->*/DeviceDriveMode = DeviceDriveMode_Tape;
-                xum1541_dbg(1, "[xum1541_init] Tape supported, tape mode entered.");
-            }
-            else
-            {
-                /*uh->*/DeviceDriveMode = DeviceDriveMode_Disk;
-                xum1541_dbg(1, "[xum1541_init] Tape supported, disk mode entered.");
-            }
+    //  Enable disk or tape mode.
+    if (devInfo[1] & XUM1541_CAP_TAP) {
+        if (devInfo[2] & XUM1541_TAPE_PRESENT) {
+            HandleXum1541->DriveMode = DeviceDriveMode_Tape;
+            xum1541_dbg(1, "[xum1541_init] Tape supported, tape mode entered.");
         }
         else
         {
-            DeviceDriveMode = (unsigned char) DeviceDriveMode_NoTapeSupport;
-            xum1541_dbg(1, "[xum1541_init] No tape support.");
+            HandleXum1541->DriveMode = DeviceDriveMode_Disk;
+            xum1541_dbg(1, "[xum1541_init] Tape supported, disk mode entered.");
         }
-
-        success = 1;
-
-    } while (0);
-
-    /* error cleanup */
-    if (!success) {
-        xum1541_close(HandleXum1541);
-        *HandleXum1541_p = NULL;
+    }
+    else
+    {
+        HandleXum1541->DriveMode = DeviceDriveMode_NoTapeSupport;
+        xum1541_dbg(1, "[xum1541_init] No tape support.");
     }
 
-    return success ? 0 : -1;
+    return 0;
 }
-/*! \brief close the xum1541 device
 
- \param HandleXum1541
+/*! \brief Initialize the xum1541 device
+  This function tries to find and identify the xum1541 device.
+
+  \param HandleXum1541
    Pointer to a XUM1541_HANDLE which will contain the file handle of the USB device.
 
- \remark
-    This function releases the interface and closes the xum1541 handle.
+  \param PortNumber
+   The device's serial number to search for also. It is not considered, if set to 0.
+
+  \return
+    0 on success, -1 on error. On error, the handle is cleaned up if it
+    was already active.
+
+  \remark
+    On success, xum1541_handle contains a valid handle to the xum1541 device.
+    In this case, the device configuration has been set and the interface
+    been claimed. xum1541_close() should be called when the user is done
+    with it.
 */
-void
-xum1541_close(struct opencbm_usb_handle *HandleXum1541)
+int
+xum1541_init(struct opencbm_usb_handle **HandleXum1541_p, int PortNumber)
 {
-    int ret;
-
-    xum1541_dbg(0, "Closing USB link");
+    struct opencbm_usb_handle *HandleXum1541;
 
-    if (HandleXum1541->devh != NULL) {
-#if HAVE_LIBUSB0
+    if (HandleXum1541_p == NULL) {
+        perror("xum1541_init: HandleXum1541_p is NULL");
+        return -1;
+    }
+
+    // In keep-alive mode, reuse the device from the last session
+    HandleXum1541 = xum1541_unkeep(PortNumber);
+    if (HandleXum1541 != NULL) {
+        xum1541_dbg(0, "reusing the USB link");
+        HandleXum1541->DriveMode = DeviceDriveMode_Uninit;
+        if (xum1541_handshake(HandleXum1541, 1) == 0) {
+            *HandleXum1541_p = HandleXum1541;
+            return 0;
+        }
+        xum1541_dbg(0, "the USB link is gone, opening it again");
+        HandleXum1541->PortNumber = -1;
+        xum1541_close(HandleXum1541);
+    }
+
+    *HandleXum1541_p = HandleXum1541 = malloc(sizeof(struct opencbm_usb_handle));
+    if (HandleXum1541 == NULL) {
+        perror("xum1541_init: malloc failed");
+        return -1;
+    }
+    HandleXum1541->devh = NULL;
+    HandleXum1541->DriveMode = DeviceDriveMode_Uninit;
+    HandleXum1541->IecScriptSupport = 0;
+    HandleXum1541->PortNumber = -1;
+    HandleXum1541->NextKept = NULL;
+
+#if HAVE_LIBUSB1
+    HandleXum1541->async = NULL;
+    usb.init(&HandleXum1541->ctx);
+#endif
+
+    if (xum1541_open_device(HandleXum1541, PortNumber) != 0
+        || xum1541_handshake(HandleXum1541, 0) != 0) {
+        /* error cleanup */
+        xum1541_close(HandleXum1541);
+        *HandleXum1541_p = NULL;
+        return -1;
+    }
+
+    HandleXum1541->PortNumber = PortNumber;
+
+    return 0;
+}
+/*! \brief close the xum1541 device
+
+ \param HandleXum1541
+   Pointer to a XUM1541_HANDLE which will contain the file handle of the USB device.
+
+ \remark
+    This function releases the interface and closes the xum1541 handle.
+    In keep-alive mode, a handle opened by xum1541_init() is kept
+    open for the next xum1541_init() of the same device instead.
+*/
+void
+xum1541_close(struct opencbm_usb_handle *HandleXum1541)
+{
+    int ret;
+    int keep = 0;
+
+    xum1541_dbg(0, "Closing USB link");
+
+    xum1541_async_shutdown(HandleXum1541);
+
+    keep = HandleXum1541->PortNumber >= 0 && xum1541_keepalive();
+
+    if (HandleXum1541->devh != NULL) {
+#if HAVE_LIBUSB0
         ret = usb.control_msg(HandleXum1541->devh, USB_TYPE_CLASS | USB_ENDPOINT_OUT,
             XUM1541_SHUTDOWN, 0, 0, NULL, 0, 1000);
 #elif HAVE_LIBUSB1
@@ -679,7 +1064,16 @@ xum1541_close(struct opencbm_usb_handle *HandleXum1541)
             fprintf(stderr,
                 "USB request for XUM1541 close failed, continuing: %s\n",
                 usb.error_name(ret));
+            keep = 0;
+        }
+
+        if (keep) {
+            xum1541_dbg(0, "keeping the USB link open");
+            HandleXum1541->NextKept = KeptHandles;
+            KeptHandles = HandleXum1541;
+            return;
         }
+
         ret = usb.release_interface(HandleXum1541->devh, 0);
 
 #if HAVE_LIBUSB0
@@ -721,6 +1115,8 @@ xum1541_control_msg(struct opencbm_usb_handle *HandleXum1541, unsigned int cmd)
 
     xum1541_dbg(1, "control msg %d", cmd);
 
+    xum1541_async_drain(HandleXum1541);
+
 #if HAVE_LIBUSB0
     nBytes = usb.control_msg(HandleXum1541->devh, USB_TYPE_CLASS | USB_ENDPOINT_OUT,
         cmd, 0, 0, NULL, 0, USB_TIMEOUT);
@@ -793,7 +1189,7 @@ xum1541_wait_status(struct opencbm_usb_handle *HandleXum1541)
 // Checks if xum1541_ioctl/xum1541_read/xum1541_write command is allowed in currently set disk/tape mode.
 #define RefuseToWorkInWrongMode \
     {                                                                                                    \
-        if (/*uh->*/DeviceDriveMode == DeviceDriveMode_Uninit)                                               \
+        if (HandleXum1541->DriveMode == DeviceDriveMode_Uninit)                                               \
         {                                                                                                \
             xum1541_dbg(1, "[RefuseToWorkInWrongMode] cmd blocked - No disk or tape mode set.");         \
             return XUM1541_Error_NoDiskTapeMode;                                                         \
@@ -801,13 +1197,13 @@ xum1541_wait_status(struct opencbm_usb_handle *HandleXum1541)
                                                                                                          \
         if (isTapeCmd)                                                                                   \
         {                                                                                                \
-            if (/*uh->*/DeviceDriveMode == DeviceDriveMode_NoTapeSupport)                                \
+            if (HandleXum1541->DriveMode == DeviceDriveMode_NoTapeSupport)                                \
             {                                                                                            \
                 xum1541_dbg(1, "[RefuseToWorkInWrongMode] cmd blocked - Firmware has no tape support."); \
                 return XUM1541_Error_NoTapeSupport;                                                      \
             }                                                                                            \
                                                                                                          \
-            if (/*uh->*/DeviceDriveMode == DeviceDriveMode_Disk)                                             \
+            if (HandleXum1541->DriveMode == DeviceDriveMode_Disk)                                             \
             {                                                                                            \
                 xum1541_dbg(1, "[RefuseToWorkInWrongMode] cmd blocked - Tape cmd in disk mode.");        \
                 return XUM1541_Error_TapeCmdInDiskMode;                                                  \
@@ -815,7 +1211,7 @@ xum1541_wait_status(struct opencbm_usb_handle *HandleXum1541)
         }                                                                                                \
         else /*isDiskCmd*/                                                                               \
         {                                                                                                \
-            if (/*uh->*/DeviceDriveMode == DeviceDriveMode_Tape)                                             \
+            if (HandleXum1541->DriveMode == DeviceDriveMode_Tape)                                             \
             {                                                                                            \
                 xum1541_dbg(1, "[RefuseToWorkInWrongMode] cmd blocked - Disk cmd in tape mode.");        \
                 return XUM1541_Error_DiskCmdInTapeMode;                                                  \
@@ -852,6 +1248,8 @@ xum1541_ioctl(struct opencbm_usb_handle *HandleXum1541, unsigned int cmd, unsign
 
     xum1541_dbg(1, "ioctl %d for device %d, sub %d", cmd, addr, secaddr);
 
+    xum1541_async_drain(HandleXum1541);
+
     RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
 
     cmdBuf[0] = (unsigned char)cmd;
@@ -936,6 +1334,8 @@ xum1541_write(struct opencbm_usb_handle *HandleXum1541, unsigned char modeFlags,
     xum1541_dbg(1, "write %d %d bytes from address %p flags %x",
         mode, size, data, modeFlags & 0x0f);
 
+    xum1541_async_drain(HandleXum1541);
+
     RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
 
     // Send the write command
@@ -1089,39 +1489,26 @@ xum1541_read_ext(struct opencbm_usb_handle *HandleXum1541, unsigned char mode, u
     return 1;
 }
 
-/*! \brief Read data from the xum1541 device
+/*! \internal \brief Send the command block of a read operation
 
  \param HandleXum1541
    A XUM1541_HANDLE which contains the file handle of the USB device.
 
  \param mode
-    Drive protocol to use to read the data from the device (e.g,
-    XUM1541_CBM is normal IEC wire protocol).
-
- \param data
-    Pointer to a buffer which will contain the data read from the xum1541
+    Drive protocol to use to read the data from the device.
 
  \param size
     The number of bytes to read from the xum1541
 
  \return
-    The number of bytes actually read, 0 on device error. If there is a
-    fatal error, returns -1.
+    0 on success, -1 on a fatal error.
 */
-int
-xum1541_read(struct opencbm_usb_handle *HandleXum1541, unsigned char mode, unsigned char *data, size_t size)
+static int
+xum1541_read_cmd(struct opencbm_usb_handle *HandleXum1541, unsigned char mode, size_t size)
 {
     int rd, ret;
-    size_t bytesRead, bytes2read;
     unsigned char cmdBuf[XUM_CMDBUF_SIZE];
-    BOOL isTapeCmd = ((mode == XUM1541_TAP) || (mode == XUM1541_TAP_CONFIG));
 
-    xum1541_dbg(1, "read %d %d bytes to address %p",
-               mode, size, data);
-
-    RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
-
-    // Send the read command
     cmdBuf[0] = XUM1541_READ;
     cmdBuf[1] = mode;
     cmdBuf[2] = size & 0xff;
@@ -1146,32 +1533,100 @@ xum1541_read(struct opencbm_usb_handle *HandleXum1541, unsigned char mode, unsig
         return -1;
     }
 
-    // Read the actual data now that it's ready.
-    bytesRead = 0;
-    while (bytesRead < size) {
-        bytes2read = size - bytesRead;
-        if (bytes2read > XUM_MAX_XFER_SIZE)
-            bytes2read = XUM_MAX_XFER_SIZE;
+    return 0;
+}
+
+/*! \internal \brief Read one bulk transfer of the data phase of a read operation
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param data
+    Pointer to a buffer which will contain the data read from the xum1541
+
+ \param size
+    The number of bytes to read, at most XUM_MAX_XFER_SIZE.
+
+ \return
+    The number of bytes actually read, -1 on a fatal error.
+*/
+static int
+xum1541_read_chunk(struct opencbm_usb_handle *HandleXum1541, unsigned char *data, size_t size)
+{
+    int rd, ret;
+
 #if HAVE_LIBUSB0
-        rd = usb.bulk_read(HandleXum1541->devh,
-            XUM_BULK_IN_ENDPOINT | USB_ENDPOINT_IN,
-            (char *)data, bytes2read, LIBUSB_NO_TIMEOUT);
+    ret = 0;
+    rd = usb.bulk_read(HandleXum1541->devh,
+        XUM_BULK_IN_ENDPOINT | USB_ENDPOINT_IN,
+        (char *)data, size, LIBUSB_NO_TIMEOUT);
 #elif HAVE_LIBUSB1
-        ret = usb.bulk_transfer(HandleXum1541->devh,
-            XUM_BULK_IN_ENDPOINT | LIBUSB_ENDPOINT_IN,
-            data, bytes2read, &rd, LIBUSB_NO_TIMEOUT);
+    ret = usb.bulk_transfer(HandleXum1541->devh,
+        XUM_BULK_IN_ENDPOINT | LIBUSB_ENDPOINT_IN,
+        data, size, &rd, LIBUSB_NO_TIMEOUT);
 #endif
 #if HAVE_LIBUSB0
-        if (rd < 0) {
+    if (rd < 0) {
 #elif HAVE_LIBUSB1
-        if (ret != LIBUSB_SUCCESS) {
+    if (ret != LIBUSB_SUCCESS) {
 #endif
-            fprintf(stderr, "USB error in read data(%p, %d): %s\n",
-               data, (int)size, usb.error_name(ret));
-            return -1;
-        }
+        fprintf(stderr, "USB error in read data(%p, %d): %s\n",
+           data, (int)size, usb.error_name(ret));
+        return -1;
+    }
 
-        xum1541_print_data(2, "read", data, rd);
+    xum1541_print_data(2, "read", data, rd);
+
+    return rd;
+}
+
+/*! \brief Read data from the xum1541 device
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param mode
+    Drive protocol to use to read the data from the device (e.g,
+    XUM1541_CBM is normal IEC wire protocol).
+
+ \param data
+    Pointer to a buffer which will contain the data read from the xum1541
+
+ \param size
+    The number of bytes to read from the xum1541
+
+ \return
+    The number of bytes actually read, 0 on device error. If there is a
+    fatal error, returns -1.
+*/
+int
+xum1541_read(struct opencbm_usb_handle *HandleXum1541, unsigned char mode, unsigned char *data, size_t size)
+{
+    int rd;
+    size_t bytesRead, bytes2read;
+    BOOL isTapeCmd = ((mode == XUM1541_TAP) || (mode == XUM1541_TAP_CONFIG));
+
+    xum1541_dbg(1, "read %d %d bytes to address %p",
+               mode, size, data);
+
+    xum1541_async_drain(HandleXum1541);
+
+    RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
+
+    // Send the read command
+    if (xum1541_read_cmd(HandleXum1541, mode, size) < 0)
+        return -1;
+
+    // Read the actual data now that it's ready.
+    bytesRead = 0;
+    while (bytesRead < size) {
+        bytes2read = size - bytesRead;
+        if (bytes2read > XUM_MAX_XFER_SIZE)
+            bytes2read = XUM_MAX_XFER_SIZE;
+
+        rd = xum1541_read_chunk(HandleXum1541, data, bytes2read);
+        if (rd < 0)
+            return -1;
 
         data += rd;
         bytesRead += rd;
@@ -1187,3 +1642,665 @@ xum1541_read(struct opencbm_usb_handle *HandleXum1541, unsigned char mode, unsig
     xum1541_dbg(2, "read done, got %d bytes", bytesRead);
     return bytesRead;
 }
+
+/*! \brief Read an open-ended data stream from the xum1541 device
+
+ Some commands (e.g., the tape capture) do not know in advance how
+ much data they are going to send. The device sends full packets
+ until it is done, and terminates the stream with a short (or empty)
+ packet. Instead of collecting all the data in one buffer, this
+ function hands it to the caller piece by piece, as it arrives.
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param mode
+    Drive protocol to use to read the data from the device (e.g,
+    XUM1541_TAP).
+
+ \param Callback
+    The function which gets the data. If it returns a value != 0,
+    the device is asked to stop with XUM1541_TAP_BREAK; the data which
+    still arrives after that is read, but discarded.
+
+ \param Context
+    Context pointer that is given to the Callback
+
+ \param Status
+   The return status.
+
+ \param BytesRead
+   The number of bytes read.
+
+ \return
+     1 : Finished successfully.
+    <0 : Fatal error.
+*/
+int
+xum1541_read_stream(struct opencbm_usb_handle *HandleXum1541, unsigned char mode, cbm_tap_capture_cb_t *Callback, void *Context, int *Status, int *BytesRead)
+{
+    unsigned char *chunk;
+    int rd, ret = 1, stopped = 0;
+    BOOL isTapeCmd = ((mode == XUM1541_TAP) || (mode == XUM1541_TAP_CONFIG));
+
+    xum1541_dbg(1, "[xum1541_read_stream] mode %d", mode);
+
+    *BytesRead = 0;
+
+    xum1541_async_drain(HandleXum1541);
+
+    RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
+
+    chunk = malloc(XUM_MAX_XFER_SIZE);
+    if (chunk == NULL)
+        return -1;
+
+    // The length is not used by the device for open-ended streams.
+    if (xum1541_read_cmd(HandleXum1541, mode, 0) < 0) {
+        free(chunk);
+        return -1;
+    }
+
+    do {
+        rd = xum1541_read_chunk(HandleXum1541, chunk, XUM_MAX_XFER_SIZE);
+        if (rd < 0) {
+            ret = -1;
+            break;
+        }
+
+        *BytesRead += rd;
+
+        if (rd > 0 && !stopped && Callback(Context, chunk, rd) != 0) {
+            xum1541_dbg(1, "[xum1541_read_stream] stopped by caller");
+            stopped = 1;
+            xum1541_tap_break(HandleXum1541);
+        }
+    } while (rd == XUM_MAX_XFER_SIZE);
+
+    free(chunk);
+
+    if (ret < 0)
+        return ret;
+
+    xum1541_dbg(2, "[xum1541_read_stream] BytesRead = %d", *BytesRead);
+    *Status = xum1541_wait_status(HandleXum1541);
+    xum1541_dbg(2, "[xum1541_read_stream] Status = %d", *Status);
+    return 1;
+}
+
+/*! \brief Execute a script of IEC line operations in the xum1541
+
+ The script is sent with one write command. The device executes it
+ and returns the first 16 sampled bits with the status. Only if there
+ are more samples, they are fetched with an additional read.
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param script
+    The IEC_SCRIPT_... operations to execute.
+
+ \param length
+    The number of bytes in script, at most XUM1541_IEC_SCRIPT_MAXLEN.
+
+ \param result
+    Receives the sampled bits, LSB first.
+
+ \param resultLength
+    The size of result, in bytes.
+
+ \return
+    The number of sampled bits, -1 on error or timeout, or -2 if the
+    firmware is too old to execute scripts or the device is in IEEE-488
+    mode.
+*/
+int
+xum1541_iec_script(struct opencbm_usb_handle *HandleXum1541, const unsigned char *script, size_t length, unsigned char *result, size_t resultLength)
+{
+    int samples, status, written;
+    size_t i;
+
+    if (!HandleXum1541->IecScriptSupport)
+        return -2;
+
+    if (length > XUM1541_IEC_SCRIPT_MAXLEN)
+        return -1;
+
+    samples = 0;
+    for (i = 0; i < length; i++) {
+        if (IEC_SCRIPT_OP(script[i]) == IEC_SCRIPT_SAMPLE(0))
+            samples++;
+    }
+    if ((size_t)samples > resultLength * 8)
+        return -1;
+
+    xum1541_dbg(1, "iec script, %d bytes, %d samples", length, samples);
+
+    if (xum1541_write_ext(HandleXum1541, XUM1541_IEC_SCRIPT, script, length, &status, &written) < 0
+        || written != (int)length || status < 0)
+        return -1;
+
+    if (samples > 16) {
+        if (xum1541_read(HandleXum1541, XUM1541_IEC_SCRIPT, result, (samples + 7) / 8) != (samples + 7) / 8)
+            return -1;
+    } else if (samples > 8) {
+        result[0] = status & 0xff;
+        result[1] = (status >> 8) & 0xff;
+    } else if (samples > 0) {
+        result[0] = status & 0xff;
+    }
+
+    return samples;
+}
+
+#if HAVE_LIBUSB1
+
+/*
+ * Asynchronous (pipelined) operation
+ *
+ * A read or write operation consists of up to three bulk transfers: the
+ * 4-byte command block, the data phase and, for CBM protocol writes, the
+ * status. The synchronous functions above perform these one after the
+ * other, paying a complete USB round trip for each of them.
+ *
+ * The functions below submit all transfers of an operation at once, and
+ * allow up to XUM1541_ASYNC_MAX_OPS operations to be in flight. As the
+ * firmware processes the commands strictly in order, and libusb completes
+ * the transfers of an endpoint in the order they were submitted, this is
+ * safe as long as nobody else talks to the device in the mean time. Thus,
+ * the synchronous functions drain the queue before they start.
+ */
+
+/*! \internal \brief the phases of one asynchronous operation */
+enum xum1541_async_phase {
+    XUM1541_ASYNC_CMD,    /*!< the 4-byte command block */
+    XUM1541_ASYNC_DATA,   /*!< the data to be read or written */
+    XUM1541_ASYNC_STATUS, /*!< the status (CBM protocol writes only) */
+    XUM1541_ASYNC_PHASES  /*!< the number of phases */
+};
+
+/*! \internal \brief one asynchronous read or write operation */
+struct xum1541_async_op {
+    struct opencbm_usb_async *queue;                            /*!< the queue this operation belongs to */
+    struct libusb_transfer *transfer[XUM1541_ASYNC_PHASES];     /*!< the transfers of the phases */
+    unsigned char inFlight[XUM1541_ASYNC_PHASES];               /*!< TRUE if the transfer has been submitted, but not completed yet */
+    unsigned char cmdBuf[XUM_CMDBUF_SIZE];                      /*!< the command block */
+    unsigned char statusBuf[XUM_STATUSBUF_SIZE];                /*!< buffer for the status */
+    unsigned int outstanding;                                   /*!< the number of transfers in flight */
+    int result;                                                 /*!< the result of the operation */
+    opencbm_plugin_async_cb_t *callback;                        /*!< the function to call on completion */
+    void *context;                                              /*!< the context for the callback */
+};
+
+/*! \internal \brief the queue of asynchronous operations of one xum1541 */
+struct opencbm_usb_async {
+    struct xum1541_async_op op[XUM1541_ASYNC_MAX_OPS];          /*!< ring buffer of the operations */
+    unsigned int first;                                         /*!< index of the oldest operation */
+    unsigned int count;                                         /*!< the number of operations in the queue */
+    int failed;                                                 /*!< an operation failed; the queue is being torn down */
+};
+
+/*! \internal \brief cancel all transfers in flight
+
+ \param Queue
+   The queue whose transfers are to be cancelled.
+
+ \remark
+   After an error, the host and the device are out of sync, so it makes no
+   sense to execute the operations queued after the failed one.
+*/
+static void
+xum1541_async_cancel(struct opencbm_usb_async *Queue)
+{
+    unsigned int i, phase;
+
+    for (i = 0; i < Queue->count; i++) {
+        struct xum1541_async_op *op = &Queue->op[(Queue->first + i) % XUM1541_ASYNC_MAX_OPS];
+
+        op->result = -1;
+        for (phase = 0; phase < XUM1541_ASYNC_PHASES; phase++) {
+            if (op->inFlight[phase])
+                usb.cancel_transfer(op->transfer[phase]);
+        }
+    }
+}
+
+/*! \internal \brief report the completed operations
+
+ \param Queue
+   The queue to process.
+
+ \remark
+   The callbacks are called in the order the operations were queued. The
+   operation is removed from the queue before its callback is executed, so
+   the callback is allowed to queue a new operation.
+*/
+static void
+xum1541_async_complete(struct opencbm_usb_async *Queue)
+{
+    while (Queue->count > 0) {
+        struct xum1541_async_op *op = &Queue->op[Queue->first];
+
+        if (op->outstanding != 0)
+            break;
+
+        Queue->first = (Queue->first + 1) % XUM1541_ASYNC_MAX_OPS;
+        Queue->count--;
+
+        xum1541_dbg(2, "async operation done, result %d", op->result);
+
+        if (op->callback)
+            op->callback(op->context, op->result);
+    }
+}
+
+/*! \internal \brief libusb completion callback of the asynchronous transfers
+
+ \param Transfer
+   The transfer which has completed.
+*/
+static void LIBUSB_CALL
+xum1541_async_transfer_cb(struct libusb_transfer *Transfer)
+{
+    struct xum1541_async_op *op = Transfer->user_data;
+    struct opencbm_usb_async *queue = op->queue;
+    enum xum1541_async_phase phase;
+    int failed = 0;
+
+    for (phase = XUM1541_ASYNC_CMD; phase < XUM1541_ASYNC_STATUS; phase++) {
+        if (Transfer == op->transfer[phase])
+            break;
+    }
+
+    if (Transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        if (Transfer->status != LIBUSB_TRANSFER_CANCELLED)
+            fprintf(stderr, "USB error in asynchronous transfer: status %d\n",
+                Transfer->status);
+        failed = 1;
+    }
+    else if (phase == XUM1541_ASYNC_CMD) {
+        if (Transfer->actual_length != XUM_CMDBUF_SIZE) {
+            fprintf(stderr, "USB error in asynchronous cmd: short write\n");
+            failed = 1;
+        }
+    }
+    else if (phase == XUM1541_ASYNC_DATA) {
+        xum1541_print_data(2,
+            (Transfer->endpoint & LIBUSB_ENDPOINT_IN) ? "read" : "wrote",
+            Transfer->buffer, Transfer->actual_length);
+        if (op->result >= 0)
+            op->result = Transfer->actual_length;
+    }
+    else if (Transfer->actual_length != XUM_STATUSBUF_SIZE) {
+        fprintf(stderr, "USB error in asynchronous status: short read\n");
+        failed = 1;
+    }
+    else {
+        switch (XUM_GET_STATUS(op->statusBuf)) {
+        case XUM1541_IO_BUSY:
+            xum1541_dbg(2, "device busy, waiting");
+            if (usb.submit_transfer(Transfer) == LIBUSB_SUCCESS)
+                return;
+            failed = 1;
+            break;
+        case XUM1541_IO_READY:
+            if (op->result >= 0)
+                op->result = XUM_GET_STATUS_VAL(op->statusBuf);
+            break;
+        case XUM1541_IO_ERROR:
+            fprintf(stderr, "device reports error\n");
+            failed = 1;
+            break;
+        default:
+            fprintf(stderr, "unknown status value: %d\n",
+                XUM_GET_STATUS(op->statusBuf));
+            failed = 1;
+            break;
+        }
+    }
+
+    op->inFlight[phase] = 0;
+    op->outstanding--;
+
+    if (failed) {
+        op->result = -1;
+        if (!queue->failed) {
+            queue->failed = 1;
+            xum1541_async_cancel(queue);
+        }
+    }
+
+    xum1541_async_complete(queue);
+}
+
+/*! \internal \brief free the queue of asynchronous operations
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \remark
+   The queue must be empty.
+*/
+static void
+xum1541_async_free(struct opencbm_usb_handle *HandleXum1541)
+{
+    struct opencbm_usb_async *queue = HandleXum1541->async;
+    unsigned int i, phase;
+
+    if (queue == NULL)
+        return;
+
+    for (i = 0; i < XUM1541_ASYNC_MAX_OPS; i++) {
+        for (phase = 0; phase < XUM1541_ASYNC_PHASES; phase++) {
+            if (queue->op[i].transfer[phase])
+                usb.free_transfer(queue->op[i].transfer[phase]);
+        }
+    }
+
+    free(queue);
+    HandleXum1541->async = NULL;
+}
+
+/*! \internal \brief get the queue of asynchronous operations, allocate it if necessary
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \return
+   The queue, NULL if it could not be allocated.
+*/
+static struct opencbm_usb_async *
+xum1541_async_queue(struct opencbm_usb_handle *HandleXum1541)
+{
+    struct opencbm_usb_async *queue;
+    unsigned int i, phase;
+
+    if (HandleXum1541->async != NULL)
+        return HandleXum1541->async;
+
+    queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        perror("xum1541_async_queue: calloc failed");
+        return NULL;
+    }
+    HandleXum1541->async = queue;
+
+    for (i = 0; i < XUM1541_ASYNC_MAX_OPS; i++) {
+        queue->op[i].queue = queue;
+        for (phase = 0; phase < XUM1541_ASYNC_PHASES; phase++) {
+            queue->op[i].transfer[phase] = usb.alloc_transfer(0);
+            if (queue->op[i].transfer[phase] == NULL) {
+                fprintf(stderr, "xum1541_async_queue: could not allocate transfer\n");
+                xum1541_async_free(HandleXum1541);
+                return NULL;
+            }
+        }
+    }
+
+    return queue;
+}
+
+/*! \internal \brief queue an asynchronous read or write operation
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param cmd
+   XUM1541_READ or XUM1541_WRITE
+
+ \param modeFlags
+   Drive protocol to use.
+
+ \param data
+   The buffer for the data. It must stay valid until the callback has been called.
+
+ \param size
+   The number of bytes to transfer.
+
+ \param Callback
+   The function to call when the operation has completed. Can be NULL.
+
+ \param Context
+   A context which is given to the Callback.
+
+ \return
+   0 if the operation has been queued, a negative value on error.
+*/
+static int
+xum1541_async_submit(struct opencbm_usb_handle *HandleXum1541, unsigned char cmd,
+                     unsigned char modeFlags, unsigned char *data, size_t size,
+                     opencbm_plugin_async_cb_t *Callback, void *Context)
+{
+    struct opencbm_usb_async *queue;
+    struct xum1541_async_op *op;
+    BOOL isTapeCmd = ((modeFlags == XUM1541_TAP) || (modeFlags == XUM1541_TAP_CONFIG));
+    unsigned char dataEndpoint;
+    unsigned int phase, phases;
+    int mode = modeFlags & 0xf0;
+
+    xum1541_dbg(1, "async %s %d %d bytes at address %p",
+        cmd == XUM1541_READ ? "read" : "write", mode, size, data);
+
+    RefuseToWorkInWrongMode; // Check if command allowed in current disk/tape mode.
+
+    if (isTapeCmd) {
+        xum1541_dbg(1, "async cmd blocked - not available for tape operations");
+        return -1;
+    }
+
+    if (size == 0 || size > XUM_MAX_XFER_SIZE) {
+        fprintf(stderr, "xum1541_async_submit: invalid size %d\n", (int)size);
+        return -1;
+    }
+
+    queue = xum1541_async_queue(HandleXum1541);
+    if (queue == NULL)
+        return -1;
+
+    // Make room for the new operation
+    if (queue->count == XUM1541_ASYNC_MAX_OPS
+        && xum1541_async_wait(HandleXum1541, XUM1541_ASYNC_MAX_OPS - 1) < 0)
+        return -1;
+
+    if (queue->failed)
+        return -1;
+
+    op = &queue->op[(queue->first + queue->count) % XUM1541_ASYNC_MAX_OPS];
+
+    op->cmdBuf[0] = cmd;
+    op->cmdBuf[1] = modeFlags;
+    op->cmdBuf[2] = size & 0xff;
+    op->cmdBuf[3] = (size >> 8) & 0xff;
+    op->outstanding = 0;
+    op->result = 0;
+    op->callback = Callback;
+    op->context = Context;
+
+    dataEndpoint = (cmd == XUM1541_READ)
+        ? XUM_BULK_IN_ENDPOINT | LIBUSB_ENDPOINT_IN
+        : XUM_BULK_OUT_ENDPOINT | LIBUSB_ENDPOINT_OUT;
+
+    libusb_fill_bulk_transfer(op->transfer[XUM1541_ASYNC_CMD], HandleXum1541->devh,
+        XUM_BULK_OUT_ENDPOINT | LIBUSB_ENDPOINT_OUT, op->cmdBuf, XUM_CMDBUF_SIZE,
+        xum1541_async_transfer_cb, op, LIBUSB_NO_TIMEOUT);
+    libusb_fill_bulk_transfer(op->transfer[XUM1541_ASYNC_DATA], HandleXum1541->devh,
+        dataEndpoint, data, (int)size,
+        xum1541_async_transfer_cb, op, LIBUSB_NO_TIMEOUT);
+    libusb_fill_bulk_transfer(op->transfer[XUM1541_ASYNC_STATUS], HandleXum1541->devh,
+        XUM_BULK_IN_ENDPOINT | LIBUSB_ENDPOINT_IN, op->statusBuf, XUM_STATUSBUF_SIZE,
+        xum1541_async_transfer_cb, op, LIBUSB_NO_TIMEOUT);
+
+    // If this is a CBM protocol write, the device sends a status afterwards
+    phases = (cmd == XUM1541_WRITE && mode == XUM1541_CBM)
+        ? XUM1541_ASYNC_PHASES : XUM1541_ASYNC_STATUS;
+
+    queue->count++;
+
+    for (phase = 0; phase < phases; phase++) {
+        int ret = usb.submit_transfer(op->transfer[phase]);
+
+        if (ret != LIBUSB_SUCCESS) {
+            fprintf(stderr, "USB error in xum1541_async_submit: %s\n",
+                usb.error_name(ret));
+
+            // the operation is reported as failed by xum1541_async_wait()
+            op->result = -1;
+            queue->failed = 1;
+            xum1541_async_cancel(queue);
+            break;
+        }
+
+        op->inFlight[phase] = 1;
+        op->outstanding++;
+    }
+
+    return 0;
+}
+
+/*! \brief Queue an asynchronous read from the xum1541 device
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param mode
+    Drive protocol to use to read the data from the device (e.g,
+    XUM1541_CBM is normal IEC wire protocol). Tape protocols are not allowed.
+
+ \param data
+    Pointer to a buffer which will contain the data read from the xum1541.
+    It must stay valid until the operation has completed.
+
+ \param size
+    The number of bytes to read from the xum1541, at most XUM_MAX_XFER_SIZE.
+
+ \param Callback
+    Function to be called with the number of bytes read (or -1 on error)
+    when the operation has completed. Can be NULL.
+
+ \param Context
+    Context which is given to Callback.
+
+ \return
+    0 if the read has been queued, a negative value on error.
+*/
+int
+xum1541_async_read(struct opencbm_usb_handle *HandleXum1541, unsigned char mode,
+                   unsigned char *data, size_t size,
+                   opencbm_plugin_async_cb_t *Callback, void *Context)
+{
+    return xum1541_async_submit(HandleXum1541, XUM1541_READ, mode, data, size, Callback, Context);
+}
+
+/*! \brief Queue an asynchronous write to the xum1541 device
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param modeFlags
+    Drive protocol to use to write the data to the device (e.g,
+    XUM1541_CBM is normal IEC wire protocol). Tape protocols are not allowed.
+
+ \param data
+    Pointer to the buffer which contains the data to be written.
+    It must stay valid until the operation has completed.
+
+ \param size
+    The number of bytes to write to the xum1541, at most XUM_MAX_XFER_SIZE.
+
+ \param Callback
+    Function to be called with the number of bytes written (or -1 on error)
+    when the operation has completed. Can be NULL.
+
+ \param Context
+    Context which is given to Callback.
+
+ \return
+    0 if the write has been queued, a negative value on error.
+*/
+int
+xum1541_async_write(struct opencbm_usb_handle *HandleXum1541, unsigned char modeFlags,
+                    const unsigned char *data, size_t size,
+                    opencbm_plugin_async_cb_t *Callback, void *Context)
+{
+    return xum1541_async_submit(HandleXum1541, XUM1541_WRITE, modeFlags,
+        (unsigned char *)data, size, Callback, Context);
+}
+
+/*! \brief Wait for asynchronous operations to complete
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \param Pending
+   Return as soon as at most this many operations are still in flight.
+   Give 0 to wait for all of them.
+
+ \return
+   0 on success, -1 if an operation has failed. In this case, all
+   operations queued after the failed one have been cancelled.
+*/
+int
+xum1541_async_wait(struct opencbm_usb_handle *HandleXum1541, unsigned int Pending)
+{
+    struct opencbm_usb_async *queue = HandleXum1541->async;
+    int ret;
+
+    if (queue == NULL)
+        return 0;
+
+    xum1541_async_complete(queue);
+
+    while (queue->count > Pending) {
+        ret = usb.handle_events(HandleXum1541->ctx);
+        if (ret != LIBUSB_SUCCESS && ret != LIBUSB_ERROR_INTERRUPTED) {
+            fprintf(stderr, "USB error in xum1541_async_wait: %s\n",
+                usb.error_name(ret));
+            exit(-1); /** \todo WHY? Consistent with the synchronous functions. */
+        }
+        xum1541_async_complete(queue);
+    }
+
+    ret = queue->failed ? -1 : 0;
+
+    // Only start over if all the cancelled operations are gone
+    if (queue->count == 0)
+        queue->failed = 0;
+
+    return ret;
+}
+
+/*! \internal \brief Make sure there are no asynchronous operations in flight
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+
+ \remark
+   This is called before each synchronous operation, as the device
+   processes its commands strictly in order.
+*/
+static void
+xum1541_async_drain(struct opencbm_usb_handle *HandleXum1541)
+{
+    if (HandleXum1541->async != NULL && HandleXum1541->async->count > 0) {
+        xum1541_dbg(1, "draining asynchronous operations");
+        xum1541_async_wait(HandleXum1541, 0);
+    }
+}
+
+/*! \internal \brief Cancel all asynchronous operations and free the queue
+
+ \param HandleXum1541
+   A XUM1541_HANDLE which contains the file handle of the USB device.
+*/
+static void
+xum1541_async_shutdown(struct opencbm_usb_handle *HandleXum1541)
+{
+    if (HandleXum1541->async == NULL)
+        return;
+
+    xum1541_async_cancel(HandleXum1541->async);
+    xum1541_async_wait(HandleXum1541, 0);
+    xum1541_async_free(HandleXum1541);
+}
+
+#endif // #if HAVE_LIBUSB1
@@ -10,6 +10,7 @@
 #define XUM1541_H
 
 #include "opencbm.h"
+#include "opencbm-plugin.h"
 
 #include "usbcommon.h"
 
@@ -65,7 +66,24 @@ int xum1541_read(struct opencbm_usb_handle *HandleXum1541, unsigned char mode,
     unsigned char *data, size_t size);
 int xum1541_read_ext(struct opencbm_usb_handle *HandleXum1541, unsigned char mode,
     unsigned char *data, size_t size, int *Status, int *BytesRead);
+int xum1541_read_stream(struct opencbm_usb_handle *HandleXum1541, unsigned char mode,
+    cbm_tap_capture_cb_t *Callback, void *Context, int *Status, int *BytesRead);
+
+int xum1541_iec_script(struct opencbm_usb_handle *HandleXum1541, const unsigned char *script,
+    size_t length, unsigned char *result, size_t resultLength);
 
 int xum1541_tap_break(struct opencbm_usb_handle *HandleXum1541);
 
+#if HAVE_LIBUSB1
+// Maximum number of read/write operations queued at the same time
+#define XUM1541_ASYNC_MAX_OPS   8
+
+// Pipelined read/write in normal CBM and speeder protocol modes
+int xum1541_async_read(struct opencbm_usb_handle *HandleXum1541, unsigned char mode,
+    unsigned char *data, size_t size, opencbm_plugin_async_cb_t *Callback, void *Context);
+int xum1541_async_write(struct opencbm_usb_handle *HandleXum1541, unsigned char mode,
+    const unsigned char *data, size_t size, opencbm_plugin_async_cb_t *Callback, void *Context);
+int xum1541_async_wait(struct opencbm_usb_handle *HandleXum1541, unsigned int Pending);
+#endif
+
 #endif // XUM1541_H
@@ -0,0 +1,437 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file lib/statistics.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Shared library / DLL for accessing the driver: per-call statistics
+**
+** If enabled for a driver handle, the bus level functions count
+** their calls, the bytes transferred and the time they take. This
+** tells if a slow transfer waits for the adapter, for the drive, or
+** for the host.
+**
+** The statistics are enabled with cbm_statistics_enable(), or for
+** all handles by setting the environment variable OPENCBM_STATS.
+** In the latter case, they are dumped when the handle is closed:
+** into the file named by OPENCBM_STATS, or to stderr if its value
+** is empty or "1".
+**
+****************************************************************/
+
+/*! Mark: We are in user-space (for debug.h) */
+#define DBG_USERMODE
+
+/*! The name of the executable */
+#define DBG_PROGNAME "OPENCBM.DLL"
+
+#include "debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! mark: We are building the DLL */
+#define DLL
+#include "opencbm.h"
+#include "archlib.h"
+
+#include "statistics.h"
+
+#include "library.h"
+
+/*! \brief the environment variable which enables the statistics for all handles */
+#define STATISTICS_ENVIRONMENT "OPENCBM_STATS"
+
+/*! \brief the statistics of one driver handle
+
+ It is allocated when the statistics are enabled for the first time,
+ and kept in the handle table until the handle is closed. Thus, it can
+ be used without a lock. All members are accessed atomically.
+*/
+struct statistics_handle_s
+{
+    int Enabled;                  /*!< the statistics are counted */
+    cbm_statistics_t Statistics;  /*!< the counters */
+};
+
+/*! \brief the statistics of one driver handle */
+typedef struct statistics_handle_s statistics_handle_t;
+
+int statistics_active;
+
+/*! \brief the names of the entries, indexed by enum cbm_statistics_entry_e */
+static const char * const statistics_entry_name[cbm_se_count] =
+{
+    "raw_write",
+    "raw_read",
+    "listen",
+    "talk",
+    "open",
+    "close",
+    "unlisten",
+    "untalk",
+    "get_eoi",
+    "clear_eoi",
+    "reset",
+    "pp_read",
+    "pp_write",
+    "iec_poll",
+    "iec_setrelease",
+    "iec_wait",
+    "iec_script",
+    "block",
+    "parallel_burst",
+    "parallel_burst_track",
+    "srq_burst",
+    "srq_burst_track"
+};
+
+/*! \internal \brief Find the statistics of a driver handle
+
+ \param HandleDevice
+   The driver handle.
+
+ \return
+   The statistics, or NULL if they have never been enabled for the handle.
+*/
+
+static statistics_handle_t *
+statistics_find(CBM_FILE HandleDevice)
+{
+    statistics_handle_t * volatile * location = handle_statistics(HandleDevice);
+
+    return location != NULL ? CBM_ATOMIC_GET(location) : NULL;
+}
+
+/*! \internal \brief Copy or clear statistics
+
+ \param Target
+   The statistics to write to.
+
+ \param Source
+   The statistics to copy, or NULL to clear Target.
+*/
+
+static void
+statistics_copy(cbm_statistics_t *Target, cbm_statistics_t *Source)
+{
+    int i;
+    int bucket;
+
+#define STATISTICS_COPY(_member) \
+    CBM_ATOMIC_SET_COUNTER(&Target->Entry[i]._member, \
+        Source ? CBM_ATOMIC_LOAD_COUNTER(&Source->Entry[i]._member) : 0)
+
+    for (i = 0; i < cbm_se_count; i++)
+    {
+        STATISTICS_COPY(Calls);
+        STATISTICS_COPY(Bytes);
+        STATISTICS_COPY(Microseconds);
+
+        for (bucket = 0; bucket < CBM_STATISTICS_BUCKETS; bucket++)
+            STATISTICS_COPY(Latency[bucket]);
+
+        CBM_ATOMIC_SET_ULONG(&Target->Entry[i].MaxMicroseconds,
+            Source ? CBM_ATOMIC_LOAD_ULONG(&Source->Entry[i].MaxMicroseconds) : 0);
+    }
+
+#undef STATISTICS_COPY
+}
+
+/*! \internal \brief Account a measured call
+
+ Use STATISTICS_STOP() instead of calling this directly.
+
+ The counters are changed with atomic operations, as another thread
+ might read them with cbm_get_statistics() at the same time.
+
+ \param HandleDevice
+   The CBM_FILE the call was made for.
+
+ \param Entry
+   The entry point.
+
+ \param Start
+   The value of STATISTICS_START() at the start of the call.
+
+ \param Bytes
+   The number of bytes transferred by the call.
+*/
+
+void
+statistics_record(CBM_FILE HandleDevice, enum cbm_statistics_entry_e Entry,
+                  unsigned long Start, size_t Bytes)
+{
+    unsigned long duration = arch_time_usec() - Start;
+    statistics_handle_t *handle = statistics_find(HandleDevice);
+    cbm_statistics_entry_t *entry;
+    unsigned long rest;
+    unsigned long max;
+    int bucket;
+
+    if (handle == NULL || !CBM_ATOMIC_LOAD_INT(&handle->Enabled))
+        return;
+
+    entry = &handle->Statistics.Entry[Entry];
+
+    CBM_ATOMIC_ADD_COUNTER(&entry->Calls, 1);
+    CBM_ATOMIC_ADD_COUNTER(&entry->Bytes, Bytes);
+    CBM_ATOMIC_ADD_COUNTER(&entry->Microseconds, duration);
+
+    do {
+        max = CBM_ATOMIC_LOAD_ULONG(&entry->MaxMicroseconds);
+    } while (duration > max && !CBM_ATOMIC_CHANGE_ULONG(&entry->MaxMicroseconds, max, duration));
+
+    for (bucket = 0, rest = duration; rest > 0 && bucket < CBM_STATISTICS_BUCKETS - 1; bucket++)
+        rest >>= 1;
+
+    CBM_ATOMIC_ADD_COUNTER(&entry->Latency[bucket], 1);
+}
+
+/*! \internal \brief Dump the statistics of a driver handle
+
+ \param File
+   The file to write to.
+
+ \param Statistics
+   The statistics.
+*/
+
+static void
+statistics_dump(FILE *File, const cbm_statistics_t *Statistics)
+{
+    int i;
+    int bucket;
+
+    fprintf(File, "opencbm statistics:\n");
+    fprintf(File, "%-20s %10s %12s %12s %8s %8s\n",
+            "entry", "calls", "bytes", "total ms", "avg us", "max us");
+
+    for (i = 0; i < cbm_se_count; i++)
+    {
+        const cbm_statistics_entry_t *entry = &Statistics->Entry[i];
+
+        if (entry->Calls == 0)
+            continue;
+
+        fprintf(File, "%-20s %10lu %12lu %12lu %8lu %8lu\n",
+                statistics_entry_name[i],
+                (unsigned long) entry->Calls,
+                (unsigned long) entry->Bytes,
+                (unsigned long) (entry->Microseconds / 1000),
+                (unsigned long) (entry->Microseconds / entry->Calls),
+                entry->MaxMicroseconds);
+
+        fprintf(File, "%-20s", "  latency (us)");
+
+        for (bucket = 0; bucket < CBM_STATISTICS_BUCKETS; bucket++)
+        {
+            if (entry->Latency[bucket] == 0)
+                continue;
+
+            if (bucket == CBM_STATISTICS_BUCKETS - 1)
+                fprintf(File, " >=%lu:", 1ul << (bucket - 1));
+            else
+                fprintf(File, " <%lu:", 1ul << bucket);
+
+            fprintf(File, "%lu", (unsigned long) entry->Latency[bucket]);
+        }
+
+        fprintf(File, "\n");
+    }
+}
+
+/*! \internal \brief Enable the statistics for a new driver handle, if requested
+
+ If the environment variable OPENCBM_STATS is set, the statistics
+ are enabled for every driver handle that is opened.
+
+ \param HandleDevice
+   The driver handle which has just been opened.
+*/
+
+void
+statistics_open(CBM_FILE HandleDevice)
+{
+    if (getenv(STATISTICS_ENVIRONMENT) != NULL)
+        cbm_statistics_enable(HandleDevice, 1);
+}
+
+/*! \internal \brief Dump (if requested) and remove the statistics of a driver handle
+
+ \param HandleDevice
+   The driver handle which is about to be closed.
+*/
+
+void
+statistics_close(CBM_FILE HandleDevice)
+{
+    cbm_statistics_t statistics;
+    const char *target = getenv(STATISTICS_ENVIRONMENT);
+
+    if (target != NULL && cbm_get_statistics(HandleDevice, &statistics) == 0)
+    {
+        if (*target == '\0' || strcmp(target, "1") == 0)
+        {
+            statistics_dump(stderr, &statistics);
+        }
+        else
+        {
+            FILE *file = fopen(target, "a");
+
+            if (file)
+            {
+                statistics_dump(file, &statistics);
+                fclose(file);
+            }
+        }
+    }
+
+    cbm_statistics_enable(HandleDevice, 0);
+}
+
+/*! \brief Enable or disable the per-call statistics
+
+ While the statistics are enabled for a driver handle, the bus
+ level functions (cbm_raw_read(), cbm_talk(), cbm_iec_poll(), ...)
+ count their calls, the bytes transferred and the time they take.
+ Without statistics, the only cost is one test per call.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Enable
+   If not zero, start counting; if the statistics are already
+   enabled, they are kept. If zero, stop counting and forget the
+   statistics.
+
+ \return
+   0 on success, -1 if there is not enough memory.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+*/
+
+int CBMAPIDECL
+cbm_statistics_enable(CBM_FILE HandleDevice, int Enable)
+{
+    statistics_handle_t * volatile * location;
+    statistics_handle_t *handle;
+
+    FUNC_ENTER();
+
+    location = handle_statistics(HandleDevice);
+
+    if (location == NULL)
+    {
+        FUNC_LEAVE_INT(Enable ? -1 : 0);
+    }
+
+    handle = CBM_ATOMIC_GET(location);
+
+    if (!Enable)
+    {
+        if (handle && CBM_ATOMIC_CHANGE_INT(&handle->Enabled, 1, 0))
+        {
+            CBM_ATOMIC_ADD_INT(&statistics_active, -1);
+            statistics_copy(&handle->Statistics, NULL);
+        }
+
+        FUNC_LEAVE_INT(0);
+    }
+
+    if (handle == NULL)
+    {
+        handle = calloc(1, sizeof(*handle));
+
+        if (handle == NULL)
+        {
+            FUNC_LEAVE_INT(-1);
+        }
+
+        /* freed when the handle is closed */
+        if (!CBM_ATOMIC_SET_IF_NULL(location, handle))
+        {
+            /* another thread has been faster */
+            free(handle);
+            handle = CBM_ATOMIC_GET(location);
+        }
+    }
+
+    if (CBM_ATOMIC_CHANGE_INT(&handle->Enabled, 0, 1))
+    {
+        CBM_ATOMIC_ADD_INT(&statistics_active, 1);
+    }
+
+    FUNC_LEAVE_INT(0);
+}
+
+/*! \brief Get the per-call statistics
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Statistics
+   Pointer to a buffer which receives a copy of the statistics.
+
+ \return
+   0 on success, -1 if the statistics are not enabled for
+   this handle, see cbm_statistics_enable().
+
+ Every counter is read atomically, but not all of them at once. If
+ the handle is used by another thread at the same time, the copy
+ might be slightly inconsistent.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+*/
+
+int CBMAPIDECL
+cbm_get_statistics(CBM_FILE HandleDevice, cbm_statistics_t *Statistics)
+{
+    statistics_handle_t *handle;
+
+    FUNC_ENTER();
+
+    handle = statistics_find(HandleDevice);
+
+    if (handle == NULL || !CBM_ATOMIC_LOAD_INT(&handle->Enabled))
+    {
+        FUNC_LEAVE_INT(-1);
+    }
+
+    statistics_copy(Statistics, &handle->Statistics);
+
+    FUNC_LEAVE_INT(0);
+}
+
+/*! \brief Get the name of an entry of the per-call statistics
+
+ \param Entry
+   The entry.
+
+ \return
+   The name, e.g. "raw_read", or NULL if Entry is invalid.
+*/
+
+const char * CBMAPIDECL
+cbm_statistics_entry_name(enum cbm_statistics_entry_e Entry)
+{
+    FUNC_ENTER();
+
+    if ((int) Entry < 0 || Entry >= cbm_se_count)
+    {
+        FUNC_LEAVE_PTR(NULL, const char *);
+    }
+
+    FUNC_LEAVE_PTR(statistics_entry_name[Entry], const char *);
+}
@@ -0,0 +1,59 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ */
+
+/*! **************************************************************
+** \file lib/statistics.h \n
+** \author OpenCBM team \n
+** \n
+** \brief Shared library / DLL: internal interface of the per-call statistics
+**
+****************************************************************/
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include "opencbm.h"
+#include "arch.h"
+#include "library.h"
+
+/*! the number of driver handles which currently have statistics; accessed atomically */
+extern int statistics_active;
+
+extern void statistics_record(CBM_FILE HandleDevice, enum cbm_statistics_entry_e Entry,
+                              unsigned long Start, size_t Bytes);
+extern void statistics_open(CBM_FILE HandleDevice);
+extern void statistics_close(CBM_FILE HandleDevice);
+
+/*! \brief Get the start time of a measured call
+
+ Without any statistics, this does not even read the clock.
+*/
+#define STATISTICS_START() (CBM_ATOMIC_LOAD_INT(&statistics_active) ? arch_time_usec() : 0)
+
+/*! \brief Account a measured call
+
+ \param _h
+   The CBM_FILE the call was made for.
+
+ \param _entry
+   The entry point, of type enum cbm_statistics_entry_e.
+
+ \param _start
+   The value of STATISTICS_START() at the start of the call.
+
+ \param _bytes
+   The number of bytes transferred by the call.
+*/
+#define STATISTICS_STOP(_h, _entry, _start, _bytes) \
+    do { \
+        if (CBM_ATOMIC_LOAD_INT(&statistics_active)) \
+            statistics_record(_h, _entry, _start, _bytes); \
+    } while (0)
+
+#endif /* #ifndef STATISTICS_H */
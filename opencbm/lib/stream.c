@@ -0,0 +1,236 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+*/
+
+/*! **************************************************************
+** \file lib/stream.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Shared library / DLL for accessing the driver: buffered talk channels
+**
+** Reading a directory or a status byte by byte results in one
+** cbm_raw_read() per byte, which is slow with USB adapters. The
+** functions here read ahead in big chunks, up to the EOI, and serve
+** the small reads from memory.
+**
+****************************************************************/
+
+/*! Mark: We are in user-space (for debug.h) */
+#define DBG_USERMODE
+
+/*! The name of the executable */
+#define DBG_PROGNAME "OPENCBM.DLL"
+
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//! mark: We are building the DLL */
+#define DLL
+#include "opencbm.h"
+#include "archlib.h"
+
+/*! \brief the number of bytes which are requested with one cbm_raw_read() */
+enum { STREAM_CHUNK_SIZE = 4096 };
+
+/*! \brief a buffered talk channel, see cbm_stream_open_talk() */
+struct cbm_stream_s
+{
+    CBM_FILE HandleDevice; /*!< the driver handle the channel belongs to */
+    int Eof;               /*!< the device has sent all of its data (or there was an error) */
+    int Error;             /*!< the last cbm_raw_read() failed */
+    size_t Pos;            /*!< the index of the next byte to return from Buffer */
+    size_t Length;         /*!< the number of valid bytes in Buffer */
+    unsigned char Buffer[STREAM_CHUNK_SIZE]; /*!< the data read ahead */
+};
+
+/*! \internal \brief Read the next chunk from the device
+
+ \param Stream
+   The stream to fill.
+
+ \return
+   0 if there is data in the buffer now, 1 if not.
+*/
+static int
+stream_fill(cbm_stream_t *Stream)
+{
+    int bytesRead;
+
+    if (Stream->Eof)
+        return 1;
+
+    bytesRead = cbm_raw_read(Stream->HandleDevice, Stream->Buffer, sizeof(Stream->Buffer));
+
+    if (bytesRead < 0)
+    {
+        Stream->Error = 1;
+        bytesRead = 0;
+    }
+
+    /* a short read means that the device signalled EOI */
+    if (bytesRead < (int) sizeof(Stream->Buffer))
+        Stream->Eof = 1;
+
+    Stream->Pos = 0;
+    Stream->Length = bytesRead;
+
+    return bytesRead == 0;
+}
+
+/*! \brief Open a buffered talk channel
+
+ This function commands a device to talk on the given secondary
+ address and returns a stream from which its data can be read with
+ cbm_stream_read() or cbm_stream_getc().
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param SecondaryAddress
+   The secondary address for the device on the IEC serial bus.
+
+ \return
+   The stream, or NULL if there was not enough memory or the
+   device did not accept the talk.
+
+ As long as the stream is open, the bus belongs to it; do not
+ call other functions for the bus before cbm_stream_close().
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+*/
+
+cbm_stream_t * CBMAPIDECL
+cbm_stream_open_talk(CBM_FILE HandleDevice, unsigned char DeviceAddress, unsigned char SecondaryAddress)
+{
+    cbm_stream_t *stream;
+
+    FUNC_ENTER();
+
+    stream = calloc(1, sizeof(*stream));
+
+    if (stream)
+    {
+        stream->HandleDevice = HandleDevice;
+
+        if (cbm_talk(HandleDevice, DeviceAddress, SecondaryAddress) != 0)
+        {
+            free(stream);
+            stream = NULL;
+        }
+    }
+
+    FUNC_LEAVE_PTR(stream, cbm_stream_t *);
+}
+
+/*! \brief Read data from a buffered talk channel
+
+ \param Stream
+   The stream, as returned by cbm_stream_open_talk().
+
+ \param Buffer
+   Pointer to a buffer which will hold the bytes read.
+
+ \param Count
+   Number of bytes to be read.
+
+ \return
+   The number of bytes read. If this is less than Count, the device
+   has sent all of its data. If nothing could be read because of
+   an error, the return value is -1.
+*/
+
+int CBMAPIDECL
+cbm_stream_read(cbm_stream_t *Stream, void *Buffer, size_t Count)
+{
+    unsigned char *buffer = Buffer;
+    size_t bytesRead = 0;
+
+    FUNC_ENTER();
+
+    while (bytesRead < Count)
+    {
+        size_t n;
+
+        if (Stream->Pos == Stream->Length && stream_fill(Stream))
+            break;
+
+        n = Stream->Length - Stream->Pos;
+        if (n > Count - bytesRead)
+            n = Count - bytesRead;
+
+        memcpy(buffer + bytesRead, Stream->Buffer + Stream->Pos, n);
+        Stream->Pos += n;
+        bytesRead += n;
+    }
+
+    if (bytesRead == 0 && Count > 0 && Stream->Error)
+    {
+        FUNC_LEAVE_INT(-1);
+    }
+
+    FUNC_LEAVE_INT((int) bytesRead);
+}
+
+/*! \brief Read one byte from a buffered talk channel
+
+ \param Stream
+   The stream, as returned by cbm_stream_open_talk().
+
+ \return
+   The byte (0 to 255), or -1 if the device has sent all of its
+   data or there was an error.
+*/
+
+int CBMAPIDECL
+cbm_stream_getc(cbm_stream_t *Stream)
+{
+    FUNC_ENTER();
+
+    if (Stream->Pos == Stream->Length && stream_fill(Stream))
+    {
+        FUNC_LEAVE_INT(-1);
+    }
+
+    FUNC_LEAVE_INT(Stream->Buffer[Stream->Pos++]);
+}
+
+/*! \brief Close a buffered talk channel
+
+ This function sends an UNTALK and frees the stream. Data that
+ has been read ahead, but not consumed, is lost.
+
+ \param Stream
+   The stream, as returned by cbm_stream_open_talk(). NULL is allowed.
+
+ \return
+   0 on success, else the result of cbm_untalk().
+*/
+
+int CBMAPIDECL
+cbm_stream_close(cbm_stream_t *Stream)
+{
+    int ret = 0;
+
+    FUNC_ENTER();
+
+    if (Stream)
+    {
+        ret = cbm_untalk(Stream->HandleDevice);
+        free(Stream);
+    }
+
+    FUNC_LEAVE_INT(ret);
+}
@@ -26,12 +26,15 @@
 #include "debug.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 //! mark: We are building the DLL */
 #define DLL
 #include "opencbm.h"
 #include "archlib.h"
 
+#include "library.h"
+
 enum { RETRIES_UPLOAD   = 5 }; //!< \brief how many retries to do when communication errors occur on upload
 enum { RETRIES_DOWNLOAD = 5 }; //!< \brief how many retries to do when communication errors occur on download
 
@@ -178,6 +181,183 @@ invalidateMWCommand(CBM_FILE HandleDevice)
     return rv;
 }
 
+/*! \brief how many drive programs the host remembers, see upload_cache */
+enum { UPLOAD_CACHE_ENTRIES = 16 };
+
+/*! \brief a drive program which has been written into a drive's memory */
+typedef struct upload_cache_entry_s
+{
+    CBM_FILE      HandleDevice;    /*!< the driver handle the drive is accessed with */
+    unsigned char DeviceAddress;   /*!< the address of the drive */
+    int           DriveMemAddress; /*!< the address of the program in the drive's memory */
+    size_t        Size;            /*!< the size of the program, 0 if the entry is unused */
+    unsigned long Hash;            /*!< the fingerprint of the program, see upload_hash() */
+} upload_cache_entry_t;
+
+/*! \brief the drive programs this process has written into drives last;
+    protected by the library lock */
+static upload_cache_entry_t upload_cache[UPLOAD_CACHE_ENTRIES];
+
+/*! \brief the entry of upload_cache which is replaced next */
+static unsigned int upload_cache_next;
+
+/*! \internal \brief Calculate the fingerprint of a drive program
+
+ \param Program
+   Pointer to the program.
+
+ \param Size
+   The size of the program, in bytes.
+
+ \return
+   The 32 bit FNV-1a hash of the program.
+*/
+
+static unsigned long
+upload_hash(const void *Program, size_t Size)
+{
+    const unsigned char *p = Program;
+    unsigned long hash = 2166136261ul;
+
+    while (Size-- > 0)
+    {
+        hash ^= *p++;
+        hash = (hash * 16777619ul) & 0xfffffffful;
+    }
+
+    return hash;
+}
+
+/*! \internal \brief Find a remembered program which overlaps a range
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param DriveMemAddress
+   The start of the range in the drive's memory.
+
+ \param Size
+   The size of the range, in bytes.
+
+ \return
+   The entry, or NULL if there is none.
+*/
+
+static upload_cache_entry_t *
+upload_cache_find(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                  int DriveMemAddress, size_t Size)
+{
+    unsigned int i;
+
+    for (i = 0; i < UPLOAD_CACHE_ENTRIES; i++)
+    {
+        upload_cache_entry_t *entry = &upload_cache[i];
+
+        if (entry->Size != 0
+            && entry->HandleDevice == HandleDevice
+            && entry->DeviceAddress == DeviceAddress
+            && entry->DriveMemAddress < DriveMemAddress + (int) Size
+            && DriveMemAddress < entry->DriveMemAddress + (int) entry->Size)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/*! \internal \brief Forget the drive programs in a range of a drive's memory
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param DriveMemAddress
+   The start of the range in the drive's memory.
+
+ \param Size
+   The size of the range, in bytes.
+*/
+
+static void
+upload_cache_forget(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                    int DriveMemAddress, size_t Size)
+{
+    upload_cache_entry_t *entry;
+
+    while ((entry = upload_cache_find(HandleDevice, DeviceAddress, DriveMemAddress, Size)) != NULL)
+    {
+        entry->Size = 0;
+    }
+}
+
+/*! \internal \brief Remember a drive program which is in a drive's memory now
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param DriveMemAddress
+   The address of the program in the drive's memory.
+
+ \param Size
+   The size of the program, in bytes.
+
+ \param Hash
+   The fingerprint of the program.
+*/
+
+static void
+upload_cache_remember(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                      int DriveMemAddress, size_t Size, unsigned long Hash)
+{
+    upload_cache_entry_t *entry;
+
+    upload_cache_forget(HandleDevice, DeviceAddress, DriveMemAddress, Size);
+
+    entry = &upload_cache[upload_cache_next];
+
+    upload_cache_next = (upload_cache_next + 1) % UPLOAD_CACHE_ENTRIES;
+
+    entry->HandleDevice = HandleDevice;
+    entry->DeviceAddress = DeviceAddress;
+    entry->DriveMemAddress = DriveMemAddress;
+    entry->Size = Size;
+    entry->Hash = Hash;
+}
+
+/*! \internal \brief Forget the drive programs written with a driver handle
+
+ Called by cbm_driver_close(); the handle value might be reused
+ for another adapter later.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+*/
+
+void
+upload_close(CBM_FILE HandleDevice)
+{
+    unsigned int i;
+
+    library_lock();
+
+    for (i = 0; i < UPLOAD_CACHE_ENTRIES; i++)
+    {
+        if (upload_cache[i].HandleDevice == HandleDevice)
+            upload_cache[i].Size = 0;
+    }
+
+    library_unlock();
+}
+
 /*! \brief Upload a program into a floppy's drive memory.
 
  This function writes a program into the drive's memory
@@ -217,6 +397,7 @@ cbm_upload(CBM_FILE HandleDevice, unsigned char DeviceAddress,
     const char *bufferToProgram = Program;
 
     unsigned char command[] = { 'M', '-', 'W', ' ', ' ', ' ' };
+    int startAddress = DriveMemAddress;
     size_t i;
     int rv = 0;
     int c;
@@ -306,6 +487,22 @@ cbm_upload(CBM_FILE HandleDevice, unsigned char DeviceAddress,
         retrycounter = RETRIES_UPLOAD;
     }
 
+    // Whatever was in this range of the drive's memory has been overwritten
+
+    library_lock();
+
+    if (rv == (int) Size)
+    {
+        upload_cache_remember(HandleDevice, DeviceAddress, startAddress,
+            Size, upload_hash(Program, Size));
+    }
+    else
+    {
+        upload_cache_forget(HandleDevice, DeviceAddress, startAddress, Size);
+    }
+
+    library_unlock();
+
     FUNC_LEAVE_INT(rv);
 }
 
@@ -494,3 +691,414 @@ cbm_download(CBM_FILE HandleDevice, unsigned char DeviceAddress,
 
     FUNC_LEAVE_INT(rv);
 }
+
+/*-------------------------------------------------------------------*/
+/*--------- FAST DOWNLOAD -------------------------------------------*/
+
+/*! \brief the dump routine for 1541, 1570 and 1571 drives */
+static const unsigned char download_prog[] = {
+#include "download.inc"
+};
+
+/*! \brief where the dump routine lives in drive memory */
+enum { DOWNLOAD_PROG_ADDRESS = 0x500 };
+
+/*! \brief how long to wait for the dump routine to start, in 10 ms */
+enum { DOWNLOAD_START_TIMEOUT = 30 };
+
+/*! \internal \brief Read bytes with the s1 protocol
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param Buffer
+   Pointer to a byte buffer where the bytes are stored.
+
+ \param Size
+   The number of bytes to read.
+
+ \return
+   0 on success, -1 on error.
+*/
+
+static int
+s1_read(CBM_FILE HandleDevice, unsigned char *Buffer, size_t Size)
+{
+    unsigned int count;
+
+    while (Size > 0) {
+        count = Size > 0x8000 ? 0x8000 : (unsigned int) Size;
+        if (cbm_block_read(HandleDevice, cbm_bp_s1, Buffer, count) != (int) count)
+            return -1;
+        Buffer += count;
+        Size -= count;
+    }
+    return 0;
+}
+
+/*! \internal \brief Dump a range of drive memory with the dump routine
+
+ The dump routine must already be in the drive's memory.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param DriveMemAddress
+   The address in the drive's memory of the first byte.
+
+ \param Buffer
+   Pointer to a byte buffer where the data is stored.
+
+ \param Size
+   The number of bytes, 1 to 65536.
+
+ \return
+   0 on success, 1 if the dump routine did not start,
+   -1 if there was an error while transferring the data.
+*/
+
+static int
+download_range_fast(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                    int DriveMemAddress, unsigned char *Buffer, size_t Size)
+{
+    unsigned char command[] = { 'M', '-', 'E', ' ', ' ', ' ', ' ', ' ', ' ' };
+    unsigned char wait[2];
+    int rv;
+
+    StoreInt16IntoBuffer(&command[3], DOWNLOAD_PROG_ADDRESS);
+    StoreInt16IntoBuffer(&command[5], DriveMemAddress);
+    StoreInt16IntoBuffer(&command[7], (unsigned int) (Size & 0xFFFF));
+
+    if (cbm_exec_command(HandleDevice, DeviceAddress, command, sizeof(command)))
+        return 1;
+
+    // the routine signals that it runs by setting DATA
+
+    wait[0] = IEC_SCRIPT_TIMEOUT(DOWNLOAD_START_TIMEOUT);
+    wait[1] = IEC_SCRIPT_WAIT_SET(IEC_DATA);
+
+    if (cbm_iec_script(HandleDevice, wait, sizeof(wait), NULL, 0) < 0)
+        return 1;
+
+    rv = s1_read(HandleDevice, Buffer, Size);
+
+    cbm_iec_release(HandleDevice, IEC_CLOCK);
+
+    return rv;
+}
+
+/*! \internal \brief Read a range of drive memory, with the dump routine if possible
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus.
+
+ \param DriveMemAddress
+   The address in the drive's memory of the first byte.
+
+ \param Buffer
+   Pointer to a byte buffer where the data is stored.
+
+ \param Size
+   The number of bytes, 0 to 65536.
+
+ \param Fast
+   If not zero, the dump routine is in the drive's memory. It is
+   tried first, "M-R" is only used if it does not start.
+
+ \return
+   0 on success, -1 on error.
+*/
+
+static int
+download_range(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+               int DriveMemAddress, unsigned char *Buffer, size_t Size, int Fast)
+{
+    int rv = 1;
+
+    if (Size == 0)
+        return 0;
+
+    if (Fast)
+        rv = download_range_fast(HandleDevice, DeviceAddress, DriveMemAddress, Buffer, Size);
+
+    if (rv > 0)
+        rv = cbm_download(HandleDevice, DeviceAddress, DriveMemAddress, Buffer, Size) == (int) Size ? 0 : -1;
+
+    return rv;
+}
+
+/*! \brief Download data from a floppy's drive memory, fast
+
+ This function reads data from the drive's memory like
+ cbm_download(), but instead of one "M-R" command per
+ (at most) 256 bytes, it uploads a small dump routine
+ which sends the whole range with the s1 protocol.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param DriveMemAddress
+   The address in the drive's memory of the first byte to read.
+
+ \param Buffer
+   Pointer to a byte buffer where the data from the drive's
+   memory is stored.
+
+ \param Size
+   The size of the data block to be read, in bytes.
+   The range must not go beyond $FFFF.
+
+ \return
+   Returns the number of bytes written into the storage buffer.
+   If it does not equal Size, than an error occurred.
+   Specifically, -1 is returned on transfer errors.
+
+ The dump routine runs on 1541, 1570 and 1571 drives; for other
+ drives, this function falls back to cbm_download(). The same
+ happens if the routine does not start.
+
+ The routine occupies drive memory from $0500 on. The part of the
+ range which overlaps it is read with "M-R" before the routine is
+ written, so the original contents are returned. Afterwards, this
+ memory has been changed, though.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+*/
+
+int CBMAPIDECL
+cbm_download_fast(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                  int DriveMemAddress, void *const Buffer, size_t Size)
+{
+    unsigned char *StoreBuffer = Buffer;
+    enum cbm_device_type_e deviceType;
+    int progStart = DOWNLOAD_PROG_ADDRESS;
+    int progEnd = DOWNLOAD_PROG_ADDRESS + sizeof(download_prog);
+    int end = DriveMemAddress + (int) Size;
+    int from, to;
+    int fast = 0;
+    int rv;
+
+    FUNC_ENTER();
+
+    if (DriveMemAddress < 0 || end > 0x10000)
+    {
+        FUNC_LEAVE_INT(-1);
+    }
+
+    if (Size == 0)
+    {
+        FUNC_LEAVE_INT(0);
+    }
+
+    if (cbm_identify(HandleDevice, DeviceAddress, &deviceType, NULL) != 0
+        || (deviceType != cbm_dt_cbm1541
+            && deviceType != cbm_dt_cbm1570
+            && deviceType != cbm_dt_cbm1571))
+    {
+        FUNC_LEAVE_INT(cbm_download(HandleDevice, DeviceAddress, DriveMemAddress, Buffer, Size));
+    }
+
+    // first, read what the dump routine is going to overwrite
+
+    from = DriveMemAddress > progStart ? DriveMemAddress : progStart;
+    to = end < progEnd ? end : progEnd;
+
+    if (from >= to)
+    {
+        from = to = end;
+    }
+
+    rv = download_range(HandleDevice, DeviceAddress, from,
+                        StoreBuffer + (from - DriveMemAddress), to - from, 0);
+
+    if (rv == 0)
+    {
+        fast = cbm_upload(HandleDevice, DeviceAddress, progStart,
+                          download_prog, sizeof(download_prog)) == sizeof(download_prog);
+
+        // the parts before and after the routine
+
+        rv = download_range(HandleDevice, DeviceAddress, DriveMemAddress,
+                            StoreBuffer, from - DriveMemAddress, fast);
+    }
+
+    if (rv == 0)
+    {
+        rv = download_range(HandleDevice, DeviceAddress, to,
+                            StoreBuffer + (to - DriveMemAddress), end - to, fast);
+    }
+
+    FUNC_LEAVE_INT(rv == 0 ? (int) Size : -1);
+}
+
+/*-------------------------------------------------------------------*/
+/*--------- RESIDENT DRIVE CODE -------------------------------------*/
+
+/*! \brief Check if a program is in a floppy's drive memory
+
+ This function compares the drive's memory with a program,
+ one page after the other via use of "M-R" commands. It stops
+ at the first difference, so a foreign or cleared range costs
+ only one "M-R".
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param DriveMemAddress
+   The address in the drive's memory where the program is
+   expected.
+
+ \param Program
+   Pointer to a byte buffer which holds the program in the
+   caller's address space.
+
+ \param Size
+   The size of the program, in bytes.
+
+ \return
+   1 if the program is in the drive's memory, 0 if not, and
+   -1 on transfer errors.
+
+ The host remembers the fingerprints of the programs it has written
+ with cbm_upload(). If another program has been written over the
+ range since, the drive's memory is not read at all.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+*/
+
+int CBMAPIDECL
+cbm_upload_is_resident(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                       int DriveMemAddress, const void *Program, size_t Size)
+{
+    const unsigned char *bufferToProgram = Program;
+    unsigned char buffer[TRANSFER_SIZE_DOWNLOAD];
+    unsigned long hash = upload_hash(Program, Size);
+    const upload_cache_entry_t *entry;
+    int overwritten;
+    size_t i;
+    int c;
+
+    FUNC_ENTER();
+
+    if (Size == 0)
+    {
+        FUNC_LEAVE_INT(1);
+    }
+
+    // if we know that something else has been written there, do not bother to look
+
+    library_lock();
+
+    entry = upload_cache_find(HandleDevice, DeviceAddress, DriveMemAddress, Size);
+
+    overwritten = entry && (entry->DriveMemAddress != DriveMemAddress
+                            || entry->Size != Size || entry->Hash != hash);
+
+    library_unlock();
+
+    if (overwritten)
+    {
+        FUNC_LEAVE_INT(0);
+    }
+
+    for (i = 0; i < Size; i += c)
+    {
+        int address = DriveMemAddress + (int) i;
+
+        // one page at a time, as cbm_download() does
+
+        c = TRANSFER_SIZE_DOWNLOAD - (address & 0xFF);
+
+        if (c > (int) (Size - i))
+        {
+            c = Size - i;
+        }
+
+        if (cbm_download(HandleDevice, DeviceAddress, address, buffer, c) != c)
+        {
+            FUNC_LEAVE_INT(-1);
+        }
+
+        if (memcmp(buffer, bufferToProgram + i, c) != 0)
+        {
+            FUNC_LEAVE_INT(0);
+        }
+    }
+
+    library_lock();
+    upload_cache_remember(HandleDevice, DeviceAddress, DriveMemAddress, Size, hash);
+    library_unlock();
+
+    FUNC_LEAVE_INT(1);
+}
+
+/*! \brief Upload a program into a floppy's drive memory, unless it is there
+
+ This function works like cbm_upload(), but it first checks with
+ cbm_upload_is_resident() if the program is already in the drive's
+ memory, e.g. because the previous invocation of a tool has
+ uploaded it and the drive has not been reset since. In this case,
+ nothing is written.
+
+ \param HandleDevice
+   A CBM_FILE which contains the file handle of the driver.
+
+ \param DeviceAddress
+   The address of the device on the IEC serial bus. This
+   is known as primary address, too.
+
+ \param DriveMemAddress
+   The address in the drive's memory where the program is to be
+   stored.
+
+ \param Program
+   Pointer to a byte buffer which holds the program in the
+   caller's address space.
+
+ \param Size
+   The size of the program to be stored, in bytes.
+
+ \return
+   Returns the number of bytes in the drive's memory.
+   If it does not equal Size, than an error occurred.
+   Specifically, -1 is returned on transfer errors.
+
+ Only use this for programs which do not modify themselves; else,
+ the check fails every time, and costs an "M-R" for nothing.
+
+ If cbm_driver_open() did not succeed, it is illegal to
+ call this function.
+*/
+
+int CBMAPIDECL
+cbm_upload_cached(CBM_FILE HandleDevice, unsigned char DeviceAddress,
+                  int DriveMemAddress, const void *Program, size_t Size)
+{
+    FUNC_ENTER();
+
+    if (cbm_upload_is_resident(HandleDevice, DeviceAddress, DriveMemAddress, Program, Size) == 1)
+    {
+        DBG_PRINT((DBG_PREFIX "%u bytes at $%04x are resident, skipping upload",
+            (unsigned int) Size, DriveMemAddress));
+
+        FUNC_LEAVE_INT((int) Size);
+    }
+
+    FUNC_LEAVE_INT(cbm_upload(HandleDevice, DeviceAddress, DriveMemAddress, Program, Size));
+}
@@ -82,10 +82,15 @@ static int check_drive_type(CBM_FILE fd, unsigned char drive,
 }
 
 
+/* what cbmcopy_read() may skip, as it is done already (batch mode) */
+#define CBMCOPY_DRIVE_SET_UP    1   /* the drive is in the right mode */
+#define CBMCOPY_TURBO_RESIDENT  2   /* the turbo is in the drive */
+
 static int send_turbo(CBM_FILE fd, unsigned char drive, int write,
                       const cbmcopy_settings *settings,
                       const unsigned char *turbo, size_t turbo_size,
                       const unsigned char *start_cmd, size_t cmd_len,
+                      int resident,
                       cbmcopy_message_cb msg_cb)
 {
     const transfer_funcs *trf;
@@ -99,8 +104,11 @@ static int send_turbo(CBM_FILE fd, unsigned char drive, int write,
     {
         if(turbo_size)
         {
-            cbm_upload( fd, drive, 0x500, turbo, turbo_size );
-            msg_cb( sev_debug, "uploading %d bytes turbo code", turbo_size );
+            if(!resident)
+            {
+                cbm_upload_cached( fd, drive, 0x500, turbo, turbo_size );
+                msg_cb( sev_debug, "uploading %d bytes turbo code", turbo_size );
+            }
             if(trf->upload_turbo(fd, drive, settings->drive_type, write) == 0)
             {
                 cbm_exec_command( fd, drive, start_cmd, cmd_len );
@@ -141,6 +149,7 @@ static int cbmcopy_read(CBM_FILE fd,
                         int cbmname_len,
                         unsigned char **filedata,
                         size_t *filedata_size,
+                        int done,
                         cbmcopy_message_cb msg_cb,
                         cbmcopy_status_cb status_cb)
 {
@@ -173,7 +182,10 @@ static int cbmcopy_read(CBM_FILE fd,
             break;
         case cbm_dt_cbm1570:
         case cbm_dt_cbm1571:
-            cbm_exec_command( fd, drive, "U0>M1", 0 );
+            if(!(done & CBMCOPY_DRIVE_SET_UP))
+            {
+                cbm_exec_command( fd, drive, "U0>M1", 0 );
+            }
             turbo = turboread1571;
             turbo_size = sizeof(turboread1571);
             break;
@@ -234,7 +246,8 @@ static int cbmcopy_read(CBM_FILE fd,
 
     SETSTATEDEBUG((void)0);    // pre send_turbo condition
     if(send_turbo(fd, drive, 0, settings,
-                  turbo, turbo_size, buf, 5, msg_cb) == 0)
+                  turbo, turbo_size, buf, 5,
+                  done & CBMCOPY_TURBO_RESIDENT, msg_cb) == 0)
     {
         msg_cb( sev_debug, "start of copy" );
         status_cb( blocks_read );
@@ -593,7 +606,7 @@ int cbmcopy_write_file(CBM_FILE fd,
 
     SETSTATEDEBUG((void)0);    // pre send_turbo condition
     if(send_turbo(fd, drive, 1, settings,
-                  turbo, turbo_size, (unsigned char*)"U4:", 3, msg_cb) == 0)
+                  turbo, turbo_size, (unsigned char*)"U4:", 3, 0, msg_cb) == 0)
     {
         msg_cb( sev_debug, "start of copy" );
         status_cb( blocks_written );
@@ -683,7 +696,7 @@ int cbmcopy_read_file_ts(CBM_FILE fd,
     return cbmcopy_read(fd, settings, (unsigned char) drive,
                         track, sector,
                         NULL, 0,
-                        filedata, filedata_size,
+                        filedata, filedata_size, 0,
                         msg_cb, status_cb);
 }
 
@@ -702,18 +715,418 @@ int cbmcopy_read_file(CBM_FILE fd,
     return cbmcopy_read(fd, settings, (unsigned char) drive,
                         0, 0,
                         cbmname, cbmname_len,
-                        filedata, filedata_size,
+                        filedata, filedata_size, 0,
                         msg_cb, status_cb);
 }
 
-/*! \brief write a data block of a file with a sequence of byte transfers
+/*
+ * Batch reading: the directory is read once, the drive is identified
+ * and set up once, and the turbo is kept in the drive for all files.
+ * The drive buffers of the turbo are allocated with "#2" and "#3", so
+ * that the DOS does not use them for the files in between.
+ *
+ * The files are handed to the caller by a thread of their own, so that
+ * storing one file overlaps with the transfer of the next one.
+ */
+#define BATCH_DEPTH     4
+#define BATCH_NAMESIZE  16
+
+typedef struct
+{
+    char name[BATCH_NAMESIZE + 1];
+    char type;
+} batch_dirent;
+
+typedef struct
+{
+    batch_dirent entry;
+    unsigned char *filedata;
+    size_t filedata_size;
+} batch_file;
+
+typedef struct
+{
+    cbmcopy_file_cb file_cb;
+    void *context;
+
+    arch_thread_t thread;
+    arch_mutex_t mutex;
+    arch_cond_t changed;
+
+    batch_file file[BATCH_DEPTH];
+    unsigned int head;   /* next entry to be filled by the reader */
+    unsigned int count;  /* number of entries not yet processed by the writer */
+    int finished;        /* the reader is done */
+
+    int errors;          /* files which were read, but could not be stored */
+} batch_writer;
+
+static int batch_store(batch_writer *writer, batch_file *file)
+{
+    if(writer->file_cb(writer->context, file->entry.name, file->entry.type,
+                       file->filedata, file->filedata_size))
+    {
+        writer->errors++;
+        return -1;
+    }
+    return 0;
+}
+
+static void batch_writer_thread(void *context)
+{
+    batch_writer *writer = context;
+    unsigned int tail = 0;
+
+    arch_mutex_lock(writer->mutex);
+    for(;;)
+    {
+        while(writer->count == 0 && !writer->finished)
+        {
+            arch_cond_wait(writer->changed, writer->mutex);
+        }
+        if(writer->count == 0)
+        {
+            break;
+        }
+        arch_mutex_unlock(writer->mutex);
+
+        batch_store(writer, &writer->file[tail]);
+        if(++tail == BATCH_DEPTH) tail = 0;
+
+        arch_mutex_lock(writer->mutex);
+        writer->count--;
+        arch_cond_signal(writer->changed);
+    }
+    arch_mutex_unlock(writer->mutex);
+}
+
+static int batch_writer_start(batch_writer *writer)
+{
+    if(arch_mutex_create(&writer->mutex) == 0)
+    {
+        if(arch_cond_create(&writer->changed) == 0)
+        {
+            if(arch_thread_create(&writer->thread, batch_writer_thread, writer) == 0)
+            {
+                return 0;
+            }
+            arch_cond_destroy(writer->changed);
+        }
+        arch_mutex_destroy(writer->mutex);
+    }
+    /* not fatal, the files are stored one after the other, then */
+    writer->mutex = NULL;
+    return -1;
+}
+
+static void batch_writer_put(batch_writer *writer, batch_file *file)
+{
+    if(writer->mutex == NULL)
+    {
+        batch_store(writer, file);
+        return;
+    }
+
+    arch_mutex_lock(writer->mutex);
+    while(writer->count == BATCH_DEPTH)
+    {
+        arch_cond_wait(writer->changed, writer->mutex);
+    }
+    arch_mutex_unlock(writer->mutex);
+
+    /* this entry is not accessed by the writer until count is incremented */
+    writer->file[writer->head] = *file;
+    if(++writer->head == BATCH_DEPTH) writer->head = 0;
+
+    arch_mutex_lock(writer->mutex);
+    writer->count++;
+    arch_cond_signal(writer->changed);
+    arch_mutex_unlock(writer->mutex);
+}
+
+/* wait until all files are stored, returns the number of failures */
+static int batch_writer_finish(batch_writer *writer)
+{
+    if(writer->mutex != NULL)
+    {
+        arch_mutex_lock(writer->mutex);
+        writer->finished = 1;
+        arch_cond_signal(writer->changed);
+        arch_mutex_unlock(writer->mutex);
+
+        arch_thread_join(writer->thread);
+        arch_cond_destroy(writer->changed);
+        arch_mutex_destroy(writer->mutex);
+    }
+    return writer->errors;
+}
+
+/*
+ * read the "$" listing and collect the files in it. Returns the number
+ * of entries, or -1 on error.
+ */
+static int read_directory(CBM_FILE fd, unsigned char drive,
+                          batch_dirent **entries,
+                          cbmcopy_message_cb msg_cb)
+{
+    static const char types[] = "DELSEQPRGUSRREL";
+    cbm_stream_t *stream;
+    batch_dirent *list = NULL;
+    batch_dirent *more;
+    unsigned char link[2];
+    char line[40];
+    char *name;
+    char *end;
+    const char *type;
+    int count = 0;
+    int size = 0;
+    int header = 1;
+    int len;
+    int c;
+
+    line[0] = '\0';
+    if(cbm_open( fd, drive, SA_READ, "$", 1 ) != 0 ||
+       cbm_device_status( fd, drive, line, sizeof(line) ) != 0)
+    {
+        msg_cb( sev_fatal, "could not read the directory: %s", line );
+        cbm_close( fd, drive, SA_READ );
+        return -1;
+    }
+
+    stream = cbm_stream_open_talk( fd, drive, SA_READ );
+
+    /* the load address, then one BASIC line per entry */
+    if(stream && cbm_stream_read( stream, link, 2 ) == 2)
+    {
+        while(cbm_stream_read( stream, link, 2 ) == 2 && (link[0] || link[1]))
+        {
+            /* the number of blocks, then the text */
+            if(cbm_stream_read( stream, line, 2 ) != 2)
+            {
+                break;
+            }
+            len = 0;
+            while((c = cbm_stream_getc( stream )) > 0)
+            {
+                if(len < (int) sizeof(line) - 1) line[len++] = (char) c;
+            }
+            line[len] = '\0';
+
+            /* the first line holds the disk name, the last one has no quotes */
+            name = strchr( line, '"' );
+            end = name ? strchr( name + 1, '"' ) : NULL;
+            if(header || end == NULL || end - name - 1 > BATCH_NAMESIZE)
+            {
+                header = 0;
+                continue;
+            }
+            *end++ = '\0';
+            while(*end == ' ') end++;
+
+            if(*end == '*')
+            {
+                msg_cb( sev_debug, "skipping \"%s\", it was not closed", name + 1 );
+                continue;
+            }
+            for(type = types; *type && strncmp( type, end, 3 ) != 0; type += 3)
+                ; /* nothing */
+            if(*type == '\0')
+            {
+                /* no file, e.g. a partition of a 1581 */
+                continue;
+            }
+
+            if(count == size)
+            {
+                size = size ? size * 2 : 32;
+                more = realloc( list, size * sizeof(*list) );
+                if(more == NULL)
+                {
+                    break;
+                }
+                list = more;
+            }
+            strcpy( list[count].name, name + 1 );
+            list[count].type = *type;
+            count++;
+        }
+    }
+    cbm_stream_close( stream );
+    cbm_close( fd, drive, SA_READ );
+
+    *entries = list;
+    return count;
+}
+
+/*
+ * match a name against a pattern of the DOS: '?' matches any character,
+ * '*' the rest of the name. ",T" at the end restricts the file type.
+ */
+static int name_matches(const char *pattern, const batch_dirent *entry)
+{
+    const char *name = entry->name;
+
+    while(*pattern && *pattern != ',' && *pattern != '*')
+    {
+        if(*name == '\0' || (*pattern != '?' && *pattern != *name))
+        {
+            return 0;
+        }
+        pattern++;
+        name++;
+    }
+    if(*pattern == '*')
+    {
+        /* the rest of the name does not matter */
+        while(*pattern && *pattern != ',') pattern++;
+    }
+    else if(*name != '\0')
+    {
+        return 0;
+    }
+    return *pattern == '\0' || pattern[1] == '\0' || pattern[1] == entry->type;
+}
+
+/* keep the buffers of the turbo away from the DOS, see above */
+static int reserve_turbo_buffers(CBM_FILE fd, unsigned char drive)
+{
+    char buf[48];
+
+    if(cbm_open( fd, drive, 2, "#2", 2 ) == 0 &&
+       cbm_device_status( fd, drive, buf, sizeof(buf) ) == 0)
+    {
+        if(cbm_open( fd, drive, 3, "#3", 2 ) == 0 &&
+           cbm_device_status( fd, drive, buf, sizeof(buf) ) == 0)
+        {
+            return 1;
+        }
+        cbm_close( fd, drive, 3 );
+    }
+    cbm_close( fd, drive, 2 );
+    return 0;
+}
+
+int cbmcopy_read_files(CBM_FILE fd,
+                       cbmcopy_settings *settings,
+                       int drivei,
+                       const char * const *patterns,
+                       int pattern_count,
+                       cbmcopy_message_cb msg_cb,
+                       cbmcopy_status_cb status_cb,
+                       cbmcopy_file_cb file_cb,
+                       void *context)
+{
+    unsigned char drive = (unsigned char) drivei;
+    batch_writer writer;
+    batch_dirent *entries = NULL;
+    batch_file file;
+    int count;
+    int matches = 0;
+    int errors = 0;
+    int reserved = 0;
+    int done = 0;
+    int i, j;
+
+    if(check_drive_type( fd, drive, settings, msg_cb ))
+    {
+        return -1;
+    }
+
+    count = read_directory( fd, drive, &entries, msg_cb );
+    if(count < 0)
+    {
+        return -1;
+    }
+
+    memset( &writer, 0, sizeof(writer) );
+    writer.file_cb = file_cb;
+    writer.context = context;
+    batch_writer_start( &writer );
+
+    if(transfers[settings->transfer_mode].abbrev[0] != 'o')
+    {
+        switch(settings->drive_type)
+        {
+            case cbm_dt_cbm1541:
+            case cbm_dt_cbm1570:
+            case cbm_dt_cbm1571:
+            case cbm_dt_cbm1581:
+                reserved = reserve_turbo_buffers( fd, drive );
+                if(!reserved)
+                {
+                    msg_cb( sev_debug, "could not allocate the turbo buffers" );
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        for(j = 0; j < pattern_count && !name_matches( patterns[j], &entries[i] ); j++)
+            ; /* nothing */
+        if(j == pattern_count)
+        {
+            continue;
+        }
+        if(entries[i].type == 'D' && patterns[j][strcspn( patterns[j], "," )] == '\0')
+        {
+            /* usually, these are separators in the listing */
+            continue;
+        }
+        matches++;
+
+        if(entries[i].type == 'R')
+        {
+            msg_cb( sev_warning, "skipping \"%s\", relative files are not supported",
+                    entries[i].name );
+            errors++;
+            continue;
+        }
+
+        msg_cb( sev_debug, "reading \"%s\"", entries[i].name );
+
+        file.entry = entries[i];
+        if(cbmcopy_read( fd, settings, drive, 0, 0,
+                         entries[i].name, strlen( entries[i].name ),
+                         &file.filedata, &file.filedata_size, done,
+                         msg_cb, status_cb ) == 0)
+        {
+            done = CBMCOPY_DRIVE_SET_UP | (reserved ? CBMCOPY_TURBO_RESIDENT : 0);
+            batch_writer_put( &writer, &file );
+        }
+        else
+        {
+            /* who knows what the drive did, check everything again */
+            done = CBMCOPY_DRIVE_SET_UP;
+            msg_cb( sev_warning, "error reading \"%s\"", entries[i].name );
+            free( file.filedata );
+            errors++;
+        }
+    }
+
+    if(reserved)
+    {
+        cbm_close( fd, drive, 3 );
+        cbm_close( fd, drive, 2 );
+    }
+
+    errors += batch_writer_finish( &writer );
+    free( entries );
+
+    if(matches == 0)
+    {
+        msg_cb( sev_warning, "no file matches" );
+    }
+    return errors;
+}
+
+/*! \brief write a data block of a file with the protocol of a drive program
 
  \param HandleDevice
    Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
 
- \param wb_func
-    Callback to the write_byte function
-
  \param data
     Pointer to buffer which contains the data to be written to the OpenCBM backend
 
@@ -722,6 +1135,9 @@ int cbmcopy_read_file(CBM_FILE fd,
     or 255, to transfer 254 bytes from the buffer and tell the turbo write routine
     that more blocks are following
 
+ \param protocol
+    The protocol of the drive program
+
  \param msg_cb
     Handle to cbmcopy's log message handler
 
@@ -729,21 +1145,18 @@ int cbmcopy_read_file(CBM_FILE fd,
     The number of bytes actually written, 0 on OpenCBM backend error.
     If there is a fatal error, returns -1.
 */
-int write_block_generic(CBM_FILE HandleDevice, const void *data, unsigned char size, write_byte_t wb_func, cbmcopy_message_cb msg_cb)
+int write_block_generic(CBM_FILE HandleDevice, const void *data, unsigned char size, enum cbm_block_protocol_e protocol, cbmcopy_message_cb msg_cb)
 {
-    int rv = 0;
-    const unsigned char *pbuffer = data;
-
     SETSTATEDEBUG((void)0);
 #ifdef LIBCBMCOPY_DEBUG
     msg_cb( sev_debug, "send byte count: %d", size );
 #endif
-    if ( (pbuffer == NULL) || (wb_func( HandleDevice, size ) != 0) )
+    if ( (data == NULL) || (cbm_block_write( HandleDevice, protocol, &size, 1 ) != 1) )
     {
         return -1;
     }
+    SETSTATEDEBUG((void)0);
 
-    SETSTATEDEBUG(DebugByteCount=0);
     if( size == 0xff )
     {
         size--;
@@ -752,24 +1165,11 @@ int write_block_generic(CBM_FILE HandleDevice, const void *data, unsigned char s
 #ifdef LIBCBMCOPY_DEBUG
     msg_cb( sev_debug, "send block data" );
 #endif
-    while( size>0 )
-    {
-        SETSTATEDEBUG(DebugByteCount++);
-        if ( wb_func( HandleDevice, *(pbuffer++) ) != 0 )
-        {
-            break;
-        }
-        rv++;
-        size--;
-    }
-
-    /* (drive is busy now) */
-    SETSTATEDEBUG(DebugByteCount=-1);
-
-    return rv;
+    /* (drive is busy afterwards) */
+    return cbm_block_write( HandleDevice, protocol, data, size );
 }
 
-/*! \brief read a data block of a file with a sequence of byte transfers
+/*! \brief read a data block of a file with the protocol of a drive program
 
  \param HandleDevice
    Pointer to a CBM_FILE which will contain the file handle of the OpenCBM backend
@@ -780,8 +1180,8 @@ int write_block_generic(CBM_FILE HandleDevice, const void *data, unsigned char s
  \param size
     The maximum size of the buffer
 
- \param rb_func
-    Callback to the read_byte function
+ \param protocol
+    The protocol of the drive program
 
  \param msg_cb
     Handle to cbmcopy's log message handler
@@ -791,15 +1191,17 @@ int write_block_generic(CBM_FILE HandleDevice, const void *data, unsigned char s
     255, if more blocks are following within this file chain.
     If there is a fatal error, returns -1.
 */
-int read_block_generic(CBM_FILE HandleDevice, void *data, size_t size, read_byte_t rb_func, cbmcopy_message_cb msg_cb)
+int read_block_generic(CBM_FILE HandleDevice, void *data, size_t size, enum cbm_block_protocol_e protocol, cbmcopy_message_cb msg_cb)
 {
     int rv = 0;
     unsigned char c;
-    unsigned char *pbuffer = data;
 
     SETSTATEDEBUG((void)0);
     /* get the number of bytes that need to be transferred for this block */
-    c = rb_func( HandleDevice );
+    if( cbm_block_read( HandleDevice, protocol, &c, 1 ) != 1 )
+    {
+        return -1;
+    }
     SETSTATEDEBUG((void)0);
 #ifdef LIBCBMCOPY_DEBUG
     msg_cb( sev_debug, "received byte count: %d", c );
@@ -812,7 +1214,7 @@ int read_block_generic(CBM_FILE HandleDevice, void *data, size_t size, read_byte
         c--;
     }
 
-    if( (pbuffer == NULL) || (c > size) )
+    if( (data == NULL) || (c > size) )
     {
         /* If the block size if greater than the available buffer, return with
          * a fatal error since the turbo handlers always need to transfer a
@@ -821,19 +1223,9 @@ int read_block_generic(CBM_FILE HandleDevice, void *data, size_t size, read_byte
         return -1;
     }
 
-    SETSTATEDEBUG(DebugByteCount=0);
 #ifdef LIBCBMCOPY_DEBUG
     msg_cb( sev_debug, "receive block data (%d)", c );
 #endif
-    while( c>0 )
-    {
-        SETSTATEDEBUG(DebugByteCount++);
-        *(pbuffer++) = rb_func( HandleDevice );
-        c--;
-    }
-
-    /* (drive is busy now) */
-    SETSTATEDEBUG(DebugByteCount=-1);
-
-    return rv;
+    /* (drive is busy afterwards) */
+    return (cbm_block_read( HandleDevice, protocol, data, c ) != c) ? -1 : rv;
 }
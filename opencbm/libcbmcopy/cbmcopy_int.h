@@ -33,13 +33,9 @@ typedef struct {
     void (*exit_turbo)(CBM_FILE,int);
 } transfer_funcs;
 
-/* callbacks from generic block handlers to the transfer function modules */
-typedef int           (*write_byte_t)(CBM_FILE,unsigned char);
-typedef unsigned char (*read_byte_t)(CBM_FILE);
-
-/* generic block handlers to the transfer data with single byte transfers */
-int write_block_generic(CBM_FILE,const void *,unsigned char,write_byte_t,cbmcopy_message_cb);
-int read_block_generic(CBM_FILE,void *,size_t,read_byte_t,cbmcopy_message_cb);
+/* generic block handlers to transfer the data with the protocol of the drive program */
+int write_block_generic(CBM_FILE,const void *,unsigned char,enum cbm_block_protocol_e,cbmcopy_message_cb);
+int read_block_generic(CBM_FILE,void *,size_t,enum cbm_block_protocol_e,cbmcopy_message_cb);
 
 #define DECLARE_TRANSFER_FUNCS(x) \
     transfer_funcs cbmcopy_ ## x = {write_blk, read_blk, check_error, \
@@ -13,12 +13,6 @@
 
 #include <stdlib.h>
 
-#include "opencbm-plugin.h"
-
-static opencbm_plugin_s1_read_n_t * opencbm_plugin_s1_read_n = NULL;
-
-static opencbm_plugin_s1_write_n_t * opencbm_plugin_s1_write_n = NULL;
-
 static const unsigned char s1r15x1[] = {
 #include "s1r.inc"
 };
@@ -47,9 +41,6 @@ static struct drive_prog
     { s1w1581, sizeof(s1w1581) }
 };
 
-static int write_byte(CBM_FILE,unsigned char);
-static unsigned char read_byte(CBM_FILE);
-
 /*! \brief write a data block of a file to the OpenCBM backend
 
  \param HandleDevice
@@ -72,34 +63,7 @@ static unsigned char read_byte(CBM_FILE);
 */
 static int write_blk(CBM_FILE HandleDevice, const void *Buffer, unsigned char Count, cbmcopy_message_cb msg_cb)
 {
-    if (opencbm_plugin_s1_write_n)
-    {
-#ifdef LIBCBMCOPY_DEBUG
-        msg_cb( sev_debug, "send byte count: %d", Count );
-#endif
-        SETSTATEDEBUG((void)0);
-        if ( (Buffer == NULL) || (opencbm_plugin_s1_write_n( HandleDevice, &Count, 1 ) != 1) )
-        {
-            return -1;
-        }
-        SETSTATEDEBUG((void)0);
-
-        if( Count == 0xff )
-        {
-            Count--;
-        }
-
-#ifdef LIBCBMCOPY_DEBUG
-        msg_cb( sev_debug, "send block data" );
-#endif
-        return opencbm_plugin_s1_write_n( HandleDevice, Buffer, Count );
-    }
-    else
-    {
-        SETSTATEDEBUG((void)0);
-        /* call generic byte oriented block handler */
-        return write_block_generic(HandleDevice, Buffer, Count, &write_byte, msg_cb);
-    }
+    return write_block_generic(HandleDevice, Buffer, Count, cbm_bp_s1, msg_cb);
 }
 
 /*! \brief read a data block of a file from the OpenCBM backend
@@ -123,127 +87,7 @@ static int write_blk(CBM_FILE HandleDevice, const void *Buffer, unsigned char Co
 */
 static int read_blk(CBM_FILE HandleDevice, void *Buffer, size_t Count, cbmcopy_message_cb msg_cb)
 {
-    unsigned char c;
-    int rv = 0;
-
-    if (opencbm_plugin_s1_read_n)
-    {
-        SETSTATEDEBUG((void)0);
-        /* get the number of bytes that need to be transferred for this block */
-        if( opencbm_plugin_s1_read_n(HandleDevice, &c, 1) != 1 )
-        {
-            return -1;
-        }
-#ifdef LIBCBMCOPY_DEBUG
-        msg_cb( sev_debug, "received byte count: %d", c );
-#endif
-        SETSTATEDEBUG((void)0);
-        rv = c;
-
-        if( c == 0xff )
-        {
-            /* this is a flag that further bytes are following, so get a full block of 254 bytes */
-            c--;
-        }
-        if( (Buffer == NULL) || (c > Count) )
-        {
-            /* If the block size if greater than the available buffer, return with
-             * a fatal error since the turbo handlers always need to transfer a
-             * complete block. If there is no buffer allocated at all, fail also.
-             */
-            return -1;
-        }
-#ifdef LIBCBMCOPY_DEBUG
-        msg_cb( sev_debug, "receive block data (%d)", c );
-#endif
-        return (opencbm_plugin_s1_read_n(HandleDevice, Buffer, c) != c )? -1 : rv;
-        /* (drive is busy now) */
-    }
-    else
-    {
-        /* call generic byte oriented block handler */
-    return read_block_generic(HandleDevice, Buffer, Count, &read_byte, msg_cb);
-    }
-}
-
-static int write_byte(CBM_FILE fd, unsigned char c)
-{
-    int b, i;
-                                                                        SETSTATEDEBUG((void)0);
-    for(i=7; i>=0; i--) {
-        b=(c >> i) & 1;
-                                                                        SETSTATEDEBUG(DebugBitCount=i);
-        if(b) cbm_iec_set(fd, IEC_DATA); else cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 1);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        if(b) cbm_iec_release(fd, IEC_DATA); else cbm_iec_set(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 1);
-#endif
-    }
-                                                                        SETSTATEDEBUG(DebugBitCount=-1);
-    return 0;
-}
-
-static unsigned char read_byte(CBM_FILE fd)
-{
-    int b=0, i;
-    unsigned char c;
-                                                                        SETSTATEDEBUG((void)0);
-    c = 0;
-    for(i=7; i>=0; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-        b = cbm_iec_get(fd, IEC_CLOCK);
-        c = (c >> 1) | (b ? 0x80 : 0);
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(b == cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, !b);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 1);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_CLOCK);
-    }
-                                                                        SETSTATEDEBUG(DebugBitCount=-1);
-    return c;
+    return read_block_generic(HandleDevice, Buffer, Count, cbm_bp_s1, msg_cb);
 }
 
 static int check_error(CBM_FILE fd, int write)
@@ -289,14 +133,11 @@ static int upload_turbo(CBM_FILE fd, unsigned char drive,
     const struct drive_prog *p;
     int dt;
 
-    opencbm_plugin_s1_read_n = cbm_get_plugin_function_address("opencbm_plugin_s1_read_n");
-    opencbm_plugin_s1_write_n = cbm_get_plugin_function_address("opencbm_plugin_s1_write_n");
-
     dt = (drive_type == cbm_dt_cbm1581);
     p = &drive_progs[dt * 2 + (write != 0)];
 
                                                                         SETSTATEDEBUG((void)0);
-    cbm_upload(fd, drive, 0x680, p->prog, p->size);
+    cbm_upload_cached(fd, drive, 0x680, p->prog, p->size);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
@@ -326,10 +167,6 @@ static void exit_turbo(CBM_FILE fd, int write)
                                                                         SETSTATEDEBUG((void)0);
 //    cbm_iec_wait(fd, IEC_DATA, 0);
                                                                         SETSTATEDEBUG((void)0);
-
-    opencbm_plugin_s1_read_n = NULL;
-
-    opencbm_plugin_s1_write_n = NULL;
 }
 
 DECLARE_TRANSFER_FUNCS(s1_transfer);
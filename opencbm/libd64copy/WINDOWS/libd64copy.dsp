@@ -133,6 +133,37 @@ SOURCE=..\gcr.h
 # PROP Default_Filter "a65"
 # Begin Source File
 
+SOURCE=..\loader.a65
+
+!IF  "$(CFG)" == "libd64copy - Win32 Release"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\libd64copy
+InputPath=..\loader.a65
+InputName=loader
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ELSEIF  "$(CFG)" == "libd64copy - Win32 Debug"
+
+# Begin Custom Build
+InputDir=\cygwin\home\tri\cbm\opencbm\libd64copy
+InputPath=..\loader.a65
+InputName=loader
+
+"$(InputDir)\$(InputName).inc" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+	..\..\WINDOWS\buildoneinc ..\.. $(InputPath)
+
+# End Custom Build
+
+!ENDIF 
+
+# End Source File
+# Begin Source File
+
 SOURCE=..\pp1541.a65
 
 !IF  "$(CFG)" == "libd64copy - Win32 Release"
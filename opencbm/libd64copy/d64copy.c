@@ -77,6 +77,21 @@ static const unsigned char turbo_write_1571[] =
 #include "turbowrite1571.inc"
 };
 
+static const unsigned char turbo_loader[] =
+{
+#include "loader.inc"
+};
+
+/* where the loader and the turbo live in drive memory */
+enum
+{
+    LOADER_ADDRESS = 0x300,
+    TURBO_ADDRESS  = 0x500,
+    TURBO_ENTRY    = 0x503, /* the "U4" vector */
+    TURBO_END      = 0x700, /* the transfer protocol starts here */
+    LOADER_RETRIES = 3
+};
+
 static const struct drive_prog
 {
     int size;
@@ -94,41 +109,115 @@ static const struct drive_prog
 };
 
 
+/* the largest interleave accepted, and tried by d64copy_tune() */
+#define MAX_INTERLEAVE 17
+
 static const int default_interleave[] = { -1, 17, 4, 13, 7, -1 };
 static const int warp_write_interleave[] = { -1, 0, 6, 12, 4, -1 };
 
 
-/*
- * Variables to make sure writing a block is an atomary process
- */
-static int atom_mustcleanup = 0;
-static const transfer_funcs *atom_dst;
-
-
 #ifdef LIBD64COPY_DEBUG
-    volatile signed int DebugLineNumber=-1, DebugBlockCount=-1,
-                        DebugByteCount=-1,  DebugBitCount=-1;
-    volatile char *     DebugFileName   = "";
-
     void printDebugLibD64Counters(d64copy_message_cb msg_cb)
     {
+        const char *file = "";
+        int line = -1;
+
+        DebugTraceLast(&file, &line);
+
         msg_cb( sev_info, "file: %s"
                           "\n\tversion: " OPENCBM_VERSION ", built: " __DATE__ " " __TIME__
                           "\n\tline=%d, blocks=%d, bytes=%d, bits=%d\n",
-                          DebugFileName, DebugLineNumber,
+                          file, line,
                           DebugBlockCount, DebugByteCount,
                           DebugBitCount);
     }
 #endif
 
-static int send_turbo(CBM_FILE fd, unsigned char drv, int write, int warp, int drv_type)
+static const struct drive_prog *select_turbo(int write, int warp, int drv_type)
 {
-    const struct drive_prog *prog;
+    return &drive_progs[drv_type * 4 + warp * 2 + write];
+}
 
-    prog = &drive_progs[drv_type * 4 + warp * 2 + write];
+static int send_turbo(CBM_FILE fd, unsigned char drv, const struct drive_prog *prog)
+{
+    SETSTATEDEBUG((void)0);
+    return cbm_upload(fd, drv, TURBO_ADDRESS, prog->prog, prog->size);
+}
+
+/*
+ * Writing the turbo with "M-W" takes one command, with its own
+ * listen/unlisten, per 32 bytes. Instead, only the small loader is
+ * written this way, and started instead of the turbo. It receives the
+ * turbo pages over the transfer protocol which is already in the drive,
+ * answers each of them with a checksum and finally starts the turbo.
+ * The host side of this is a sequence of "write block" exchanges, thus
+ * the transfer module does not need to know about it.
+ * This is only done with settings->turbo_loader ("--turbo-loader"), as
+ * the loader has not been tried with enough drives yet.
+ */
+static int start_loader(CBM_FILE fd, unsigned char drive)
+{
+    static const unsigned char cmd[] =
+        { 'M', '-', 'E', LOADER_ADDRESS % 256, LOADER_ADDRESS / 256 };
+
+    SETSTATEDEBUG((void)0);
+    if(cbm_upload(fd, drive, LOADER_ADDRESS, turbo_loader, sizeof(turbo_loader))
+       != sizeof(turbo_loader))
+    {
+        return -1;
+    }
+    SETSTATEDEBUG((void)0);
+    return cbm_exec_command(fd, drive, cmd, sizeof(cmd));
+}
+
+static int load_turbo(const transfer_funcs *transf, void *state,
+                      const struct drive_prog *prog)
+{
+    unsigned char page[BLOCKSIZE];
+    unsigned char sum;
+    int addr, size, i, retry, st;
+
+    if(TURBO_ADDRESS + prog->size > TURBO_END)
+    {
+        return -1;
+    }
+
+    for(addr = TURBO_ADDRESS; addr < TURBO_ADDRESS + prog->size; addr += BLOCKSIZE)
+    {
+        size = TURBO_ADDRESS + prog->size - addr;
+        if(size > BLOCKSIZE)
+        {
+            size = BLOCKSIZE;
+        }
+
+        /* the loader always fills complete pages */
+        memset(page, 0, sizeof(page));
+        memcpy(page, prog->prog + (addr - TURBO_ADDRESS), size);
+
+        for(sum = 0, i = 0; i < BLOCKSIZE; i++)
+        {
+            sum += page[i];
+        }
+
+        retry = LOADER_RETRIES;
+        do
+        {
+            SETSTATEDEBUG((void)0);
+            st = transf->write_block(state, (unsigned char) (addr / 256), 0,
+                                     page, BLOCKSIZE, 0);
+        } while(st != sum && --retry > 0);
+
+        if(st != sum)
+        {
+            return -1;
+        }
+    }
 
+    /* start the turbo */
+    page[0] = TURBO_ENTRY % 256;
+    page[1] = TURBO_ENTRY / 256;
     SETSTATEDEBUG((void)0);
-    return cbm_upload(fd, drv, 0x500, prog->prog, prog->size);
+    return transf->write_block(state, 0, 1, page, 2, 0) == 0 ? 0 : -1;
 }
 
 extern transfer_funcs d64copy_fs_transfer,
@@ -137,8 +226,69 @@ extern transfer_funcs d64copy_fs_transfer,
                       d64copy_s1_transfer,
                       d64copy_s2_transfer;
 
-static d64copy_message_cb message_cb;
-static d64copy_status_cb status_cb;
+/*
+ * the context used by the non-reentrant API functions
+ */
+static d64copy_context default_context;
+
+int d64copy_wait_line(CBM_FILE fd, int line, int state)
+{
+    int timeout;
+
+    for(timeout = D64COPY_SYNC_TIMEOUT; timeout > 0; timeout--)
+    {
+        if((cbm_iec_get(fd, line) != 0) == (state != 0))
+        {
+            return 0;
+        }
+        arch_usleep(1000);
+    }
+    return -1;
+}
+
+int d64copy_queue_open(d64copy_queue *q, CBM_FILE fd, unsigned int protocol)
+{
+    q->fd = fd;
+    q->protocol = protocol;
+    q->read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_async_read_n");
+    q->write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_async_write_n");
+    q->wait = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_async_wait");
+
+    if(!q->read_n || !q->write_n || !q->wait)
+    {
+        q->wait = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+int d64copy_queue_block(d64copy_queue *q,
+                        const unsigned char *cmd, int cmd_size,
+                        const unsigned char *out, int out_size,
+                        unsigned char *status, int status_size,
+                        unsigned char *in, int in_size)
+{
+    int ret;
+
+    SETSTATEDEBUG((void)0);
+    ret = q->write_n(q->fd, q->protocol, cmd, cmd_size, NULL, NULL);
+    if(!ret && out_size > 0)
+    {
+        ret = q->write_n(q->fd, q->protocol, out, out_size, NULL, NULL);
+    }
+    if(!ret)
+    {
+        ret = q->read_n(q->fd, q->protocol, status, status_size, NULL, NULL);
+    }
+    if(!ret && in_size > 0)
+    {
+        ret = q->read_n(q->fd, q->protocol, in, in_size, NULL, NULL);
+    }
+    SETSTATEDEBUG((void)0);
+
+    /* even after an error, nothing may be left in flight on our buffers */
+    return (q->wait(q->fd, 0) || ret) ? -1 : 0;
+}
 
 int d64copy_sector_count(int two_sided, int track)
 {
@@ -176,6 +326,8 @@ d64copy_settings *d64copy_get_default_settings(void)
         settings->drive_type  = cbm_dt_unknown; /* auto detect later on */
         settings->two_sided   = 0;
         settings->error_mode  = em_on_error;
+        settings->atomic_write = 0;
+        settings->turbo_loader = 0;
     }
     return settings;
 }
@@ -188,10 +340,157 @@ static int start_turbo(CBM_FILE fd, unsigned char drive)
 }
 
 
-static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
-              const transfer_funcs *src, const void *src_arg,
-              const transfer_funcs *dst, const void *dst_arg, unsigned char cbm_drive)
+/*
+ * When reading a disk into an image file, the drive is the slow side.
+ * The blocks read are handed over to a writer thread through a bounded
+ * queue; that thread stores them into the image and reports the
+ * progress, while the drive is already busy with the next blocks.
+ *
+ * Writing into the image file only fails for blocks outside of the
+ * image, and copy_disk() never asks for those: the image is opened with
+ * the tracks which are copied. Thus, the reading side marks a block as
+ * copied as soon as it has been read, and the write result which the
+ * writer thread passes on to the status callback is always 0.
+ *
+ * The pipeline is remembered in the context, so that
+ * d64copy_cleanup_ex() can store the queued blocks before it closes
+ * the image.
+ */
+#define PIPELINE_DEPTH (2 * MAX_SECTORS)
+
+typedef struct
+{
+    unsigned char block[BLOCKSIZE];
+    d64copy_status status;
+} pipeline_entry;
+
+typedef struct d64copy_pipeline_s
+{
+    d64copy_context *ctx;
+
+    arch_thread_t thread;
+    arch_mutex_t mutex;
+    arch_cond_t changed;
+
+    pipeline_entry entry[PIPELINE_DEPTH];
+    unsigned int head;   /* next entry to be written by the reader */
+    unsigned int count;  /* number of entries not yet processed by the writer */
+    int finished;        /* the reader is done */
+} d64copy_pipeline;
+
+static void pipeline_writer(void *context)
+{
+    d64copy_pipeline *pipe = context;
+    d64copy_context *ctx = pipe->ctx;
+    unsigned int tail = 0;
+    pipeline_entry *e;
+
+    arch_mutex_lock(pipe->mutex);
+    for(;;)
+    {
+        while(pipe->count == 0 && !pipe->finished)
+        {
+            arch_cond_wait(pipe->changed, pipe->mutex);
+        }
+        if(pipe->count == 0)
+        {
+            break;
+        }
+        arch_mutex_unlock(pipe->mutex);
+
+        e = &pipe->entry[tail];
+        e->status.write_result =
+            ctx->dst->write_block(ctx->dst_state, (unsigned char) e->status.track,
+                                  (unsigned char) e->status.sector, e->block,
+                                  BLOCKSIZE, e->status.read_result);
+        ctx->status_cb(e->status);
+
+        if(++tail == PIPELINE_DEPTH) tail = 0;
+
+        arch_mutex_lock(pipe->mutex);
+        pipe->count--;
+        arch_cond_signal(pipe->changed);
+    }
+    arch_mutex_unlock(pipe->mutex);
+}
+
+static d64copy_pipeline *pipeline_start(d64copy_context *ctx)
+{
+    d64copy_pipeline *pipe = calloc(1, sizeof(*pipe));
+
+    if(pipe)
+    {
+        pipe->ctx = ctx;
+        if(arch_mutex_create(&pipe->mutex) == 0)
+        {
+            if(arch_cond_create(&pipe->changed) == 0)
+            {
+                if(arch_thread_create(&pipe->thread, pipeline_writer, pipe) == 0)
+                {
+                    return pipe;
+                }
+                arch_cond_destroy(pipe->changed);
+            }
+            arch_mutex_destroy(pipe->mutex);
+        }
+        free(pipe);
+    }
+    /* not fatal, we just do without */
+    return NULL;
+}
+
+static void pipeline_put(d64copy_pipeline *pipe, const unsigned char *block,
+                         const d64copy_status *status)
 {
+    pipeline_entry *e;
+
+    arch_mutex_lock(pipe->mutex);
+    while(pipe->count == PIPELINE_DEPTH)
+    {
+        arch_cond_wait(pipe->changed, pipe->mutex);
+    }
+    arch_mutex_unlock(pipe->mutex);
+
+    /* this entry is not accessed by the writer until count is incremented */
+    e = &pipe->entry[pipe->head];
+    memcpy(e->block, block, BLOCKSIZE);
+    e->status = *status;
+    if(++pipe->head == PIPELINE_DEPTH) pipe->head = 0;
+
+    arch_mutex_lock(pipe->mutex);
+    pipe->count++;
+    arch_cond_signal(pipe->changed);
+    arch_mutex_unlock(pipe->mutex);
+}
+
+/*
+ * wait until everything is written, and free the pipeline.
+ */
+static void pipeline_finish(d64copy_pipeline *pipe)
+{
+    pipe->ctx->pipe = NULL;
+
+    arch_mutex_lock(pipe->mutex);
+    pipe->finished = 1;
+    arch_cond_signal(pipe->changed);
+    arch_mutex_unlock(pipe->mutex);
+
+    arch_thread_join(pipe->thread);
+    arch_cond_destroy(pipe->changed);
+    arch_mutex_destroy(pipe->mutex);
+
+    free(pipe);
+}
+
+static int copy_disk(d64copy_context *ctx, CBM_FILE fd_cbm, d64copy_settings *settings,
+              const void *src_arg, const void *dst_arg, unsigned char cbm_drive)
+{
+    const transfer_funcs *src = ctx->src;
+    const transfer_funcs *dst = ctx->dst;
+    void *src_state = ctx->src_state;
+    void *dst_state = ctx->dst_state;
+    d64copy_message_cb message_cb = ctx->message_cb;
+    d64copy_status_cb status_cb = ctx->status_cb;
     unsigned char tr = 0;
     unsigned char se = 0;
     int st;
@@ -199,7 +498,6 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     unsigned char scnt = 0;
     unsigned char errors;
     int retry_count;
-    int resend_trackmap;
     int max_tracks;
     char trackmap[MAX_SECTORS+1];
     char buf[40];
@@ -208,7 +506,14 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     unsigned char bam2[BLOCKSIZE];
     unsigned char block[BLOCKSIZE];
     unsigned char gcr[GCRBUFSIZE];
+    unsigned char gcrtrack[GCRTRACKSIZE];
+    unsigned const char *rec = NULL;
+    char received[MAX_SECTORS];
     const transfer_funcs *cbm_transf = NULL;
+    void *cbm_state;
+    const struct drive_prog *turbo = NULL;
+    turbo_start start = start_turbo;
+    d64copy_pipeline *pipe = NULL;
     d64copy_status status;
     const char *sector_map;
     const char *type_str = "*unknown*";
@@ -223,7 +528,7 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     }
 
     if(settings->interleave != -1 &&
-           (settings->interleave < 1 || settings->interleave > 17))
+           (settings->interleave < 1 || settings->interleave > MAX_INTERLEAVE))
     {
         message_cb(0,
                 "invalid value (%d) for interleave", settings->interleave);
@@ -325,7 +630,7 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     SETSTATEDEBUG((void)0);
     cbm_transf = src->is_cbm_drive ? src : dst;
 
-    if(settings->warp && (cbm_transf->read_gcr_block == NULL))
+    if(settings->warp && (cbm_transf->read_gcr_track == NULL))
     {
         if(settings->warp>0)
             message_cb(1, "`-w' for this transfer mode ignored");
@@ -336,14 +641,33 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
 
     if(cbm_transf->needs_turbo)
     {
+        turbo = select_turbo(dst->is_cbm_drive, settings->warp,
+                             settings->drive_type == cbm_dt_cbm1541 ? 0 : 1);
+
         SETSTATEDEBUG((void)0);
-        send_turbo(fd_cbm, cbm_drive, dst->is_cbm_drive, settings->warp,
-                   settings->drive_type == cbm_dt_cbm1541 ? 0 : 1);
+        if(cbm_upload_is_resident(fd_cbm, cbm_drive, TURBO_ADDRESS,
+                                  turbo->prog, turbo->size) == 1)
+        {
+            /* still there from the last run, no need to load it */
+            message_cb(2, "turbo code is resident");
+            turbo = NULL;
+        }
+        else if(settings->turbo_loader)
+        {
+            /* the loader sends the turbo when the disk is open */
+            start = start_loader;
+        }
+        else
+        {
+            SETSTATEDEBUG((void)0);
+            send_turbo(fd_cbm, cbm_drive, turbo);
+            turbo = NULL;
+        }
     }
 
     SETSTATEDEBUG((void)0);
-    if(src->open_disk(fd_cbm, settings, src_arg, 0,
-                      start_turbo, message_cb) == 0)
+    if(src->open_disk(src_state, fd_cbm, settings, src_arg, 0,
+                      start, message_cb) == 0)
     {
         if(settings->end_track == -1)
         {
@@ -351,8 +675,8 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                 settings->two_sided ? D71_TRACKS : STD_TRACKS;
         }
         SETSTATEDEBUG((void)0);
-        if(dst->open_disk(fd_cbm, settings, dst_arg, 1,
-                          start_turbo, message_cb) != 0)
+        if(dst->open_disk(dst_state, fd_cbm, settings, dst_arg, 1,
+                          start, message_cb) != 0)
         {
             message_cb(0, "can't open destination");
             return -1;
@@ -364,6 +688,38 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
         return -1;
     }
 
+    if(turbo)
+    {
+        cbm_state = src->is_cbm_drive ? src_state : dst_state;
+
+        SETSTATEDEBUG((void)0);
+        if(load_turbo(cbm_transf, cbm_state, turbo) != 0)
+        {
+            /* the loader (or the turbo) returns to DOS on close */
+            message_cb(1, "turbo loader failed, using M-W");
+            cbm_transf->close_disk(cbm_state);
+
+            SETSTATEDEBUG((void)0);
+            send_turbo(fd_cbm, cbm_drive, turbo);
+            SETSTATEDEBUG((void)0);
+            if(cbm_transf->open_disk(cbm_state, fd_cbm, settings,
+                                     src->is_cbm_drive ? src_arg : dst_arg,
+                                     dst->is_cbm_drive, start_turbo,
+                                     message_cb) != 0)
+            {
+                message_cb(0, "can't open %s",
+                           src->is_cbm_drive ? "source" : "destination");
+                return -1;
+            }
+        }
+        else if(cbm_transf->sync_turbo(cbm_state) != 0)
+        {
+            /* like open_disk(), wait for the init of the turbo */
+            message_cb(0, "the turbo does not answer after the loader started it");
+            return -1;
+        }
+    }
+
     memset(status.bam, bs_invalid, MAX_TRACKS * MAX_SECTORS);
 
     if(settings->bam_mode != bm_ignore)
@@ -374,20 +730,21 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
             trackmap[0] = bs_must_copy;
             scnt = 1;
             SETSTATEDEBUG((void)0);
-            src->send_track_map(18, trackmap, scnt);
+            src->send_track_map(src_state, 18, trackmap, scnt);
             SETSTATEDEBUG(DebugBlockCount=0);
-            st = src->read_gcr_block(&se, gcr);
+            src->read_gcr_track(src_state, 1, gcrtrack);
             SETSTATEDEBUG(DebugBlockCount=-1);
-            if(st == 0) st = gcr_decode(gcr, bam);
+            st = gcrtrack[1];
+            if(st == 0) st = gcr_decode(gcrtrack + 2, bam);
         }
         else
         {
             SETSTATEDEBUG(DebugBlockCount=0);
-            st = src->read_block(18, 0, bam);
+            st = src->read_block(src_state, 18, 0, bam);
             if(settings->two_sided && (st == 0))
             {
                 SETSTATEDEBUG(DebugBlockCount=1);
-                st = src->read_block(53, 0, bam2);
+                st = src->read_block(src_state, 53, 0, bam2);
             }
             SETSTATEDEBUG(DebugBlockCount=-1);
         }
@@ -446,6 +803,11 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     message_cb(2, "copying tracks %d-%d (%d sectors)",
             settings->start_track, settings->end_track, status.total_sectors);
 
+    if(src->is_cbm_drive && !dst->is_cbm_drive)
+    {
+        pipe = ctx->pipe = pipeline_start(ctx);
+    }
+
     SETSTATEDEBUG(DebugBlockCount=0);
     for(tr = 1; tr <= max_tracks; tr++)
     {
@@ -467,42 +829,76 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
             retry_count = settings->retries;
             do
             {
-                errors = resend_trackmap = 0;
+                errors = 0;
                 if(scnt && settings->warp && src->is_cbm_drive)
                 {
                     SETSTATEDEBUG((void)0);
-                    src->send_track_map(tr, trackmap, scnt);
+                    src->send_track_map(src_state, tr, trackmap, scnt);
+                    SETSTATEDEBUG((void)0);
+                    st = src->read_gcr_track(src_state, scnt, gcrtrack);
+                    memset(received, 0, sizeof(received));
+                    for(rec = gcrtrack; rec < gcrtrack + st * GCRRECSIZE; rec += GCRRECSIZE)
+                    {
+                        if(rec[0] >= sector_map[tr] || !NEED_SECTOR(trackmap[rec[0]]) ||
+                           received[rec[0]]++)
+                        {
+                            break;
+                        }
+                    }
+                    if(rec < gcrtrack + st * GCRRECSIZE)
+                    {
+                        /* the transfer is garbled, read the whole track again */
+                        for(se = 0; se < sector_map[tr]; se++)
+                        {
+                            if(NEED_SECTOR(trackmap[se]))
+                            {
+                                trackmap[se] = bs_error;
+                                errors++;
+                            }
+                        }
+                        scnt = 0;
+
+                        /* the drive must be waiting for the next track map */
+                        SETSTATEDEBUG((void)0);
+                        if(src->sync_turbo(src_state) != 0)
+                        {
+                            message_cb(0, "the drive program does not answer");
+                            cnt = -1;
+                            break;
+                        }
+                    }
+                    else
+                    {
+                        /* after an error, the drive gives up the rest of the track */
+                        for(se = 0; se < sector_map[tr]; se++)
+                        {
+                            if(NEED_SECTOR(trackmap[se]) && !received[se])
+                            {
+                                trackmap[se] = bs_error;
+                                errors++;
+                            }
+                        }
+                        scnt = (unsigned char) st;
+                    }
+                    rec = gcrtrack;
                 }
                 else
                 {
                     se = 0;
                 }
-                while(scnt && !resend_trackmap)
+                while(scnt)
                 {
                     if(settings->warp && src->is_cbm_drive)
                     {
-                        SETSTATEDEBUG((void)0);
-                        status.read_result = src->read_gcr_block(&se, gcr);
+                        /* the next sector of the track read above */
+                        se = rec[0];
+                        status.read_result = rec[1];
                         if(status.read_result == 0)
                         {
                             SETSTATEDEBUG((void)0);
-                            status.read_result = gcr_decode(gcr, block);
-                        }
-                        else
-                        {
-                            /* mark all sectors not received so far */
-                            /* ugly */
-                            errors = 0;
-                            for(scnt = 0; scnt < sector_map[tr]; scnt++)
-                            {
-                                if(NEED_SECTOR(trackmap[scnt]) && scnt != se)
-                                {
-                                    trackmap[scnt] = bs_error;
-                                    errors++;
-                                }
-                            }
-                            resend_trackmap = 1;
+                            status.read_result = gcr_decode(rec + 2, block);
                         }
+                        rec += GCRRECSIZE;
                     }
                     else
                     {
@@ -511,7 +907,7 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                             if(++se >= sector_map[tr]) se = 0;
                         }
                         SETSTATEDEBUG(DebugBlockCount++);
-                        status.read_result = src->read_block(tr, se, block);
+                        status.read_result = src->read_block(src_state, tr, se, block);
                     }
 
                     if(settings->warp && dst->is_cbm_drive)
@@ -520,14 +916,19 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                         gcr_encode(block, gcr);
                         SETSTATEDEBUG(DebugBlockCount++);
                         status.write_result =
-                            dst->write_block(tr, se, gcr, GCRBUFSIZE-1,
+                            dst->write_block(dst_state, tr, se, gcr, GCRBUFSIZE-1,
                                              status.read_result);
                     }
+                    else if(pipe)
+                    {
+                        /* pipeline_writer() stores the block, this cannot fail */
+                        status.write_result = 0;
+                    }
                     else
                     {
                         SETSTATEDEBUG(DebugBlockCount++);
                         status.write_result =
-                            dst->write_block(tr, se, block, BLOCKSIZE,
+                            dst->write_block(dst_state, tr, se, block, BLOCKSIZE,
                                              status.read_result);
                     }
                     SETSTATEDEBUG((void)0);
@@ -570,15 +971,19 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                         }
                     }
                     /* remaining sectors on this track */
-                    if(!resend_trackmap)
-                    {
-                        scnt--;
-                    }
+                    scnt--;
 
                     status.track = tr;
                     status.sector= se;
 
-                    status_cb(status);
+                    if(pipe)
+                    {
+                        pipeline_put(pipe, block, &status);
+                    }
+                    else
+                    {
+                        status_cb(status);
+                    }
 
                     if(dst->is_cbm_drive || !settings->warp)
                     {
@@ -593,6 +998,10 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
                 }
             }
             while(retry_count >= 0 && errors > 0);
+            if(cnt < 0)
+            {
+                break;
+            }
             if(errors)
             {
                 message_cb(1, "giving up...");
@@ -615,9 +1024,14 @@ static int copy_disk(CBM_FILE fd_cbm, d64copy_settings *settings,
     }
     SETSTATEDEBUG(DebugBlockCount=-1);
 
-    dst->close_disk();
+    if(pipe)
+    {
+        pipeline_finish(pipe);
+    }
+
+    dst->close_disk(dst_state);
     SETSTATEDEBUG((void)0);
-    src->close_disk();
+    src->close_disk(src_state);
 
     SETSTATEDEBUG((void)0);
     return cnt;
@@ -709,6 +1123,49 @@ int d64copy_get_transfer_mode_index(const char *name)
     return -1;
 }
 
+/*
+ * check if there is a parallel (XP1541/XP1571) cable to the drive
+ */
+static int has_parallel_cable(CBM_FILE cbm_fd, int drive)
+{
+    enum cbm_cable_type_e cable_type;
+
+    SETSTATEDEBUG((void)0);
+    return cbm_identify_xp1541(cbm_fd, (unsigned char)drive, NULL, &cable_type) == 0
+        && cable_type == cbm_ct_xp1541;
+}
+
+/*
+ * check if the drive is the only one on the bus; serial2 does not
+ * work otherwise
+ */
+static int is_only_drive(CBM_FILE cbm_fd, int drive)
+{
+    unsigned char testdrive;
+
+    for (testdrive = 4; testdrive < 31; ++testdrive)
+    {
+        enum cbm_device_type_e device_type;
+
+        /* of course, the drive to be transfered to is present! */
+        if (testdrive == drive)
+            continue;
+
+        SETSTATEDEBUG((void)0);
+        if (cbm_identify(cbm_fd, testdrive, &device_type, NULL) == 0)
+        {
+            /*
+             * My bad, there is another drive
+             */
+            SETSTATEDEBUG((void)0);
+            return 0;
+        }
+    }
+
+    SETSTATEDEBUG((void)0);
+    return 1;
+}
+
 int d64copy_check_auto_transfer_mode(CBM_FILE cbm_fd, int auto_transfermode, int drive)
 {
     int transfermode = auto_transfermode;
@@ -718,96 +1175,142 @@ int d64copy_check_auto_transfer_mode(CBM_FILE cbm_fd, int auto_transfermode, int
 
     if (auto_transfermode == 0)
     {
-        do {
-            enum cbm_cable_type_e cable_type;
-            unsigned char testdrive;
-
+        if (has_parallel_cable(cbm_fd, drive))
+        {
             /*
-             * Test the cable
+             * We have a parallel cable, use that
              */
-
-            SETSTATEDEBUG((void)0);
-            if (cbm_identify_xp1541(cbm_fd, (unsigned char)drive, NULL, &cable_type) == 0)
-            {
-                if (cable_type == cbm_ct_xp1541)
-                {
-                    /*
-                     * We have a parallel cable, use that
-                     */
-                    SETSTATEDEBUG((void)0);
-                    transfermode = d64copy_get_transfer_mode_index("parallel");
-                    break;
-                }
-            }
-
+            transfermode = d64copy_get_transfer_mode_index("parallel");
+        }
+        else if (is_only_drive(cbm_fd, drive))
+        {
             /*
-             * We do not have a parallel cable. Check if we are the only drive
-             * on the bus, so we can use serial2, at least.
+             * We do not have a parallel cable, but we are the only
+             * drive on the bus, so we can use serial2, at least.
              */
+            transfermode = d64copy_get_transfer_mode_index("serial2");
+        }
+        else
+        {
+            transfermode = d64copy_get_transfer_mode_index("serial1");
+        }
+    }
 
-            for (testdrive = 4; testdrive < 31; ++testdrive)
-            {
-                enum cbm_device_type_e device_type;
+    SETSTATEDEBUG((void)0);
+    return transfermode;
+}
+
+d64copy_context *d64copy_create_context(void)
+{
+    return calloc(1, sizeof(d64copy_context));
+}
 
-                /* of course, the drive to be transfered to is present! */
-                if (testdrive == drive)
-                    continue;
+void d64copy_destroy_context(d64copy_context *ctx)
+{
+    free(ctx);
+}
 
-                SETSTATEDEBUG((void)0);
-                if (cbm_identify(cbm_fd, testdrive, &device_type, NULL) == 0)
-                {
-                    /*
-                     * My bad, there is another drive -> only use serial1
-                     */
-                    SETSTATEDEBUG((void)0);
-                    transfermode = d64copy_get_transfer_mode_index("serial1");
-                    break;
-                }
-            }
+/*
+ * allocate the transfer states, run the copy, and free them again
+ */
+static int run_copy(d64copy_context *ctx, CBM_FILE cbm_fd,
+                    d64copy_settings *settings,
+                    const transfer_funcs *src, const void *src_arg,
+                    const transfer_funcs *dst, const void *dst_arg,
+                    unsigned char cbm_drive, int must_cleanup)
+{
+    int ret = -1;
 
-            /*
-             * If we reached here with transfermode 0, we are the only
-             * drive, thus, use serial2.
-             */
-            SETSTATEDEBUG((void)0);
-            if (transfermode == 0)
-                transfermode = d64copy_get_transfer_mode_index("serial2");
-            SETSTATEDEBUG((void)0);
+    ctx->src = src;
+    ctx->dst = dst;
+    ctx->src_state = calloc(1, src->state_size);
+    ctx->dst_state = calloc(1, dst->state_size);
+
+    if(ctx->src_state && ctx->dst_state)
+    {
+        ctx->atom_mustcleanup = must_cleanup;
+
+        SETSTATEDEBUG((void)0);
+        ret = copy_disk(ctx, cbm_fd, settings, src_arg, dst_arg, cbm_drive);
 
-        } while (0);
+        ctx->atom_mustcleanup = 0;
+    }
+    else
+    {
+        ctx->message_cb(0, "no memory for transfer state");
     }
 
-    SETSTATEDEBUG((void)0);
-    return transfermode;
+    free(ctx->src_state);
+    free(ctx->dst_state);
+    ctx->src_state = ctx->dst_state = NULL;
+
+    return ret;
 }
 
-int d64copy_read_image(CBM_FILE cbm_fd,
-                       d64copy_settings *settings,
-                       int src_drive,
-                       const char *dst_image,
-                       d64copy_message_cb msg_cb,
-                       d64copy_status_cb stat_cb)
+int d64copy_read_image_ex(d64copy_context *ctx,
+                          CBM_FILE cbm_fd,
+                          d64copy_settings *settings,
+                          int src_drive,
+                          const char *dst_image,
+                          d64copy_message_cb msg_cb,
+                          d64copy_status_cb stat_cb)
 {
-    const transfer_funcs *src;
-    const transfer_funcs *dst;
-    int ret;
+    ctx->message_cb = msg_cb;
+    ctx->status_cb = stat_cb;
 
-    message_cb = msg_cb;
-    status_cb = stat_cb;
+    return run_copy(ctx, cbm_fd, settings,
+            transfers[settings->transfer_mode].trf, (void*)(ULONG_PTR)src_drive,
+            &d64copy_fs_transfer, (void*)dst_image,
+            (unsigned char) src_drive, 1);
+}
 
-    src = transfers[settings->transfer_mode].trf;
-    dst = &d64copy_fs_transfer;
+int d64copy_write_image_ex(d64copy_context *ctx,
+                           CBM_FILE cbm_fd,
+                           d64copy_settings *settings,
+                           const char *src_image,
+                           int dst_drive,
+                           d64copy_message_cb msg_cb,
+                           d64copy_status_cb stat_cb)
+{
+    ctx->message_cb = msg_cb;
+    ctx->status_cb = stat_cb;
 
-    atom_dst = dst;
-    atom_mustcleanup = 1;
+    return run_copy(ctx, cbm_fd, settings,
+            &d64copy_fs_transfer, (void*)src_image,
+            transfers[settings->transfer_mode].trf, (void*)(ULONG_PTR)dst_drive,
+            (unsigned char) dst_drive, 0);
+}
 
-    SETSTATEDEBUG((void)0);
-    ret = copy_disk(cbm_fd, settings,
-            src, (void*)(ULONG_PTR)src_drive, dst, (void*)dst_image, (unsigned char) src_drive);
+void d64copy_cleanup_ex(d64copy_context *ctx)
+{
+    /* if we were interrupted writing to the fs, make sure to
+     * write anything that has already been started
+     */
 
-    atom_mustcleanup = 0;
+    if (ctx->pipe)
+    {
+        /* store the queued blocks, and stop the writer before
+         * the image goes away under it
+         */
+        pipeline_finish(ctx->pipe);
+    }
 
-    return ret;
+    if (ctx->atom_mustcleanup)
+    {
+        ctx->atom_mustcleanup = 0;
+        ctx->dst->close_disk(ctx->dst_state);
+    }
+}
+
+int d64copy_read_image(CBM_FILE cbm_fd,
+                       d64copy_settings *settings,
+                       int src_drive,
+                       const char *dst_image,
+                       d64copy_message_cb msg_cb,
+                       d64copy_status_cb stat_cb)
+{
+    return d64copy_read_image_ex(&default_context, cbm_fd, settings,
+            src_drive, dst_image, msg_cb, stat_cb);
 }
 
 int d64copy_write_image(CBM_FILE cbm_fd,
@@ -817,29 +1320,254 @@ int d64copy_write_image(CBM_FILE cbm_fd,
                         d64copy_message_cb msg_cb,
                         d64copy_status_cb stat_cb)
 {
-    const transfer_funcs *src;
-    const transfer_funcs *dst;
+    return d64copy_write_image_ex(&default_context, cbm_fd, settings,
+            src_image, dst_drive, msg_cb, stat_cb);
+}
+
+void d64copy_cleanup(void)
+{
+    d64copy_cleanup_ex(&default_context);
+}
+
+
+/*
+ * Auto-tuning: one track is read into a "null" image under each
+ * candidate transfer mode, with warp and with a range of interleaves,
+ * and the time from opening the image to the last block received is
+ * measured. The image is opened after the drive, thus, this is the
+ * whole transfer of the track without uploading the turbo, and the
+ * probes can be compared with each other. The time between the first
+ * and the last block would not do: in warp mode, all blocks of the
+ * track arrive at once after the track has been transferred.
+ */
+#define TUNE_TRACK 18
+
+typedef struct
+{
+    int blocks;             /* the number of blocks received without error */
+    unsigned long start;    /* arch_time_usec() when the image was opened */
+    unsigned long last;     /* arch_time_usec() of the last block */
+} tune_probe;
 
-    message_cb = msg_cb;
-    status_cb = stat_cb;
+typedef struct
+{
+    tune_probe *probe;
+} tune_state;
 
-    src = &d64copy_fs_transfer;
-    dst = transfers[settings->transfer_mode].trf;
+static int tune_open_disk(void *state, CBM_FILE fd, d64copy_settings *settings,
+                          const void *arg, int for_writing, turbo_start start,
+                          d64copy_message_cb message_cb)
+{
+    tune_probe *probe = (tune_probe *) arg;
+
+    ((tune_state *) state)->probe = probe;
+    probe->start = arch_time_usec();
+    return 0;
+}
+
+static int tune_read_block(void *state, unsigned char tr, unsigned char se,
+                           unsigned char *block)
+{
+    return 1;
+}
+
+static int tune_write_block(void *state, unsigned char tr, unsigned char se,
+                            const unsigned char *blk, int size, int read_status)
+{
+    tune_probe *probe = ((tune_state *) state)->probe;
+    unsigned long now = arch_time_usec();
+
+    if(read_status == 0)
+    {
+        probe->blocks++;
+        probe->last = now;
+    }
+    return 0;
+}
+
+static void tune_close_disk(void *state)
+{
+}
+
+static const transfer_funcs tune_transfer =
+{
+    tune_open_disk,
+    tune_read_block,
+    tune_write_block,
+    tune_close_disk,
+    0,
+    0,
+    NULL,
+    NULL,
+    NULL,
+    sizeof(tune_state)
+};
+
+static int tune_status_cb(d64copy_status status)
+{
+    return 0;
+}
+
+/*
+ * read the tune track once; returns the time per block in us,
+ * or -1 if not all blocks could be read
+ */
+static long tune_measure(d64copy_context *ctx, CBM_FILE cbm_fd,
+                         const d64copy_settings *base, int drive,
+                         int transfer_mode, int warp, int interleave)
+{
+    d64copy_settings settings = *base;
+    tune_probe probe;
+    int sectors = d64_sector_map[TUNE_TRACK];
+    long usec;
+
+    settings.transfer_mode = transfer_mode;
+    settings.warp          = warp;
+    settings.interleave    = interleave;
+    settings.start_track   = TUNE_TRACK;
+    settings.end_track     = TUNE_TRACK;
+    settings.two_sided     = 0;
+    settings.retries       = 0;
+    settings.bam_mode      = bm_ignore;
+    settings.turbo_loader  = 0;     /* it would send the turbo after the image is opened */
+
+    memset(&probe, 0, sizeof(probe));
 
     SETSTATEDEBUG((void)0);
-    return copy_disk(cbm_fd, settings,
-            src, (void*)src_image, dst, (void*)(ULONG_PTR)dst_drive, (unsigned char) dst_drive);
+    if(run_copy(ctx, cbm_fd, &settings,
+                transfers[transfer_mode].trf, (void*)(ULONG_PTR)drive,
+                &tune_transfer, &probe,
+                (unsigned char) drive, 0) != sectors
+       || probe.blocks != sectors)
+    {
+        usec = -1;
+    }
+    else
+    {
+        usec = (long) ((probe.last - probe.start) / sectors);
+    }
+
+    if(usec < 0)
+    {
+        ctx->message_cb(sev_info, "tune: %s, %s: failed", transfers[transfer_mode].name,
+                        warp ? "warp" : "no warp");
+    }
+    else if(warp)
+    {
+        ctx->message_cb(sev_info, "tune: %s, warp: %ld us/block",
+                        transfers[transfer_mode].name, usec);
+    }
+    else
+    {
+        ctx->message_cb(sev_info, "tune: %s, interleave %d: %ld us/block",
+                        transfers[transfer_mode].name, interleave, usec);
+    }
+
+    return usec;
 }
 
-void d64copy_cleanup(void)
+int d64copy_tune_ex(d64copy_context *ctx,
+                    CBM_FILE cbm_fd,
+                    d64copy_settings *settings,
+                    int drive,
+                    d64copy_message_cb msg_cb)
 {
-    /* if we were interrupted writing to the fs, make sure to
-     * write anything that has already been started
-     */
+    int candidate[3];
+    int candidates = 0;
+    long best_time = -1;
+    int i;
+
+    ctx->message_cb = msg_cb;
+    ctx->status_cb = tune_status_cb;
+
+    /* the fastest mode first; it is taken if the times are equal */
+    if(has_parallel_cable(cbm_fd, drive))
+    {
+        candidate[candidates++] = d64copy_get_transfer_mode_index("parallel");
+    }
+    if(is_only_drive(cbm_fd, drive))
+    {
+        candidate[candidates++] = d64copy_get_transfer_mode_index("serial2");
+    }
+    candidate[candidates++] = d64copy_get_transfer_mode_index("serial1");
+
+    for(i = 0; i < candidates; i++)
+    {
+        int mode = candidate[i];
+        int interleave = default_interleave[mode];
+        int il, step;
+        long t, mode_time;
+
+        t = tune_measure(ctx, cbm_fd, settings, drive, mode, 1, -1);
+        if(t >= 0 && (best_time < 0 || t < best_time))
+        {
+            best_time = t;
+            settings->transfer_mode = mode;
+            settings->warp = 1;
+            settings->interleave = interleave;
+        }
+
+        /*
+         * starting with the default interleave, go into the
+         * direction which is faster, as long as it gets faster
+         */
+        mode_time = tune_measure(ctx, cbm_fd, settings, drive, mode, 0, interleave);
+        if(mode_time < 0)
+        {
+            continue;
+        }
+
+        for(step = -1; step <= 1; step += 2)
+        {
+            int moved = 0;
 
-    if (atom_mustcleanup)
+            for(il = interleave + step; il >= 1 && il <= MAX_INTERLEAVE; il += step)
+            {
+                t = tune_measure(ctx, cbm_fd, settings, drive, mode, 0, il);
+                if(t < 0 || t >= mode_time)
+                {
+                    break;
+                }
+                mode_time = t;
+                interleave = il;
+                moved = 1;
+            }
+            if(moved)
+            {
+                break;
+            }
+        }
+
+        if(best_time < 0 || mode_time < best_time)
+        {
+            best_time = mode_time;
+            settings->transfer_mode = mode;
+            settings->warp = 0;
+        }
+
+        /* remember the interleave of the chosen mode, even if warp is faster */
+        if(settings->transfer_mode == mode)
+        {
+            settings->interleave = interleave;
+        }
+    }
+
+    if(best_time < 0)
     {
-        atom_dst->close_disk();
-        atom_mustcleanup = 0;
+        msg_cb(sev_warning, "tune: no turbo transfer mode works, using `original'");
+        settings->transfer_mode = d64copy_get_transfer_mode_index("original");
+        settings->warp = 0;
+        settings->interleave = default_interleave[settings->transfer_mode];
+        return -1;
     }
+
+    return 0;
+}
+
+int d64copy_tune(CBM_FILE cbm_fd,
+                 d64copy_settings *settings,
+                 int drive,
+                 d64copy_message_cb msg_cb)
+{
+    return d64copy_tune_ex(&default_context, cbm_fd, settings, drive, msg_cb);
 }
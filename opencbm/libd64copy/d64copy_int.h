@@ -15,6 +15,7 @@
 #include "gcr.h"
 
 #include "arch.h"
+#include "opencbm-plugin.h"
 
 #ifdef LIBD64COPY_DEBUG
 # define DEBUG_STATEDEBUG
@@ -38,18 +39,36 @@
 
 #define NEED_SECTOR(b) ((((b)==bs_error)||((b)==bs_must_copy))?1:0)
 
+/*
+ * In warp mode, the drive sends the sectors of a track one after the
+ * other, as they pass the head: the sector number, the read status and,
+ * if the sector could be read, the GCR data. After an error, the drive
+ * gives up the rest of the track and waits for the next track map.
+ * read_gcr_track() stores one record of GCRRECSIZE bytes per sector,
+ * and returns the number of records.
+ */
+#define GCRRECSIZE   (2 + GCRBUFSIZE)
+#define GCRTRACKSIZE (MAX_SECTORS * GCRRECSIZE)
+
 typedef int(*turbo_start)(CBM_FILE,unsigned char);
 
+/*
+ * Every transfer module keeps its state in a private "transfer_state"
+ * structure. One instance of it is allocated per copy operation and
+ * handed to each of the functions as first parameter.
+ */
 typedef struct {
-    int  (*open_disk)(CBM_FILE,d64copy_settings*,const void*,int,
+    int  (*open_disk)(void*,CBM_FILE,d64copy_settings*,const void*,int,
                       turbo_start,d64copy_message_cb);
-    int  (*read_block)(unsigned char,unsigned char,unsigned char*);
-    int  (*write_block)(unsigned char,unsigned char,const unsigned char*,int,int);
-    void (*close_disk)(void);
+    int  (*read_block)(void*,unsigned char,unsigned char,unsigned char*);
+    int  (*write_block)(void*,unsigned char,unsigned char,const unsigned char*,int,int);
+    void (*close_disk)(void*);
     int  is_cbm_drive;
     int  needs_turbo;
-    int  (*send_track_map)(unsigned char,const char*,unsigned char);
-    int  (*read_gcr_block)(unsigned char*,unsigned char*);
+    int  (*send_track_map)(void*,unsigned char,const char*,unsigned char);
+    int  (*read_gcr_track)(void*,unsigned char,unsigned char*);
+    int  (*sync_turbo)(void*);
+    size_t state_size;
 } transfer_funcs;
 
 #define DECLARE_TRANSFER_FUNCS(x,c,t) \
@@ -60,7 +79,9 @@ typedef struct {
                         c, \
                         t, \
                         NULL, \
-                        NULL}
+                        NULL, \
+                        NULL, \
+                        sizeof(transfer_state)}
 
 #define DECLARE_TRANSFER_FUNCS_EX(x,c,t) \
     transfer_funcs d64copy_ ## x = {open_disk, \
@@ -70,6 +91,61 @@ typedef struct {
                         c, \
                         t, \
                         send_track_map, \
-                        read_gcr_block}
+                        read_gcr_track, \
+                        sync_turbo, \
+                        sizeof(transfer_state)}
+
+/*
+ * The time the drive program gets to answer after it has been started,
+ * in ms. d64copy_wait_line() returns -1 if the line has not reached the
+ * state by then, instead of waiting forever for a drive which crashed.
+ */
+#define D64COPY_SYNC_TIMEOUT 5000
+
+extern int d64copy_wait_line(CBM_FILE fd, int line, int state);
+
+/*
+ * With a plugin that can queue transfers, all parts of one block exchange
+ * are handed over at once, saving the USB round trips between them. The
+ * delay before reading the status is not needed then, as the adapter
+ * waits for the drive's handshake anyway. The exchange has completed when
+ * d64copy_queue_block() returns, as the caller needs the drive's status
+ * before it goes on with the next block.
+ */
+typedef struct {
+    CBM_FILE fd;
+    unsigned int protocol;
+    opencbm_plugin_async_read_n_t *read_n;
+    opencbm_plugin_async_write_n_t *write_n;
+    opencbm_plugin_async_wait_t *wait;
+} d64copy_queue;
+
+extern int d64copy_queue_open(d64copy_queue *q, CBM_FILE fd, unsigned int protocol);
+extern int d64copy_queue_block(d64copy_queue *q,
+                               const unsigned char *cmd, int cmd_size,
+                               const unsigned char *out, int out_size,
+                               unsigned char *status, int status_size,
+                               unsigned char *in, int in_size);
+
+/*
+ * Everything one copy operation needs. Separate contexts can be used
+ * from separate threads at the same time.
+ */
+struct d64copy_context_s
+{
+    d64copy_message_cb message_cb;
+    d64copy_status_cb status_cb;
+
+    const transfer_funcs *src;
+    const transfer_funcs *dst;
+    void *src_state;
+    void *dst_state;
+
+    /* make sure writing a block is an atomary process */
+    int atom_mustcleanup;
+
+    /* the writer thread while reading into an image, or NULL */
+    struct d64copy_pipeline_s *pipe;
+};
 
 #endif
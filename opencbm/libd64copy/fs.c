@@ -14,85 +14,113 @@
 #include <string.h>
 
 #include "arch.h"
+#include "imagefile.h"
 
-static d64copy_settings *fs_settings;
+typedef struct
+{
+    d64copy_settings *fs_settings;
+    d64copy_message_cb message_cb;
+
+    cbmlibmisc_image image;
+    int is_open;
+    int for_writing;
+    char *error_map;
+    int block_count;
 
-static FILE *the_file;
-static char *error_map;
-static int block_count;
+    /*
+     * Variables to make sure writing the block is an atomary process
+     */
+    int atom_execute;
+    unsigned char atom_tr;
+    unsigned char atom_se;
+    const unsigned char *atom_blk;
+    int atom_size;
+    int atom_read_status;
+} transfer_state;
 
 /* always use maximum size for error map */
 #define ERROR_MAP_LENGTH D71_BLOCKS
 
-static int block_offset(int tr, int se)
+static int read_block(void *state, unsigned char tr, unsigned char se, unsigned char *block)
 {
-    int sectors = 0, i;
-    for(i = 1; i < tr; i++)
-    {
-        sectors += d64copy_sector_count(fs_settings->two_sided, i);
-    }
-    return (sectors + se) * BLOCKSIZE;
-}
+    transfer_state *ts = state;
+    const unsigned char *data;
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
-{
-    if(fseek(the_file, block_offset(tr, se), SEEK_SET) == 0)
+    data = cbmlibmisc_image_block(&ts->image, tr, se);
+    if(data)
     {
-        return fread(block, BLOCKSIZE, 1, the_file) != 1;
+        memcpy(block, data, BLOCKSIZE);
+        return 0;
     }
     return 1;
 }
 
-/*
- * Variables to make sure writing the block is an atomary process
- */
-static int atom_execute = 0;
-static unsigned char atom_tr;
-static unsigned char atom_se;
-static const unsigned char *atom_blk;
-static int atom_size;
-static int atom_read_status;
-
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(void *state, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
-    long ofs;
+    transfer_state *ts = state;
+    int block;
     int ret;
 
-    atom_tr = tr;
-    atom_se = se;
-    atom_blk = blk;
-    atom_size = size;
-    atom_read_status = read_status;
+    ts->atom_tr = tr;
+    ts->atom_se = se;
+    ts->atom_blk = blk;
+    ts->atom_size = size;
+    ts->atom_read_status = read_status;
 
-    atom_execute = 1;
+    ts->atom_execute = 1;
 
-    ofs = block_offset(tr, se);
-    if(fseek(the_file, ofs, SEEK_SET) == 0)
+    block = cbmlibmisc_image_block_number(&ts->image, tr, se);
+    if(block >= 0)
     {
-        error_map[ofs / BLOCKSIZE] = (char) ((read_status == 0) ? 1 : read_status);
-        ret = fwrite(blk, size, 1, the_file) != 1;
+        ts->error_map[block] = (char) ((read_status == 0) ? 1 : read_status);
+        memcpy(ts->image.Data + block * BLOCKSIZE, blk, size);
+        /* errors show up again on close */
+        cbmlibmisc_image_track_written(&ts->image, tr);
+        ret = 0;
     }
     else
     {
         ret = 1;
     }
 
-    atom_execute = 0;
+    ts->atom_execute = 0;
 
     return ret;
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+/*
+ * the layout of the image: all tracks which are possible with
+ * the given number of sides
+ */
+static int set_tracks(transfer_state *ts)
+{
+    unsigned char sectors[D71_TRACKS + 1];
+    int tracks = ts->fs_settings->two_sided ? D71_TRACKS : TOT_TRACKS;
+    int tr;
+
+    for(tr = 1; tr <= tracks; tr++)
+    {
+        sectors[tr] = (unsigned char) d64copy_sector_count(ts->fs_settings->two_sided, tr);
+    }
+    return cbmlibmisc_image_set_tracks(&ts->image, tracks, sectors);
+}
+
+static int open_disk(void *state, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
+    transfer_state *ts = state;
     off_t filesize;
     int stat_ok, is_image, error_info;
     int tr = 0;
+    int block_count;
     char *name = (char*)arg;
 
-    the_file = NULL;
-    fs_settings = settings;
+    ts->is_open = 0;
+    ts->for_writing = for_writing;
+    ts->error_map = NULL;
+    ts->fs_settings = settings;
+    ts->message_cb = message_cb;
     block_count = 0;
 
     stat_ok = arch_filesize(name, &filesize) == 0;
@@ -142,8 +170,11 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
         {
             if(is_image)
             {
-                the_file = fopen(name, "rb");
-                if(the_file == NULL)
+                if(cbmlibmisc_image_open(&ts->image, name, 0, 0) == 0)
+                {
+                    ts->is_open = 1;
+                }
+                else
                 {
                     message_cb(0, "could not open %s", name);
                 }
@@ -174,8 +205,7 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
     }
     else
     {
-        the_file = fopen(name, is_image ? "r+b" : "wb");
-        if(the_file)
+        if(cbmlibmisc_image_open(&ts->image, name, 1, settings->atomic_write) == 0)
         {
             /* check whether we must resize or create an image file */
             int new_tr;
@@ -196,39 +226,29 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
                 new_tr = TOT_TRACKS;
             }
 
+            if(!is_image)
+            {
+                /* anything which is not an image is overwritten */
+                tr = block_count = 0;
+            }
+
             /* always use maximum size for error map */
-            error_map = calloc(ERROR_MAP_LENGTH, 1);
-            if(!error_map)
+            ts->error_map = calloc(ERROR_MAP_LENGTH, 1);
+            if(!ts->error_map)
             {
                 message_cb(0, "no memory for error map");
-                fclose(the_file);
-                if(!is_image)
-                {
-                    arch_unlink(name);
-                }
+                cbmlibmisc_image_close(&ts->image, 0);
                 return 1;
             }
 
-            if(is_image)
+            if(error_info)
             {
-                if(error_info)
-                {
-                    if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) != 0 ||
-                       fread(error_map, block_count, 1, the_file) != 1)
-                    {
-                        message_cb(0, "%s: could not read error map", name);
-                        fclose(the_file);
-                        return 1;
-                    }
-                }
-                if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) != 0)
-                {
-                    message_cb(0, "%s: could not seek to end of file", name);
-                    fclose(the_file);
-                    return 1;
-                }
+                memcpy(ts->error_map, ts->image.Data + block_count * BLOCKSIZE, block_count);
             }
 
+            /* strip the error info, it is appended again on close */
+            cbmlibmisc_image_resize(&ts->image, block_count * BLOCKSIZE);
+
             if(new_tr > tr)
             {
                 /* grow image */
@@ -239,41 +259,52 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
 
                 message_cb(1, "growing image file to %d blocks", block_count);
 
-                if (arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE) != 0)
+                if(cbmlibmisc_image_resize(&ts->image, block_count * BLOCKSIZE) != 0)
                 {
                     message_cb(0, "%s: could not extend image file", name);
-                    fclose(the_file);
-                    if(!is_image)
-                        arch_unlink(name);
+                    free(ts->error_map);
+                    ts->error_map = NULL;
+                    cbmlibmisc_image_close(&ts->image, 0);
                     return 1;
                 }
             }
+
+            ts->is_open = 1;
         }
         else
         {
             message_cb(0, "could not open %s", name);
         }
     }
-    return the_file == NULL;
+
+    if(ts->is_open)
+    {
+        set_tracks(ts);
+    }
+
+    ts->block_count = block_count;
+
+    return !ts->is_open;
 }
 
-static void close_disk(void)
+static void close_disk(void *state)
 {
+    transfer_state *ts = state;
     int i, has_errors = 0;
 
     /* if writing the block was interrupted, make sure it is
      * redone before closing the disk
      */
 
-    if (the_file && atom_execute)
+    if (ts->is_open && ts->atom_execute)
     {
-        atom_execute = 0;
-        write_block(atom_tr, atom_se, atom_blk, atom_size, atom_read_status);
+        ts->atom_execute = 0;
+        write_block(ts, ts->atom_tr, ts->atom_se, ts->atom_blk, ts->atom_size, ts->atom_read_status);
     }
 
-    if (fs_settings)
+    if (ts->fs_settings)
     {
-        switch(fs_settings->error_mode)
+        switch(ts->fs_settings->error_mode)
         {
             case em_always:
                 has_errors = 1;
@@ -282,44 +313,39 @@ static void close_disk(void)
                 has_errors = 0;
                 break;
             default:
-                if(error_map)
+                if(ts->error_map)
                 {
-                    for(i = 0; !has_errors && i < block_count; i++)
+                    for(i = 0; !has_errors && i < ts->block_count; i++)
                     {
-                        has_errors = error_map[i] != 1;
+                        has_errors = ts->error_map[i] != 1;
                     }
                 }
                 break;
         }
     }
 
-    if(the_file)
+    if(ts->is_open)
     {
-        if(has_errors)
+        if(ts->for_writing && has_errors)
         {
-            if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) == 0)
+            /* append the error map */
+            if(cbmlibmisc_image_resize(&ts->image, ts->block_count * (BLOCKSIZE + 1)) == 0)
             {
-                fwrite(error_map, block_count, 1, the_file);
+                memcpy(ts->image.Data + ts->block_count * BLOCKSIZE, ts->error_map, ts->block_count);
             }
         }
-        else
+
+        ts->is_open = 0;
+        if(cbmlibmisc_image_close(&ts->image, 1) != 0)
         {
-            if (arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE) < 0)
-            {
-                /* ignore it */
-            }
+            ts->message_cb(0, "could not write image file");
         }
     }
 
-    if(error_map)
-    {
-        free(error_map);
-        error_map = NULL;
-    }
-    if(the_file)
+    if(ts->error_map)
     {
-        fclose(the_file);
-        the_file = NULL;
+        free(ts->error_map);
+        ts->error_map = NULL;
     }
 }
 
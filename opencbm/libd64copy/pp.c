@@ -17,17 +17,22 @@
 
 #include "opencbm-plugin.h"
 
-static opencbm_plugin_pp_dc_read_n_t * opencbm_plugin_pp_dc_read_n = NULL;
-
-static opencbm_plugin_pp_dc_write_n_t * opencbm_plugin_pp_dc_write_n = NULL;
-
 enum pp_direction_e
 {
     PP_READ, PP_WRITE
 };
 
-static CBM_FILE fd_cbm;
-static int two_sided;
+typedef struct
+{
+    CBM_FILE fd_cbm;
+    int two_sided;
+    enum pp_direction_e direction;
+
+    opencbm_plugin_pp_dc_read_n_t * pp_dc_read_n;
+    opencbm_plugin_pp_dc_write_n_t * pp_dc_write_n;
+
+    d64copy_queue queue;
+} transfer_state;
 
 static const unsigned char pp1541_drive_prog[] = {
 #include "pp1541.inc"
@@ -37,20 +42,20 @@ static const unsigned char pp1571_drive_prog[] = {
 #include "pp1571.inc"
 };
 
-static void pp_check_direction(enum pp_direction_e dir)
+static void pp_check_direction(transfer_state *ts, enum pp_direction_e dir)
 {
-    static enum pp_direction_e direction = PP_READ;
-    if(direction != dir)
+    if(ts->direction != dir)
     {
         arch_usleep(100);
-        direction = dir;
+        ts->direction = dir;
     }
 }
 
-static int pp_write(CBM_FILE fd, char c1, char c2)
+static int pp_write(transfer_state *ts, char c1, char c2)
 {
+    CBM_FILE fd = ts->fd_cbm;
                                                                         SETSTATEDEBUG((void)0);
-    pp_check_direction(PP_WRITE);
+    pp_check_direction(ts, PP_WRITE);
                                                                         SETSTATEDEBUG((void)0);
 #ifndef USE_CBM_IEC_WAIT
     while(!cbm_iec_get(fd, IEC_DATA));
@@ -78,24 +83,25 @@ static int pp_write(CBM_FILE fd, char c1, char c2)
 }
 
 /* write_n redirects USB writes to the external reader if required */
-static void write_n(const unsigned char *data, int size)
+static void write_n(transfer_state *ts, const unsigned char *data, int size)
 {
     int i;
 
-    if (opencbm_plugin_pp_dc_write_n)
+    if (ts->pp_dc_write_n)
     {
-        opencbm_plugin_pp_dc_write_n(fd_cbm, data, size);
+        ts->pp_dc_write_n(ts->fd_cbm, data, size);
         return;
     }
 
     for(i=0;i<size/2;i++,data+=2)
-        pp_write(fd_cbm, data[0], data[1]);
+        pp_write(ts, data[0], data[1]);
 }
 
-static int pp_read(CBM_FILE fd, unsigned char *c1, unsigned char *c2)
+static int pp_read(transfer_state *ts, unsigned char *c1, unsigned char *c2)
 {
+    CBM_FILE fd = ts->fd_cbm;
                                                                         SETSTATEDEBUG((void)0);
-    pp_check_direction(PP_READ);
+    pp_check_direction(ts, PP_READ);
                                                                         SETSTATEDEBUG((void)0);
 #ifndef USE_CBM_IEC_WAIT
     while(!cbm_iec_get(fd, IEC_DATA));
@@ -123,59 +129,97 @@ static int pp_read(CBM_FILE fd, unsigned char *c1, unsigned char *c2)
 }
 
 /* read_n redirects USB reads to the external reader if required */
-static void read_n(unsigned char *data, int size)
+static void read_n(transfer_state *ts, unsigned char *data, int size)
 {
     int i;
 
-    if (opencbm_plugin_pp_dc_read_n)
+    if (ts->pp_dc_read_n)
     {
-        opencbm_plugin_pp_dc_read_n(fd_cbm, data, size);
+        ts->pp_dc_read_n(ts->fd_cbm, data, size);
         return;
     }
 
     for(i=0;i<size/2;i++,data+=2)
-        pp_read(fd_cbm, data, data+1);
+        pp_read(ts, data, data+1);
+}
+
+static int read_block_queued(transfer_state *ts, unsigned char tr, unsigned char se, unsigned char *block)
+{
+    unsigned char cmd[2], status[2];
+
+    cmd[0] = tr; cmd[1] = se;
+    if (d64copy_queue_block(&ts->queue, cmd, 2, NULL, 0, status, 2, block, BLOCKSIZE))
+        return -1;
+
+    return status[1];
+}
+
+static int write_block_queued(transfer_state *ts, unsigned char tr, unsigned char se, const unsigned char *blk, int size)
+{
+    int i = 0;
+    unsigned char cmd[4], status[2];
+
+    cmd[0] = tr; cmd[1] = se;
+
+    /* send first byte twice if length is odd */
+    if(size % 2) {
+        cmd[2] = blk[0]; cmd[3] = blk[1];
+        i = 1;
+    }
+    if (d64copy_queue_block(&ts->queue, cmd, 2 + 2*i, blk+i, size-i, status, 2, NULL, 0))
+        return -1;
+
+    return status[1];
 }
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int read_block(void *state, unsigned char tr, unsigned char se, unsigned char *block)
 {
+    transfer_state *ts = state;
     unsigned char status[2];
+
+    if (ts->queue.wait)
+        return read_block_queued(ts, tr, se, block);
+
                                                                         SETSTATEDEBUG((void)0);
 
     status[0] = tr; status[1] = se;
-    write_n(status, 2);
+    write_n(ts, status, 2);
 
 #ifndef USE_CBM_IEC_WAIT
     arch_usleep(20000);
 #endif
                                                                         SETSTATEDEBUG((void)0);
-    read_n(status, 2);
+    read_n(ts, status, 2);
 
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(block, BLOCKSIZE);
+    read_n(ts, block, BLOCKSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 
                                                                         SETSTATEDEBUG((void)0);
     return status[1];
 }
 
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(void *state, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
+    transfer_state *ts = state;
     int i = 0;
     unsigned char status[2];
 
+    if (ts->queue.wait)
+        return write_block_queued(ts, tr, se, blk, size);
+
                                                                         SETSTATEDEBUG((void)0);
     status[0] = tr; status[1] = se;
-    write_n(status, 2);
+    write_n(ts, status, 2);
 
                                                                         SETSTATEDEBUG((void)0);
     /* send first byte twice if length is odd */
     if(size % 2) {
-        write_n(blk, 2);
+        write_n(ts, blk, 2);
         i = 1;
     }
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    write_n(blk+i, size-i);
+    write_n(ts, blk+i, size-i);
 
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 #ifndef USE_CBM_IEC_WAIT
@@ -185,26 +229,43 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
 #endif
 
                                                                         SETSTATEDEBUG((void)0);
-    read_n(status, 2);
+    read_n(ts, status, 2);
 
                                                                         SETSTATEDEBUG((void)0);
     return status[1];
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+/* the drive program does not signal its init; pp_write() and pp_read()
+ * wait for it before every byte anyway */
+static int sync_turbo(void *state)
+{
+    return 0;
+}
+
+static int open_disk(void *state, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
+    transfer_state *ts = state;
     unsigned char d = (unsigned char)(ULONG_PTR)arg;
     const unsigned char *drive_prog;
     int prog_size;
 
-    fd_cbm    = fd;
-    two_sided = settings->two_sided;
+    ts->fd_cbm    = fd;
+    ts->two_sided = settings->two_sided;
+
+    ts->pp_dc_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_pp_dc_read_n");
 
-    opencbm_plugin_pp_dc_read_n = cbm_get_plugin_function_address("opencbm_plugin_pp_dc_read_n");
+    ts->pp_dc_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_pp_dc_write_n");
+
+    /* the plugin might have the functions without the adapter supporting them */
+    if (!(cbm_block_caps(fd) & CBM_BLOCK_CAP(cbm_bp_pp_dc)))
+    {
+        ts->pp_dc_read_n = NULL;
+        ts->pp_dc_write_n = NULL;
+    }
 
-    opencbm_plugin_pp_dc_write_n = cbm_get_plugin_function_address("opencbm_plugin_pp_dc_write_n");
+    d64copy_queue_open(&ts->queue, fd, OPENCBM_PROTOCOL_PP_DC);
 
     if(settings->drive_type != cbm_dt_cbm1541)
     {
@@ -219,46 +280,44 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
 
                                                                         SETSTATEDEBUG((void)0);
     /* make sure the XP1541 portion of the cable is in input mode */
-    cbm_pp_read(fd_cbm);
+    cbm_pp_read(ts->fd_cbm);
 
                                                                         SETSTATEDEBUG((void)0);
-    cbm_upload(fd_cbm, d, 0x700, drive_prog, prog_size);
+    cbm_upload_cached(ts->fd_cbm, d, 0x700, drive_prog, prog_size);
                                                                         SETSTATEDEBUG((void)0);
     start(fd, d);
                                                                         SETSTATEDEBUG((void)0);
-    pp_check_direction(PP_READ);
+    pp_check_direction(ts, PP_READ);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_set(fd_cbm, IEC_CLOCK);
+    cbm_iec_set(ts->fd_cbm, IEC_CLOCK);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_wait(fd_cbm, IEC_DATA, 1);
+    cbm_iec_wait(ts->fd_cbm, IEC_DATA, 1);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static void close_disk(void)
+static void close_disk(void *state)
 {
+    transfer_state *ts = state;
                                                                         SETSTATEDEBUG((void)0);
-    pp_write(fd_cbm, 0, 0);
+    pp_write(ts, 0, 0);
     arch_usleep(100);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_wait(fd_cbm, IEC_DATA, 0);
+    cbm_iec_wait(ts->fd_cbm, IEC_DATA, 0);
 
     /* make sure the XP1541 portion of the cable is in input mode */
                                                                         SETSTATEDEBUG((void)0);
-    cbm_pp_read(fd_cbm);
+    cbm_pp_read(ts->fd_cbm);
                                                                         SETSTATEDEBUG((void)0);
-
-    opencbm_plugin_pp_dc_read_n = NULL;
-
-    opencbm_plugin_pp_dc_write_n = NULL;
 }
 
-static int send_track_map(unsigned char tr, const char *trackmap, unsigned char count)
+static int send_track_map(void *state, unsigned char tr, const char *trackmap, unsigned char count)
 {
+    transfer_state *ts = state;
     int i, size;
     unsigned char *data;
 
-    size = d64copy_sector_count(two_sided, tr);
+    size = d64copy_sector_count(ts->two_sided, tr);
     data = malloc(2+2*size);
 
     data[0] = tr;
@@ -268,30 +327,38 @@ static int send_track_map(unsigned char tr, const char *trackmap, unsigned char
     for(i = 0; i < size; i++)
         data[2+2*i] = data[2+2*i+1] = !NEED_SECTOR(trackmap[i]);
 
-    write_n(data, 2*size+2);
+    write_n(ts, data, 2*size+2);
     free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static int read_gcr_block(unsigned char *se, unsigned char *gcrbuf)
+static int read_gcr_track(void *state, unsigned char count, unsigned char *gcrtrack)
 {
+    transfer_state *ts = state;
     unsigned char s[2];
+    unsigned char *rec;
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        rec = gcrtrack + i * GCRRECSIZE;
                                                                         SETSTATEDEBUG((void)0);
-    read_n(s, 2);
-    *se = s[1];
+        read_n(ts, s, 2);
+        rec[0] = s[1];
                                                                         SETSTATEDEBUG((void)0);
-    read_n(s, 2);
-
-    if(s[1]) {
-        return s[1];
-    }
+        read_n(ts, s, 2);
+        rec[1] = s[1];
+        if(rec[1])
+        {
+            return i + 1;
+        }
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(gcrbuf, GCRBUFSIZE);
+        read_n(ts, rec + 2, GCRBUFSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
-
+    }
                                                                         SETSTATEDEBUG((void)0);
-    return 0;
+    return count;
 }
 
 DECLARE_TRANSFER_FUNCS_EX(pp_transfer, 1, 1);
@@ -14,179 +14,124 @@
 #include <stdlib.h>
 
 #include "arch.h"
+#include "iecscript.h"
 
 #include "opencbm-plugin.h"
 
-static opencbm_plugin_s1_read_n_t * opencbm_plugin_s1_read_n = NULL;
-
-static opencbm_plugin_s1_write_n_t * opencbm_plugin_s1_write_n = NULL;
-
 static const unsigned char s1_drive_prog[] = {
 #include "s1.inc"
 };
 
-static CBM_FILE fd_cbm;
-static int two_sided;
-
-static int s1_write_byte_nohs(CBM_FILE fd, unsigned char c)
+typedef struct
 {
-    int b, i;
-    for(i=7; ; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i);
-        b=(c >> i) & 1;
-                                                                        SETSTATEDEBUG((void)0);
-        if(b) cbm_iec_set(fd, IEC_DATA); else cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 1);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        if(b) cbm_iec_release(fd, IEC_DATA); else cbm_iec_set(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
+    CBM_FILE fd_cbm;
+    int two_sided;
 
-        if(i<=0) return 0;
-                                                                        SETSTATEDEBUG((void)0);
+    d64copy_queue queue;
+} transfer_state;
 
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 1);
-#endif
-    }
+/* the drive program quits without acknowledging the last bits of
+ * the last byte, which cbm_block_write() would wait for */
+static int s1_write_byte_nohs(CBM_FILE fd, unsigned char c)
+{
+    unsigned char script[CBMLIBMISC_IEC_SCRIPT_S1_LEN];
                                                                         SETSTATEDEBUG((void)0);
+    return cbm_iec_script(fd, script, cbmlibmisc_iec_script_s1_write(script, c, 0), NULL, 0) < 0 ? -1 : 0;
 }
 
 static int s1_write_byte(CBM_FILE fd, unsigned char c)
 {
                                                                         SETSTATEDEBUG((void)0);
-    s1_write_byte_nohs(fd, c);
+    return cbm_block_write(fd, cbm_bp_s1, &c, 1) == 1 ? 0 : -1;
+}
+
+/* write_n lets the adapter move all bytes with one request, if it can */
+static void write_n(transfer_state *ts, const unsigned char *data, int size)
+{
                                                                         SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-    while(!cbm_iec_get(fd, IEC_DATA));
-#else
-    cbm_iec_wait(fd, IEC_DATA, 1);
-#endif
+    cbm_block_write(ts->fd_cbm, cbm_bp_s1, data, size);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
-    return 0;
 }
 
-/* write_n redirects USB writes to the external reader if required */
-static void write_n(const unsigned char *data, int size)
+/* read_n lets the adapter move all bytes with one request, if it can */
+static void read_n(transfer_state *ts, unsigned char *data, int size)
 {
-    int i;
-
-    if (opencbm_plugin_s1_write_n)
-    {
-        opencbm_plugin_s1_write_n(fd_cbm, data, size);
-        return;
-    }
-
-    for(i=0;i<size;i++)
-        s1_write_byte(fd_cbm, *data++);
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_block_read(ts->fd_cbm, cbm_bp_s1, data, size);
+                                                                        SETSTATEDEBUG(DebugBitCount=-1);
 }
 
-static int s1_read_byte(CBM_FILE fd, unsigned char *c)
+static int read_block_queued(transfer_state *ts, unsigned char tr, unsigned char se, unsigned char *block)
 {
-    int b=0, i;
-    *c = 0;
-    for(i=7; i>=0; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-        b = cbm_iec_get(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-        *c = (*c >> 1) | (b ? 0x80 : 0);
-        cbm_iec_set(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(b == cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, !b);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_DATA);
+    unsigned char cmd[2], status;
+
+    cmd[0] = tr;
+    cmd[1] = se;
+    if (d64copy_queue_block(&ts->queue, cmd, 2, NULL, 0, &status, 1, block, BLOCKSIZE))
+        return -1;
                                                                         SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 1);
-#endif
+    cbm_iec_release(ts->fd_cbm, IEC_DATA);
                                                                         SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_CLOCK);
-    }
-                                                                        SETSTATEDEBUG(DebugBitCount=-1);
-    return 0;
+    return status;
 }
 
-/* read_n redirects USB reads to the external reader if required */
-static void read_n(unsigned char *data, int size)
+static int write_block_queued(transfer_state *ts, unsigned char tr, unsigned char se, const unsigned char *blk, int size)
 {
-    int i;
-
-    if (opencbm_plugin_s1_read_n)
-    {
-        opencbm_plugin_s1_read_n(fd_cbm, data, size);
-        return;
-    }
+    unsigned char cmd[2], status;
 
-    for(i=0;i<size;i++)
-        s1_read_byte(fd_cbm, data++);
+    cmd[0] = tr;
+    cmd[1] = se;
+    if (d64copy_queue_block(&ts->queue, cmd, 2, blk, size, &status, 1, NULL, 0))
+        return -1;
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_iec_release(ts->fd_cbm, IEC_DATA);
+                                                                        SETSTATEDEBUG((void)0);
+    return status;
 }
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int read_block(void *state, unsigned char tr, unsigned char se, unsigned char *block)
 {
+    transfer_state *ts = state;
     unsigned char status;
 
+    if (ts->queue.wait)
+        return read_block_queued(ts, tr, se, block);
+
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&tr, 1);
+    write_n(ts, &tr, 1);
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&se, 1);
+    write_n(ts, &se, 1);
                                                                         SETSTATEDEBUG((void)0);
 #ifndef USE_CBM_IEC_WAIT
     arch_usleep(20000);
 #endif
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&status, 1);
+    read_n(ts, &status, 1);
                                                                         SETSTATEDEBUG(DebugByteCount=0);
     // removed from loop: SETSTATEDEBUG(DebugByteCount++);
-    read_n(block, 256);
+    read_n(ts, block, 256);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
-    cbm_iec_release(fd_cbm, IEC_DATA);
+    cbm_iec_release(ts->fd_cbm, IEC_DATA);
                                                                         SETSTATEDEBUG((void)0);
     return status;
 }
 
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(void *state, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
+    transfer_state *ts = state;
     unsigned char status;
+
+    if (ts->queue.wait)
+        return write_block_queued(ts, tr, se, blk, size);
+
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&tr, 1);
+    write_n(ts, &tr, 1);
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&se, 1);
+    write_n(ts, &se, 1);
                                                                         SETSTATEDEBUG(DebugByteCount=0);
 
     // removed from loop: SETSTATEDEBUG(DebugByteCount++);
-    write_n(blk, size);
+    write_n(ts, blk, size);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 #ifndef USE_CBM_IEC_WAIT
     if(size == BLOCKSIZE) {
@@ -195,58 +140,67 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
     }
 #endif
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&status, 1);
+    read_n(ts, &status, 1);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_release(fd_cbm, IEC_DATA);
+    cbm_iec_release(ts->fd_cbm, IEC_DATA);
                                                                         SETSTATEDEBUG((void)0);
 
     return status;
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+/* the drive program sets DATA when it is ready */
+static int sync_turbo(void *state)
+{
+    transfer_state *ts = state;
+                                                                        SETSTATEDEBUG((void)0);
+    return d64copy_wait_line(ts->fd_cbm, IEC_DATA, 1);
+}
+
+static int open_disk(void *state, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
+    transfer_state *ts = state;
     unsigned char d = (unsigned char)(ULONG_PTR)arg;
 
-    fd_cbm = fd;
-    two_sided = settings->two_sided;
+    ts->fd_cbm = fd;
+    ts->two_sided = settings->two_sided;
 
-    opencbm_plugin_s1_read_n = cbm_get_plugin_function_address("opencbm_plugin_s1_read_n");
-
-    opencbm_plugin_s1_write_n = cbm_get_plugin_function_address("opencbm_plugin_s1_write_n");
+    d64copy_queue_open(&ts->queue, fd, OPENCBM_PROTOCOL_S1);
 
                                                                         SETSTATEDEBUG((void)0);
-    cbm_upload(fd_cbm, d, 0x700, s1_drive_prog, sizeof(s1_drive_prog));
+    cbm_upload_cached(ts->fd_cbm, d, 0x700, s1_drive_prog, sizeof(s1_drive_prog));
                                                                         SETSTATEDEBUG((void)0);
     start(fd, d);
                                                                         SETSTATEDEBUG((void)0);
-    while(!cbm_iec_get(fd_cbm, IEC_DATA));
+    if(sync_turbo(ts) != 0)
+    {
+        message_cb(0, "the drive program does not answer");
+        return -1;
+    }
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static void close_disk(void)
+static void close_disk(void *state)
 {
+    transfer_state *ts = state;
                                                                         SETSTATEDEBUG((void)0);
-    s1_write_byte(fd_cbm, 0);
+    s1_write_byte(ts->fd_cbm, 0);
                                                                         SETSTATEDEBUG((void)0);
-    s1_write_byte_nohs(fd_cbm, 0);
+    s1_write_byte_nohs(ts->fd_cbm, 0);
                                                                         SETSTATEDEBUG((void)0);
     arch_usleep(100);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
-
-    opencbm_plugin_s1_read_n = NULL;
-
-    opencbm_plugin_s1_write_n = NULL;
 }
 
-static int send_track_map(unsigned char tr, const char *trackmap, unsigned char count)
+static int send_track_map(void *state, unsigned char tr, const char *trackmap, unsigned char count)
 {
+    transfer_state *ts = state;
     int i, size;
     unsigned char *data;
                                                                         SETSTATEDEBUG((void)0);
-    size = d64copy_sector_count(two_sided, tr);
+    size = d64copy_sector_count(ts->two_sided, tr);
     data = malloc(size+2);
 
     data[0] = tr;
@@ -256,31 +210,32 @@ static int send_track_map(unsigned char tr, const char *trackmap, unsigned char
     for(i = 0; i < size; i++)
         data[2+i] = !NEED_SECTOR(trackmap[i]);
                                                                         SETSTATEDEBUG((void)0);
-    write_n(data, size+2);
+    write_n(ts, data, size+2);
     free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static int read_gcr_block(unsigned char *se, unsigned char *gcrbuf)
+static int read_gcr_track(void *state, unsigned char count, unsigned char *gcrtrack)
 {
-    unsigned char s;
+    transfer_state *ts = state;
+    unsigned char *rec;
+    int i;
 
+    for(i = 0; i < count; i++)
+    {
+        rec = gcrtrack + i * GCRRECSIZE;
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&s, 1);
-                                                                        SETSTATEDEBUG((void)0);
-    *se = s;
-    read_n(&s, 1);
-                                                                        SETSTATEDEBUG((void)0);
-
-    if(s) {
-        return s;
-    }
-
+        read_n(ts, rec, 2);
+        if(rec[1])
+        {
+            return i + 1;
+        }
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(gcrbuf, GCRBUFSIZE);
+        read_n(ts, rec + 2, GCRBUFSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
-    return 0;
+    }
+    return count;
 }
 
 DECLARE_TRANSFER_FUNCS_EX(s1_transfer, 1, 1);
@@ -14,156 +14,115 @@
 #include <stdlib.h>
 
 #include "arch.h"
+#include "iecscript.h"
 
 #include "opencbm-plugin.h"
 
-static opencbm_plugin_s2_read_n_t * opencbm_plugin_s2_read_n = NULL;
-
-static opencbm_plugin_s2_write_n_t * opencbm_plugin_s2_write_n = NULL;
-
 static const unsigned char s2_drive_prog[] = {
 #include "s2.inc"
 };
 
-static CBM_FILE fd_cbm;
-static int two_sided;
-
-static int s2_read_byte(CBM_FILE fd, unsigned char *c)
+typedef struct
 {
-    int i;
-    *c = 0;
-    for(i=4; i>0; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i*2);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_CLOCK));
-                                                                        SETSTATEDEBUG((void)0);
-        *c = (*c>>1) | (cbm_iec_get(fd, IEC_DATA) ? 0x80 : 0);
-#else
-        *c = (*c>>1) | ((cbm_iec_wait(fd, IEC_CLOCK, 0) & IEC_DATA) ? 0x80 : 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_ATN);
-                                                                        SETSTATEDEBUG(DebugBitCount--);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd,IEC_CLOCK));
-                                                                        SETSTATEDEBUG((void)0);
-        *c = (*c>>1) | (cbm_iec_get(fd, IEC_DATA) ? 0x80 : 0);
-#else
-        *c = (*c>>1) | ((cbm_iec_wait(fd, IEC_CLOCK, 1) & IEC_DATA) ? 0x80 : 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_ATN);
-    }
-                                                                        SETSTATEDEBUG(DebugBitCount=-1);
-    return 0;
-}
+    CBM_FILE fd_cbm;
+    int two_sided;
+
+    d64copy_queue queue;
+} transfer_state;
 
+/* the drive program quits without acknowledging the last bits of
+ * the last byte, which cbm_block_write() would wait for */
 static int s2_write_byte_nohs(CBM_FILE fd, unsigned char c)
 {
-    int i;
-    for(i=4; ; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i*2);
-        c & 1 ? cbm_iec_set(fd, IEC_DATA) : cbm_iec_release(fd, IEC_DATA);
-        c >>= 1;
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_ATN);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 0);
-#endif
-                                                                        SETSTATEDEBUG(DebugBitCount--);
-        c & 1 ? cbm_iec_set(fd, IEC_DATA) : cbm_iec_release(fd, IEC_DATA);
-        c >>= 1;
+    unsigned char script[CBMLIBMISC_IEC_SCRIPT_S2_WRITE_LEN];
                                                                         SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_ATN);
-
-        if(i<=1) return 0;
+    return cbm_iec_script(fd, script, cbmlibmisc_iec_script_s2_write(script, c, 0), NULL, 0) < 0 ? -1 : 0;
+}
 
+static int s2_write_byte(CBM_FILE fd, unsigned char c)
+{
                                                                         SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 1);
-#endif
-    }
+    return cbm_block_write(fd, cbm_bp_s2, &c, 1) == 1 ? 0 : -1;
 }
 
-/* read_n redirects USB reads to the external reader if required */
-static void read_n(unsigned char *data, int size)
+/* write_n lets the adapter move all bytes with one request, if it can */
+static void write_n(transfer_state *ts, const unsigned char *data, int size)
 {
-    int i;
-
-    if (opencbm_plugin_s2_read_n)
-    {
-        opencbm_plugin_s2_read_n(fd_cbm, data, size);
-        return;
-    }
-
-    for(i=0;i<size;i++)
-        s2_read_byte(fd_cbm, data++);
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_block_write(ts->fd_cbm, cbm_bp_s2, data, size);
+                                                                        SETSTATEDEBUG(DebugBitCount=-1);
 }
 
-static int s2_write_byte(CBM_FILE fd, unsigned char c)
+/* read_n lets the adapter move all bytes with one request, if it can */
+static void read_n(transfer_state *ts, unsigned char *data, int size)
 {
                                                                         SETSTATEDEBUG((void)0);
-    s2_write_byte_nohs(fd, c);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-    while(!cbm_iec_get(fd, IEC_CLOCK));
-#else
-    cbm_iec_wait(fd, IEC_CLOCK, 1);
-#endif
+    cbm_block_read(ts->fd_cbm, cbm_bp_s2, data, size);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
-    cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-    return 0;
 }
 
-/* write_n redirects USB writes to the external reader if required */
-static void write_n(const unsigned char *data, int size)
+static int read_block_queued(transfer_state *ts, unsigned char tr, unsigned char se, unsigned char *block)
 {
-    int i;
+    unsigned char cmd[2], status;
 
-    if (opencbm_plugin_s2_write_n)
-    {
-        opencbm_plugin_s2_write_n(fd_cbm, data, size);
-        return;
-    }
+    cmd[0] = tr;
+    cmd[1] = se;
+    if (d64copy_queue_block(&ts->queue, cmd, 2, NULL, 0, &status, 1, block, BLOCKSIZE))
+        return -1;
+
+    return status;
+}
+
+static int write_block_queued(transfer_state *ts, unsigned char tr, unsigned char se, const unsigned char *blk, int size)
+{
+    unsigned char cmd[2], status;
+
+    cmd[0] = tr;
+    cmd[1] = se;
+    if (d64copy_queue_block(&ts->queue, cmd, 2, blk, size, &status, 1, NULL, 0))
+        return -1;
 
-    for(i=0;i<size;i++)
-        s2_write_byte(fd_cbm, *data++);
+    return status;
 }
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int read_block(void *state, unsigned char tr, unsigned char se, unsigned char *block)
 {
+    transfer_state *ts = state;
     unsigned char status;
 
+    if (ts->queue.wait)
+        return read_block_queued(ts, tr, se, block);
+
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&tr, 1);
+    write_n(ts, &tr, 1);
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&se, 1);
+    write_n(ts, &se, 1);
 #ifndef USE_CBM_IEC_WAIT
     arch_usleep(20000);
 #endif
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&status, 1);
+    read_n(ts, &status, 1);
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(block, BLOCKSIZE);
+    read_n(ts, block, BLOCKSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 
     return status;
 }
 
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(void *state, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
+    transfer_state *ts = state;
     unsigned char status;
+
+    if (ts->queue.wait)
+        return write_block_queued(ts, tr, se, blk, size);
+
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&tr, 1);
+    write_n(ts, &tr, 1);
                                                                         SETSTATEDEBUG((void)0);
-    write_n(&se, 1);
+    write_n(ts, &se, 1);
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    write_n(blk, size);
+    write_n(ts, blk, size);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
 #ifndef USE_CBM_IEC_WAIT
     if(size == BLOCKSIZE) {
@@ -171,68 +130,80 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
     }
 #endif
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&status, 1);
+    read_n(ts, &status, 1);
                                                                         SETSTATEDEBUG((void)0);
     return status;
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+/* the drive program sets CLOCK when it is ready, and waits for ATN */
+static int sync_turbo(void *state)
+{
+    transfer_state *ts = state;
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_iec_release(ts->fd_cbm, IEC_CLOCK);
+                                                                        SETSTATEDEBUG((void)0);
+    if(d64copy_wait_line(ts->fd_cbm, IEC_CLOCK, 1) != 0)
+    {
+        return -1;
+    }
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_iec_set(ts->fd_cbm, IEC_ATN);
+    arch_usleep(20000);
+    return 0;
+}
+
+static int open_disk(void *state, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
+    transfer_state *ts = state;
     unsigned char d = (unsigned char)(ULONG_PTR)arg;
 
-    fd_cbm = fd;
-    two_sided = settings->two_sided;
-
-    opencbm_plugin_s2_read_n = cbm_get_plugin_function_address("opencbm_plugin_s2_read_n");
+    ts->fd_cbm = fd;
+    ts->two_sided = settings->two_sided;
 
-    opencbm_plugin_s2_write_n = cbm_get_plugin_function_address("opencbm_plugin_s2_write_n");
+    d64copy_queue_open(&ts->queue, fd, OPENCBM_PROTOCOL_S2);
 
                                                                         SETSTATEDEBUG((void)0);
-    cbm_upload(fd_cbm, d, 0x700, s2_drive_prog, sizeof(s2_drive_prog));
+    cbm_upload_cached(ts->fd_cbm, d, 0x700, s2_drive_prog, sizeof(s2_drive_prog));
                                                                         SETSTATEDEBUG((void)0);
     start(fd, d);
-                                                                        SETSTATEDEBUG((void)0);
-    cbm_iec_release(fd_cbm, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-    while(!cbm_iec_get(fd_cbm, IEC_CLOCK));
-                                                                        SETSTATEDEBUG((void)0);
-    cbm_iec_set(fd_cbm, IEC_ATN);
-    arch_usleep(20000);
+    if(sync_turbo(ts) != 0)
+    {
+        message_cb(0, "the drive program does not answer");
+        return -1;
+    }
 
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static void close_disk(void)
+static void close_disk(void *state)
 {
+    transfer_state *ts = state;
                                                                         SETSTATEDEBUG((void)0);
-    s2_write_byte(fd_cbm, 0);
+    s2_write_byte(ts->fd_cbm, 0);
                                                                         SETSTATEDEBUG((void)0);
-    s2_write_byte_nohs(fd_cbm, 0);
+    s2_write_byte_nohs(ts->fd_cbm, 0);
     arch_usleep(100);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
-    cbm_iec_release(fd_cbm, IEC_DATA);
+    cbm_iec_release(ts->fd_cbm, IEC_DATA);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_release(fd_cbm, IEC_ATN);
+    cbm_iec_release(ts->fd_cbm, IEC_ATN);
                                                                         SETSTATEDEBUG((void)0);
-    cbm_iec_set(fd_cbm, IEC_CLOCK);
+    cbm_iec_set(ts->fd_cbm, IEC_CLOCK);
                                                                         SETSTATEDEBUG((void)0);
-
-    opencbm_plugin_s2_read_n = NULL;
-
-    opencbm_plugin_s2_write_n = NULL;
 }
 
-static int send_track_map(unsigned char tr, const char *trackmap, unsigned char count)
+static int send_track_map(void *state, unsigned char tr, const char *trackmap, unsigned char count)
 {
+    transfer_state *ts = state;
     int i;
     int size;
     unsigned char *data;
 
                                                                         SETSTATEDEBUG((void)0);
-    size = d64copy_sector_count(two_sided, tr);
+    size = d64copy_sector_count(ts->two_sided, tr);
     data = malloc(2+size);
 
     data[0] = tr;
@@ -242,29 +213,32 @@ static int send_track_map(unsigned char tr, const char *trackmap, unsigned char
     for(i = 0; i < size; i++)
         data[2+i] = !NEED_SECTOR(trackmap[i]);
 
-    write_n(data, size+2);
+    write_n(ts, data, size+2);
     free(data);
                                                                         SETSTATEDEBUG((void)0);
     return 0;
 }
 
-static int read_gcr_block(unsigned char *se, unsigned char *gcrbuf)
+static int read_gcr_track(void *state, unsigned char count, unsigned char *gcrtrack)
 {
-    unsigned char s;
+    transfer_state *ts = state;
+    unsigned char *rec;
+    int i;
 
+    for(i = 0; i < count; i++)
+    {
+        rec = gcrtrack + i * GCRRECSIZE;
                                                                         SETSTATEDEBUG((void)0);
-    read_n(&s, 1);
-    *se = s;
-                                                                        SETSTATEDEBUG((void)0);
-    read_n(&s, 1);
-
-    if(s) {
-        return s;
-    }
+        read_n(ts, rec, 2);
+        if(rec[1])
+        {
+            return i + 1;
+        }
                                                                         SETSTATEDEBUG(DebugByteCount=0);
-    read_n(gcrbuf, GCRBUFSIZE);
+        read_n(ts, rec + 2, GCRBUFSIZE);
                                                                         SETSTATEDEBUG(DebugByteCount=-1);
-    return 0;
+    }
+    return count;
 }
 
 DECLARE_TRANSFER_FUNCS_EX(s2_transfer, 1, 1);
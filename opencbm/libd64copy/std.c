@@ -13,11 +13,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-static unsigned char drive = 0;
-static CBM_FILE fd_cbm = (CBM_FILE) -1;
+typedef struct
+{
+    unsigned char drive;
+    CBM_FILE fd_cbm;
+} transfer_state;
 
-static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
+static int read_block(void *state, unsigned char tr, unsigned char se, unsigned char *block)
 {
+    transfer_state *ts = state;
+    CBM_FILE fd_cbm = ts->fd_cbm;
+    unsigned char drive = ts->drive;
     char cmd[48];
     int rv = 1;
 
@@ -38,8 +44,11 @@ static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
     return rv;
 }
 
-static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
+static int write_block(void *state, unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
+    transfer_state *ts = state;
+    CBM_FILE fd_cbm = ts->fd_cbm;
+    unsigned char drive = ts->drive;
     char cmd[48];
     int  rv = 1;
 
@@ -62,10 +71,11 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
     return rv;
 }
 
-static int open_disk(CBM_FILE fd, d64copy_settings *settings,
+static int open_disk(void *state, CBM_FILE fd, d64copy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, d64copy_message_cb message_cb)
 {
+    transfer_state *ts = state;
     char buf[48];
     int rv;
 
@@ -76,23 +86,25 @@ static int open_disk(CBM_FILE fd, d64copy_settings *settings,
         return 99;
     }
 
-    drive = (unsigned char)(ULONG_PTR)arg;
+    ts->drive = (unsigned char)(ULONG_PTR)arg;
 
-    fd_cbm = fd;
+    ts->fd_cbm = fd;
 
-    cbm_open(fd_cbm, drive, 2, "#", 1);
+    cbm_open(ts->fd_cbm, ts->drive, 2, "#", 1);
 
-    rv = cbm_device_status(fd_cbm, drive, buf, sizeof(buf));
+    rv = cbm_device_status(ts->fd_cbm, ts->drive, buf, sizeof(buf));
     if(rv)
     {
-        message_cb(0, "drive %02d: %s", drive, buf);
+        message_cb(0, "drive %02d: %s", ts->drive, buf);
     }
     return rv;
 }
 
-static void close_disk(void)
+static void close_disk(void *state)
 {
-    cbm_close(fd_cbm, drive, 2);
+    transfer_state *ts = state;
+
+    cbm_close(ts->fd_cbm, ts->drive, 2);
 }
 
 DECLARE_TRANSFER_FUNCS(std_transfer, 1, 0);
@@ -145,6 +145,7 @@ d82copy_settings *d82copy_get_default_settings(void)
         settings->drive_type  = cbm_dt_unknown; /* auto detect later on */
         settings->two_sided   = -1; /* set later on */
         settings->error_mode  = em_on_error;
+        settings->atomic_write = 0;
     }
     return settings;
 }
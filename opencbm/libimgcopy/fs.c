@@ -15,10 +15,14 @@
 #include <string.h>
 
 #include "arch.h"
+#include "imagefile.h"
 
 static imgcopy_settings *fs_settings;
+static imgcopy_message_cb fs_message_cb;
 
-static FILE *the_file;
+static cbmlibmisc_image image;
+static int is_open;
+static int is_for_writing;
 static char *error_map;
 static int block_count;
 
@@ -28,21 +32,15 @@ static int block_count;
 //#define ERROR_MAP_LENGTH D82_BLOCKS
 
 
-static int block_offset(int tr, int se)
-{
-    int sectors = 0, i;
-    for(i = 1; i < tr; i++)
-    {
-        sectors += imgcopy_sector_count(fs_settings, i);
-    }
-    return (sectors + se) * BLOCKSIZE;
-}
-
 static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
 {
-    if(fseek(the_file, block_offset(tr, se), SEEK_SET) == 0)
+    const unsigned char *data;
+
+    data = cbmlibmisc_image_block(&image, tr, se);
+    if(data)
     {
-        return fread(block, BLOCKSIZE, 1, the_file) != 1;
+        memcpy(block, data, BLOCKSIZE);
+        return 0;
     }
     return 1;
 }
@@ -59,7 +57,7 @@ static int atom_read_status;
 
 static int write_block(unsigned char tr, unsigned char se, const unsigned char *blk, int size, int read_status)
 {
-    long ofs;
+    int block;
     int ret;
 
     atom_tr = tr;
@@ -70,11 +68,14 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
 
     atom_execute = 1;
 
-    ofs = block_offset(tr, se);
-    if(fseek(the_file, ofs, SEEK_SET) == 0)
+    block = cbmlibmisc_image_block_number(&image, tr, se);
+    if(block >= 0)
     {
-        error_map[ofs / BLOCKSIZE] = (char) ((read_status == 0) ? 1 : read_status);
-        ret = fwrite(blk, size, 1, the_file) != 1;
+        error_map[block] = (char) ((read_status == 0) ? 1 : read_status);
+        memcpy(image.Data + block * BLOCKSIZE, blk, size);
+        /* errors show up again on close */
+        cbmlibmisc_image_track_written(&image, tr);
+        ret = 0;
     }
     else
     {
@@ -86,6 +87,27 @@ static int write_block(unsigned char tr, unsigned char se, const unsigned char *
     return ret;
 }
 
+/*
+ * the layout of the image, as given by the image type
+ */
+static int set_tracks(void)
+{
+    unsigned char sectors[MAX_TRACKS + 1];
+    int tracks = fs_settings->max_tracks;
+    int tr, count;
+
+    if(tracks > MAX_TRACKS)
+    {
+        return 1;
+    }
+    for(tr = 1; tr <= tracks; tr++)
+    {
+        count = imgcopy_sector_count(fs_settings, tr);
+        sectors[tr] = (unsigned char) ((count < 0) ? 0 : count);
+    }
+    return cbmlibmisc_image_set_tracks(&image, tracks, sectors);
+}
+
 static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
                      const void *arg, int for_writing,
                      turbo_start start, imgcopy_message_cb message_cb)
@@ -97,8 +119,11 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
 
     //printf("open imagefile ...\n");
 
-    the_file = NULL;
+    is_open = 0;
+    is_for_writing = for_writing;
+    error_map = NULL;
     fs_settings = settings;
+    fs_message_cb = message_cb;
     //block_count = 0;
 
     stat_ok = arch_filesize(name, &filesize) == 0;
@@ -151,8 +176,11 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
         {
             if(is_image)
             {
-                the_file = fopen(name, "rb");
-                if(the_file == NULL)
+                if(cbmlibmisc_image_open(&image, name, 0, 0) == 0)
+                {
+                    is_open = 1;
+                }
+                else
                 {
                     message_cb(0, "could not open %s", name);
                 }
@@ -183,69 +211,66 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     }
     else
     {
-        the_file = fopen(name, is_image ? "r+b" : "wb");
-        if(the_file)
+        if(cbmlibmisc_image_open(&image, name, 1, settings->atomic_write) == 0)
         {
             /* check whether we must resize or create an image file */
             int new_tr;
 
             new_tr = settings->max_tracks;
 
+            if(!is_image)
+            {
+                /* anything which is not an image is overwritten */
+                tr = 0;
+            }
+
             /* always use maximum size for error map */
             error_map = calloc(block_count, 1);
             if(!error_map)
             {
                 message_cb(0, "no memory for error map");
-                fclose(the_file);
-                if(!is_image)
-                {
-                    arch_unlink(name);
-                }
+                cbmlibmisc_image_close(&image, 0);
                 return 1;
             }
 
-            if(is_image)
+            if(error_info)
             {
-                if(error_info)
-                {
-                    if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) != 0 ||
-                       fread(error_map, block_count, 1, the_file) != 1)
-                    {
-                        message_cb(0, "%s: could not read error map", name);
-                        fclose(the_file);
-                        return 1;
-                    }
-                }
-                if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) != 0)
-                {
-                    message_cb(0, "%s: could not seek to end of file", name);
-                    fclose(the_file);
-                    return 1;
-                }
+                memcpy(error_map, image.Data + block_count * BLOCKSIZE, block_count);
             }
 
+            /* strip the error info, it is appended again on close */
+            cbmlibmisc_image_resize(&image, is_image ? block_count * BLOCKSIZE : 0);
+
             if(new_tr > tr)
             {
                 /* grow image */
                 message_cb(1, "growing image file to %d blocks", block_count);
 
-                if (arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE) != 0)
+                if(cbmlibmisc_image_resize(&image, block_count * BLOCKSIZE) != 0)
                 {
                     message_cb(0, "%s: could not extend image file", name);
-                    fclose(the_file);
-                    if(!is_image)
-                        arch_unlink(name);
+                    free(error_map);
+                    error_map = NULL;
+                    cbmlibmisc_image_close(&image, 0);
                     return 1;
                 }
             }
+
+            is_open = 1;
         }
         else
         {
             message_cb(0, "could not open %s", name);
         }
     }
+
+    if(is_open)
+    {
+        set_tracks();
+    }
+
     message_cb(2, "open imagefile ok. %s", name);
-    return the_file == NULL;
+    return !is_open;
 }
 
 static void close_disk(void)
@@ -256,7 +281,7 @@ static void close_disk(void)
      * redone before closing the disk
      */
 
-    if (the_file && atom_execute)
+    if (is_open && atom_execute)
     {
         atom_execute = 0;
         write_block(atom_tr, atom_se, atom_blk, atom_size, atom_read_status);
@@ -284,21 +309,21 @@ static void close_disk(void)
         }
     }
 
-    if(the_file)
+    if(is_open)
     {
-        if(has_errors)
+        if(is_for_writing && has_errors)
         {
-            if(fseek(the_file, block_count * BLOCKSIZE, SEEK_SET) == 0)
+            /* append the error map */
+            if(cbmlibmisc_image_resize(&image, block_count * (BLOCKSIZE + 1)) == 0)
             {
-                fwrite(error_map, block_count, 1, the_file);
+                memcpy(image.Data + block_count * BLOCKSIZE, error_map, block_count);
             }
         }
-        else
+
+        is_open = 0;
+        if(cbmlibmisc_image_close(&image, 1) != 0)
         {
-            if (arch_ftruncate(arch_fileno(the_file), block_count * BLOCKSIZE) < 0)
-            {
-                /* ignore it */
-            }
+            fs_message_cb(0, "could not write image file");
         }
     }
 
@@ -307,11 +332,6 @@ static void close_disk(void)
         free(error_map);
         error_map = NULL;
     }
-    if(the_file)
-    {
-        fclose(the_file);
-        the_file = NULL;
-    }
 }
 
 DECLARE_TRANSFER_FUNCS(fs_transfer, 0, 0);
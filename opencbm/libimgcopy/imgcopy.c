@@ -229,7 +229,7 @@ static int send_turbo(imgcopy_settings *settings, CBM_FILE fd, unsigned char drv
     printf("uploading drivecode %d\n", idx);
     prog = &drive_progs[idx];
 
-    return cbm_upload(fd, drv, 0x500, prog->prog, prog->size) != prog->size;
+    return cbm_upload_cached(fd, drv, 0x500, prog->prog, prog->size) != prog->size;
 }
 
 extern transfer_funcs imgcopy_fs_transfer,
@@ -488,6 +488,7 @@ imgcopy_settings *imgcopy_get_default_settings(void)
         settings->image_type_std = cbm_it_unknown;
         settings->two_sided   = -1; /* set later on */
         settings->error_mode  = em_on_error;
+        settings->atomic_write = 0;
         settings->cat_track = 0;
         settings->bam_track = 0;
         settings->block_count = 0;
@@ -202,9 +202,16 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     fd_cbm    = fd;
     two_sided = settings->two_sided;
 
-    opencbm_plugin_pp_dc_read_n = cbm_get_plugin_function_address("opencbm_plugin_pp_dc_read_n");
+    opencbm_plugin_pp_dc_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_pp_dc_read_n");
 
-    opencbm_plugin_pp_dc_write_n = cbm_get_plugin_function_address("opencbm_plugin_pp_dc_write_n");
+    opencbm_plugin_pp_dc_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_pp_dc_write_n");
+
+    /* the plugin might have the functions without the adapter supporting them */
+    if (!(cbm_block_caps(fd) & CBM_BLOCK_CAP(cbm_bp_pp_dc)))
+    {
+        opencbm_plugin_pp_dc_read_n = NULL;
+        opencbm_plugin_pp_dc_write_n = NULL;
+    }
 
     if(settings->drive_type != cbm_dt_cbm1541)
     {
@@ -222,7 +229,7 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     cbm_pp_read(fd_cbm);
 
                                                                         SETSTATEDEBUG((void)0);
-    cbm_upload(fd_cbm, d, 0x700, drive_prog, prog_size);
+    cbm_upload_cached(fd_cbm, d, 0x700, drive_prog, prog_size);
                                                                         SETSTATEDEBUG((void)0);
     start(fd, d);
                                                                         SETSTATEDEBUG((void)0);
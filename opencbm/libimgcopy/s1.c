@@ -14,14 +14,7 @@
 #include <stdlib.h>
 
 #include "arch.h"
-
-#include "opencbm-plugin.h"
-
-static opencbm_plugin_s1_read_n_t * opencbm_plugin_s1_read_n = NULL;
-
-static opencbm_plugin_s1_write_n_t * opencbm_plugin_s1_write_n = NULL;
-
-
+#include "iecscript.h"
 
 //
 // drive code
@@ -38,129 +31,35 @@ static const unsigned char s1_drive_prog_1581[] = {
 static CBM_FILE fd_cbm;
 static int two_sided;
 
+/* the drive program quits without acknowledging the last bits of
+ * the last byte, which cbm_block_write() would wait for */
 static int s1_write_byte_nohs(CBM_FILE fd, unsigned char c)
 {
-    int b, i;
-    for(i=7; ; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i);
-        b=(c >> i) & 1;
-                                                                        SETSTATEDEBUG((void)0);
-        if(b) cbm_iec_set(fd, IEC_DATA); else cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 1);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        if(b) cbm_iec_release(fd, IEC_DATA); else cbm_iec_set(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-
-        if(i<=0) return 0;
-                                                                        SETSTATEDEBUG((void)0);
-
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 1);
-#endif
-    }
+    unsigned char script[CBMLIBMISC_IEC_SCRIPT_S1_LEN];
                                                                         SETSTATEDEBUG((void)0);
+    return cbm_iec_script(fd, script, cbmlibmisc_iec_script_s1_write(script, c, 0), NULL, 0) < 0 ? -1 : 0;
 }
 
 static int s1_write_byte(CBM_FILE fd, unsigned char c)
 {
                                                                         SETSTATEDEBUG((void)0);
-    s1_write_byte_nohs(fd, c);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-    while(!cbm_iec_get(fd, IEC_DATA));
-#else
-    cbm_iec_wait(fd, IEC_DATA, 1);
-#endif
-                                                                        SETSTATEDEBUG(DebugBitCount=-1);
-    return 0;
+    return cbm_block_write(fd, cbm_bp_s1, &c, 1) == 1 ? 0 : -1;
 }
 
-/* write_n redirects USB writes to the external reader if required */
+/* write_n lets the adapter move all bytes with one request, if it can */
 static void write_n(const unsigned char *data, int size)
 {
-    int i;
-
-    if (opencbm_plugin_s1_write_n)
-    {
-        opencbm_plugin_s1_write_n(fd_cbm, data, size);
-        return;
-    }
-
-    for(i=0;i<size;i++)
-        s1_write_byte(fd_cbm, *data++);
-}
-
-static int s1_read_byte(CBM_FILE fd, unsigned char *c)
-{
-    int b=0, i;
-    *c = 0;
-    for(i=7; i>=0; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_CLOCK);
                                                                         SETSTATEDEBUG((void)0);
-        b = cbm_iec_get(fd, IEC_CLOCK);
-                                                                        SETSTATEDEBUG((void)0);
-        *c = (*c >> 1) | (b ? 0x80 : 0);
-        cbm_iec_set(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(b == cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, !b);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_DATA));
-#else
-        cbm_iec_wait(fd, IEC_DATA, 1);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_CLOCK);
-    }
+    cbm_block_write(fd_cbm, cbm_bp_s1, data, size);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
-    return 0;
 }
 
-/* read_n redirects USB reads to the external reader if required */
+/* read_n lets the adapter move all bytes with one request, if it can */
 static void read_n(unsigned char *data, int size)
 {
-    int i;
-
-    if (opencbm_plugin_s1_read_n)
-    {
-        opencbm_plugin_s1_read_n(fd_cbm, data, size);
-        return;
-    }
-
-    for(i=0;i<size;i++)
-        s1_read_byte(fd_cbm, data++);
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_block_read(fd_cbm, cbm_bp_s1, data, size);
+                                                                        SETSTATEDEBUG(DebugBitCount=-1);
 }
 
 static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
@@ -222,21 +121,17 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     fd_cbm = fd;
     two_sided = settings->two_sided;
 
-    opencbm_plugin_s1_read_n = cbm_get_plugin_function_address("opencbm_plugin_s1_read_n");
-
-    opencbm_plugin_s1_write_n = cbm_get_plugin_function_address("opencbm_plugin_s1_write_n");
-
                                                                         SETSTATEDEBUG((void)0);
     switch(settings->drive_type)
     {
         case cbm_dt_cbm1541:
         case cbm_dt_cbm1570:
         case cbm_dt_cbm1571:
-            cbm_upload(fd_cbm, d, 0x700, s1_drive_prog_1541, sizeof(s1_drive_prog_1541));
+            cbm_upload_cached(fd_cbm, d, 0x700, s1_drive_prog_1541, sizeof(s1_drive_prog_1541));
             break;
 
         case cbm_dt_cbm1581:
-            cbm_upload(fd_cbm, d, 0x700, s1_drive_prog_1581, sizeof(s1_drive_prog_1581));
+            cbm_upload_cached(fd_cbm, d, 0x700, s1_drive_prog_1581, sizeof(s1_drive_prog_1581));
             break;
 
         case cbm_dt_cbm2040:
@@ -269,10 +164,6 @@ static void close_disk(void)
                                                                         SETSTATEDEBUG((void)0);
     arch_usleep(100);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
-
-    opencbm_plugin_s1_read_n = NULL;
-
-    opencbm_plugin_s1_write_n = NULL;
 }
 
 static int send_track_map(imgcopy_settings *settings, unsigned char tr, const char *trackmap, unsigned char count)
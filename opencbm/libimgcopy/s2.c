@@ -14,13 +14,7 @@
 #include <stdlib.h>
 
 #include "arch.h"
-
-#include "opencbm-plugin.h"
-
-static opencbm_plugin_s2_read_n_t * opencbm_plugin_s2_read_n = NULL;
-
-static opencbm_plugin_s2_write_n_t * opencbm_plugin_s2_write_n = NULL;
-
+#include "iecscript.h"
 
 //
 // drive code
@@ -37,111 +31,35 @@ static const unsigned char s2_drive_prog_1581[] = {
 static CBM_FILE fd_cbm;
 static int two_sided;
 
-static int s2_read_byte(CBM_FILE fd, unsigned char *c)
-{
-    int i;
-    *c = 0;
-    for(i=4; i>0; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i*2);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_CLOCK));
-                                                                        SETSTATEDEBUG((void)0);
-        *c = (*c>>1) | (cbm_iec_get(fd, IEC_DATA) ? 0x80 : 0);
-#else
-        *c = (*c>>1) | ((cbm_iec_wait(fd, IEC_CLOCK, 0) & IEC_DATA) ? 0x80 : 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_ATN);
-                                                                        SETSTATEDEBUG(DebugBitCount--);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd,IEC_CLOCK));
-                                                                        SETSTATEDEBUG((void)0);
-        *c = (*c>>1) | (cbm_iec_get(fd, IEC_DATA) ? 0x80 : 0);
-#else
-        *c = (*c>>1) | ((cbm_iec_wait(fd, IEC_CLOCK, 1) & IEC_DATA) ? 0x80 : 0);
-#endif
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_ATN);
-    }
-                                                                        SETSTATEDEBUG(DebugBitCount=-1);
-    return 0;
-}
-
+/* the drive program quits without acknowledging the last bits of
+ * the last byte, which cbm_block_write() would wait for */
 static int s2_write_byte_nohs(CBM_FILE fd, unsigned char c)
 {
-    int i;
-    for(i=4; ; i--) {
-                                                                        SETSTATEDEBUG(DebugBitCount=i*2);
-        c & 1 ? cbm_iec_set(fd, IEC_DATA) : cbm_iec_release(fd, IEC_DATA);
-        c >>= 1;
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_release(fd, IEC_ATN);
-#ifndef USE_CBM_IEC_WAIT
-        while(cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 0);
-#endif
-                                                                        SETSTATEDEBUG(DebugBitCount--);
-        c & 1 ? cbm_iec_set(fd, IEC_DATA) : cbm_iec_release(fd, IEC_DATA);
-        c >>= 1;
-                                                                        SETSTATEDEBUG((void)0);
-        cbm_iec_set(fd, IEC_ATN);
-
-        if(i<=1) return 0;
-
+    unsigned char script[CBMLIBMISC_IEC_SCRIPT_S2_WRITE_LEN];
                                                                         SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-        while(!cbm_iec_get(fd, IEC_CLOCK));
-#else
-        cbm_iec_wait(fd, IEC_CLOCK, 1);
-#endif
-    }
+    return cbm_iec_script(fd, script, cbmlibmisc_iec_script_s2_write(script, c, 0), NULL, 0) < 0 ? -1 : 0;
 }
 
-/* read_n redirects USB reads to the external reader if required */
-static void read_n(unsigned char *data, int size)
+static int s2_write_byte(CBM_FILE fd, unsigned char c)
 {
-    int i;
-
-    if (opencbm_plugin_s2_read_n)
-    {
-        opencbm_plugin_s2_read_n(fd_cbm, data, size);
-        return;
-    }
-
-    for(i=0;i<size;i++)
-        s2_read_byte(fd_cbm, data++);
+                                                                        SETSTATEDEBUG((void)0);
+    return cbm_block_write(fd, cbm_bp_s2, &c, 1) == 1 ? 0 : -1;
 }
 
-static int s2_write_byte(CBM_FILE fd, unsigned char c)
+/* write_n lets the adapter move all bytes with one request, if it can */
+static void write_n(const unsigned char *data, int size)
 {
                                                                         SETSTATEDEBUG((void)0);
-    s2_write_byte_nohs(fd, c);
-                                                                        SETSTATEDEBUG((void)0);
-#ifndef USE_CBM_IEC_WAIT
-    while(!cbm_iec_get(fd, IEC_CLOCK));
-#else
-    cbm_iec_wait(fd, IEC_CLOCK, 1);
-#endif
+    cbm_block_write(fd_cbm, cbm_bp_s2, data, size);
                                                                         SETSTATEDEBUG(DebugBitCount=-1);
-    cbm_iec_release(fd, IEC_DATA);
-                                                                        SETSTATEDEBUG((void)0);
-    return 0;
 }
 
-/* write_n redirects USB writes to the external reader if required */
-static void write_n(const unsigned char *data, int size)
+/* read_n lets the adapter move all bytes with one request, if it can */
+static void read_n(unsigned char *data, int size)
 {
-    int i;
-
-    if (opencbm_plugin_s2_write_n)
-    {
-        opencbm_plugin_s2_write_n(fd_cbm, data, size);
-        return;
-    }
-
-    for(i=0;i<size;i++)
-    s2_write_byte(fd_cbm, *data++);
+                                                                        SETSTATEDEBUG((void)0);
+    cbm_block_read(fd_cbm, cbm_bp_s2, data, size);
+                                                                        SETSTATEDEBUG(DebugBitCount=-1);
 }
 
 static int read_block(unsigned char tr, unsigned char se, unsigned char *block)
@@ -194,21 +112,17 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     fd_cbm = fd;
     two_sided = settings->two_sided;
 
-    opencbm_plugin_s2_read_n = cbm_get_plugin_function_address("opencbm_plugin_s2_read_n");
-
-    opencbm_plugin_s2_write_n = cbm_get_plugin_function_address("opencbm_plugin_s2_write_n");
-
                                                                         SETSTATEDEBUG((void)0);
     switch(settings->drive_type)
     {
        case cbm_dt_cbm1541:
        case cbm_dt_cbm1570:
        case cbm_dt_cbm1571:
-        cbm_upload(fd_cbm, d, 0x700, s2_drive_prog_1541, sizeof(s2_drive_prog_1541));
+        cbm_upload_cached(fd_cbm, d, 0x700, s2_drive_prog_1541, sizeof(s2_drive_prog_1541));
         break;
 
        case cbm_dt_cbm1581:
-        cbm_upload(fd_cbm, d, 0x700, s2_drive_prog_1581, sizeof(s2_drive_prog_1581));
+        cbm_upload_cached(fd_cbm, d, 0x700, s2_drive_prog_1581, sizeof(s2_drive_prog_1581));
         break;
 
        case cbm_dt_cbm2040:
@@ -252,10 +166,6 @@ static void close_disk(void)
                                                                         SETSTATEDEBUG((void)0);
     cbm_iec_set(fd_cbm, IEC_CLOCK);
                                                                         SETSTATEDEBUG((void)0);
-
-    opencbm_plugin_s2_read_n = NULL;
-
-    opencbm_plugin_s2_write_n = NULL;
 }
 
 static int send_track_map(imgcopy_settings *settings, unsigned char tr, const char *trackmap, unsigned char count)
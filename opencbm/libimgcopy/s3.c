@@ -139,19 +139,19 @@ static int open_disk(CBM_FILE fd, imgcopy_settings *settings,
     fd_cbm = fd;
     two_sided = settings->two_sided;
 
-    opencbm_plugin_s3_read_n = cbm_get_plugin_function_address("opencbm_plugin_s3_read_n");
-    opencbm_plugin_s3_write_n = cbm_get_plugin_function_address("opencbm_plugin_s3_write_n");
+    opencbm_plugin_s3_read_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s3_read_n");
+    opencbm_plugin_s3_write_n = cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_s3_write_n");
 
     switch(settings->drive_type)
     {
         case cbm_dt_cbm1541:
         case cbm_dt_cbm1570:
         case cbm_dt_cbm1571:
-            cbm_upload(fd_cbm, d, 0x700, s3_drive_prog_1541, sizeof(s3_drive_prog_1541));
+            cbm_upload_cached(fd_cbm, d, 0x700, s3_drive_prog_1541, sizeof(s3_drive_prog_1541));
             break;
 
         case cbm_dt_cbm1581:
-            cbm_upload(fd_cbm, d, 0x700, s3_drive_prog_1581, sizeof(s3_drive_prog_1581));
+            cbm_upload_cached(fd_cbm, d, 0x700, s3_drive_prog_1581, sizeof(s3_drive_prog_1581));
             break;
 
         case cbm_dt_cbm2040:
@@ -0,0 +1,152 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+ */
+
+/*! **************************************************************
+** \file libmisc/iecscript.c \n
+** \author OpenCBM team \n
+** \n
+** \brief The IEC line scripts of the serial-1 and serial-2 protocols
+**
+** cbm_block_read() and cbm_block_write() use these scripts if the
+** adapter cannot move the blocks itself. The drive programs of
+** d64copy and imgcopy are left with a last byte which the drive does
+** not acknowledge; they build it here, too, with Handshake set to 0.
+**
+****************************************************************/
+
+#include "opencbm.h"
+#include "iecscript.h"
+
+/*! \brief Build the script which reads a serial-1 byte
+
+ \param Script
+   Where to store the script.
+
+ \return
+   The length of the script, CBMLIBMISC_IEC_SCRIPT_S1_LEN.
+*/
+unsigned int
+cbmlibmisc_iec_script_s1_read(unsigned char *Script)
+{
+    unsigned int n = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--)
+    {
+        Script[n++] = IEC_SCRIPT_WAIT_RELEASE(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_RELEASE(IEC_CLOCK);
+        Script[n++] = IEC_SCRIPT_SAMPLE(IEC_CLOCK);
+        Script[n++] = IEC_SCRIPT_SET(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_WAIT_CHANGE(IEC_CLOCK);
+        Script[n++] = IEC_SCRIPT_RELEASE(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_WAIT_SET(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_SET(IEC_CLOCK);
+    }
+    return n;
+}
+
+/*! \brief Build the script which writes a serial-1 byte
+
+ \param Script
+   Where to store the script.
+
+ \param Byte
+   The byte to write.
+
+ \param Handshake
+   0 if the drive does not acknowledge the last bit.
+
+ \return
+   The length of the script, at most CBMLIBMISC_IEC_SCRIPT_S1_LEN.
+*/
+unsigned int
+cbmlibmisc_iec_script_s1_write(unsigned char *Script, unsigned char Byte, int Handshake)
+{
+    unsigned int n = 0;
+    int b, i;
+
+    for (i = 7; i >= 0; i--)
+    {
+        b = (Byte >> i) & 1;
+        Script[n++] = b ? IEC_SCRIPT_SET(IEC_DATA) : IEC_SCRIPT_RELEASE(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_RELEASE(IEC_CLOCK);
+        Script[n++] = IEC_SCRIPT_WAIT_SET(IEC_CLOCK);
+        Script[n++] = b ? IEC_SCRIPT_RELEASE(IEC_DATA) : IEC_SCRIPT_SET(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_WAIT_RELEASE(IEC_CLOCK);
+        Script[n++] = IEC_SCRIPT_RELEASE(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_SET(IEC_CLOCK);
+        if (i > 0 || Handshake)
+            Script[n++] = IEC_SCRIPT_WAIT_SET(IEC_DATA);
+    }
+    return n;
+}
+
+/*! \brief Build the script which reads a serial-2 byte
+
+ \param Script
+   Where to store the script.
+
+ \return
+   The length of the script, CBMLIBMISC_IEC_SCRIPT_S2_READ_LEN.
+*/
+unsigned int
+cbmlibmisc_iec_script_s2_read(unsigned char *Script)
+{
+    unsigned int n = 0;
+    int i;
+
+    for (i = 4; i > 0; i--)
+    {
+        Script[n++] = IEC_SCRIPT_WAIT_RELEASE(IEC_CLOCK);
+        Script[n++] = IEC_SCRIPT_SAMPLE(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_RELEASE(IEC_ATN);
+        Script[n++] = IEC_SCRIPT_WAIT_SET(IEC_CLOCK);
+        Script[n++] = IEC_SCRIPT_SAMPLE(IEC_DATA);
+        Script[n++] = IEC_SCRIPT_SET(IEC_ATN);
+    }
+    return n;
+}
+
+/*! \brief Build the script which writes a serial-2 byte
+
+ \param Script
+   Where to store the script.
+
+ \param Byte
+   The byte to write.
+
+ \param Handshake
+   0 if the drive does not acknowledge the last bits.
+
+ \return
+   The length of the script, at most CBMLIBMISC_IEC_SCRIPT_S2_WRITE_LEN.
+*/
+unsigned int
+cbmlibmisc_iec_script_s2_write(unsigned char *Script, unsigned char Byte, int Handshake)
+{
+    unsigned int n = 0;
+    int i;
+
+    for (i = 4; i > 0; i--)
+    {
+        Script[n++] = Byte & 1 ? IEC_SCRIPT_SET(IEC_DATA) : IEC_SCRIPT_RELEASE(IEC_DATA);
+        Byte >>= 1;
+        Script[n++] = IEC_SCRIPT_RELEASE(IEC_ATN);
+        Script[n++] = IEC_SCRIPT_WAIT_RELEASE(IEC_CLOCK);
+        Script[n++] = Byte & 1 ? IEC_SCRIPT_SET(IEC_DATA) : IEC_SCRIPT_RELEASE(IEC_DATA);
+        Byte >>= 1;
+        Script[n++] = IEC_SCRIPT_SET(IEC_ATN);
+        if (i > 1 || Handshake)
+            Script[n++] = IEC_SCRIPT_WAIT_SET(IEC_CLOCK);
+    }
+    if (Handshake)
+        Script[n++] = IEC_SCRIPT_RELEASE(IEC_DATA);
+    return n;
+}
@@ -0,0 +1,421 @@
+/*
+ *      This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ *
+ */
+
+/*! **************************************************************
+** \file libmisc/imagefile.c \n
+** \author OpenCBM team \n
+** \n
+** \brief Disk image files (.d64, .d71, .d80, .d81, .d82) held in memory
+**
+** The image is read with one fread() on open and written with one
+** fwrite() on close. If requested, the data is written into a
+** temporary file which is renamed to the image name on close, so
+** that there is never a half-written image file. Otherwise, every
+** track is also written into the image file when the caller moves
+** on to the next one, so that a crash does not lose what has been
+** read so far.
+**
+****************************************************************/
+
+#include "arch.h"
+#include "imagefile.h"
+#include "libmisc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*! \internal \brief Free all resources of an image
+
+ \param Image
+   The image to free.
+*/
+static void
+image_free(cbmlibmisc_image *Image)
+{
+    if (Image->File)
+    {
+        fclose(Image->File);
+        Image->File = NULL;
+    }
+
+    free(Image->Data);
+    Image->Data = NULL;
+    Image->Length = Image->Allocated = 0;
+
+    cbmlibmisc_strfree(Image->TempName);
+    Image->TempName = NULL;
+
+    cbmlibmisc_strfree(Image->Name);
+    Image->Name = NULL;
+}
+
+/*! \brief Open an image file
+
+ Open an image file and read its contents into memory.
+
+ \param Image
+   Pointer to the image structure to be initialized.
+
+ \param Name
+   The name of the image file.
+
+ \param ForWriting
+   If 0, the image is only read; it must exist, then.
+   If 1, the image is written back on cbmlibmisc_image_close().
+   It is created if it does not exist yet.
+
+ \param Atomic
+   Only used if ForWriting is 1. If 1, the image file itself is
+   not touched until cbmlibmisc_image_close(). Instead, the data is
+   written into "<Name>.tmp", which replaces the image file then.
+
+ \return
+   0 on success, 1 on error. On error, arch_get_errno() tells the
+   reason, and the image structure needs no cleanup.
+*/
+int
+cbmlibmisc_image_open(cbmlibmisc_image *Image, const char *Name, int ForWriting, int Atomic)
+{
+    off_t filesize;
+    FILE *file = NULL;
+    int error = 1;
+
+    memset(Image, 0, sizeof(*Image));
+
+    do {
+        Image->Name = cbmlibmisc_strdup(Name);
+        if (Image->Name == NULL)
+            break;
+
+        Image->Existed = arch_filesize(Name, &filesize) == 0;
+
+        if (!Image->Existed && !ForWriting)
+            break;
+
+        if (ForWriting && !Atomic)
+        {
+            /* the file we read from is the file we write to */
+            file = Image->File = fopen(Name, Image->Existed ? "r+b" : "wb");
+        }
+        else if (Image->Existed)
+        {
+            file = fopen(Name, "rb");
+        }
+
+        if (Image->Existed)
+        {
+            if (file == NULL)
+                break;
+
+            if (cbmlibmisc_image_resize(Image, (size_t) filesize))
+                break;
+
+            if (Image->Length > 0 && fread(Image->Data, Image->Length, 1, file) != 1)
+                break;
+
+            if (file != Image->File)
+            {
+                fclose(file);
+                file = NULL;
+            }
+        }
+
+        if (ForWriting && Atomic)
+        {
+            Image->TempName = cbmlibmisc_sprintf("%s.tmp", Name);
+            if (Image->TempName == NULL)
+                break;
+
+            Image->File = fopen(Image->TempName, "wb");
+        }
+
+        if (ForWriting && Image->File == NULL)
+            break;
+
+        error = 0;
+
+    } while (0);
+
+    if (error)
+    {
+        if (file && file != Image->File)
+        {
+            fclose(file);
+        }
+        if (Image->File && !Image->Existed && !Atomic)
+        {
+            fclose(Image->File);
+            Image->File = NULL;
+            arch_unlink(Name);
+        }
+        image_free(Image);
+    }
+
+    return error;
+}
+
+/*! \brief Close an image file
+
+ Write back the image (if it was opened for writing) and free
+ all resources.
+
+ \param Image
+   The image to close.
+
+ \param Commit
+   If 1, the image contents are written into the image file.
+   If 0, the image file is left as it was before it was opened,
+   or it is removed if it did not exist before. This is used
+   for giving up after errors in the caller's open function.
+
+ \return
+   0 on success, 1 if the image could not be written.
+*/
+int
+cbmlibmisc_image_close(cbmlibmisc_image *Image, int Commit)
+{
+    int error = 0;
+
+    if (Image->File)
+    {
+        if (Commit)
+        {
+            if (fseek(Image->File, 0, SEEK_SET) != 0
+                || (Image->Length > 0 && fwrite(Image->Data, Image->Length, 1, Image->File) != 1)
+                || fflush(Image->File) != 0)
+            {
+                error = 1;
+            }
+            else if (Image->TempName)
+            {
+                /* make sure the data is on the disk before it replaces the image */
+                error = arch_fsync(arch_fileno(Image->File)) != 0;
+            }
+            else
+            {
+                /* the image might have been bigger, e.g. with error info */
+                error = arch_ftruncate(arch_fileno(Image->File), Image->Length) != 0;
+            }
+        }
+
+        fclose(Image->File);
+        Image->File = NULL;
+
+        if (Image->TempName)
+        {
+            if (Commit && !error)
+            {
+                error = arch_rename_replace(Image->TempName, Image->Name) != 0;
+            }
+            if (!Commit || error)
+            {
+                arch_unlink(Image->TempName);
+            }
+        }
+        else if (!Commit && !Image->Existed)
+        {
+            arch_unlink(Image->Name);
+        }
+    }
+
+    image_free(Image);
+
+    return error;
+}
+
+/*! \brief Tell that a block of a track has been written
+
+ Without Atomic, the blocks of the previous track are written into
+ the image file when the blocks of another track start to arrive.
+ With Atomic, this does nothing; the temporary file gets all of the
+ image on close.
+
+ \param Image
+   The image.
+
+ \param Track
+   The track of the block which has been written into Data.
+
+ \return
+   0 on success, 1 if the image file could not be written.
+   cbmlibmisc_image_close() writes the track again anyway.
+*/
+int
+cbmlibmisc_image_track_written(cbmlibmisc_image *Image, unsigned int Track)
+{
+    unsigned int track = Image->WriteTrack;
+    size_t offset, length;
+    int error = 0;
+
+    if (Image->File == NULL || Image->TempName || track == Track)
+        return 0;
+
+    if (track != 0 && track <= Image->Tracks)
+    {
+        offset = (size_t) Image->TrackOffset[track] * CBMLIBMISC_IMAGE_BLOCKSIZE;
+        length = (size_t) Image->TrackOffset[track + 1] * CBMLIBMISC_IMAGE_BLOCKSIZE;
+        if (length > Image->Length)
+            length = Image->Length;
+
+        if (offset < length)
+        {
+            length -= offset;
+            error = fseek(Image->File, (long) offset, SEEK_SET) != 0
+                || fwrite(Image->Data + offset, length, 1, Image->File) != 1
+                || fflush(Image->File) != 0;
+        }
+    }
+
+    Image->WriteTrack = Track;
+
+    return error;
+}
+
+/*! \brief Set the number of tracks and sectors of an image
+
+ This builds the table which cbmlibmisc_image_block() uses to find
+ a block. It does not change the image contents or its size; use
+ cbmlibmisc_image_resize() for that.
+
+ \param Image
+   The image.
+
+ \param Tracks
+   The number of tracks of the image.
+
+ \param Sectors
+   Sectors[t] is the number of sectors of track t, for t = 1 to
+   Tracks. Sectors[0] is not used.
+
+ \return
+   0 on success, 1 if there are too many tracks.
+*/
+int
+cbmlibmisc_image_set_tracks(cbmlibmisc_image *Image, unsigned int Tracks, const unsigned char *Sectors)
+{
+    unsigned int track;
+
+    if (Tracks > CBMLIBMISC_IMAGE_MAX_TRACKS)
+        return 1;
+
+    Image->TrackOffset[0] = 0;
+    Image->TrackOffset[1] = 0;
+
+    for (track = 1; track <= Tracks; track++)
+    {
+        Image->TrackOffset[track + 1] = Image->TrackOffset[track] + Sectors[track];
+    }
+
+    Image->Tracks = Tracks;
+    Image->BlockCount = Image->TrackOffset[Tracks + 1];
+
+    return 0;
+}
+
+/*! \brief Change the size of an image
+
+ \param Image
+   The image.
+
+ \param Length
+   The new size of the image, in bytes. If the image grows,
+   the new bytes are set to 0.
+
+ \return
+   0 on success, 1 if there is not enough memory.
+*/
+int
+cbmlibmisc_image_resize(cbmlibmisc_image *Image, size_t Length)
+{
+    if (Length > Image->Allocated)
+    {
+        unsigned char *data = realloc(Image->Data, Length);
+
+        if (data == NULL)
+            return 1;
+
+        Image->Data = data;
+        Image->Allocated = Length;
+    }
+
+    if (Length > Image->Length)
+    {
+        memset(Image->Data + Image->Length, 0, Length - Image->Length);
+    }
+
+    Image->Length = Length;
+
+    return 0;
+}
+
+/*! \brief Find the block number of a block of an image
+
+ \param Image
+   The image.
+
+ \param Track
+   The track of the block, starting with 1.
+
+ \param Sector
+   The sector of the block, starting with 0.
+
+ \return
+   The number of the block, counted from the start of the image,
+   or -1 if the block is not part of the image.
+*/
+int
+cbmlibmisc_image_block_number(cbmlibmisc_image *Image, unsigned int Track, unsigned int Sector)
+{
+    unsigned int block;
+
+    if (Track < 1 || Track > Image->Tracks
+        || Sector >= Image->TrackOffset[Track + 1] - Image->TrackOffset[Track])
+    {
+        return -1;
+    }
+
+    block = Image->TrackOffset[Track] + Sector;
+
+    if ((size_t) (block + 1) * CBMLIBMISC_IMAGE_BLOCKSIZE > Image->Length)
+    {
+        return -1;
+    }
+
+    return (int) block;
+}
+
+/*! \brief Find a block of an image
+
+ \param Image
+   The image.
+
+ \param Track
+   The track of the block, starting with 1.
+
+ \param Sector
+   The sector of the block, starting with 0.
+
+ \return
+   Pointer to the CBMLIBMISC_IMAGE_BLOCKSIZE bytes of the block,
+   or NULL if the block is not part of the image.
+*/
+unsigned char *
+cbmlibmisc_image_block(cbmlibmisc_image *Image, unsigned int Track, unsigned int Sector)
+{
+    int block = cbmlibmisc_image_block_number(Image, Track, Sector);
+
+    if (block < 0)
+    {
+        return NULL;
+    }
+
+    return Image->Data + (size_t) block * CBMLIBMISC_IMAGE_BLOCKSIZE;
+}
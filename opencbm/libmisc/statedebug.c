@@ -5,6 +5,7 @@
  *      2 of the License, or (at your option) any later version.
  *
  *  Copyright 2011 Spiro Trikaliotis
+ *  Copyright 2026 OpenCBM team
  *
  */
 
@@ -14,23 +15,281 @@
 ** \n
 ** \brief Debug states in transfer functions of end-user tools
 **
+** The trace points are recorded into one ring per thread. Only the
+** thread itself writes into its ring, thus, no locking is needed;
+** the rings are registered in a fixed table with an atomic increment.
+**
 ****************************************************************/
 
+#ifdef WIN32
+# include <windows.h>
+#endif
+
 #include "statedebug.h"
 #include "version.h"
+#include "arch.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+# define STATEDEBUG_ATOMIC_INC(_x) InterlockedIncrement(&(_x))     /*!< increment, return the new value */
+#else
+# define STATEDEBUG_ATOMIC_INC(_x) __sync_add_and_fetch(&(_x), 1)  /*!< increment, return the new value */
+#endif
+
+/*! \brief the maximum number of threads which can be traced */
+#define STATEDEBUG_MAX_THREADS 16
+
+/*! \brief one recorded trace point */
+typedef struct statedebug_event_s
+{
+    unsigned long Time;     /*!< the time stamp, from arch_time_usec() */
+    const char *File;       /*!< the source file of the trace point */
+    int Line;               /*!< the line of the trace point */
+    int BlockCount;         /*!< the value of DebugBlockCount */
+    int ByteCount;          /*!< the value of DebugByteCount */
+    int BitCount;           /*!< the value of DebugBitCount */
+} statedebug_event_t;
+
+/*! \brief the trace of one thread */
+typedef struct statedebug_ring_s
+{
+    unsigned long Count;    /*!< the number of events recorded in total */
+    statedebug_event_t Event[STATEDEBUG_RING_SIZE]; /*!< the last events, Count % STATEDEBUG_RING_SIZE is the next one */
+} statedebug_ring_t;
+
+enum statedebug_state_e DebugTraceState = statedebug_unknown;
+
+STATEDEBUG_THREAD int DebugBlockCount = -1;
+STATEDEBUG_THREAD int DebugByteCount = -1;
+STATEDEBUG_THREAD int DebugBitCount = -1;
+
+/*! \brief the ring of the current thread; NULL if there is none yet */
+static STATEDEBUG_THREAD statedebug_ring_t *statedebug_ring;
+
+/*! \brief the rings of all threads, in the order of their first trace point */
+static statedebug_ring_t *statedebug_rings[STATEDEBUG_MAX_THREADS];
+
+/*! \brief the number of entries of statedebug_rings which have been handed out */
+static volatile long statedebug_ring_count;
+
+/*! \brief the ring for the threads which do not fit into statedebug_rings; it is never saved */
+static statedebug_ring_t statedebug_overflow_ring;
+
+/*! \internal \brief Write the trace at the end of the program */
+static void
+statedebug_atexit(void)
+{
+    DebugTraceSave(NULL);
+}
+
+/*! \internal \brief Check the environment if the trace is requested */
+static void
+statedebug_init(void)
+{
+    const char *target = getenv(STATEDEBUG_ENVIRONMENT);
+
+    if (target != NULL && *target != '\0')
+    {
+        DebugTraceState = statedebug_on;
+        atexit(statedebug_atexit);
+    }
+    else
+    {
+        DebugTraceState = statedebug_off;
+    }
+}
+
+/*! \internal \brief Get the ring of the current thread, create it if necessary */
+static statedebug_ring_t *
+statedebug_get_ring(void)
+{
+    statedebug_ring_t *ring = statedebug_ring;
+
+    if (ring == NULL)
+    {
+        long index = STATEDEBUG_ATOMIC_INC(statedebug_ring_count) - 1;
+
+        if (index < STATEDEBUG_MAX_THREADS)
+            ring = calloc(1, sizeof(*ring));
+
+        if (ring != NULL)
+            statedebug_rings[index] = ring;
+        else
+            ring = &statedebug_overflow_ring;
+
+        statedebug_ring = ring;
+    }
+
+    return ring;
+}
+
+/*! \brief Record a trace point
+
+ Use SETSTATEDEBUG() or STATEDEBUG_TRACE() instead of calling
+ this directly.
+
+ \param File
+   The source file of the trace point.
+
+ \param Line
+   The line of the trace point.
+*/
+void
+DebugTrace(const char *File, int Line)
+{
+    statedebug_ring_t *ring;
+    statedebug_event_t *event;
+
+    if (DebugTraceState == statedebug_unknown)
+        statedebug_init();
+
+    if (DebugTraceState != statedebug_on)
+        return;
+
+    ring = statedebug_get_ring();
+    event = &ring->Event[ring->Count % STATEDEBUG_RING_SIZE];
 
-volatile signed int DebugLineNumber=-1, DebugBlockCount=-1,
-                    DebugByteCount=-1, DebugBitCount=-1;
-volatile char * DebugFileName = "";
+    event->Time = arch_time_usec();
+    event->File = File;
+    event->Line = Line;
+    event->BlockCount = DebugBlockCount;
+    event->ByteCount = DebugByteCount;
+    event->BitCount = DebugBitCount;
+
+    ring->Count++;
+}
+
+/*! \internal \brief Write a 4 byte number, little endian */
+static void
+statedebug_put32(FILE *File, unsigned long Value)
+{
+    putc((int) (Value & 0xff), File);
+    putc((int) ((Value >> 8) & 0xff), File);
+    putc((int) ((Value >> 16) & 0xff), File);
+    putc((int) ((Value >> 24) & 0xff), File);
+}
+
+/*! \brief Write the trace of all threads into a file
+
+ See statedebug.h for the format of the file.
+
+ \param Filename
+   The name of the file. If NULL, the file named by the
+   environment variable OPENCBM_TRACE is used.
+
+ \return
+   0 on success, 1 if the trace is off or the file could
+   not be written.
+
+ The other threads are not stopped; the events they record
+ while the file is written might be garbled.
+*/
+int
+DebugTraceSave(const char *Filename)
+{
+    FILE *file;
+    long rings = statedebug_ring_count;
+    long i;
+    int error;
+
+    if (Filename == NULL)
+        Filename = getenv(STATEDEBUG_ENVIRONMENT);
+
+    if (DebugTraceState != statedebug_on || Filename == NULL)
+        return 1;
+
+    if (rings > STATEDEBUG_MAX_THREADS)
+        rings = STATEDEBUG_MAX_THREADS;
+
+    file = fopen(Filename, "wb");
+
+    if (file == NULL)
+        return 1;
+
+    fwrite(STATEDEBUG_FILE_MAGIC, 1, strlen(STATEDEBUG_FILE_MAGIC), file);
+    statedebug_put32(file, rings);
+
+    for (i = 0; i < rings; i++)
+    {
+        const statedebug_ring_t *ring = statedebug_rings[i];
+        unsigned long count = ring ? ring->Count : 0;
+        unsigned long stored = count < STATEDEBUG_RING_SIZE ? count : STATEDEBUG_RING_SIZE;
+        unsigned long n;
+
+        statedebug_put32(file, i);
+        statedebug_put32(file, count);
+        statedebug_put32(file, stored);
+
+        for (n = count - stored; n < count; n++)
+        {
+            const statedebug_event_t *event = &ring->Event[n % STATEDEBUG_RING_SIZE];
+            const char *name = event->File ? event->File : "";
+            size_t length = strlen(name);
+
+            if (length > 0xffff)
+                length = 0xffff;
+
+            statedebug_put32(file, event->Time);
+            statedebug_put32(file, event->Line);
+            statedebug_put32(file, event->BlockCount);
+            statedebug_put32(file, event->ByteCount);
+            statedebug_put32(file, event->BitCount);
+            putc((int) (length & 0xff), file);
+            putc((int) (length >> 8), file);
+            fwrite(name, 1, length, file);
+        }
+    }
+
+    error = ferror(file) != 0;
+
+    if (fclose(file) != 0)
+        error = 1;
+
+    return error;
+}
+
+/*! \brief Get the last trace point of the current thread
+
+ \param File
+   Receives the source file of the trace point.
+
+ \param Line
+   Receives the line of the trace point.
+
+ \return
+   1 if there is a trace point, 0 if the trace is off or the
+   thread has not passed a trace point yet.
+*/
+int
+DebugTraceLast(const char **File, int *Line)
+{
+    const statedebug_ring_t *ring = statedebug_ring;
+    const statedebug_event_t *event;
+
+    if (ring == NULL || ring->Count == 0 || ring == &statedebug_overflow_ring)
+        return 0;
+
+    event = &ring->Event[(ring->Count - 1) % STATEDEBUG_RING_SIZE];
+    *File = event->File;
+    *Line = event->Line;
+
+    return 1;
+}
 
 void DebugPrintDebugCounters(void)
 {
+    const char *file = "";
+    int line = -1;
+
+    DebugTraceLast(&file, &line);
+
     fprintf(stderr, "file: %s"
                       "\n\tversion: " OPENCBM_VERSION_STRING ", built: " __DATE__ " " __TIME__
                       "\n\tline=%d, blocks=%d, bytes=%d, bits=%d\n",
-                      DebugFileName, DebugLineNumber,
+                      file, line,
                       DebugBlockCount, DebugByteCount,
                       DebugBitCount);
 }
@@ -26,15 +26,22 @@
 #include <usb.h>
 #endif
 
+struct opencbm_usb_async;
+
 struct opencbm_usb_handle {
 #if HAVE_LIBUSB1
         libusb_context *ctx;
         libusb_device_handle *devh;
+        struct opencbm_usb_async *async; /*!< \internal \brief queue of asynchronous transfers, NULL if not in use */
 #elif HAVE_LIBUSB0
         usb_dev_handle *devh; /*!< \internal \brief handle to the xu1541 device */
 #else
 #error Could not find the libusb 1.0 development packages. Please install them and retry!
 #endif
+        int DriveMode; /*!< \internal \brief xum1541: the disk or tape mode, one of DeviceDriveMode_* */
+        int IecScriptSupport; /*!< \internal \brief xum1541: the firmware can execute IEC line scripts (and is not in IEEE-488 mode) */
+        int PortNumber; /*!< \internal \brief xum1541: the PortNumber given to xum1541_init(), -1 if not opened by it */
+        struct opencbm_usb_handle *NextKept; /*!< \internal \brief xum1541: the next handle kept open in keep-alive mode */
 };
 
 #if HAVE_LIBUSB0
@@ -120,6 +120,28 @@ linkedlist_removeafter(linkedlist_node_t * const Previous)
     FUNC_LEAVE_PTR(currentItem, void*);
 }
 
+/*-----------------------------------------------------------*/
+/* hash function for the symbol table and the relocation cache */
+
+/* FNV-1a, 32 bit */
+#define O65_HASH_INIT 2166136261u
+
+static uint32
+o65_hash(uint32 Hash, const void * const Buffer, unsigned int Length)
+{
+    const uint8 *p = Buffer;
+
+    FUNC_ENTER();
+
+    while (Length-- > 0)
+    {
+        Hash ^= *p++;
+        Hash *= 16777619u;
+    }
+
+    FUNC_LEAVE_UINT(Hash);
+}
+
 /*-----------------------------------------------------------*/
 /* functions for implementing the symbol table of the loader */
 
@@ -129,12 +151,18 @@ struct o65_symboltable_entry
     unsigned char *module;  /* name of the module which contains this symbol */
     unsigned char *name;    /* name of the symbol */
     uint16         address; /* address to where this symbol is located */
+    int            next;    /* next symbol in the same hash bucket (index + 1), 0 = none */
 } o65_symbol;
 
 #define O65_SYMBOLTABLE_MAX 1000
 
+/* the symbols are found by the hash of their names: every bucket is a
+   chain of the symbols with that hash, as (index + 1) into the table */
+#define O65_SYMBOLTABLE_BUCKETS 256
+
 static o65_symbol o65_symboltable[O65_SYMBOLTABLE_MAX];
 static int        o65_symboltable_count = 0;
+static int        o65_symboltable_bucket[O65_SYMBOLTABLE_BUCKETS];
 
 
 static char *
@@ -156,6 +184,53 @@ stralloc(const char * const String)
     FUNC_LEAVE_STRING(p);
 }
 
+static int *
+o65_symbol_bucket(const char * const Name)
+{
+    uint32 hash;
+
+    FUNC_ENTER();
+
+    hash = o65_hash(O65_HASH_INIT, Name, strlen(Name));
+
+    FUNC_LEAVE_PTR(&o65_symboltable_bucket[hash % O65_SYMBOLTABLE_BUCKETS], int *);
+}
+
+static void
+o65_symbol_link(int Entry)
+{
+    int *bucket;
+
+    FUNC_ENTER();
+
+    bucket = o65_symbol_bucket((char *) o65_symboltable[Entry].name);
+
+    o65_symboltable[Entry].next = *bucket;
+    *bucket = Entry + 1;
+
+    FUNC_LEAVE();
+}
+
+static void
+o65_symbol_unlink(int Entry)
+{
+    int *link;
+
+    FUNC_ENTER();
+
+    link = o65_symbol_bucket((char *) o65_symboltable[Entry].name);
+
+    while (*link != Entry + 1)
+    {
+        DBG_ASSERT(*link != 0);
+        link = &o65_symboltable[*link - 1].next;
+    }
+
+    *link = o65_symboltable[Entry].next;
+
+    FUNC_LEAVE();
+}
+
 static int
 o65_symbol_search(const char * const Name)
 {
@@ -164,11 +239,11 @@ o65_symbol_search(const char * const Name)
 
     FUNC_ENTER();
 
-    for (i = 0; i < o65_symboltable_count; i++)
+    for (i = *o65_symbol_bucket(Name); i != 0; i = o65_symboltable[i - 1].next)
     {
-        if (strcmp(o65_symboltable[i].name, Name) == 0)
+        if (strcmp(o65_symboltable[i - 1].name, Name) == 0)
         {
-            found = i;
+            found = i - 1;
             break;
         }
     }
@@ -197,6 +272,11 @@ o65_symbol_add(const char * const Name, uint16 Address, const char * const Modul
 
         entry = -1;
     }
+    else if (o65_symboltable_count >= O65_SYMBOLTABLE_MAX)
+    {
+        DBG_ERROR((DBG_PREFIX "No room for symbol %s in the symbol table!",
+            Name));
+    }
     else
     {
         /* advance the number of symbols in the table */
@@ -204,9 +284,9 @@ o65_symbol_add(const char * const Name, uint16 Address, const char * const Modul
         o65_symboltable[o65_symboltable_count].name = stralloc(Name);
         o65_symboltable[o65_symboltable_count].address = Address;
 
-        o65_symboltable_count++;
+        o65_symbol_link(o65_symboltable_count);
 
-        DBG_ASSERT(o65_symboltable_count < O65_SYMBOLTABLE_MAX);
+        entry = o65_symboltable_count++;
     }
 
     FUNC_LEAVE_INT(entry);
@@ -227,6 +307,8 @@ o65_symbol_delete(int Entry)
     DBG_O65_SHOW((DBG_PREFIX "Deleting symbol '%s'.",
         o65_symboltable[Entry].name));
 
+    o65_symbol_unlink(Entry);
+
     /* free the allocated memory */
     free(o65_symboltable[Entry].module);
     free(o65_symboltable[Entry].name);
@@ -234,14 +316,22 @@ o65_symbol_delete(int Entry)
     --o65_symboltable_count;
 
     /* now, copy the last item over the just removed item */
-    o65_symboltable[Entry].module  = o65_symboltable[o65_symboltable_count].module;
-    o65_symboltable[Entry].name    = o65_symboltable[o65_symboltable_count].name;
-    o65_symboltable[Entry].address = o65_symboltable[o65_symboltable_count].address;
+    if (Entry != o65_symboltable_count)
+    {
+        o65_symbol_unlink(o65_symboltable_count);
+
+        o65_symboltable[Entry].module  = o65_symboltable[o65_symboltable_count].module;
+        o65_symboltable[Entry].name    = o65_symboltable[o65_symboltable_count].name;
+        o65_symboltable[Entry].address = o65_symboltable[o65_symboltable_count].address;
+
+        o65_symbol_link(Entry);
+    }
 
     /* clear the last entry */
     DBGDO(o65_symboltable[o65_symboltable_count].module  = NULL);
     DBGDO(o65_symboltable[o65_symboltable_count].name    = NULL);
     DBGDO(o65_symboltable[o65_symboltable_count].address = 0);
+    DBGDO(o65_symboltable[o65_symboltable_count].next    = 0);
 
     FUNC_LEAVE_INT(0);
 }
@@ -303,7 +393,7 @@ typedef
 struct o65_file_relocation_entry_s
 {
     uint32 relocAddress;
-    uint8  reference;
+    uint32 reference;
     uint8  segment;
     uint8  type;
     uint8  additional;
@@ -314,6 +404,9 @@ typedef
 struct o65_file_s
 {
     char                       *raw_buffer;
+    unsigned int                raw_length;
+    uint32                      raw_hash;
+    char                       *module;
     o65version_type             o65version;
     o65_file_header_common_t    header;
     o65_file_header_32_t        header_32;
@@ -326,6 +419,9 @@ struct o65_file_s
     unsigned char              *pdata;
     linkedlist_node_t           text_relocation_list;
     linkedlist_node_t           data_relocation_list;
+    unsigned char              *image;
+    uint32                      image_length;
+    unsigned int                image_address;
 
 } o65_file_t;
 
@@ -768,6 +864,14 @@ o65_file_load_oheader_dump(o65_file_t *O65file, o65_file_header_oheader_t *po65_
                 error = O65ERR_OPTIONAL_HEADER_NOT_TERMINATED;
             }
         }
+
+        if (!error
+            && po65_file_header_oheader->optiontype == O65_FILE_HEADER_OHEADER_TYPE_FILENAME
+            && !O65file->module)
+        {
+            /* the globals of the file are exported under this name */
+            O65file->module = stralloc((char *) po65_file_header_oheader->data);
+        }
         break;
 
     default:
@@ -1117,45 +1221,51 @@ o65_file_load_reloc(uint8 *Buffer, unsigned Length, unsigned *Ptr,
 
         po65_relocation_entry->type = *p & O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_MASK;
 
-        switch (po65_relocation_entry->type)
+        /* relocations to an undefined reference name the reference */
+
+        if (po65_relocation_entry->segment == O65_FILE_RELOC_SEGMTYPEBYTE_SEGM_UNDEF)
         {
-        case O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_WORD:
-            if ((error = o65_read_byte(Buffer, Length, Ptr, "2 bytes from reloc table, 1", p+1, 2)) == 0)
+            if ((error = o65_file_read_size(Buffer, Length, Ptr, "reference from reloc table",
+                O65file, &po65_relocation_entry->reference)) == 0)
             {
-                po65_relocation_entry->reference = p[1];
-                po65_relocation_entry->additional = p[2];
-
-                DBG_O65_SHOW((DBG_PREFIX
-                    "    - Type WORD, %s(%u), additional data: $%04X",
-                    O65file->references[p[1]], p[1], p[2]));
-                p += 2;
+                if (po65_relocation_entry->reference >= O65file->references_count)
+                {
+                    DBG_ERROR((DBG_PREFIX "references illegal reference %u",
+                        po65_relocation_entry->reference));
+                    error = O65ERR_UNDEFINED_REFERENCE;
+                }
+                else
+                {
+                    DBG_O65_SHOW((DBG_PREFIX "    - Reference '%s' (%u)",
+                        O65file->references[po65_relocation_entry->reference].name,
+                        po65_relocation_entry->reference));
+                }
             }
+        }
+
+        switch (po65_relocation_entry->type)
+        {
+        case O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_WORD:
+            DBG_O65_SHOW((DBG_PREFIX "    - Type WORD"));
             break;
 
         case O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_HIGH:
-            if ((error = o65_read_byte(Buffer, Length, Ptr, "2 bytes from reloc table, 2", p+1, 2)) == 0)
+            /* unless relocating page-wise, the low byte follows */
+            if (!error && !(O65file->header.mode & O65_FILE_HEADER_MODE_PAGERELOC))
             {
-                po65_relocation_entry->reference = p[1];
-                po65_relocation_entry->additional = p[2];
-
-                DBG_O65_SHOW((DBG_PREFIX
-                    "    - Type HIGH, %s, additional data: $%04X",
-                    O65file->references[p[1]], p[2]));
-                p += 2;
+                if ((error = o65_read_byte(Buffer, Length, Ptr, "low byte from reloc table", p+1, 1)) == 0)
+                {
+                    po65_relocation_entry->additional = p[1];
+                }
             }
+
+            DBG_O65_SHOW((DBG_PREFIX
+                "    - Type HIGH, low byte: $%02X",
+                po65_relocation_entry->additional));
             break;
 
         case O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_LOW:
-            if ((error = o65_read_byte(Buffer, Length, Ptr, "2 bytes from reloc table, 3", p+1, 2)) == 0)
-            {
-                po65_relocation_entry->reference = p[1];
-                po65_relocation_entry->additional = p[2];
-
-                DBG_O65_SHOW((DBG_PREFIX
-                    "    - Type LOW, %s, additional data: $%04X",
-                    O65file->references[p[1]], p[2]));
-                p += 2;
-            }
+            DBG_O65_SHOW((DBG_PREFIX "    - Type LOW"));
             break;
 
         case O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_SEGADR:
@@ -1180,13 +1290,6 @@ o65_file_load_reloc(uint8 *Buffer, unsigned Length, unsigned *Ptr,
 
         if (po65_relocation_entry)
         {
-            if (po65_relocation_entry->reference >= O65file->references_count)
-            {
-                DBG_ERROR((DBG_PREFIX "references illegal reference %u",
-                    po65_relocation_entry->reference));
-                error = O65ERR_UNDEFINED_REFERENCE;
-            }
-
             if (!error)
             {
                 linkedlist_insertafter(List, po65_relocation_entry);
@@ -1240,6 +1343,29 @@ o65_file_delete(o65_file_t *O65file)
 
     if (O65file)
     {
+        uint32 i;
+
+        if (O65file->module)
+        {
+            o65_symbol_delete_module(O65file->module);
+            free(O65file->module);
+        }
+
+        if (O65file->references)
+        {
+            for (i = 0; i < O65file->references_count; i++)
+                free(O65file->references[i].name);
+            free(O65file->references);
+        }
+
+        if (O65file->globals)
+        {
+            for (i = 0; i < O65file->globals_count; i++)
+                free(O65file->globals[i].name);
+            free(O65file->globals);
+        }
+
+        free(O65file->image);
         free(O65file->ptext);
         free(O65file->pdata);
 
@@ -1284,6 +1410,9 @@ o65_file_process(char *Buffer, unsigned Length, o65_file_t **PO65file)
             break;
         }
 
+        o65file->raw_length = Length;
+        o65file->raw_hash = o65_hash(O65_HASH_INIT, Buffer, Length);
+
         if ( O65ERR_NO_ERROR != (error = o65_file_load_header(Buffer, Length, &ptr, o65file) ) ) {
             break;
         }
@@ -1420,6 +1549,10 @@ o65_file_load(const char * const Filename, o65_file_t **PO65file)
             break;
         }
 
+        if (!(*PO65file)->module) {
+            (*PO65file)->module = stralloc(Filename);
+        }
+
     } while (0);
 
     if (f != NULL) {
@@ -1433,12 +1566,327 @@ o65_file_load(const char * const Filename, o65_file_t **PO65file)
     FUNC_LEAVE_INT(error);
 }
 
+/*-----------------------------------------------------------*/
+/* functions for relocating the o65 file                     */
+
+/* the relocated images of the files, so that relocating the same file
+   to the same address again costs nothing but a copy */
+#define O65_RELOC_CACHE_MAX 16
+
+typedef
+struct o65_reloc_cache_entry_s
+{
+    uint32         hash;          /* hash of the file, the address and the symbols */
+    char          *raw_buffer;    /* the file itself, to rule out hash collisions */
+    unsigned int   raw_length;
+    unsigned int   address;       /* the address the image is relocated to */
+    uint16        *symbols;       /* the addresses of the references of the file */
+    uint32         symbols_count;
+    unsigned char *image;         /* text and data segment, relocated */
+    uint32         image_length;
+} o65_reloc_cache_entry_t;
+
+static o65_reloc_cache_entry_t o65_reloc_cache[O65_RELOC_CACHE_MAX];
+static unsigned int            o65_reloc_cache_next = 0;
+
+static o65_reloc_cache_entry_t *
+o65_reloc_cache_search(o65_file_t *O65file, unsigned int Address,
+                       const uint16 Symbols[], uint32 Hash)
+{
+    o65_reloc_cache_entry_t *found = NULL;
+    int i;
+
+    FUNC_ENTER();
+
+    for (i = 0; i < O65_RELOC_CACHE_MAX; i++)
+    {
+        o65_reloc_cache_entry_t *entry = &o65_reloc_cache[i];
+
+        if (entry->image
+            && entry->hash == Hash
+            && entry->address == Address
+            && entry->raw_length == O65file->raw_length
+            && entry->symbols_count == O65file->references_count
+            && memcmp(entry->raw_buffer, O65file->raw_buffer, O65file->raw_length) == 0
+            && memcmp(entry->symbols, Symbols, sizeof(*Symbols) * O65file->references_count) == 0)
+        {
+            found = entry;
+            break;
+        }
+    }
+
+    FUNC_LEAVE_PTR(found, o65_reloc_cache_entry_t *);
+}
+
+static void
+o65_reloc_cache_insert(o65_file_t *O65file, const uint16 Symbols[], uint32 Hash)
+{
+    o65_reloc_cache_entry_t *entry;
+
+    FUNC_ENTER();
+
+    /* replace the oldest entry */
+
+    entry = &o65_reloc_cache[o65_reloc_cache_next];
+    o65_reloc_cache_next = (o65_reloc_cache_next + 1) % O65_RELOC_CACHE_MAX;
+
+    free(entry->raw_buffer);
+    free(entry->symbols);
+    free(entry->image);
+    memset(entry, 0, sizeof(*entry));
+
+    entry->raw_buffer = malloc(O65file->raw_length);
+    entry->symbols = malloc(sizeof(*Symbols) * (O65file->references_count + 1));
+    entry->image = malloc(O65file->image_length + 1);
+
+    if (entry->raw_buffer && entry->symbols && entry->image)
+    {
+        memcpy(entry->raw_buffer, O65file->raw_buffer, O65file->raw_length);
+        memcpy(entry->symbols, Symbols, sizeof(*Symbols) * O65file->references_count);
+        memcpy(entry->image, O65file->image, O65file->image_length);
+
+        entry->hash          = Hash;
+        entry->raw_length    = O65file->raw_length;
+        entry->address       = O65file->image_address;
+        entry->symbols_count = O65file->references_count;
+        entry->image_length  = O65file->image_length;
+    }
+    else
+    {
+        /* the cache is only an optimisation, do without it */
+
+        DBG_WARN((DBG_PREFIX "Not enough memory for caching the relocated image."));
+
+        free(entry->raw_buffer);
+        free(entry->symbols);
+        free(entry->image);
+        memset(entry, 0, sizeof(*entry));
+    }
+
+    FUNC_LEAVE();
+}
+
+static int
+o65_file_reloc_segment(unsigned char *Segment, uint32 SegmentLength,
+                       linkedlist_node_t *List, const long Diff[], const uint16 Symbols[])
+{
+    linkedlist_node_t *node;
+    int error = O65ERR_NO_ERROR;
+
+    FUNC_ENTER();
+
+    for (node = List->next; !linkedlist_is_last(node); node = node->next)
+    {
+        o65_file_relocation_entry_t *entry = (o65_file_relocation_entry_t *) node->item;
+        unsigned char *p;
+        unsigned int value;
+        long diff;
+
+        if (entry->relocAddress + (entry->type == O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_WORD ? 2 : 1)
+            > SegmentLength)
+        {
+            DBG_ERROR((DBG_PREFIX "Relocation at $%04X is outside of the segment.",
+                entry->relocAddress));
+            error = O65ERR_RELOC_OUT_OF_RANGE;
+            break;
+        }
+
+        p = &Segment[entry->relocAddress];
+
+        if (entry->segment == O65_FILE_RELOC_SEGMTYPEBYTE_SEGM_UNDEF)
+            diff = Symbols[entry->reference];
+        else
+            diff = Diff[entry->segment];
+
+        switch (entry->type)
+        {
+        case O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_WORD:
+            value = p[0] | (p[1] << 8);
+            value += diff;
+            p[0] = (unsigned char) value;
+            p[1] = (unsigned char) (value >> 8);
+            break;
+
+        case O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_HIGH:
+            value = (p[0] << 8) | entry->additional;
+            value += diff;
+            p[0] = (unsigned char) (value >> 8);
+            break;
+
+        case O65_FILE_RELOC_SEGMTYPEBYTE_TYPE_LOW:
+            p[0] = (unsigned char) (p[0] + diff);
+            break;
+        }
+    }
+
+    FUNC_LEAVE_INT(error);
+}
+
+static int
+o65_file_export_globals(o65_file_t *O65file, const long Diff[])
+{
+    uint32 i;
+
+    FUNC_ENTER();
+
+    if (O65file->module)
+    {
+        /* forget the addresses of an earlier relocation */
+        o65_symbol_delete_module(O65file->module);
+
+        for (i = 0; i < O65file->globals_count; i++)
+        {
+            o65_file_globals_t *global = &O65file->globals[i];
+
+            o65_symbol_add(global->name,
+                (uint16) (global->value
+                    + Diff[global->segmentid & O65_FILE_RELOC_SEGMTYPEBYTE_SEGM_MASK]),
+                O65file->module);
+        }
+    }
+
+    FUNC_LEAVE_INT(O65ERR_NO_ERROR);
+}
+
 int
 o65_file_reloc(o65_file_t *O65file, unsigned int Address)
+{
+    long diff[O65_FILE_RELOC_SEGMTYPEBYTE_SEGM_MASK + 1];
+    uint16 *symbols = NULL;
+    o65_reloc_cache_entry_t *cached;
+    uint32 tlen, dlen;
+    uint32 hash;
+    uint32 i;
+    int error = O65ERR_NO_ERROR;
+
+    FUNC_ENTER();
+
+    DBG_ASSERT(O65file != NULL);
+
+    do {
+        tlen = O65file->header_32.tlen;
+        dlen = O65file->header_32.dlen;
+
+        /* the segments follow each other, starting at Address */
+
+        memset(diff, 0, sizeof(diff));
+        diff[O65_FILE_RELOC_SEGMTYPEBYTE_SEGM_TEXT] =
+            (long) Address - (long) O65file->header_32.tbase;
+        diff[O65_FILE_RELOC_SEGMTYPEBYTE_SEGM_DATA] =
+            (long) (Address + tlen) - (long) O65file->header_32.dbase;
+        diff[O65_FILE_RELOC_SEGMTYPEBYTE_SEGM_BSS] =
+            (long) (Address + tlen + dlen) - (long) O65file->header_32.bbase;
+
+        /* find the addresses of the references */
+
+        symbols = malloc(sizeof(*symbols) * (O65file->references_count + 1));
+        if (!symbols) {
+            error = O65ERR_OUT_OF_MEMORY;
+            break;
+        }
+
+        for (i = 0; i < O65file->references_count; i++)
+        {
+            int entry = o65_symbol_search(O65file->references[i].name);
+
+            if (entry < 0)
+            {
+                DBG_ERROR((DBG_PREFIX "Undefined reference to '%s'.",
+                    O65file->references[i].name));
+                error = O65ERR_UNDEFINED_REFERENCE;
+                break;
+            }
+
+            symbols[i] = o65_symboltable[entry].address;
+        }
+
+        if (error) {
+            break;
+        }
+
+        /* the image only depends on the file, the address and the symbols */
+
+        hash = o65_hash(O65file->raw_hash, &Address, sizeof(Address));
+        hash = o65_hash(hash, symbols, sizeof(*symbols) * O65file->references_count);
+
+        free(O65file->image);
+
+        O65file->image_address = Address;
+        O65file->image_length = tlen + dlen;
+        O65file->image = malloc(O65file->image_length + 1);
+        if (!O65file->image) {
+            error = O65ERR_OUT_OF_MEMORY;
+            break;
+        }
+
+        cached = o65_reloc_cache_search(O65file, Address, symbols, hash);
+
+        if (cached)
+        {
+            DBG_O65_SHOW((DBG_PREFIX "Relocated image for $%04X found in the cache.",
+                Address));
+
+            memcpy(O65file->image, cached->image, O65file->image_length);
+        }
+        else
+        {
+            if (tlen)
+                memcpy(O65file->image, O65file->ptext, tlen);
+            if (dlen)
+                memcpy(O65file->image + tlen, O65file->pdata, dlen);
+
+            error = o65_file_reloc_segment(O65file->image, tlen,
+                &O65file->text_relocation_list, diff, symbols);
+
+            if (!error)
+            {
+                error = o65_file_reloc_segment(O65file->image + tlen, dlen,
+                    &O65file->data_relocation_list, diff, symbols);
+            }
+
+            if (error) {
+                break;
+            }
+
+            o65_reloc_cache_insert(O65file, symbols, hash);
+        }
+
+        error = o65_file_export_globals(O65file, diff);
+
+    } while (0);
+
+    if (error && O65file)
+    {
+        free(O65file->image);
+        O65file->image = NULL;
+        O65file->image_length = 0;
+    }
+
+    free(symbols);
+
+    FUNC_LEAVE_INT(error);
+}
+
+int
+o65_file_image(o65_file_t *O65file, const unsigned char **Image, unsigned int *Length)
 {
     int error = O65ERR_NO_ERROR;
 
     FUNC_ENTER();
 
+    DBG_ASSERT(O65file != NULL);
+    DBG_ASSERT(Image != NULL);
+    DBG_ASSERT(Length != NULL);
+
+    if (!O65file->image)
+    {
+        error = O65ERR_NO_DATA;
+    }
+    else
+    {
+        *Image = O65file->image;
+        *Length = O65file->image_length;
+    }
+
     FUNC_LEAVE_INT(error);
 }
@@ -123,7 +123,7 @@ upload(CBM_FILE fd, unsigned char drive)
         return 1;
     }
 
-    bytesWritten = cbm_upload(fd, drive, 0x700, pp_drive_prog, pp_drive_prog_length);
+    bytesWritten = cbm_upload_cached(fd, drive, 0x700, pp_drive_prog, pp_drive_prog_length);
 
     if (bytesWritten != pp_drive_prog_length)
     {
@@ -117,7 +117,7 @@ upload(CBM_FILE fd, unsigned char drive)
 {
     unsigned int bytesWritten;
 
-    bytesWritten = cbm_upload(fd, drive, 0x700, s1_drive_prog, sizeof(s1_drive_prog));
+    bytesWritten = cbm_upload_cached(fd, drive, 0x700, s1_drive_prog, sizeof(s1_drive_prog));
 
     if (bytesWritten != sizeof(s1_drive_prog))
     {
@@ -103,7 +103,7 @@ upload(CBM_FILE fd, unsigned char drive)
 {
     unsigned int bytesWritten;
 
-    bytesWritten = cbm_upload(fd, drive, 0x700, s2_drive_prog, sizeof(s2_drive_prog));
+    bytesWritten = cbm_upload_cached(fd, drive, 0x700, s2_drive_prog, sizeof(s2_drive_prog));
 
     if (bytesWritten != sizeof(s2_drive_prog))
     {
@@ -100,7 +100,7 @@ libopencbmtransfer_install(CBM_FILE HandleDevice, unsigned char DeviceAddress)
 
         // Now, upload the main loop into the drive
 
-        bytesWritten = cbm_upload(HandleDevice, DeviceAddress, 0x500,
+        bytesWritten = cbm_upload_cached(HandleDevice, DeviceAddress, 0x500,
             turbomain_drive_prog, sizeof(turbomain_drive_prog));
 
         if (bytesWritten != sizeof(turbomain_drive_prog))
@@ -0,0 +1,735 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+*/
+
+/*
+ * opencbmd opens the adapter once and serves any number of client
+ * processes over a local socket. The clients use the opencbmd plugin
+ * (-@ opencbmd), thus, the tools work unchanged. See opencbmd.h for
+ * the protocol.
+ *
+ * The bus belongs to one client at a time; the requests of the other
+ * clients wait in a queue, in the order they arrived, until the bus
+ * is free again.
+ */
+
+#include "opencbm.h"
+#include "opencbm-plugin.h"
+#include "opencbmd.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "arch.h"
+#include "libmisc.h"
+
+/* a connected client */
+typedef struct client_s
+{
+    int Socket;
+    unsigned Id;                    /* for the messages */
+    unsigned Locks;                 /* the number of cbm_lock() without cbm_unlock() */
+    int Waiting;                    /* it is in the queue for the bus */
+    int Dead;                       /* it has disconnected, or there was an error */
+    struct client_s *Next;          /* the next client */
+    struct client_s *NextWaiting;   /* the next client in the queue */
+} client_t;
+
+static CBM_FILE fd_cbm;
+static int verbose;
+static volatile sig_atomic_t stop;
+
+static client_t *clients;
+static client_t *owner;             /* the client the bus belongs to, or NULL */
+static client_t *queue_head;        /* the queue of the clients which wait for the bus */
+static client_t *queue_tail;
+static unsigned next_id = 1;
+
+static void help()
+{
+    printf(
+        "Usage: opencbmd [OPTION]...\n"
+        "Share one adapter among many OpenCBM programs\n"
+        "\n"
+        "  -h, --help                 display this help and exit\n"
+        "  -V, --version              display version information and exit\n"
+        "  -@, --adapter=plugin:bus   adapter to serve\n"
+        "  -s, --socket=FILE          listen on FILE (default: $" OPENCBMD_SOCKET_ENVIRONMENT ",\n"
+        "                             or $XDG_RUNTIME_DIR/" OPENCBMD_DEFAULT_SOCKET_NAME ")\n"
+        "  -d, --detach               run in the background\n"
+        "  -v, --verbose              report the clients and the bus hand-overs\n"
+        "\n"
+        "The programs use the daemon with the adapter opencbmd, e.g.:\n"
+        "\n"
+        "  opencbmd -@ xum1541 -d\n"
+        "  cbmctrl -@ opencbmd status 8\n"
+        "\n"
+        );
+}
+
+static void hint(char *s)
+{
+    fprintf(stderr, "Try `%s' -h for more information.\n", s);
+}
+
+static void report(const client_t *client, const char *message)
+{
+    if (verbose)
+        fprintf(stderr, "opencbmd: client %u: %s\n", client->Id, message);
+}
+
+static void on_signal(int sig)
+{
+    (void) sig;
+    stop = 1;
+}
+
+/* read exactly Length bytes; returns 0 on success */
+static int receive_all(int Socket, void *Buffer, size_t Length)
+{
+    unsigned char *p = Buffer;
+
+    while (Length > 0)
+    {
+        ssize_t n = recv(Socket, p, Length, 0);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+
+        p += n;
+        Length -= n;
+    }
+
+    return 0;
+}
+
+/* write exactly Length bytes; returns 0 on success */
+static int send_all(int Socket, const void *Buffer, size_t Length)
+{
+    const unsigned char *p = Buffer;
+
+    while (Length > 0)
+    {
+        ssize_t n = send(Socket, p, Length, 0);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+
+        p += n;
+        Length -= n;
+    }
+
+    return 0;
+}
+
+static int send_reply(client_t *client, int Result, const void *Data, unsigned int Length)
+{
+    opencbmd_reply_t reply;
+
+    reply.Result = Result;
+    reply.Length = Length;
+
+    return send_all(client->Socket, &reply, sizeof(reply))
+        || (Length > 0 && send_all(client->Socket, Data, Length));
+}
+
+/* does the request need the bus? */
+static int needs_bus(unsigned int Command)
+{
+    return Command != OPENCBMD_HELLO && Command != OPENCBMD_UNLOCK
+        && Command != OPENCBMD_BLOCK_CAPS;
+}
+
+static void queue_remove(client_t *client)
+{
+    client_t **p;
+
+    for (p = &queue_head; *p; p = &(*p)->NextWaiting)
+    {
+        if (*p == client)
+        {
+            *p = client->NextWaiting;
+            break;
+        }
+    }
+
+    queue_tail = NULL;
+    for (p = &queue_head; *p; p = &(*p)->NextWaiting)
+        queue_tail = *p;
+
+    client->NextWaiting = NULL;
+    client->Waiting = 0;
+}
+
+static void release_bus(client_t *client)
+{
+    if (owner == client)
+    {
+        owner = NULL;
+        client->Locks = 0;
+        report(client, "releases the bus");
+    }
+}
+
+static void drop_client(client_t *client)
+{
+    if (client->Dead)
+        return;
+
+    report(client, "disconnected");
+
+    if (client->Waiting)
+        queue_remove(client);
+
+    release_bus(client);
+
+    close(client->Socket);
+    client->Dead = 1;
+}
+
+/* transfer a block with one of the fast protocols */
+static int transfer_n(int Protocol, int Write, unsigned char *Data, unsigned int Size)
+{
+    if (Protocol < OPENCBM_PROTOCOL_S1 || Protocol > OPENCBM_PROTOCOL_PP_CC)
+        return -1;
+
+    if (Write)
+        return cbm_block_write(fd_cbm, (enum cbm_block_protocol_e) Protocol, Data, Size);
+    else
+        return cbm_block_read(fd_cbm, (enum cbm_block_protocol_e) Protocol, Data, Size);
+}
+
+/*
+ * Read the next request of a client, execute it, and send the reply.
+ * Returns 0 on success, 1 if the client is to be dropped.
+ */
+static int serve_request(client_t *client)
+{
+    opencbmd_request_t request;
+    unsigned char *data = NULL;
+    unsigned char *out = NULL;
+    unsigned int out_length = 0;
+    int result = 0;
+    int error;
+
+    if (receive_all(client->Socket, &request, sizeof(request))
+        || request.Length > OPENCBMD_MAX_DATA)
+        return 1;
+
+    if (request.Length > 0)
+    {
+        data = malloc(request.Length);
+        if (data == NULL || receive_all(client->Socket, data, request.Length))
+        {
+            free(data);
+            return 1;
+        }
+    }
+
+    /* the requests which return data */
+    if (request.Command == OPENCBMD_RAW_READ || request.Command == OPENCBMD_READ_N
+        || request.Command == OPENCBMD_IEC_SCRIPT)
+    {
+        int length = request.Command == OPENCBMD_READ_N ? request.Arg2 : request.Arg1;
+
+        if (length < 0 || (unsigned long) length > OPENCBMD_MAX_DATA
+            || (length > 0 && (out = calloc(1, length)) == NULL))
+        {
+            free(data);
+            return 1;
+        }
+        out_length = length;
+    }
+
+    switch (request.Command)
+    {
+        case OPENCBMD_HELLO:
+            result = OPENCBMD_VERSION;
+            break;
+
+        case OPENCBMD_LOCK:
+            client->Locks++;
+            break;
+
+        case OPENCBMD_UNLOCK:
+            if (client->Locks > 0)
+                client->Locks--;
+            if (client->Locks == 0)
+                release_bus(client);
+            break;
+
+        case OPENCBMD_RAW_WRITE:
+            result = cbm_raw_write(fd_cbm, data, request.Length);
+            break;
+
+        case OPENCBMD_RAW_READ:
+            result = cbm_raw_read(fd_cbm, out, out_length);
+            out_length = result > 0 ? result : 0;
+            break;
+
+        case OPENCBMD_OPEN:
+            result = cbm_open(fd_cbm, (unsigned char) request.Arg1, (unsigned char) request.Arg2, NULL, 0);
+            break;
+
+        case OPENCBMD_CLOSE:
+            result = cbm_close(fd_cbm, (unsigned char) request.Arg1, (unsigned char) request.Arg2);
+            break;
+
+        case OPENCBMD_LISTEN:
+            result = cbm_listen(fd_cbm, (unsigned char) request.Arg1, (unsigned char) request.Arg2);
+            break;
+
+        case OPENCBMD_TALK:
+            result = cbm_talk(fd_cbm, (unsigned char) request.Arg1, (unsigned char) request.Arg2);
+            break;
+
+        case OPENCBMD_UNLISTEN:
+            result = cbm_unlisten(fd_cbm);
+            break;
+
+        case OPENCBMD_UNTALK:
+            result = cbm_untalk(fd_cbm);
+            break;
+
+        case OPENCBMD_GET_EOI:
+            result = cbm_get_eoi(fd_cbm);
+            break;
+
+        case OPENCBMD_CLEAR_EOI:
+            result = cbm_clear_eoi(fd_cbm);
+            break;
+
+        case OPENCBMD_RESET:
+            result = cbm_reset(fd_cbm);
+            break;
+
+        case OPENCBMD_PP_READ:
+            result = cbm_pp_read(fd_cbm);
+            break;
+
+        case OPENCBMD_PP_WRITE:
+            cbm_pp_write(fd_cbm, (unsigned char) request.Arg1);
+            break;
+
+        case OPENCBMD_IEC_POLL:
+            result = cbm_iec_poll(fd_cbm);
+            break;
+
+        case OPENCBMD_IEC_SET:
+            cbm_iec_set(fd_cbm, request.Arg1);
+            break;
+
+        case OPENCBMD_IEC_RELEASE:
+            cbm_iec_release(fd_cbm, request.Arg1);
+            break;
+
+        case OPENCBMD_IEC_SETRELEASE:
+            cbm_iec_setrelease(fd_cbm, request.Arg1, request.Arg2);
+            break;
+
+        case OPENCBMD_IEC_WAIT:
+            result = cbm_iec_wait(fd_cbm, request.Arg1, request.Arg2);
+            break;
+
+        case OPENCBMD_IEC_SCRIPT:
+            result = cbm_iec_script(fd_cbm, data, request.Length, out, out_length);
+            break;
+
+        case OPENCBMD_READ_N:
+            result = transfer_n(request.Arg1, 0, out, out_length);
+            break;
+
+        case OPENCBMD_WRITE_N:
+            result = transfer_n(request.Arg1, 1, data, request.Length);
+            break;
+
+        case OPENCBMD_BLOCK_CAPS:
+            /* the library emulates the others in the daemon, still one request for the client */
+            result = cbm_block_caps(fd_cbm) | CBM_BLOCK_CAP(cbm_bp_s1)
+                   | CBM_BLOCK_CAP(cbm_bp_s2) | CBM_BLOCK_CAP(cbm_bp_pp_cc);
+            break;
+
+        default:
+            result = -1;
+            break;
+    }
+
+    error = send_reply(client, result, out, out_length);
+
+    free(data);
+    free(out);
+
+    return error;
+}
+
+/* the client has sent a request; execute it if the bus is free, or queue the client */
+static void serve(client_t *client)
+{
+    opencbmd_request_t request;
+    ssize_t n;
+
+    do
+    {
+        n = recv(client->Socket, &request, sizeof(request), MSG_PEEK);
+    }
+    while (n < 0 && errno == EINTR);
+
+    if (n <= 0)
+    {
+        drop_client(client);
+        return;
+    }
+
+    /* wait for the complete header */
+    if ((size_t) n < sizeof(request))
+        return;
+
+    if (needs_bus(request.Command) && owner != client)
+    {
+        if (owner != NULL)
+        {
+            if (!client->Waiting)
+            {
+                report(client, "waits for the bus");
+                client->Waiting = 1;
+                client->NextWaiting = NULL;
+                if (queue_tail)
+                    queue_tail->NextWaiting = client;
+                else
+                    queue_head = client;
+                queue_tail = client;
+            }
+            return;
+        }
+
+        owner = client;
+        report(client, "gets the bus");
+    }
+
+    if (serve_request(client) != 0)
+        drop_client(client);
+}
+
+/* hand the bus to the clients in the queue, as long as it is free */
+static void serve_queue(void)
+{
+    while (owner == NULL && queue_head != NULL)
+    {
+        client_t *client = queue_head;
+
+        queue_remove(client);
+        serve(client);
+    }
+}
+
+static void accept_client(int listener)
+{
+    client_t *client;
+    int s = accept(listener, NULL, NULL);
+
+    if (s < 0)
+        return;
+
+    client = calloc(1, sizeof(*client));
+    if (client == NULL)
+    {
+        close(s);
+        return;
+    }
+
+    client->Socket = s;
+    client->Id = next_id++;
+    client->Next = clients;
+    clients = client;
+
+    report(client, "connected");
+}
+
+static void reap_clients(void)
+{
+    client_t **p = &clients;
+
+    while (*p)
+    {
+        client_t *client = *p;
+
+        if (client->Dead)
+        {
+            *p = client->Next;
+            free(client);
+        }
+        else
+        {
+            p = &client->Next;
+        }
+    }
+}
+
+static int open_listener(const char *path)
+{
+    struct sockaddr_un address;
+    struct stat st;
+    int s;
+
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "opencbmd: the name of the socket is too long: %s\n", path);
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0)
+    {
+        arch_error(0, arch_get_errno(), "socket");
+        return -1;
+    }
+
+    /* a socket which is left over from a daemon that was killed;
+     * never remove anything else */
+    if (lstat(path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid())
+        {
+            fprintf(stderr, "opencbmd: %s is in the way, it is not a socket of this user\n", path);
+            close(s);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    if (bind(s, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(s, 16) != 0)
+    {
+        arch_error(0, arch_get_errno(), "%s", path);
+        close(s);
+        return -1;
+    }
+
+    return s;
+}
+
+int ARCH_MAINDECL main(int argc, char *argv[])
+{
+    char *adapter = NULL;
+    const char *driver_name;
+    const char *path = getenv(OPENCBMD_SOCKET_ENVIRONMENT);
+    char *default_path = NULL;
+    int detach = 0;
+    int listener;
+    int option;
+    struct pollfd *fds = NULL;
+    client_t **polled = NULL;
+    size_t fds_size = 0;
+
+    static const struct option longopts[] =
+    {
+        { "help"       , no_argument      , NULL, 'h' },
+        { "version"    , no_argument      , NULL, 'V' },
+        { "adapter"    , required_argument, NULL, '@' },
+        { "socket"     , required_argument, NULL, 's' },
+        { "detach"     , no_argument      , NULL, 'd' },
+        { "verbose"    , no_argument      , NULL, 'v' },
+        { NULL         , 0                , NULL, 0   }
+    };
+
+    static const char shortopts[] ="hV@:s:dv";
+
+    while ((option = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1)
+    {
+        switch(option)
+        {
+            case 'h': help();
+                      return 0;
+            case 'V': printf("opencbmd %s\n", OPENCBM_VERSION);
+                      return 0;
+            case '@': if (adapter == NULL)
+                          adapter = cbmlibmisc_strdup(optarg);
+                      else
+                      {
+                          fprintf(stderr, "--adapter/-@ given more than once.\n");
+                          hint(argv[0]);
+                          return 1;
+                      }
+                      break;
+            case 's': path = optarg;
+                      break;
+            case 'd': detach = 1;
+                      break;
+            case 'v': verbose = 1;
+                      break;
+            default : hint(argv[0]);
+                      return 1;
+        }
+    }
+
+    if (optind != argc)
+    {
+        fprintf(stderr, "Usage: %s [OPTION]...\n", argv[0]);
+        hint(argv[0]);
+        return 1;
+    }
+
+    if (path == NULL || *path == '\0')
+    {
+        const char *dir = getenv("XDG_RUNTIME_DIR");
+
+        if (dir == NULL || *dir == '\0')
+        {
+            fprintf(stderr, "opencbmd: no socket is given, and $XDG_RUNTIME_DIR is not set\n");
+            cbmlibmisc_strfree(adapter);
+            return 1;
+        }
+        path = default_path = cbmlibmisc_sprintf("%s/%s", dir, OPENCBMD_DEFAULT_SOCKET_NAME);
+        if (path == NULL)
+        {
+            fprintf(stderr, "opencbmd: out of memory\n");
+            cbmlibmisc_strfree(adapter);
+            return 1;
+        }
+    }
+
+    driver_name = cbm_get_driver_name_ex(adapter);
+    if (driver_name != NULL && strncmp(driver_name, "opencbmd:", 9) == 0)
+    {
+        fprintf(stderr, "opencbmd: the daemon cannot serve the adapter opencbmd; use -@ to give the real one\n");
+        cbmlibmisc_strfree(adapter);
+        cbmlibmisc_strfree(default_path);
+        return 1;
+    }
+
+    if (cbm_driver_open_ex(&fd_cbm, adapter) != 0)
+    {
+        fprintf(stderr, "opencbmd: cannot open the adapter %s\n", adapter ? adapter : "(default)");
+        cbmlibmisc_strfree(adapter);
+        cbmlibmisc_strfree(default_path);
+        return 1;
+    }
+
+    listener = open_listener(path);
+    if (listener < 0)
+    {
+        cbm_driver_close(fd_cbm);
+        cbmlibmisc_strfree(adapter);
+        cbmlibmisc_strfree(default_path);
+        return 1;
+    }
+
+    if (detach && daemon(0, verbose) != 0)
+    {
+        arch_error(0, arch_get_errno(), "cannot run in the background");
+        stop = 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGHUP, on_signal);
+
+    if (verbose)
+        fprintf(stderr, "opencbmd: serving %s on %s\n", cbm_get_driver_name_ex(adapter), path);
+
+    while (!stop)
+    {
+        client_t *client;
+        size_t count = 1;
+        size_t i;
+
+        for (client = clients; client; client = client->Next)
+            count++;
+
+        if (count > fds_size)
+        {
+            struct pollfd *more_fds = realloc(fds, count * sizeof(*fds));
+            client_t **more_polled = realloc(polled, count * sizeof(*polled));
+
+            if (more_fds)
+                fds = more_fds;
+            if (more_polled)
+                polled = more_polled;
+            if (more_fds == NULL || more_polled == NULL)
+            {
+                fprintf(stderr, "opencbmd: out of memory\n");
+                break;
+            }
+            fds_size = count;
+        }
+
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        count = 1;
+
+        /* the clients in the queue are not polled until they get the bus */
+        for (client = clients; client; client = client->Next)
+        {
+            if (client->Waiting)
+                continue;
+
+            fds[count].fd = client->Socket;
+            fds[count].events = POLLIN;
+            fds[count].revents = 0;
+            polled[count] = client;
+            count++;
+        }
+
+        if (poll(fds, count, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            arch_error(0, arch_get_errno(), "poll");
+            break;
+        }
+
+        for (i = 1; i < count; i++)
+        {
+            if (fds[i].revents != 0 && !polled[i]->Dead)
+                serve(polled[i]);
+        }
+
+        serve_queue();
+
+        if (fds[0].revents & POLLIN)
+            accept_client(listener);
+
+        reap_clients();
+    }
+
+    while (clients)
+    {
+        drop_client(clients);
+        reap_clients();
+    }
+
+    free(fds);
+    free(polled);
+
+    close(listener);
+    unlink(path);
+
+    cbm_driver_close(fd_cbm);
+    cbmlibmisc_strfree(adapter);
+    cbmlibmisc_strfree(default_path);
+
+    return 0;
+}
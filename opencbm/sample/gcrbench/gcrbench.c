@@ -0,0 +1,246 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ */
+
+/*
+ * Microbenchmark and self test of the GCR block functions.
+ *
+ * It compares gcr_decode_block_n() and gcr_encode_block_n() with
+ * the group-wise gcr_5_to_4_decode() and gcr_4_to_5_encode(), and
+ * measures the throughput of both.
+ */
+
+#include "opencbm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*! the number of blocks of a track in zone 1 of a 1541 */
+#define TRACK_BLOCKS 21
+
+/* block conversion the way it was done before gcr_*_block_n() existed */
+
+static int ref_decode(const unsigned char *gcr, unsigned char *decoded)
+{
+    unsigned char chkref[4], chksum = 0;
+    int i, j;
+
+    gcr_5_to_4_decode(gcr, chkref, 5, sizeof(chkref));
+    gcr += 5;
+
+    if (chkref[0] != 0x07)
+    {
+        return 4;
+    }
+
+    for (j = 1; j < 4; j++, decoded++)
+    {
+        *decoded = chkref[j];
+        chksum  ^= chkref[j];
+    }
+
+    for (i = 1; i < GCR_BLOCK_DATASIZE / 4; i++)
+    {
+        gcr_5_to_4_decode(gcr, decoded, 5, 4);
+        gcr += 5;
+
+        for (j = 0; j < 4; j++, decoded++)
+        {
+            chksum ^= *decoded;
+        }
+    }
+
+    gcr_5_to_4_decode(gcr, chkref, 5, 4);
+    *decoded = chkref[0];
+    chksum  ^= chkref[0];
+
+    return (chkref[1] != chksum) ? 5 : 0;
+}
+
+static void ref_encode(const unsigned char *block, unsigned char *encoded)
+{
+    unsigned char chkref[4] = { 0x07, 0, 0, 0 };
+    int i, j;
+
+    for (j = 1; j < 4; j++, block++)
+    {
+        chkref[j] = *block;
+    }
+    gcr_4_to_5_encode(chkref, encoded, sizeof(chkref), 5);
+    encoded += 5;
+
+    chkref[1] ^= (chkref[2] ^ chkref[3]);
+
+    for (i = 1; i < GCR_BLOCK_DATASIZE / 4; i++)
+    {
+        gcr_4_to_5_encode(block, encoded, 4, 5);
+        encoded += 5;
+
+        for (j = 0; j < 4; j++, block++)
+        {
+            chkref[1] ^= *block;
+        }
+    }
+
+    chkref[0]  = *block;
+    chkref[1] ^= *block;
+    chkref[2]  = chkref[3] = 0;
+
+    gcr_4_to_5_encode(chkref, encoded, 4, 5);
+}
+
+static double seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void report(const char *what, unsigned long blocks, double secs)
+{
+    if (secs <= 0)
+    {
+        secs = 1.0 / CLOCKS_PER_SEC;
+    }
+    printf("  %-32s %8.3f s, %10.0f blocks/s, %7.1f MB/s\n",
+           what, secs, blocks / secs,
+           blocks * (double) GCR_BLOCK_DATASIZE / secs / (1024 * 1024));
+}
+
+static int self_test(void)
+{
+    unsigned char plain[TRACK_BLOCKS * GCR_BLOCK_DATASIZE];
+    unsigned char check[TRACK_BLOCKS * GCR_BLOCK_DATASIZE];
+    unsigned char gcr_ref[TRACK_BLOCKS * GCR_BLOCK_GCRSIZE];
+    unsigned char gcr_new[TRACK_BLOCKS * GCR_BLOCK_GCRSIZE];
+    int status[TRACK_BLOCKS];
+    int errors = 0;
+    int round, i;
+
+    for (round = 0; round < 100; round++)
+    {
+        for (i = 0; i < (int) sizeof(plain); i++)
+        {
+            plain[i] = (unsigned char) rand();
+        }
+
+        for (i = 0; i < TRACK_BLOCKS; i++)
+        {
+            ref_encode(plain + i * GCR_BLOCK_DATASIZE, gcr_ref + i * GCR_BLOCK_GCRSIZE);
+        }
+        gcr_encode_block_n(plain, gcr_new, TRACK_BLOCKS);
+
+        if (memcmp(gcr_ref, gcr_new, sizeof(gcr_ref)) != 0)
+        {
+            fprintf(stderr, "round %d: gcr_encode_block_n() differs from gcr_4_to_5_encode()\n", round);
+            errors++;
+        }
+
+        /* damage some blocks: some random GCR byte, and the data block marker */
+        gcr_new[1 * GCR_BLOCK_GCRSIZE + rand() % GCR_BLOCK_GCRSIZE] ^= (unsigned char) (1 + rand() % 255);
+        gcr_new[2 * GCR_BLOCK_GCRSIZE] ^= 0x08;
+
+        gcr_decode_block_n(gcr_new, check, TRACK_BLOCKS, status);
+
+        if (status[2] != 4)
+        {
+            fprintf(stderr, "round %d: damaged data block marker was not detected\n", round);
+            errors++;
+        }
+
+        for (i = 0; i < TRACK_BLOCKS; i++)
+        {
+            unsigned char ref_block[GCR_BLOCK_DATASIZE];
+            int ref_status = ref_decode(gcr_new + i * GCR_BLOCK_GCRSIZE, ref_block);
+
+            if (ref_status != status[i]
+                || (ref_status != 4
+                    && memcmp(ref_block, check + i * GCR_BLOCK_DATASIZE, GCR_BLOCK_DATASIZE) != 0))
+            {
+                fprintf(stderr, "round %d, block %d: gcr_decode_block_n() differs from gcr_5_to_4_decode()\n", round, i);
+                errors++;
+            }
+            else if (status[i] == 0
+                     && memcmp(plain + i * GCR_BLOCK_DATASIZE, check + i * GCR_BLOCK_DATASIZE, GCR_BLOCK_DATASIZE) != 0)
+            {
+                fprintf(stderr, "round %d, block %d: round trip failed\n", round, i);
+                errors++;
+            }
+        }
+    }
+
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char plain[TRACK_BLOCKS * GCR_BLOCK_DATASIZE];
+    unsigned char gcr[TRACK_BLOCKS * GCR_BLOCK_GCRSIZE];
+    unsigned long tracks = 20000;
+    unsigned long n;
+    clock_t start;
+    int i;
+
+    if (argc > 2 || (argc == 2 && (tracks = strtoul(argv[1], NULL, 0)) == 0))
+    {
+        fprintf(stderr, "usage: %s [<number of tracks>]\n", argv[0]);
+        return 1;
+    }
+
+    srand(1541);
+
+    if (self_test() != 0)
+    {
+        fprintf(stderr, "self test FAILED\n");
+        return 1;
+    }
+    printf("self test passed\n");
+
+    for (i = 0; i < (int) sizeof(plain); i++)
+    {
+        plain[i] = (unsigned char) rand();
+    }
+
+    printf("converting %lu tracks of %d blocks:\n", tracks, TRACK_BLOCKS);
+
+    start = clock();
+    for (n = 0; n < tracks; n++)
+    {
+        for (i = 0; i < TRACK_BLOCKS; i++)
+        {
+            ref_encode(plain + i * GCR_BLOCK_DATASIZE, gcr + i * GCR_BLOCK_GCRSIZE);
+        }
+    }
+    report("encode, gcr_4_to_5_encode():", tracks * TRACK_BLOCKS, seconds(start));
+
+    start = clock();
+    for (n = 0; n < tracks; n++)
+    {
+        gcr_encode_block_n(plain, gcr, TRACK_BLOCKS);
+    }
+    report("encode, gcr_encode_block_n():", tracks * TRACK_BLOCKS, seconds(start));
+
+    start = clock();
+    for (n = 0; n < tracks; n++)
+    {
+        for (i = 0; i < TRACK_BLOCKS; i++)
+        {
+            ref_decode(gcr + i * GCR_BLOCK_GCRSIZE, plain + i * GCR_BLOCK_DATASIZE);
+        }
+    }
+    report("decode, gcr_5_to_4_decode():", tracks * TRACK_BLOCKS, seconds(start));
+
+    start = clock();
+    for (n = 0; n < tracks; n++)
+    {
+        gcr_decode_block_n(gcr, plain, TRACK_BLOCKS, NULL);
+    }
+    report("decode, gcr_decode_block_n():", tracks * TRACK_BLOCKS, seconds(start));
+
+    return 0;
+}
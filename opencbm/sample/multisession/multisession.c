@@ -0,0 +1,226 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version
+ *  2 of the License, or (at your option) any later version.
+ *
+ *  Copyright 2026 OpenCBM team
+ */
+
+/*
+ * Test of concurrent sessions: every adapter given on the command line
+ * is opened and used by a thread of its own, at the same time as the
+ * others. Each thread writes a pattern of its own into the memory of
+ * its drive, reads it back and checks it, and reads the status of the
+ * drive.
+ *
+ * With the image plugin, this needs no hardware:
+ *
+ *   multisession image:a.d64 image:b.d64 opencbmd
+ */
+
+#include "opencbm.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+
+/* the drive memory which is written; the buffers of a 1541 */
+#define TEST_ADDRESS 0x0300
+#define TEST_SIZE    0x0100
+
+/* the state of one session */
+typedef struct session_s
+{
+    int Index;
+    char *Adapter;
+    unsigned char Drive;
+    unsigned int Rounds;
+    unsigned int Done;
+    int Failed;
+    char Message[200];
+} session_t;
+
+static void help()
+{
+    printf(
+        "Usage: multisession [OPTION]... ADAPTER...\n"
+        "Use several adapters at the same time, one thread for each of them\n"
+        "\n"
+        "  -h, --help                 display this help and exit\n"
+        "  -V, --version              display version information and exit\n"
+        "\n"
+        "  -d, --drive=N              the drive to use on every adapter (default: 8)\n"
+        "  -r, --rounds=N             the number of rounds of every session (default: 20)\n"
+        "\n"
+        );
+}
+
+static void hint(char *s)
+{
+    fprintf(stderr, "Try `%s' -h for more information.\n", s);
+}
+
+static void fail(session_t *session, const char *what)
+{
+    session->Failed = 1;
+    arch_snprintf(session->Message, sizeof(session->Message),
+                  "round %u: %s", session->Done + 1, what);
+}
+
+static void session_run(void *Context)
+{
+    session_t *session = Context;
+    unsigned char pattern[TEST_SIZE];
+    unsigned char buffer[TEST_SIZE];
+    char status[40];
+    CBM_FILE fd;
+    unsigned int i;
+
+    if (cbm_driver_open_ex(&fd, session->Adapter) != 0)
+    {
+        fail(session, "cannot open the adapter");
+        return;
+    }
+
+    /* the functions of the plugin must be the ones of this adapter */
+    if (cbm_get_plugin_function_address_ex(fd, "opencbm_plugin_driver_open") == NULL)
+    {
+        fail(session, "cannot find the functions of the plugin");
+    }
+
+    for (; !session->Failed && session->Done < session->Rounds; session->Done++)
+    {
+        for (i = 0; i < TEST_SIZE; i++)
+            pattern[i] = (unsigned char) (session->Index * 77 + session->Done * 13 + i);
+
+        if (cbm_upload(fd, session->Drive, TEST_ADDRESS, pattern, sizeof(pattern)) != sizeof(pattern))
+        {
+            fail(session, "cannot write the drive memory");
+            break;
+        }
+
+        if (cbm_upload_is_resident(fd, session->Drive, TEST_ADDRESS, pattern, sizeof(pattern)) != 1)
+        {
+            fail(session, "the pattern is not resident");
+            break;
+        }
+
+        memset(buffer, 0, sizeof(buffer));
+
+        if (cbm_download(fd, session->Drive, TEST_ADDRESS, buffer, sizeof(buffer)) != sizeof(buffer))
+        {
+            fail(session, "cannot read the drive memory");
+            break;
+        }
+
+        if (memcmp(buffer, pattern, sizeof(pattern)) != 0)
+        {
+            fail(session, "the drive memory does not contain the pattern");
+            break;
+        }
+
+        if (cbm_device_status(fd, session->Drive, status, sizeof(status)) != 0)
+        {
+            fail(session, status);
+            break;
+        }
+    }
+
+    cbm_driver_close(fd);
+}
+
+int ARCH_MAINDECL main(int argc, char *argv[])
+{
+    session_t *sessions;
+    arch_thread_t *threads;
+    unsigned int rounds = 20;
+    unsigned char drive = 8;
+    int count;
+    int failed = 0;
+    int option;
+    int i;
+
+    static const struct option longopts[] =
+    {
+        { "help"       , no_argument      , NULL, 'h' },
+        { "version"    , no_argument      , NULL, 'V' },
+        { "drive"      , required_argument, NULL, 'd' },
+        { "rounds"     , required_argument, NULL, 'r' },
+        { NULL         , 0                , NULL, 0   }
+    };
+
+    static const char shortopts[] ="hVd:r:";
+
+    while ((option = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1)
+    {
+        switch(option)
+        {
+            case 'h': help();
+                      return 0;
+            case 'V': printf("multisession %s\n", OPENCBM_VERSION);
+                      return 0;
+            case 'd': drive = (unsigned char) atoi(optarg);
+                      break;
+            case 'r': rounds = (unsigned int) atoi(optarg);
+                      break;
+            default : hint(argv[0]);
+                      return 1;
+        }
+    }
+
+    count = argc - optind;
+
+    if (count < 1)
+    {
+        fprintf(stderr, "Usage: %s [OPTION]... ADAPTER...\n", argv[0]);
+        hint(argv[0]);
+        return 1;
+    }
+
+    sessions = calloc(count, sizeof(*sessions));
+    threads = calloc(count, sizeof(*threads));
+
+    if (sessions == NULL || threads == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sessions[i].Index = i;
+        sessions[i].Adapter = argv[optind + i];
+        sessions[i].Drive = drive;
+        sessions[i].Rounds = rounds;
+
+        if (arch_thread_create(&threads[i], session_run, &sessions[i]) != 0)
+        {
+            fprintf(stderr, "cannot create a thread\n");
+            return 1;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        arch_thread_join(threads[i]);
+
+        if (sessions[i].Failed)
+        {
+            printf("%s: FAILED in %s\n", sessions[i].Adapter, sessions[i].Message);
+            failed = 1;
+        }
+        else
+        {
+            printf("%s: %u rounds ok\n", sessions[i].Adapter, sessions[i].Done);
+        }
+    }
+
+    free(threads);
+    free(sessions);
+
+    return failed;
+}
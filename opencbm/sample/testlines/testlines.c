@@ -911,7 +911,9 @@ static int do_command(CBM_FILE fd, OPTIONS * const options)
  */
 static int do_dir(CBM_FILE fd, OPTIONS * const options)
 {
-    char c, buf[40];
+    char buf[40];
+    int c;
+    cbm_stream_t *stream;
     unsigned char command[] = { '$', '0' };
     int rv;
     unsigned char unit;
@@ -933,31 +935,31 @@ static int do_dir(CBM_FILE fd, OPTIONS * const options)
     {
         if(cbm_device_status(fd, unit, buf, sizeof(buf)) == 0)
         {
-            cbm_talk(fd, unit, 0);
-            if(cbm_raw_read(fd, buf, 2) == 2)
+            stream = cbm_stream_open_talk(fd, unit, 0);
+            if(stream && cbm_stream_read(stream, buf, 2) == 2)
             {
-                while(cbm_raw_read(fd, buf, 2) == 2)
+                while(cbm_stream_read(stream, buf, 2) == 2)
                 {
-                    if(cbm_raw_read(fd, buf, 2) == 2)
+                    if(cbm_stream_read(stream, buf, 2) == 2)
                     {
                         printf("%u ", (unsigned char)buf[0] | (unsigned char)buf[1] << 8 );
-                        while((cbm_raw_read(fd, &c, 1) == 1) && c)
+                        while((c = cbm_stream_getc(stream)) > 0)
                         {
                             if (options->petsciiraw == PA_PETSCII)
-                                putchar(cbm_petscii2ascii_c(c));
+                                putchar(cbm_petscii2ascii_c((char) c));
                             else
                                 putchar(c);
                         }
                         putchar('\n');
                     }
                 }
-                cbm_untalk(fd);
+                cbm_stream_close(stream);
                 cbm_device_status(fd, unit, buf, sizeof(buf));
                 printf("%s", cbm_petscii2ascii(buf));
             }
             else
             {
-                cbm_untalk(fd);
+                cbm_stream_close(stream);
             }
 
         }
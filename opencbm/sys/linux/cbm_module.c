@@ -52,14 +52,22 @@
 #include <linux/fs.h>
 #include <linux/kernel.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
 #include <linux/sched.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
 #include <linux/sched/signal.h>
 #endif
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 #include "cbm_module.h"
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,16,0)
+typedef unsigned int __poll_t;
+#endif
+
 /*! \brief
  * If DBG_IMPLANT_FAIL is defined, then there is a machinsm so we can fail some
  * communication calls.  That is, we can emulate the failure of the
@@ -246,6 +254,10 @@ int cbm_handshaked_write(char data, int toggle);
 
 /* Defines needed for parallel burst end */
 
+/* forward references for the block transfers */
+static int cbm_block_read(int protocol, unsigned char *buffer, int length);
+static int cbm_block_write(int protocol, const unsigned char *buffer, int length);
+
 #ifdef DIRECT_PORT_ACCESS
 unsigned int port = 0x378;    /* lpt port address             */
 unsigned int irq = 7;         /* lpt irq line                 */
@@ -266,6 +278,9 @@ int reset = 1;                /* >1 => force reset            */
 int hold_clk = 1;       /* >0 => strict C64 behaviour   */
                               /* =0 => release CLK when idle  */
 
+int atn_settle = 20000;       /* us the devices get to react  */
+                              /* to ATN, like on a C64        */
+
 #ifdef DIRECT_PORT_ACCESS
 module_param(port, int, 0444);
 MODULE_PARM_DESC(port, "IO portnumber of parallel port. (default 0x378)");
@@ -293,6 +308,9 @@ MODULE_PARM_DESC(reset,
 module_param(hold_clk, int, 0444);
 MODULE_PARM_DESC(hold_clk,
              "0=release CLK when idle, >0=strict C64 behaviour. (default 1)");
+module_param(atn_settle, int, 0444);
+MODULE_PARM_DESC(atn_settle,
+             "time in us the devices get to react to ATN. (default 20000)");
 
 MODULE_AUTHOR("Michael Klein");
 MODULE_DESCRIPTION("Serial CBM bus driver module");
@@ -398,6 +416,24 @@ volatile static int cbm_irq_count;
 #define BUFFER_SIZE 0x2000
 static unsigned char *track_buffer;
 
+/*
+ *  the ring of parallel burst tracks, shared with user space by mmap();
+ *  a worker reads the tracks into it, so that user space can process
+ *  one track while the next one is being read
+ */
+static void *track_ring;
+static struct work_struct track_ring_work;
+static wait_queue_head_t track_ring_wait_q;
+static unsigned long track_ring_flags;
+#define TRACK_RING_BUSY 0   /* the worker owns the bus */
+static int track_ring_var;
+static atomic_t track_ring_maps;    /* mappings of the ring */
+
+/* the driver's own state of the ring; user space only gets copies,
+ * in the header, so that it cannot confuse the driver */
+static unsigned int track_ring_head;
+static int track_ring_last;     /* result of the last track */
+
 /*
  *  dump input lines
  */
@@ -409,10 +445,50 @@ static void show(char *s)
 }
 #endif /* DEBUG */
 
-static void timeout_us(int us)
+/*
+ *  sleep for some microseconds, on a high resolution timer
+ *  where available, instead of keeping the CPU busy
+ */
+static void timeout_us(unsigned long us)
 {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+    usleep_range(us, us + us / 4 + 10);
+#else
     current->state = TASK_INTERRUPTIBLE;
-    schedule_timeout(HZ / 1000000 * us);
+    schedule_timeout(usecs_to_jiffies(us));
+#endif
+}
+
+/*
+ *  wait until an input line is set (set != 0) or released
+ *
+ *  The line is polled busily for about spin_us microseconds, as the
+ *  drives usually answer within that time. After that, we sleep
+ *  between the polls, with the sleeps growing up to WAIT_SLEEP_MAX_US,
+ *  so that a drive which is busy for long does not cost a whole CPU.
+ */
+#define WAIT_SLEEP_MIN_US   50
+#define WAIT_SLEEP_MAX_US 2000
+
+static int wait_for_line(unsigned char mask, int set, int spin_us)
+{
+    unsigned char state = set ? mask : 0;
+    unsigned long sleep_us = WAIT_SLEEP_MIN_US;
+    int i = 0;
+
+    while ((POLL() & mask) == state) {
+        if (i < spin_us) {
+            i += 10;
+            udelay(10);
+        } else {
+            if (signal_pending(current))
+                return -EINTR;
+            timeout_us(sleep_us);
+            if (sleep_us < WAIT_SLEEP_MAX_US)
+                sleep_us *= 2;
+        }
+    }
+    return 0;
 }
 
 static int check_if_bus_free(void)
@@ -500,19 +576,20 @@ static int send_byte(int b)
 
     DPRINTK("send_byte %02x\n", b);
 
-    local_irq_save(flags);
     for (i = 0; i < 8; i++) {
         udelay(70);
+        /* only the time a bit is valid on the bus is critical */
+        local_irq_save(flags);
         if (!((b >> i) & 1))
             SET(DATA_OUT);
         RELEASE(CLK_OUT);
         udelay(20);
         SET_RELEASE(CLK_OUT, DATA_OUT);
+        local_irq_restore(flags);
     }
-    local_irq_restore(flags);
 
     for (i = 0; (i < 20) && !(ack = GET(DATA_IN)); i++)
-        udelay(100);
+        timeout_us(100);
 
     DPRINTK("ack=%d\n", ack);
 
@@ -546,11 +623,55 @@ static void wait_for_listener(void)
     DPRINTK_INT("cbm: wait_for_listener() got an interrupt\n");
 }
 
+/*
+ *  the worker which reads a track into the next slot of the ring
+ */
+static void track_ring_read(struct work_struct *work)
+{
+    CBM_TRACK_RING_HEADER *header = track_ring;
+    unsigned int slot = track_ring_head % CBM_TRACK_RING_SLOTS;
+    unsigned char *buffer = (unsigned char *)track_ring
+        + CBM_TRACK_RING_SLOT_OFFSET(slot);
+
+    if (track_ring_var)
+        track_ring_last = cbm_parallel_burst_read_track_var(buffer);
+    else
+        track_ring_last = cbm_parallel_burst_read_track(buffer);
+    track_ring_head++;
+
+    WRITE_ONCE(header->result[slot], track_ring_last);
+    /* the track must be complete before user space sees it */
+    smp_wmb();
+    WRITE_ONCE(header->head, track_ring_head);
+
+    /* orders the state above before the bus is given back */
+    clear_bit_unlock(TRACK_RING_BUSY, &track_ring_flags);
+    wake_up_interruptible(&track_ring_wait_q);
+}
+
+/*
+ *  the bus belongs to the worker while it reads a track;
+ *  wait for it to finish, or tell a nonblocking caller to try later
+ */
+static int wait_for_track_ring(struct file *f)
+{
+    if (!test_bit(TRACK_RING_BUSY, &track_ring_flags))
+        return 0;
+    if (f->f_flags & O_NONBLOCK)
+        return -EAGAIN;
+    if (wait_event_interruptible(track_ring_wait_q,
+            !test_bit(TRACK_RING_BUSY, &track_ring_flags)))
+        return -EINTR;
+    return 0;
+}
+
 static ssize_t cbm_read(struct file *f, char *buf, size_t count, loff_t *ppos)
 {
     size_t received = 0;
+    size_t buffered = 0;
     int i, b, bit;
     int ok = 0;
+    int rv;
     unsigned long flags;
 
     DPRINTK("cbm_read: %zu bytes\n", count);
@@ -558,19 +679,26 @@ static ssize_t cbm_read(struct file *f, char *buf, size_t count, loff_t *ppos)
     if (eoi)
         return 0;
 
+    rv = wait_for_track_ring(f);
+    if (rv)
+        return rv;
+
     do {
-        i = 0;
-        while (GET(CLK_IN)) {
-            if (i >= 50) {
-                current->state = TASK_INTERRUPTIBLE;
-                schedule_timeout(HZ / 50);
-                if (signal_pending(current))
-                    return -EINTR;
-            } else {
-                i++;
-                udelay(20);
-            }
+        if ((f->f_flags & O_NONBLOCK) && GET(CLK_IN)) {
+            /* the talker is not ready, do not wait for it */
+            if (!received)
+                return -EAGAIN;
+            break;
         }
+
+        /* wait for the talker to be ready */
+        if (wait_for_line(CLK_IN, 0, 1000))
+            return -EINTR;
+
+        /*
+         * From here on, the talker does not wait for us anymore
+         * until the byte has been sent completely.
+         */
         local_irq_save(flags);
         RELEASE(DATA_OUT);
         for (i = 0; (i < 40) && !(ok = GET(CLK_IN)); i++)
@@ -604,12 +732,16 @@ static ssize_t cbm_read(struct file *f, char *buf, size_t count, loff_t *ppos)
             IMPLANT_FAIL(FAILCOUNTER_READ, " cbm_read", { ok = 0; continue; })
 
             received++;
-            put_user((char)b, buf++);
+            track_buffer[buffered++] = (unsigned char)b;
+
+            if (buffered == BUFFER_SIZE) {
+                if (copy_to_user(buf, track_buffer, buffered))
+                    return -EFAULT;
+                buf += buffered;
+                buffered = 0;
+            }
 
-            if (received % 256)
-                udelay(50);
-            else
-                schedule();
+            timeout_us(50);
         }
 
     } while (received < count && ok && !eoi);
@@ -619,6 +751,9 @@ static ssize_t cbm_read(struct file *f, char *buf, size_t count, loff_t *ppos)
         return -EIO;
     }
 
+    if (buffered && copy_to_user(buf, track_buffer, buffered))
+        return -EFAULT;
+
     DPRINTK("received=%zu, count=%zu, ok=%d, eoi=%d\n",
         received, count, ok, eoi);
 
@@ -649,15 +784,24 @@ static int cbm_raw_write(const char *buf, size_t cnt, int atn, int talk)
         return -ENODEV;
     }
 
-    current->state = TASK_INTERRUPTIBLE;
-    schedule_timeout(HZ / 50);  /* 20ms */
+    /* give all devices the time to react to ATN, like the C64 does */
+    if (atn_settle > 0)
+        timeout_us(atn_settle);
 
     while (cnt > sent && rv == 0) {
-        if (atn == 0)
-            get_user(c, buf++);
-        else
-            c = *buf++;
-        udelay(50);
+        if (atn == 0) {
+            /* fetch the data from user space a buffer at a time */
+            if (sent % BUFFER_SIZE == 0
+                && copy_from_user(track_buffer, buf + sent,
+                                  min_t(size_t, cnt - sent, BUFFER_SIZE))) {
+                rv = -EFAULT;
+                break;
+            }
+            c = track_buffer[sent % BUFFER_SIZE];
+        } else {
+            c = buf[sent];
+        }
+        timeout_us(50);
         if (GET(DATA_IN)) {
             cbm_irq_count = ((sent == (cnt - 1))
                      && (atn == 0)) ? 2 : 1;
@@ -668,7 +812,7 @@ static int cbm_raw_write(const char *buf, size_t cnt, int atn, int talk)
             } else {
                 if (send_byte(c)) {
                     sent++;
-                    udelay(100);
+                    timeout_us(100);
                 } else {
                     printk("cbm_write: I/O error\n");
                     rv = -EIO;
@@ -688,18 +832,18 @@ static int cbm_raw_write(const char *buf, size_t cnt, int atn, int talk)
         RELEASE(ATN_OUT);
 
         RELEASE(CLK_OUT);
+        local_irq_restore(flags);
+
         for (i = 0; (i < 100) && !GET(CLK_IN); i++)
             udelay(10);
         if (!GET(CLK_IN)) {
             printk("cbm_write: device not present\n");
             rv = -ENODEV;
         }
-
-        local_irq_restore(flags);
     } else {
         RELEASE(ATN_OUT);
     }
-    udelay(100);
+    timeout_us(100);
 
     return (rv < 0) ? rv : (int)sent;
 }
@@ -707,16 +851,97 @@ static int cbm_raw_write(const char *buf, size_t cnt, int atn, int talk)
 static ssize_t cbm_write(struct file *f, const char *buf, size_t cnt,
              loff_t *ppos)
 {
+    int rv = wait_for_track_ring(f);
+
+    if (rv)
+        return rv;
+
     return cbm_raw_write(buf, cnt, 0, 0);
 }
 
+static __poll_t cbm_poll(struct file *f, poll_table *wait)
+{
+    CBM_TRACK_RING_HEADER *header = track_ring;
+    CBM_TRACK_RING_TAIL *tail = (CBM_TRACK_RING_TAIL *)
+        ((unsigned char *)track_ring + CBM_TRACK_RING_TAIL_OFFSET);
+    __poll_t mask = 0;
+
+    poll_wait(f, &track_ring_wait_q, wait);
+
+    /* a track is waiting in the ring; the worker may already be
+     * reading the next one, so look at the copy it has published */
+    if (READ_ONCE(header->head) != READ_ONCE(tail->tail))
+        mask |= POLLIN | POLLRDNORM;
+
+    /* the bus is not used by the worker */
+    if (!test_bit(TRACK_RING_BUSY, &track_ring_flags))
+        mask |= POLLOUT | POLLWRNORM;
+
+    return mask;
+}
+
+/*
+ *  count the mappings of the ring, so that cbm_open() does not reset it
+ *  under the feet of a process which still has it mapped
+ */
+static void cbm_vm_open(struct vm_area_struct *vma)
+{
+    atomic_inc(&track_ring_maps);
+}
+
+static void cbm_vm_close(struct vm_area_struct *vma)
+{
+    atomic_dec(&track_ring_maps);
+}
+
+static const struct vm_operations_struct cbm_vm_ops = {
+    .open = cbm_vm_open,
+    .close = cbm_vm_close,
+};
+
+static int cbm_mmap(struct file *f, struct vm_area_struct *vma)
+{
+    unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+    int rv;
+
+    if (offset >= CBM_TRACK_RING_SIZE
+        || vma->vm_end - vma->vm_start > CBM_TRACK_RING_SIZE - offset)
+        return -EINVAL;
+
+    /* the header belongs to the driver */
+    if (offset < CBM_TRACK_RING_TAIL_OFFSET) {
+        if (vma->vm_flags & VM_WRITE)
+            return -EPERM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+        vm_flags_clear(vma, VM_MAYWRITE);
+#else
+        vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+    }
+
+    rv = remap_vmalloc_range(vma, track_ring, vma->vm_pgoff);
+    if (rv)
+        return rv;
+
+    vma->vm_ops = &cbm_vm_ops;
+    cbm_vm_open(vma);
+    return 0;
+}
+
 static long cbm_unlocked_ioctl(struct file *f,
              unsigned int cmd, unsigned long arg)
 {
-    unsigned char buf[2], c, talk, mask, state, i;
+    unsigned char buf[2], c, talk, mask;
     int rv = 0;
     int intarg = 0;
     PARBURST_RW_VALUE val;
+    BLOCK_RW_VALUE block;
+    CBM_TRACK_RING_TAIL *tail = (CBM_TRACK_RING_TAIL *)
+        ((unsigned char *)track_ring + CBM_TRACK_RING_TAIL_OFFSET);
+
+    rv = wait_for_track_ring(f);
+    if (rv)
+        return rv;
 
     if (cmd == CBMCTRL_TALK
         || cmd == CBMCTRL_LISTEN
@@ -725,7 +950,8 @@ static long cbm_unlocked_ioctl(struct file *f,
         || cmd == CBMCTRL_IEC_SET
         || cmd == CBMCTRL_IEC_RELEASE
         || cmd == CBMCTRL_IEC_WAIT
-        || cmd == CBMCTRL_IEC_SETRELEASE)
+        || cmd == CBMCTRL_IEC_SETRELEASE
+        || cmd == CBMCTRL_PARBURST_READ_TRACK_RING)
         get_user(intarg, (int *)arg);
 
     buf[0] = (intarg >> 8) & 0x1f;  /* device */
@@ -784,19 +1010,8 @@ static long cbm_unlocked_ioctl(struct file *f,
         default:
             return -EINVAL;
         }
-        state = (intarg & 0xff) ? mask : 0;
-        i = 0;
-        while ((POLL() & mask) == state) {
-            if (i >= 20) {
-                current->state = TASK_INTERRUPTIBLE;
-                schedule_timeout(HZ / 50);  /* 20ms */
-                if (signal_pending(current))
-                    return -EINTR;
-            } else {
-                i++;
-                udelay(10);
-            }
-        }
+        if (wait_for_line(mask, intarg & 0xff, 200))
+            return -EINTR;
         /* fall through */
 
     case CBMCTRL_IEC_POLL:
@@ -941,6 +1156,52 @@ static long cbm_unlocked_ioctl(struct file *f,
         if (val.length > BUFFER_SIZE) return -EFAULT;
         if (copy_from_user(buf, val.buffer, val.length)) return -EFAULT;
         return cbm_parallel_burst_write_track(buf, val.length);
+
+    case CBMCTRL_PARBURST_READ_TRACK_RING:
+        /* another thread may have started the worker in the meantime */
+        while (test_and_set_bit_lock(TRACK_RING_BUSY, &track_ring_flags)) {
+            rv = wait_for_track_ring(f);
+            if (rv)
+                return rv;
+        }
+        if (track_ring_head - READ_ONCE(tail->tail) >= CBM_TRACK_RING_SLOTS) {
+            clear_bit_unlock(TRACK_RING_BUSY, &track_ring_flags);
+            return -ENOBUFS;
+        }
+        track_ring_var = (intarg == CBM_TRACK_RING_VAR);
+        schedule_work(&track_ring_work);
+        if (f->f_flags & O_NONBLOCK)
+            return 0;
+        rv = wait_for_track_ring(f);
+        if (rv)
+            return rv;
+        return track_ring_last;
+
+/* the block transfers of the drive programs */
+
+    case CBMCTRL_BLOCK_CAPS:
+        put_user((1 << CBM_BLOCK_PROTOCOL_S1)
+                 | (1 << CBM_BLOCK_PROTOCOL_S2)
+                 | (1 << CBM_BLOCK_PROTOCOL_PP_DC)
+                 | (1 << CBM_BLOCK_PROTOCOL_PP_CC), (int *)arg);
+        return 0;
+
+    case CBMCTRL_BLOCK_READ:
+        if (copy_from_user(&block, (BLOCK_RW_VALUE *) arg,
+            sizeof(BLOCK_RW_VALUE))) return -EFAULT;
+        if (block.length < 0 || block.length > BUFFER_SIZE) return -EINVAL;
+        rv = cbm_block_read(block.protocol, track_buffer, block.length);
+        if (rv > 0 && copy_to_user(block.buffer, track_buffer, rv))
+            return -EFAULT;
+        return rv;
+
+    case CBMCTRL_BLOCK_WRITE:
+        if (copy_from_user(&block, (BLOCK_RW_VALUE *) arg,
+            sizeof(BLOCK_RW_VALUE))) return -EFAULT;
+        if (block.length < 0 || block.length > BUFFER_SIZE) return -EINVAL;
+        if (copy_from_user(track_buffer, block.buffer, block.length))
+            return -EFAULT;
+        return cbm_block_write(block.protocol, track_buffer, block.length);
     }
     return -EINVAL;
 }
@@ -950,7 +1211,15 @@ static int cbm_open(struct inode *inode, struct file *f)
     if (busy)
         return -EBUSY;
 
+    /* an old process still has the ring mapped; resetting it would
+     * pull the header and the tail out from under it */
+    if (atomic_read(&track_ring_maps))
+        return -EBUSY;
+
     init_waitqueue_head(&cbm_wait_q);
+    /* start with an empty ring */
+    track_ring_head = 0;
+    memset(track_ring, 0, CBM_TRACK_RING_SLOT_OFFSET(0));
     busy = 1;
     if (hold_clk)
         SET(CLK_OUT);
@@ -960,6 +1229,8 @@ static int cbm_open(struct inode *inode, struct file *f)
 
 static int cbm_release(struct inode *inode, struct file *f)
 {
+    /* do not leave the worker alone on the bus */
+    flush_work(&track_ring_work);
     if (!hold_clk)
         RELEASE(CLK_OUT);
     busy = 0;
@@ -1016,6 +1287,8 @@ static const struct file_operations cbm_fops = {
     .read       = cbm_read,
     .write      = cbm_write,
     .unlocked_ioctl = cbm_unlocked_ioctl,
+    .poll       = cbm_poll,
+    .mmap       = cbm_mmap,
     .open       = cbm_open,
     .release    = cbm_release,
 };
@@ -1029,6 +1302,7 @@ static struct miscdevice cbm_dev = {
 void cbm_cleanup(void)
 {
     kfree(track_buffer);
+    vfree(track_ring);
 #ifdef DIRECT_PORT_ACCESS
     free_irq(irq, NULL);
     release_region(port, 3);
@@ -1104,8 +1378,24 @@ int cbm_init(void)
     }
     DPRINTK("parallel port is mine now\n");
 #endif
-    misc_register(&cbm_dev);
     track_buffer = kmalloc(BUFFER_SIZE, GFP_KERNEL);
+    track_ring = vmalloc_user(CBM_TRACK_RING_SIZE);
+    if (track_buffer == NULL || track_ring == NULL) {
+        printk("cbm_init: out of memory\n");
+        kfree(track_buffer);
+        vfree(track_ring);
+#ifdef DIRECT_PORT_ACCESS
+        free_irq(irq, NULL);
+        release_region(port, 3);
+#else
+        parport_release(cbm_device);
+        parport_unregister_device(cbm_device);
+#endif
+        return -ENOMEM;
+    }
+    INIT_WORK(&track_ring_work, track_ring_read);
+    init_waitqueue_head(&track_ring_wait_q);
+    misc_register(&cbm_dev);
 
 #ifdef DIRECT_PORT_ACCESS
     in_port = port + 1;
@@ -1349,3 +1639,252 @@ int cbm_handshaked_write(char data, int toggle)
     XP_WRITE(data);
     return 1;
 }
+
+/*
+        And the block transfers, with the protocols of the
+        drive programs of cbmcopy, d64copy and imgcopy
+        (called by the ioctl-function)
+*/
+
+#define BLOCK_WAIT(_mask, _set) \
+    do { \
+        int _rv = wait_for_line(_mask, _set, 200); \
+        if (_rv) \
+            return _rv; \
+    } while (0)
+
+static unsigned char cbm_block_xp_read(void)
+{
+    if (!data_reverse) {
+        XP_WRITE(0xff);
+        set_data_reverse();
+    }
+    return XP_READ();
+}
+
+static void cbm_block_xp_write(unsigned char c)
+{
+    if (data_reverse)
+        set_data_forward();
+    XP_WRITE(c);
+}
+
+static int cbm_s1_read(void)
+{
+    unsigned char c = 0;
+    int b, i;
+
+    for (i = 7; i >= 0; i--) {
+        BLOCK_WAIT(DATA_IN, 0);
+        RELEASE(CLK_OUT);
+        udelay(2);  /* let the line settle */
+        b = GET(CLK_IN);
+        c = (c >> 1) | (b ? 0x80 : 0);
+        SET(DATA_OUT);
+        BLOCK_WAIT(CLK_IN, !b);
+        RELEASE(DATA_OUT);
+        BLOCK_WAIT(DATA_IN, 1);
+        SET(CLK_OUT);
+    }
+    return c;
+}
+
+static int cbm_s1_write(unsigned char c)
+{
+    int b, i;
+
+    for (i = 7; i >= 0; i--) {
+        b = (c >> i) & 1;
+        if (b)
+            SET(DATA_OUT);
+        else
+            RELEASE(DATA_OUT);
+        RELEASE(CLK_OUT);
+        BLOCK_WAIT(CLK_IN, 1);
+        if (b)
+            RELEASE(DATA_OUT);
+        else
+            SET(DATA_OUT);
+        BLOCK_WAIT(CLK_IN, 0);
+        RELEASE(DATA_OUT);
+        SET(CLK_OUT);
+        BLOCK_WAIT(DATA_IN, 1);
+    }
+    return 0;
+}
+
+static int cbm_s2_read(void)
+{
+    unsigned char c = 0;
+    int i;
+
+    for (i = 4; i > 0; i--) {
+        BLOCK_WAIT(CLK_IN, 0);
+        c = (c >> 1) | (GET(DATA_IN) ? 0x80 : 0);
+        RELEASE(ATN_OUT);
+        BLOCK_WAIT(CLK_IN, 1);
+        c = (c >> 1) | (GET(DATA_IN) ? 0x80 : 0);
+        SET(ATN_OUT);
+    }
+    return c;
+}
+
+static int cbm_s2_write(unsigned char c)
+{
+    int i;
+
+    for (i = 4; i > 0; i--) {
+        if (c & 1)
+            SET(DATA_OUT);
+        else
+            RELEASE(DATA_OUT);
+        c >>= 1;
+        RELEASE(ATN_OUT);
+        BLOCK_WAIT(CLK_IN, 0);
+        if (c & 1)
+            SET(DATA_OUT);
+        else
+            RELEASE(DATA_OUT);
+        c >>= 1;
+        SET(ATN_OUT);
+        BLOCK_WAIT(CLK_IN, 1);
+    }
+    RELEASE(DATA_OUT);
+    return 0;
+}
+
+static int cbm_pp_cc_read(void)
+{
+    unsigned char c;
+
+    RELEASE(CLK_OUT);
+    BLOCK_WAIT(DATA_IN, 0);
+    c = cbm_block_xp_read();
+    SET(CLK_OUT);
+    BLOCK_WAIT(DATA_IN, 1);
+    return c;
+}
+
+static int cbm_pp_cc_write(unsigned char c)
+{
+    cbm_block_xp_write(c);
+    RELEASE(CLK_OUT);
+    BLOCK_WAIT(DATA_IN, 0);
+    SET(CLK_OUT);
+    BLOCK_WAIT(DATA_IN, 1);
+    return 0;
+}
+
+/*
+ * the drive needs some time to switch the direction of its port,
+ * just like d64copy waits for it with this protocol
+ */
+static void cbm_pp_dc_direction(int write)
+{
+    static int last = -1;
+
+    if (last != write && last != -1)
+        udelay(100);
+    last = write;
+}
+
+static int cbm_pp_dc_read(int toggle)
+{
+    unsigned char c;
+
+    if (!toggle) {
+        BLOCK_WAIT(DATA_IN, 1);
+        c = cbm_block_xp_read();
+        RELEASE(CLK_OUT);
+    } else {
+        BLOCK_WAIT(DATA_IN, 0);
+        c = cbm_block_xp_read();
+        SET(CLK_OUT);
+    }
+    return c;
+}
+
+static int cbm_pp_dc_write(unsigned char c, int toggle)
+{
+    if (!toggle) {
+        BLOCK_WAIT(DATA_IN, 1);
+        cbm_block_xp_write(c);
+        RELEASE(CLK_OUT);
+    } else {
+        BLOCK_WAIT(DATA_IN, 0);
+        cbm_block_xp_write(c);
+        SET(CLK_OUT);
+    }
+    return 0;
+}
+
+/*
+ * transfer a whole block; the number of bytes which were transferred
+ * is returned, or an error if not even the first one was
+ */
+static int cbm_block_read(int protocol, unsigned char *buffer, int length)
+{
+    int i, rv;
+
+    if (protocol == CBM_BLOCK_PROTOCOL_PP_DC) {
+        if (length & 1)
+            return -EINVAL;
+        cbm_pp_dc_direction(0);
+    }
+
+    for (i = 0; i < length; i++) {
+        switch (protocol) {
+        case CBM_BLOCK_PROTOCOL_S1:
+            rv = cbm_s1_read();
+            break;
+        case CBM_BLOCK_PROTOCOL_S2:
+            rv = cbm_s2_read();
+            break;
+        case CBM_BLOCK_PROTOCOL_PP_DC:
+            rv = cbm_pp_dc_read(i & 1);
+            break;
+        case CBM_BLOCK_PROTOCOL_PP_CC:
+            rv = cbm_pp_cc_read();
+            break;
+        default:
+            return -EINVAL;
+        }
+        if (rv < 0)
+            return i > 0 ? i : rv;
+        buffer[i] = rv;
+    }
+    return length;
+}
+
+static int cbm_block_write(int protocol, const unsigned char *buffer, int length)
+{
+    int i, rv;
+
+    if (protocol == CBM_BLOCK_PROTOCOL_PP_DC) {
+        if (length & 1)
+            return -EINVAL;
+        cbm_pp_dc_direction(1);
+    }
+
+    for (i = 0; i < length; i++) {
+        switch (protocol) {
+        case CBM_BLOCK_PROTOCOL_S1:
+            rv = cbm_s1_write(buffer[i]);
+            break;
+        case CBM_BLOCK_PROTOCOL_S2:
+            rv = cbm_s2_write(buffer[i]);
+            break;
+        case CBM_BLOCK_PROTOCOL_PP_DC:
+            rv = cbm_pp_dc_write(buffer[i], i & 1);
+            break;
+        case CBM_BLOCK_PROTOCOL_PP_CC:
+            rv = cbm_pp_cc_write(buffer[i]);
+            break;
+        default:
+            return -EINVAL;
+        }
+        if (rv < 0)
+            return i > 0 ? i : rv;
+    }
+    return length;
+}
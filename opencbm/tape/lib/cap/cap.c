@@ -13,6 +13,9 @@
 
 #define Default_CAP_Header_Size 0xA0
 
+// Size of the read-ahead/write-behind buffer for the signal data.
+#define CAP_Buffer_Size 0x10000
+
 #define SEEK_START_OF_FILE 1
 #define SEEK_START_OF_DATA 2
 
@@ -26,10 +29,80 @@ typedef struct _INFOBLOCK {
     char          header[Default_CAP_Header_Size+1]; // + 0-termination
     unsigned char Machine, Video, StartEdge, SignalFormat;
     unsigned int  Precision, SignalWidth, StartOfs;
+    BOOL          Writing;                  // File created for writing, Buffer holds write-behind data.
+    unsigned int  BufferLen;                // Number of valid bytes in Buffer.
+    unsigned int  BufferPos;                // Read position in Buffer.
+    unsigned char Buffer[CAP_Buffer_Size];  // Read-ahead or write-behind buffer for the signal data.
     unsigned int  MemTag2;
 } INFOBLOCK, *PINFOBLOCK;
 
 
+// Internal function.
+// Write the buffered signal data to the image file.
+int CAP_FlushBuffer(HANDLE hHandle)
+{
+    PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
+
+    ASSERT(pInfoBlock != 0, CAP_Status_Error_Invalid_Handle);
+
+    if (pInfoBlock->BufferLen > 0)
+    {
+        if (fwrite(pInfoBlock->Buffer, pInfoBlock->BufferLen, 1, pInfoBlock->fd) != 1)
+            return CAP_Status_Error_Writing_data;
+
+        pInfoBlock->BufferLen = 0;
+    }
+
+    return CAP_Status_OK;
+}
+
+
+// Internal function.
+// Write out pending signal data, or drop read-ahead data, before the file is accessed directly.
+int CAP_SyncBuffer(HANDLE hHandle)
+{
+    PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
+
+    ASSERT(pInfoBlock != 0, CAP_Status_Error_Invalid_Handle);
+
+    if (pInfoBlock->Writing)
+        return CAP_FlushBuffer(hHandle);
+
+    pInfoBlock->BufferLen = 0;
+    pInfoBlock->BufferPos = 0;
+
+    return CAP_Status_OK;
+}
+
+
+// Internal function.
+// Make sure at least uiNeeded bytes are in the read-ahead buffer, if the file has that many left.
+int CAP_FillBuffer(HANDLE hHandle, unsigned int uiNeeded)
+{
+    PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
+
+    if (pInfoBlock->BufferLen - pInfoBlock->BufferPos >= uiNeeded)
+        return CAP_Status_OK;
+
+    // Move the rest to the front and append new data.
+    pInfoBlock->BufferLen -= pInfoBlock->BufferPos;
+    memmove(pInfoBlock->Buffer, &(pInfoBlock->Buffer[pInfoBlock->BufferPos]), pInfoBlock->BufferLen);
+    pInfoBlock->BufferPos = 0;
+
+    pInfoBlock->BufferLen += (unsigned int) fread(&(pInfoBlock->Buffer[pInfoBlock->BufferLen]), 1, CAP_Buffer_Size - pInfoBlock->BufferLen, pInfoBlock->fd);
+
+    if (pInfoBlock->BufferLen < uiNeeded)
+    {
+        if (ferror(pInfoBlock->fd) != 0)
+            return CAP_Status_Error_Reading_data;
+        else
+            return CAP_Status_OK_End_of_file;
+    }
+
+    return CAP_Status_OK;
+}
+
+
 // Exported function.
 // Create (overwrite) an image file for writing.
 int CAP_CreateFile(HANDLE *hHandle, char *pcFilename)
@@ -56,6 +129,7 @@ int CAP_CreateFile(HANDLE *hHandle, char *pcFilename)
     }
 
     pInfoBlock->StartOfs = 0;
+    pInfoBlock->Writing = TRUE;
     *hHandle = (HANDLE) pInfoBlock;
 
     return CAP_Status_OK;
@@ -99,6 +173,7 @@ int CAP_OpenFile(HANDLE *hHandle, char *pcFilename)
 int CAP_CloseFile(HANDLE *hHandle)
 {
     PINFOBLOCK pInfoBlock;
+    int        ret = CAP_Status_OK;
 
     ASSERT(hHandle != 0, CAP_Status_Error_Invalid_Handle);
 
@@ -107,14 +182,18 @@ int CAP_CloseFile(HANDLE *hHandle)
     ASSERT(pInfoBlock != 0, CAP_Status_Error_Invalid_Handle);
 
     if (pInfoBlock->fd != NULL)
-        if (fclose(pInfoBlock->fd) != 0)
-            return CAP_Status_Error_Closing_file;
+    {
+        ret = CAP_SyncBuffer(*hHandle);
+
+        if ((fclose(pInfoBlock->fd) != 0) && (ret == CAP_Status_OK))
+            ret = CAP_Status_Error_Closing_file;
+    }
 
     free(pInfoBlock);
 
     *hHandle = NULL;
 
-    return CAP_Status_OK;
+    return ret;
 }
 
 
@@ -140,6 +219,9 @@ int CAP_GetFileSize(HANDLE hHandle, int *piFileSize)
     ASSERT(pInfoBlock != 0, CAP_Status_Error_Invalid_Handle);
     ASSERT(piFileSize != 0, CAP_Status_Error_Invalid_pointer);
 
+    if (CAP_SyncBuffer(hHandle) != CAP_Status_OK)
+        return CAP_Status_Error_Writing_data;
+
     if (fseek(pInfoBlock->fd, 0, SEEK_END) != 0)
         return CAP_Status_Error_Seek_failed;
 
@@ -159,6 +241,9 @@ int CAP_SeekFile(HANDLE hHandle, char cDestination)
     ASSERT(pInfoBlock != 0, CAP_Status_Error_Invalid_Handle);
     ASSERT(pInfoBlock->fd != 0, CAP_Status_Error_File_not_open);
 
+    if (CAP_SyncBuffer(hHandle) != CAP_Status_OK)
+        return CAP_Status_Error_Writing_data;
+
     if (cDestination == SEEK_START_OF_FILE)
     {
         if (fseek(pInfoBlock->fd, 0, SEEK_SET) != 0)
@@ -391,6 +476,9 @@ int CAP_WriteHeaderAddon(HANDLE hHandle, unsigned char *pucString, unsigned int
     ASSERT(pInfoBlock != 0, CAP_Status_Error_Invalid_Handle);
     ASSERT(pInfoBlock->fd != 0, CAP_Status_Error_File_not_open);
 
+    if (CAP_SyncBuffer(hHandle) != CAP_Status_OK)
+        return CAP_Status_Error_Writing_data;
+
     if (fwrite(pucString, uiStringLen, 1, pInfoBlock->fd) != 1)
         return CAP_Status_Error_Writing_header;
 
@@ -402,8 +490,9 @@ int CAP_WriteHeaderAddon(HANDLE hHandle, unsigned char *pucString, unsigned int
 // Read a signal from image, increment byte counter.
 int CAP_ReadSignal(HANDLE hHandle, unsigned __int64 *pui64Signal, int *piCounter)
 {
-    unsigned char    buf5[5]; // Compatible with 40bit signal width.
+    unsigned char    *buf5; // Compatible with 40bit signal width.
     unsigned __int64 ui64Signal;
+    int              ret;
 
     PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
 
@@ -411,13 +500,11 @@ int CAP_ReadSignal(HANDLE hHandle, unsigned __int64 *pui64Signal, int *piCounter
     ASSERT(pInfoBlock->fd != 0, CAP_Status_Error_File_not_open);
     ASSERT(pui64Signal != 0, CAP_Status_Error_Invalid_pointer);
 
-    if (fread(buf5, 5, 1, pInfoBlock->fd) != 1)
-    {
-        if (feof(pInfoBlock->fd) == 0)
-            return CAP_Status_Error_Reading_data;
-        else
-            return CAP_Status_OK_End_of_file;
-    }
+    if ((ret = CAP_FillBuffer(hHandle, 5)) != CAP_Status_OK)
+        return ret;
+
+    buf5 = &(pInfoBlock->Buffer[pInfoBlock->BufferPos]);
+    pInfoBlock->BufferPos += 5;
 
     ui64Signal = buf5[0];
     ui64Signal = (ui64Signal << 8) + buf5[1];
@@ -434,6 +521,28 @@ int CAP_ReadSignal(HANDLE hHandle, unsigned __int64 *pui64Signal, int *piCounter
 }
 
 
+// Exported function.
+// Read up to uiMaxSignals signals from image, increment byte counter.
+// Returns CAP_Status_OK_End_of_file only if no signal was left.
+int CAP_ReadSignals(HANDLE hHandle, unsigned __int64 *pui64Signals, unsigned int uiMaxSignals, unsigned int *puiNumSignals, int *piCounter)
+{
+    unsigned int i = 0;
+    int          ret = CAP_Status_OK;
+
+    ASSERT(puiNumSignals != 0, CAP_Status_Error_Invalid_pointer);
+
+    while ((i < uiMaxSignals) && ((ret = CAP_ReadSignal(hHandle, &pui64Signals[i], piCounter)) == CAP_Status_OK))
+        i++;
+
+    *puiNumSignals = i;
+
+    if ((ret == CAP_Status_OK_End_of_file) && (i > 0))
+        ret = CAP_Status_OK;
+
+    return ret;
+}
+
+
 // Internal function.
 // Write a single byte to image, increment counter.
 int CAP_WriteSingleByte(HANDLE hHandle, unsigned char ucByte, int *piCounter)
@@ -445,9 +554,11 @@ int CAP_WriteSingleByte(HANDLE hHandle, unsigned char ucByte, int *piCounter)
     if (pInfoBlock->fd == NULL)
         return CAP_Status_Error_File_not_open;
 
-    if (fwrite(&ucByte, 1, 1, pInfoBlock->fd) != 1)
+    if ((pInfoBlock->BufferLen == CAP_Buffer_Size) && (CAP_FlushBuffer(hHandle) != CAP_Status_OK))
         return CAP_Status_Error_Writing_data;
 
+    pInfoBlock->Buffer[pInfoBlock->BufferLen++] = ucByte;
+
     if (piCounter != NULL)
         (*piCounter)++;
 
@@ -458,21 +569,49 @@ int CAP_WriteSingleByte(HANDLE hHandle, unsigned char ucByte, int *piCounter)
 // Write a signal to image, increment counter for each written byte.
 int CAP_WriteSignal(HANDLE hHandle, unsigned __int64 ui64Signal, int *piCounter)
 {
-    if (CAP_WriteSingleByte( hHandle, (unsigned char) ((ui64Signal >> 32) & 0xff), piCounter ) != CAP_Status_OK)
-        return CAP_Status_Error_Writing_data;
+    unsigned char *buf5;
 
-    if (CAP_WriteSingleByte( hHandle, (unsigned char) ((ui64Signal >> 24) & 0xff), piCounter ) != CAP_Status_OK)
-        return CAP_Status_Error_Writing_data;
+    PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
 
-    if (CAP_WriteSingleByte( hHandle, (unsigned char) ((ui64Signal >> 16) & 0xff), piCounter ) != CAP_Status_OK)
-        return CAP_Status_Error_Writing_data;
+    ASSERT(pInfoBlock != 0, CAP_Status_Error_Invalid_Handle);
 
-    if (CAP_WriteSingleByte( hHandle, (unsigned char) ((ui64Signal >> 8) & 0xff), piCounter ) != CAP_Status_OK)
-        return CAP_Status_Error_Writing_data;
+    if (pInfoBlock->fd == NULL)
+        return CAP_Status_Error_File_not_open;
 
-    if (CAP_WriteSingleByte( hHandle, (unsigned char) ((ui64Signal) & 0xff), piCounter ) != CAP_Status_OK)
+    if ((pInfoBlock->BufferLen > CAP_Buffer_Size - 5) && (CAP_FlushBuffer(hHandle) != CAP_Status_OK))
         return CAP_Status_Error_Writing_data;
 
+    buf5 = &(pInfoBlock->Buffer[pInfoBlock->BufferLen]);
+    pInfoBlock->BufferLen += 5;
+
+    buf5[0] = (unsigned char) ((ui64Signal >> 32) & 0xff);
+    buf5[1] = (unsigned char) ((ui64Signal >> 24) & 0xff);
+    buf5[2] = (unsigned char) ((ui64Signal >> 16) & 0xff);
+    buf5[3] = (unsigned char) ((ui64Signal >>  8) & 0xff);
+    buf5[4] = (unsigned char) ((ui64Signal      ) & 0xff);
+
+    if (piCounter != NULL)
+        (*piCounter)+=5;
+
+    return CAP_Status_OK;
+}
+
+
+// Exported function.
+// Write uiNumSignals signals to image, increment counter for each written byte.
+int CAP_WriteSignals(HANDLE hHandle, const unsigned __int64 *pui64Signals, unsigned int uiNumSignals, int *piCounter)
+{
+    unsigned int i;
+    int          ret;
+
+    ASSERT(pui64Signals != 0, CAP_Status_Error_Invalid_pointer);
+
+    for (i = 0; i < uiNumSignals; i++)
+    {
+        if ((ret = CAP_WriteSignal(hHandle, pui64Signals[i], piCounter)) != CAP_Status_OK)
+            return ret;
+    }
+
     return CAP_Status_OK;
 }
 
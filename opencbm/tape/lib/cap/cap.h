@@ -93,9 +93,15 @@ int CAP_WriteHeaderAddon(HANDLE hHandle, unsigned char *pucString, unsigned int
 // Read a signal from image, increment byte counter.
 int CAP_ReadSignal(HANDLE hHandle, unsigned __int64 *pui64Signal, int *piCounter);
 
+// Read up to uiMaxSignals signals from image, increment byte counter.
+int CAP_ReadSignals(HANDLE hHandle, unsigned __int64 *pui64Signals, unsigned int uiMaxSignals, unsigned int *puiNumSignals, int *piCounter);
+
 // Write a signal to image, increment counter for each written byte.
 int CAP_WriteSignal(HANDLE hHandle, unsigned __int64 ui64Signal, int *piCounter);
 
+// Write uiNumSignals signals to image, increment counter for each written byte.
+int CAP_WriteSignals(HANDLE hHandle, const unsigned __int64 *pui64Signals, unsigned int uiNumSignals, int *piCounter);
+
 // Verify header contents (Signature, Version, Precision, Machine, Video, StartEdge, SignalFormat, SignalWidth, StartOfs).
 int CAP_isValidHeader(HANDLE hHandle);
 
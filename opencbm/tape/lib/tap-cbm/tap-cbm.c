@@ -13,6 +13,9 @@
 
 #define Header_Size_TAP_CBM 0x14
 
+// Size of the read-ahead/write-behind buffer for the signal data.
+#define TAP_CBM_Buffer_Size 0x10000
+
 #define SEEK_START_OF_FILE 1
 #define SEEK_START_OF_DATA 2
 
@@ -26,10 +29,80 @@ typedef struct _INFOBLOCK {
     char          header[Header_Size_TAP_CBM+1]; // + 0-termination
     unsigned char Machine, Video, TAPversion;
     unsigned int  ByteCount;
+    BOOL          Writing;                      // File created for writing, Buffer holds write-behind data.
+    unsigned int  BufferLen;                    // Number of valid bytes in Buffer.
+    unsigned int  BufferPos;                    // Read position in Buffer.
+    unsigned char Buffer[TAP_CBM_Buffer_Size];  // Read-ahead or write-behind buffer for the signal data.
     unsigned int  MemTag2;
 } INFOBLOCK, *PINFOBLOCK;
 
 
+// Internal function.
+// Write the buffered signal data to the image file.
+int TAP_CBM_FlushBuffer(HANDLE hHandle)
+{
+    PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
+
+    ASSERT(pInfoBlock != 0, TAP_CBM_Status_Error_Invalid_Handle);
+
+    if (pInfoBlock->BufferLen > 0)
+    {
+        if (fwrite(pInfoBlock->Buffer, pInfoBlock->BufferLen, 1, pInfoBlock->fd) != 1)
+            return TAP_CBM_Status_Error_Writing_data;
+
+        pInfoBlock->BufferLen = 0;
+    }
+
+    return TAP_CBM_Status_OK;
+}
+
+
+// Internal function.
+// Write out pending signal data, or drop read-ahead data, before the file is accessed directly.
+int TAP_CBM_SyncBuffer(HANDLE hHandle)
+{
+    PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
+
+    ASSERT(pInfoBlock != 0, TAP_CBM_Status_Error_Invalid_Handle);
+
+    if (pInfoBlock->Writing)
+        return TAP_CBM_FlushBuffer(hHandle);
+
+    pInfoBlock->BufferLen = 0;
+    pInfoBlock->BufferPos = 0;
+
+    return TAP_CBM_Status_OK;
+}
+
+
+// Internal function.
+// Make sure at least uiNeeded bytes are in the read-ahead buffer, if the file has that many left.
+int TAP_CBM_FillBuffer(HANDLE hHandle, unsigned int uiNeeded)
+{
+    PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
+
+    if (pInfoBlock->BufferLen - pInfoBlock->BufferPos >= uiNeeded)
+        return TAP_CBM_Status_OK;
+
+    // Move the rest to the front and append new data.
+    pInfoBlock->BufferLen -= pInfoBlock->BufferPos;
+    memmove(pInfoBlock->Buffer, &(pInfoBlock->Buffer[pInfoBlock->BufferPos]), pInfoBlock->BufferLen);
+    pInfoBlock->BufferPos = 0;
+
+    pInfoBlock->BufferLen += (unsigned int) fread(&(pInfoBlock->Buffer[pInfoBlock->BufferLen]), 1, TAP_CBM_Buffer_Size - pInfoBlock->BufferLen, pInfoBlock->fd);
+
+    if (pInfoBlock->BufferLen < uiNeeded)
+    {
+        if (ferror(pInfoBlock->fd) != 0)
+            return TAP_CBM_Status_Error_Reading_data;
+        else
+            return TAP_CBM_Status_OK_End_of_file;
+    }
+
+    return TAP_CBM_Status_OK;
+}
+
+
 // Exported function.
 // Create (overwrite) an image file for writing.
 int TAP_CBM_CreateFile(HANDLE *hHandle, char *pcFilename)
@@ -55,6 +128,7 @@ int TAP_CBM_CreateFile(HANDLE *hHandle, char *pcFilename)
         return TAP_CBM_Status_Error_Creating_file;
     }
 
+    pInfoBlock->Writing = TRUE;
     *hHandle = (HANDLE) pInfoBlock;
 
     return TAP_CBM_Status_OK;
@@ -97,6 +171,7 @@ int TAP_CBM_OpenFile(HANDLE *hHandle, char *pcFilename)
 int TAP_CBM_CloseFile(HANDLE *hHandle)
 {
     PINFOBLOCK pInfoBlock;
+    int        ret = TAP_CBM_Status_OK;
 
     ASSERT(hHandle != 0, TAP_CBM_Status_Error_Invalid_Handle);
 
@@ -105,14 +180,18 @@ int TAP_CBM_CloseFile(HANDLE *hHandle)
     ASSERT(pInfoBlock != 0, TAP_CBM_Status_Error_Invalid_Handle);
 
     if (pInfoBlock->fd != NULL)
-        if (fclose(pInfoBlock->fd) != 0)
-            return TAP_CBM_Status_Error_Closing_file;
+    {
+        ret = TAP_CBM_SyncBuffer(*hHandle);
+
+        if ((fclose(pInfoBlock->fd) != 0) && (ret == TAP_CBM_Status_OK))
+            ret = TAP_CBM_Status_Error_Closing_file;
+    }
 
     free(pInfoBlock);
 
     *hHandle = NULL;
 
-    return TAP_CBM_Status_OK;
+    return ret;
 }
 
 
@@ -139,6 +218,9 @@ int TAP_CBM_GetFileSize(HANDLE hHandle, int *piFileSize)
     ASSERT(piFileSize != 0, TAP_CBM_Status_Error_Invalid_pointer);
     ASSERT(pInfoBlock->fd != 0, TAP_CBM_Status_Error_File_not_open);
 
+    if (TAP_CBM_SyncBuffer(hHandle) != TAP_CBM_Status_OK)
+        return TAP_CBM_Status_Error_Writing_data;
+
     if (fseek(pInfoBlock->fd, 0, SEEK_END) != 0)
         return TAP_CBM_Status_Error_Seek_failed;
 
@@ -158,6 +240,9 @@ int TAP_CBM_SeekFile(HANDLE hHandle, char cDestination)
     ASSERT(pInfoBlock != 0, TAP_CBM_Status_Error_Invalid_Handle);
     ASSERT(pInfoBlock->fd != 0, TAP_CBM_Status_Error_File_not_open);
 
+    if (TAP_CBM_SyncBuffer(hHandle) != TAP_CBM_Status_OK)
+        return TAP_CBM_Status_Error_Writing_data;
+
     if (cDestination == SEEK_START_OF_FILE)
     {
         if (fseek(pInfoBlock->fd, 0, SEEK_SET) != 0)
@@ -318,9 +403,10 @@ int TAP_CBM_WriteHeader(HANDLE hHandle)
 // Read a signal from image, increment counter for each read byte.
 int TAP_CBM_ReadSignal(HANDLE hHandle, unsigned int *puiSignal, unsigned int *puiCounter)
 {
-    unsigned char buf3[3];
+    unsigned char *buf3;
     unsigned char ch;
     unsigned int  uiSignal;
+    int           ret;
 
     PINFOBLOCK pInfoBlock = (struct _INFOBLOCK*)hHandle;
 
@@ -329,13 +415,10 @@ int TAP_CBM_ReadSignal(HANDLE hHandle, unsigned int *puiSignal, unsigned int *pu
     ASSERT(puiSignal != 0, TAP_CBM_Status_Error_Invalid_pointer);
     ASSERT(puiCounter != 0, TAP_CBM_Status_Error_Invalid_pointer);
 
-    if (fread(&ch, 1, 1, pInfoBlock->fd) != 1)
-    {
-        if (feof(pInfoBlock->fd) == 0)
-            return TAP_CBM_Status_Error_Reading_data;
-        else
-            return TAP_CBM_Status_OK_End_of_file;
-    }
+    if ((ret = TAP_CBM_FillBuffer(hHandle, 1)) != TAP_CBM_Status_OK)
+        return ret;
+
+    ch = pInfoBlock->Buffer[pInfoBlock->BufferPos++];
 
     if (ch == 0) // Pause detected.
     {
@@ -343,13 +426,11 @@ int TAP_CBM_ReadSignal(HANDLE hHandle, unsigned int *puiSignal, unsigned int *pu
             *puiSignal = 2040; // 8*0xff=2040
         else
         {
-            if (fread(buf3, 3, 1, pInfoBlock->fd) != 1)
-            {
-                if (feof(pInfoBlock->fd) == 0)
-                    return TAP_CBM_Status_Error_Reading_data;
-                else
-                    return TAP_CBM_Status_OK_End_of_file;
-            }
+            if ((ret = TAP_CBM_FillBuffer(hHandle, 3)) != TAP_CBM_Status_OK)
+                return ret;
+
+            buf3 = &(pInfoBlock->Buffer[pInfoBlock->BufferPos]);
+            pInfoBlock->BufferPos += 3;
 
             (*puiCounter)+=3;
 
@@ -378,9 +459,11 @@ int TAP_CBM_WriteSignal_1Byte(HANDLE hHandle, unsigned char ucByte, unsigned int
     ASSERT(pInfoBlock->fd != 0, TAP_CBM_Status_Error_File_not_open);
     ASSERT(puiCounter != 0, TAP_CBM_Status_Error_Invalid_pointer);
 
-    if (fwrite(&ucByte, 1, 1, pInfoBlock->fd) != 1)
+    if ((pInfoBlock->BufferLen == TAP_CBM_Buffer_Size) && (TAP_CBM_FlushBuffer(hHandle) != TAP_CBM_Status_OK))
         return TAP_CBM_Status_Error_Writing_data;
 
+    pInfoBlock->Buffer[pInfoBlock->BufferLen++] = ucByte;
+
     (*puiCounter)++;
 
     return TAP_CBM_Status_OK;
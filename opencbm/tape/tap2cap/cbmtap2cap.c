@@ -31,16 +31,15 @@ unsigned __int32  TAP_ByteCount;
 
 __int32 HandleDeltaAndWriteToCAP(HANDLE hCAP, unsigned __int64 ui64Delta, unsigned __int8 uiSplit)
 {
-    unsigned __int64 ui64SplitLen;
+    unsigned __int64 ui64SplitLen[2];
     __int32          FuncRes;
 
     if (uiSplit == NeedSplit)
     {
         // Write two halfwaves.
-        ui64SplitLen = ui64Delta/2;
-        Check_CAP_Error_TextRetM1(CAP_WriteSignal(hCAP, ui64SplitLen, NULL));
-        ui64SplitLen = ui64Delta-ui64SplitLen;
-        Check_CAP_Error_TextRetM1(CAP_WriteSignal(hCAP, ui64SplitLen, NULL));
+        ui64SplitLen[0] = ui64Delta/2;
+        ui64SplitLen[1] = ui64Delta-ui64SplitLen[0];
+        Check_CAP_Error_TextRetM1(CAP_WriteSignals(hCAP, ui64SplitLen, 2, NULL));
     }
     else
     {
@@ -23,6 +23,19 @@ CBM_FILE         fd;
 CRITICAL_SECTION CritSec_fd, CritSec_BreakHandler;
 BOOL             fd_Initialized = FALSE, AbortTapeOps = FALSE;
 
+// State of the conversion of capture data into CAP signals.
+// The capture data can arrive in pieces, thus a timestamp
+// may be split between two pieces.
+typedef struct _CAPTURE_STATE {
+    HANDLE           hCAP;
+    unsigned __int8  ucPending[5];      // Incomplete timestamp at the end of the last piece.
+    __int32          iPendingLen;
+    unsigned __int64 ui64TotalTapeTime;
+    unsigned __int32 uiNumSignals;
+    __int32          iCaptureLen;
+    BOOL             bWriteError;
+} CAPTURE_STATE;
+
 
 void usage(void)
 {
@@ -38,9 +51,11 @@ void usage(void)
     printf("  -spec48k: Spectrum48K \n");
     printf("  -x      : custom/unknown\n");
     printf("\n");
-    printf("You can specify the buffer size for the capture data (optional):\n\n");
+    printf("The capture data is written to the file while the tape is being read.\n");
+    printf("If your adapter does not support this, specify a buffer size for\n");
+    printf("capturing the whole tape into memory first (optional):\n\n");
     printf("  -b10 :  10 Megabyte\n");
-    printf("  -b25 :  25 Megabyte (default)\n");
+    printf("  -b25 :  25 Megabyte\n");
     printf("  -b50 :  50 Megabyte\n");
     printf("  -b100: 100 Megabyte\n");
     printf("\n");
@@ -64,7 +79,7 @@ __int32 EvaluateCommandlineParams(__int32 argc, __int8 *argv[], __int32 *piTapeB
         return -1;
     }
 
-    *piTapeBufferSize = 1024*1024*25; // Default buffer size: 25MB.
+    *piTapeBufferSize = 0; // Default: no buffer, stream into the file.
 
     // Evaluate flags.
     while (--argc && (*(++argv)[0] == '-'))
@@ -181,7 +196,7 @@ __int32 EvaluateCommandlineParams(__int32 argc, __int8 *argv[], __int32 *piTapeB
 
     if (bBufferSize == 0)
     {
-        printf("* Buffer size: 25 MB\n"); // use default value
+        printf("* Buffer size: none, streaming\n"); // use default value
     }
     else if (bBufferSize > 1)
     {
@@ -250,63 +265,104 @@ void OutputTapeLength(unsigned __int32 uiTotalTapeTimeSeconds, unsigned __int32
 }
 
 
-// Convert timestamps to 5 bytes, downscale precision to 1us if requested and write to CAP file.
-__int32 ConvertAndWriteCaptureData(HANDLE hCAP, unsigned __int8 *pucTapeBuffer, __int32 iCaptureLen, unsigned __int32 *puiTotalTapeTimeSeconds, unsigned __int32 *puiNumSignals)
+// Decode one timestamp of the capture data.
+// Returns the number of bytes used: 2 for a short signal (<2ms), 5 for a long signal (>=2ms).
+__int32 DecodeTimestamp(const unsigned __int8 *pucData, unsigned __int64 *pui64Delta)
 {
-    unsigned __int64 ui64Delta, ui64TotalTapeTime = 0;
-    __int32          FuncRes, i = 0;
+    unsigned __int64 ui64Delta;
 
-    *puiTotalTapeTimeSeconds = 0;
-    *puiNumSignals = 0;
+    ui64Delta = pucData[0];
+    ui64Delta = (ui64Delta << 8) + pucData[1];
 
-    while (i < iCaptureLen)
+    if (ui64Delta < 0x8000)
     {
-        ui64Delta = pucTapeBuffer[i];
-        ui64Delta = (ui64Delta << 8) + pucTapeBuffer[i+1];
+        // Short signal (<2ms)
+        *pui64Delta = ui64Delta;
+        return 2;
+    }
+
+    // Long signal (>=2ms)
+    ui64Delta &= 0x7fff;
+    ui64Delta = (ui64Delta << 8) + pucData[2];
+    ui64Delta = (ui64Delta << 8) + pucData[3];
+    ui64Delta = (ui64Delta << 8) + pucData[4];
+    *pui64Delta = ui64Delta;
+    return 5;
+}
+
+
+// Downscale precision to 1us if requested and write a signal to the CAP file.
+__int32 WriteCaptureSignal(CAPTURE_STATE *pState, unsigned __int64 ui64Delta)
+{
+    __int32 FuncRes;
+
+    pState->ui64TotalTapeTime += ui64Delta;
+    pState->uiNumSignals++;
+
+    if (CAP_Precision == 1) ui64Delta = (ui64Delta + 8) >> 4; // downscale by 16
+
+    FuncRes = CAP_WriteSignal(pState->hCAP, ui64Delta, NULL);
+    if (FuncRes != CAP_Status_OK)
+    {
+        CAP_OutputError(FuncRes);
+        pState->bWriteError = TRUE;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+// Convert a piece of the capture data to 5 byte timestamps and write them to the CAP file.
+// A timestamp which is incomplete at the end of the piece is kept until the next call.
+__int32 ConvertAndWriteCaptureData(CAPTURE_STATE *pState, const unsigned __int8 *pucData, __int32 iLen)
+{
+    unsigned __int64 ui64Delta;
+    __int32          i = 0;
 
-        if (ui64Delta < 0x8000)
+    pState->iCaptureLen += iLen;
+
+    while (i < iLen)
+    {
+        if ((pState->iPendingLen == 0) && (iLen - i >= 5))
         {
-            // Short signal (<2ms)
-            i += 2;
+            // Complete timestamp available.
+            i += DecodeTimestamp(&pucData[i], &ui64Delta);
         }
         else
         {
-            // Long signal (>=2ms)
-            ui64Delta &= 0x7fff;
-            ui64Delta = (ui64Delta << 8) + pucTapeBuffer[i+2];
-            ui64Delta = (ui64Delta << 8) + pucTapeBuffer[i+3];
-            ui64Delta = (ui64Delta << 8) + pucTapeBuffer[i+4];
-            i += 5;
-        }
+            // Collect a timestamp split between two pieces.
+            pState->ucPending[pState->iPendingLen++] = pucData[i++];
 
-        ui64TotalTapeTime += ui64Delta;
-        (*puiNumSignals)++;
+            if (pState->iPendingLen < 2)
+                continue;
 
-        if (CAP_Precision == 1) ui64Delta = (ui64Delta + 8) >> 4; // downscale by 16
+            if (pState->iPendingLen < ((pState->ucPending[0] & 0x80) ? 5 : 2))
+                continue;
 
-        FuncRes = CAP_WriteSignal(hCAP, ui64Delta, NULL);
-        if (FuncRes != CAP_Status_OK)
-        {
-            CAP_OutputError(FuncRes);
-            return -1;
+            DecodeTimestamp(pState->ucPending, &ui64Delta);
+            pState->iPendingLen = 0;
         }
-    }
 
-    // Calculate tape length in seconds.
-    *puiTotalTapeTimeSeconds = (unsigned __int32) (((ui64TotalTapeTime + 8000000) >> 10)/15625); //16000000;
+        if (WriteCaptureSignal(pState, ui64Delta) == -1)
+            return -1;
+    }
 
     return 0;
 }
 
 
-// Write tape image to specified image file.
-__int32 WriteTapeBufferToCaptureFile(HANDLE hCAP, unsigned __int8 *pucTapeBuffer, __int32 iCaptureLen)
+// Callback for streaming capture: convert and write the data as it arrives.
+int CBMAPIDECL CaptureStreamCallback(void *Context, const unsigned char *Data, unsigned int Length)
 {
-    unsigned __int32 uiTotalTapeTimeSeconds, uiNumSignals;
-    __int32          FuncRes;
+    return (ConvertAndWriteCaptureData((CAPTURE_STATE *) Context, Data, (__int32) Length) == -1) ? 1 : 0;
+}
 
-    if (iCaptureLen == 0)
-        printf("Empty capture file.\n");
+
+// Write CAP file header.
+__int32 WriteCaptureFileHeader(HANDLE hCAP)
+{
+    __int32 FuncRes;
 
     FuncRes = CAP_SetHeader(hCAP, CAP_Precision, CAP_Machine, CAP_Video, CAP_StartEdge, CAP_SignalFormat, CAP_SignalWidth, CAP_StartOfs);
     if (FuncRes != CAP_Status_OK)
@@ -329,18 +385,30 @@ __int32 WriteTapeBufferToCaptureFile(HANDLE hCAP, unsigned __int8 *pucTapeBuffer
         return -1;
     }
 
-    // Convert timestamps to 5 bytes, downscale precision to 1us if requested and write to CAP file.
-    if (ConvertAndWriteCaptureData(hCAP, pucTapeBuffer, iCaptureLen, &uiTotalTapeTimeSeconds, &uiNumSignals) == -1)
-        return -1;
+    return 0;
+}
 
-    // Print tape length to console.
-    OutputTapeLength(uiTotalTapeTimeSeconds, uiNumSignals, iCaptureLen);
 
-    return 0;
+// Print statistics of the written capture data to console.
+void FinishCaptureData(CAPTURE_STATE *pState)
+{
+    unsigned __int32 uiTotalTapeTimeSeconds;
+
+    if (pState->iCaptureLen == 0)
+        printf("Empty capture file.\n");
+
+    if (pState->iPendingLen != 0)
+        printf("Incomplete last timestamp dropped.\n");
+
+    // Calculate tape length in seconds.
+    uiTotalTapeTimeSeconds = (unsigned __int32) (((pState->ui64TotalTapeTime + 8000000) >> 10)/15625); //16000000;
+
+    // Print tape length to console.
+    OutputTapeLength(uiTotalTapeTimeSeconds, pState->uiNumSignals, pState->iCaptureLen);
 }
 
 
-__int32 CaptureTape(CBM_FILE fd, unsigned __int8 *pucTapeBuffer, __int32 iTapeBufferSize, __int32 *piCaptureLen)
+__int32 CaptureTape(CBM_FILE fd, unsigned __int8 *pucTapeBuffer, __int32 iTapeBufferSize, CAPTURE_STATE *pState)
 {
     unsigned __int8 ReadConfig, ReadConfig2;
     __int32         Status, BytesRead, BytesWritten, FuncRes;
@@ -586,19 +654,41 @@ __int32 CaptureTape(CBM_FILE fd, unsigned __int8 *pucTapeBuffer, __int32 iTapeBu
     //   - XUM1541_Error_NoTapeSupport
     //   - XUM1541_Error_NoDiskTapeMode
     //   - XUM1541_Error_TapeCmdInDiskMode
-    FuncRes = cbm_tap_start_capture(fd, pucTapeBuffer, iTapeBufferSize, &Status, &BytesRead);
-    if (FuncRes < 0)
+    if (pucTapeBuffer == NULL)
     {
-        printf("\nReturned error [capture]: ");
-        if (OutputFuncError(FuncRes) < 0)
-            printf("%d\n", FuncRes);
-        return -1;
+        // Convert and write the capture data while it arrives.
+        FuncRes = cbm_tap_capture_stream(fd, CaptureStreamCallback, pState, &Status, &BytesRead);
+        if (FuncRes < 0)
+        {
+            printf("\nReturned error [capture_stream]: ");
+            if (OutputFuncError(FuncRes) < 0)
+                printf("%d (streaming not supported? try a buffer size)\n", FuncRes);
+            return -1;
+        }
+        if (pState->bWriteError)
+            return -1;
+        if (Status == Tape_Status_ERROR_External_Break)
+        {
+            // Everything captured until now is in the file already.
+            printf("\nCapture aborted, the data read so far has been written.\n");
+            return -1;
+        }
     }
-    *piCaptureLen = BytesRead;
-    if (*piCaptureLen >= iTapeBufferSize)
+    else
     {
-        printf("\nError [capture]: Buffer full, use larger buffer size!\n");
-        return -1;
+        FuncRes = cbm_tap_start_capture(fd, pucTapeBuffer, iTapeBufferSize, &Status, &BytesRead);
+        if (FuncRes < 0)
+        {
+            printf("\nReturned error [capture]: ");
+            if (OutputFuncError(FuncRes) < 0)
+                printf("%d\n", FuncRes);
+            return -1;
+        }
+        if (BytesRead >= iTapeBufferSize)
+        {
+            printf("\nError [capture]: Buffer full, use larger buffer size!\n");
+            return -1;
+        }
     }
     if (Status != Tape_Status_OK_Capture_Finished)
     {
@@ -614,6 +704,13 @@ __int32 CaptureTape(CBM_FILE fd, unsigned __int8 *pucTapeBuffer, __int32 iTapeBu
 
     printf("\nReading finished OK.\n");
 
+    if (pucTapeBuffer != NULL)
+    {
+        // Convert timestamps to 5 bytes, downscale precision to 1us if requested and write to CAP file.
+        if (ConvertAndWriteCaptureData(pState, pucTapeBuffer, BytesRead) == -1)
+            return -1;
+    }
+
     return 0;
 }
 
@@ -652,9 +749,10 @@ BOOL BreakHandler(DWORD fdwCtrlType)
 int ARCH_MAINDECL main(int argc, char *argv[])
 {
     HANDLE          hCAP;
+    CAPTURE_STATE   State;
     unsigned __int8 *pucTapeBuffer = NULL;
     __int8          filename[_MAX_PATH];
-    __int32         iCaptureLen, iTapeBufferSize = 0;
+    __int32         iTapeBufferSize = 0;
     __int32         FuncRes, RetVal = -1;
 
     printf("\ntapread v1.00 - Commodore 1530/1531 tape image creator\n");
@@ -679,8 +777,8 @@ int ARCH_MAINDECL main(int argc, char *argv[])
         goto exit;
     }
 
-    // Allocate memory for tape image.
-    if (AllocateImageBuffer(&pucTapeBuffer, iTapeBufferSize) == -1)
+    // Allocate memory for tape image, if not streaming.
+    if ((iTapeBufferSize > 0) && (AllocateImageBuffer(&pucTapeBuffer, iTapeBufferSize) == -1))
         goto exit;
 
     // Check if specified image file is already existing.
@@ -701,6 +799,16 @@ int ARCH_MAINDECL main(int argc, char *argv[])
         goto exit;
     }
 
+    // Write the header first, so that the file is valid even if the capture is aborted.
+    if (WriteCaptureFileHeader(hCAP) == -1)
+    {
+        CAP_CloseFile(&hCAP);
+        goto exit;
+    }
+
+    memset(&State, 0, sizeof(State));
+    State.hCAP = hCAP;
+
     EnterCriticalSection(&CritSec_fd); // Acquire handle flag access.
 
     if (cbm_driver_open_ex(&fd, NULL) != 0)
@@ -714,30 +822,26 @@ int ARCH_MAINDECL main(int argc, char *argv[])
     fd_Initialized = TRUE;
     LeaveCriticalSection(&CritSec_fd); // Release handle flag access.
 
-    RetVal = CaptureTape(fd, pucTapeBuffer, iTapeBufferSize, &iCaptureLen);
+    RetVal = CaptureTape(fd, pucTapeBuffer, iTapeBufferSize, &State);
 
     EnterCriticalSection(&CritSec_fd); // Acquire handle flag access.
     cbm_driver_close(fd);
     fd_Initialized = FALSE;
     LeaveCriticalSection(&CritSec_fd); // Release handle flag access.
 
-    if (RetVal != 0)
-    {
-        CAP_CloseFile(&hCAP);
-        goto exit;
-    }
-
-    // Write tape image to specified image file.
-    RetVal = WriteTapeBufferToCaptureFile(hCAP, pucTapeBuffer, iCaptureLen);
+    if ((RetVal == 0) || (State.iCaptureLen > 0))
+        FinishCaptureData(&State);
 
     FuncRes = CAP_CloseFile(&hCAP);
     if (FuncRes != CAP_Status_OK)
     {
         CAP_OutputError(FuncRes);
+        RetVal = -1;
         goto exit;
     }
 
-    printf("Capture file successfully created.\n");
+    if (RetVal == 0)
+        printf("Capture file successfully created.\n");
 
     exit:
     DeleteCriticalSection(&CritSec_fd);
@@ -39,6 +39,9 @@ struct ProtocolFunctions *cmds;
 
 static int nib_check_write(uint8_t data);
 
+// Sampled bits of the last IEC line script, see iecScriptRun()
+static uint8_t scriptResult[XUM1541_IEC_SCRIPT_MAXLEN / 8];
+
 // Allow setting tracking var usbDataLen from outside.
 void Set_usbDataLen(uint16_t Len) { usbDataLen = Len; }
 
@@ -552,6 +555,95 @@ nib_check_write(uint8_t data)
     return true;
 }
 
+/*
+ * Wait for an IEC line as in iec_wait(), but give up after the timeout
+ * (in units of 10 ms, 0 = forever). Returns false on timeout or abort.
+ */
+static bool
+iecScriptWait(uint8_t line, uint8_t state, uint8_t timeout)
+{
+    uint16_t count = (uint16_t)timeout * 1000;
+
+    while (((cmds->cbm_poll() & line) != 0) != state) {
+        if (!TimerWorker())
+            return false;
+        if (timeout != 0 && count-- == 0)
+            return false;
+        DELAY_US(10);
+    }
+
+    return true;
+}
+
+/*
+ * Run an IEC line script of len bytes (XUM1541_IEC_SCRIPT). The
+ * operations are executed as they arrive, so no script buffer is
+ * needed. The sampled bits go to scriptResult[], LSB first.
+ *
+ * Returns false if a wait timed out. In that case, the rest of the
+ * script is read but not executed.
+ */
+static bool
+iecScriptRun(uint16_t len)
+{
+    uint8_t op, line, timeout, lastSample, samples;
+    bool ok;
+
+    timeout = lastSample = samples = 0;
+    ok = true;
+    memset(scriptResult, 0, sizeof(scriptResult));
+
+    usbInitIo(len, ENDPOINT_DIR_OUT);
+    while (len-- != 0) {
+        if (usbRecvByte(&op) != 0) {
+            ok = false;
+            break;
+        }
+        if (!ok)
+            continue;
+
+        line = IEC_SCRIPT_ARG(op) & ~IEC_SCRIPT_SRQ;
+        if (op & IEC_SCRIPT_SRQ)
+            line |= IEC_SRQ;
+
+        switch (IEC_SCRIPT_OP(op)) {
+        case IEC_SCRIPT_SET:
+            cmds->cbm_setrelease(line, 0);
+            break;
+        case IEC_SCRIPT_RELEASE:
+            cmds->cbm_setrelease(0, line);
+            break;
+        case IEC_SCRIPT_WAIT_SET:
+            ok = iecScriptWait(line, 1, timeout);
+            break;
+        case IEC_SCRIPT_WAIT_RELEASE:
+            ok = iecScriptWait(line, 0, timeout);
+            break;
+        case IEC_SCRIPT_WAIT_CHANGE:
+            ok = iecScriptWait(line, !lastSample, timeout);
+            break;
+        case IEC_SCRIPT_SAMPLE:
+            if (samples == sizeof(scriptResult) * 8) {
+                ok = false;
+                break;
+            }
+            lastSample = (cmds->cbm_poll() & line) != 0;
+            if (lastSample)
+                scriptResult[samples / 8] |= 1 << (samples % 8);
+            samples++;
+            break;
+        case IEC_SCRIPT_TIMEOUT:
+            timeout = IEC_SCRIPT_ARG(op);
+            break;
+        default:
+            break;
+        }
+    }
+    usbIoDone();
+
+    return ok;
+}
+
 /*
  * Delay a little (required), shutdown USB, disable watchdog and interrupts,
  * and jump to the bootloader.
@@ -657,7 +749,7 @@ usbHandleControl(uint8_t cmd, uint8_t *replyBuf)
 int8_t
 usbHandleBulk(uint8_t *request, uint8_t *status)
 {
-    uint8_t cmd, proto;
+    uint8_t cmd, proto, i;
     int8_t ret;
     uint16_t len;
     bool nibEarlyExit;
@@ -720,6 +812,17 @@ usbHandleBulk(uint8_t *request, uint8_t *status)
             ret = 0;
             break;
 #endif // SRQ_NIB_SUPPORT
+        case XUM1541_IEC_SCRIPT:
+            if (len > sizeof(scriptResult))
+                len = sizeof(scriptResult);
+            usbInitIo(len, ENDPOINT_DIR_IN);
+            for (i = 0; i < len; i++) {
+                if (usbSendByte(scriptResult[i]) != 0)
+                    break;
+            }
+            usbIoDone();
+            ret = 0;
+            break;
 #ifdef TAPE_SUPPORT
         case XUM1541_TAP:
             XUM_SET_STATUS_VAL(status, Tape_Capture());
@@ -780,6 +883,18 @@ usbHandleBulk(uint8_t *request, uint8_t *status)
             ret = 0;
             break;
 #endif // SRQ_NIB_SUPPORT
+        case XUM1541_IEC_SCRIPT:
+            if (len > XUM1541_IEC_SCRIPT_MAXLEN) {
+                ret = -1;
+                break;
+            }
+            if (!iecScriptRun(len)) {
+                ret = XUM1541_IO_ERROR;
+                break;
+            }
+            XUM_SET_STATUS_VAL(status,
+                scriptResult[0] | ((uint16_t)scriptResult[1] << 8));
+            break;
 #ifdef TAPE_SUPPORT
         case XUM1541_TAP:
             XUM_SET_STATUS_VAL(status, Tape_Write());
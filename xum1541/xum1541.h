@@ -141,6 +141,19 @@ extern volatile uint8_t TSR;
 #define IEC_RESET   0x08
 #define IEC_SRQ     0x80
 
+/* operations of XUM1541_IEC_SCRIPT (must match values from opencbm.h) */
+#define IEC_SCRIPT_OP(x)            ((x) & 0xe0)
+#define IEC_SCRIPT_ARG(x)           ((x) & 0x1f)
+#define IEC_SCRIPT_NOP              0x00
+#define IEC_SCRIPT_SET              0x20
+#define IEC_SCRIPT_RELEASE          0x40
+#define IEC_SCRIPT_WAIT_SET         0x60
+#define IEC_SCRIPT_WAIT_RELEASE     0x80
+#define IEC_SCRIPT_SAMPLE           0xa0
+#define IEC_SCRIPT_WAIT_CHANGE      0xc0
+#define IEC_SCRIPT_TIMEOUT          0xe0
+#define IEC_SCRIPT_SRQ              0x10 // SRQ is 0x10 in scripts
+
 /* specifiers for the IEEE-488 lines (must match values from opencbm.h) */
 #define IEE_NDAC    0x01 // Not data accepted
 #define IEE_NRFD    0x02 // Not ready for data
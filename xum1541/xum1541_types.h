@@ -15,7 +15,7 @@
 #define XUM1541_PID                 0x0504
 
 // XUM1541_INIT reports this versions
-#define XUM1541_VERSION             8
+#define XUM1541_VERSION             9
 #define XUM1541_MINIMUM_COMPATIBLE_VERSION 7
 
 // USB parameters for descriptor configuration
@@ -148,6 +148,7 @@
 #define XUM1541_NIB_SRQ_COMMAND     (9 << 4) // Serial commands
 #define XUM1541_TAP                (10 << 4) // tape read/write
 #define XUM1541_TAP_CONFIG         (11 << 4) // tape send/receive configuration
+#define XUM1541_IEC_SCRIPT         (12 << 4) // IEC line operation script
 
 // Flags for use with write and XUM1541_CBM protocol
 #define XUM_WRITE_TALK              (1 << 0)
@@ -156,4 +157,13 @@
 // Request an early exit from nib read via burst_read_track_var()
 #define XUM1541_NIB_READ_VAR        0x8000
 
+/*
+ * IEC line operation scripts (XUM1541_IEC_SCRIPT), firmware version 9
+ * and later. A write executes the script, which is made of the one-byte
+ * IEC_SCRIPT_... operations from opencbm.h. The status value holds the
+ * first 16 sampled bits; a following read returns all of them.
+ */
+#define XUM1541_IEC_SCRIPT_VERSION  9
+#define XUM1541_IEC_SCRIPT_MAXLEN   128
+
 #endif // _XUM1541_TYPES_H